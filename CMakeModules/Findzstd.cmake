@@ -9,9 +9,9 @@ find_path(ZSTD_INCLUDE_DIR
   NAMES zstd.h
   HINTS ${ZSTD_ROOT_DIR}/include)
 
+# The static library is preferred, the shared one is used where only it is installed
 find_library(ZSTD_LIBRARIES
-  #NAMES zstd
-  NAMES libzstd.a
+  NAMES libzstd.a zstd
   HINTS ${ZSTD_ROOT_DIR}/lib) #/usr/lib/x86_64-linux-gnu
 
 include(FindPackageHandleStandardArgs)
@@ -22,6 +22,6 @@ mark_as_advanced(
   ZSTD_INCLUDE_DIR)
 
 if(ZSTD_FOUND)
-    add_library(zstd STATIC IMPORTED)
+    add_library(zstd UNKNOWN IMPORTED)
     set_property(TARGET zstd PROPERTY IMPORTED_LOCATION ${ZSTD_LIBRARIES})
 endif()
\ No newline at end of file
@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 #include <cctype>
+#include <limits>
 
 #include <wls/app/api.hpp>
 #include <wls/app/api_access.hpp>
@@ -129,11 +130,26 @@ namespace wls { namespace app {
        _app.get_max_block_age( _max_block_age );
     }
 
+    network_broadcast_api::~network_broadcast_api()
+    {
+       if( _applied_block_subscription )
+          _app._block_notifier->unsubscribe( _applied_block_subscription );
+    }
+
     void network_broadcast_api::on_api_startup()
     {
-       /// note cannot capture shared pointer here, because _applied_block_connection will never
-       /// be freed if the lambda holds a reference to it.
-       _applied_block_connection = connect_signal( _app.chain_database()->applied_block, *this, &network_broadcast_api::on_applied_block );
+       if( !_app._block_notifier )
+          return;
+
+       /// note cannot capture shared pointer here, because the subscription would keep this api alive
+       /// forever. Confirmations must not be missed, so its blocks are never dropped.
+       std::weak_ptr< network_broadcast_api > weak_this = shared_from_this();
+       _applied_block_subscription = _app._block_notifier->subscribe( [weak_this]( const block_notification_ptr& n )
+       {
+          auto self = weak_this.lock();
+          if( self )
+             self->on_applied_block( n );
+       }, std::numeric_limits< uint32_t >::max() );
     }
 
     bool network_broadcast_api::check_max_block_age( int32_t max_block_age )
@@ -156,24 +172,42 @@ namespace wls { namespace app {
        _max_block_age = max_block_age;
     }
 
-    void network_broadcast_api::on_applied_block( const signed_block& b )
+    chain::transaction_pool_stats network_broadcast_api::get_transaction_pool_stats()const
     {
-       /// we need to ensure the database_api is not deleted for the life of the async operation
-       auto capture_this = shared_from_this();
+       if( _app._read_only )
+       {
+          // Transactions are pooled by the write node
+          if( !_app._remote_net_api )
+          {
+             _app.connect_to_write_node();
+             FC_ASSERT( _app._remote_net_api, "Write node RPC not configured properly or not currently connected." );
+          }
 
-       fc::async( [this,capture_this,b]() {
-          int32_t block_num = int32_t(b.block_num());
+          return (*_app._remote_net_api)->get_transaction_pool_stats();
+       }
+
+       return _app.chain_database()->_pending_tx.get_stats();
+    }
+
+    void network_broadcast_api::on_applied_block( const block_notification_ptr& n )
+    {
+       /// the notification is shared rather than copied, and carries the transaction ids
+       const signed_block& b = n->block->block();
+       int32_t block_num = int32_t(b.block_num());
+
+       /// callbacks are called without the mutex, a client sending a confirmation must not block new broadcasts
+       vector< std::pair< confirmation_callback, transaction_confirmation > > confirmations;
+       {
+          std::lock_guard< std::mutex > guard( _callbacks_mutex );
           if( _callbacks.size() )
           {
              for( size_t trx_num = 0; trx_num < b.transactions.size(); ++trx_num )
              {
-                const auto& trx = b.transactions[trx_num];
-                auto id = trx.id();
+                const auto& id = n->block->transactions()[trx_num].id;
                 auto itr = _callbacks.find(id);
                 if( itr == _callbacks.end() ) continue;
-                confirmation_callback callback = itr->second;
+                confirmations.emplace_back( itr->second, transaction_confirmation( id, block_num, int32_t(trx_num), false ) );
                 itr->second = [](variant){};
-                callback( fc::variant(transaction_confirmation( id, block_num, int32_t(trx_num), false )) );
              }
           }
 
@@ -192,16 +226,25 @@ namespace wls { namespace app {
                 if( cb_it == _callbacks.end() )
                    continue;
 
-                confirmation_callback callback = cb_it->second;
-                transaction_id_type txid_byval = txid;    // can't pass in by reference as it's going to be deleted
-                callback( fc::variant(transaction_confirmation{ txid_byval, block_num, -1, true}) );
-
+                confirmations.emplace_back( cb_it->second, transaction_confirmation{ txid, block_num, -1, true } );
                 _callbacks.erase( cb_it );
              }
              _callbacks_expirations.erase( exp_it );
           }
-       }); /// fc::async
+       }
 
+       for( const auto& c : confirmations )
+       {
+          /// a client that went away must not cost the others their confirmations
+          try
+          {
+             c.first( fc::variant( c.second ) );
+          }
+          catch( const fc::exception& e )
+          {
+             wlog( "Transaction confirmation failed: ${e}", ("e",e.to_string()) );
+          }
+       }
     }
 
     void network_broadcast_api::broadcast_transaction(const signed_transaction& trx)
@@ -287,8 +330,11 @@ namespace wls { namespace app {
        {
           FC_ASSERT( !check_max_block_age( _max_block_age ) );
           trx.validate();
-          _callbacks[trx.id()] = cb;
-          _callbacks_expirations[trx.expiration].push_back(trx.id());
+          {
+             std::lock_guard< std::mutex > guard( _callbacks_mutex );
+             _callbacks[trx.id()] = cb;
+             _callbacks_expirations[trx.expiration].push_back(trx.id());
+          }
 
           _app.chain_database()->push_transaction(trx);
           _app.p2p_node()->broadcast_transaction(trx);
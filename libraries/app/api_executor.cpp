@@ -0,0 +1,124 @@
+#include <wls/app/api_executor.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+
+namespace wls { namespace app {
+
+   namespace detail {
+
+      void api_slots::acquire()
+      {
+         fc::promise< void >::ptr waiter;
+         {
+            std::lock_guard< std::mutex > guard( _mutex );
+
+            if( _stats.running < _limits.max_concurrent )
+            {
+               ++_stats.running;
+               return;
+            }
+
+            if( _stats.queued >= _limits.max_queued )
+            {
+               ++_stats.rejected;
+               FC_THROW( "${api} is overloaded, ${r} calls running and ${q} queued", ("api",_api)("r",_stats.running)("q",_stats.queued) );
+            }
+
+            waiter.reset( new fc::promise< void >( "api_slots::acquire" ) );
+            _waiters.push_back( waiter );
+            ++_stats.queued;
+         }
+
+         try
+         {
+            // release() hands its slot over, so running already accounts for this call
+            fc::future< void >( waiter ).wait();
+         }
+         catch( ... )
+         {
+            bool handed_over = true;
+            {
+               std::lock_guard< std::mutex > guard( _mutex );
+               auto itr = std::find( _waiters.begin(), _waiters.end(), waiter );
+               if( itr != _waiters.end() )
+               {
+                  _waiters.erase( itr );
+                  --_stats.queued;
+                  handed_over = false;
+               }
+            }
+
+            if( handed_over )
+               release();
+            throw;
+         }
+      }
+
+      void api_slots::release()
+      {
+         fc::promise< void >::ptr next;
+         {
+            std::lock_guard< std::mutex > guard( _mutex );
+            ++_stats.completed;
+
+            if( _waiters.empty() )
+            {
+               --_stats.running;
+               return;
+            }
+
+            next = _waiters.front();
+            _waiters.pop_front();
+            --_stats.queued;
+         }
+
+         next->set_value();
+      }
+
+      api_call_stats api_slots::stats()const
+      {
+         std::lock_guard< std::mutex > guard( _mutex );
+         return _stats;
+      }
+   }
+
+   api_executor::api_executor( uint32_t threads )
+   {
+      _next_worker = 0;
+      _workers.resize( threads );
+      for( uint32_t i = 0; i < threads; ++i )
+         _workers[i] = std::make_shared< fc::thread >( "api_worker_" + fc::to_string( i ) );
+   }
+
+   api_executor::~api_executor() {}
+
+   void api_executor::add_api( const string& api, const api_limits& limits )
+   {
+      if( _workers.empty() )
+         return;
+
+      FC_ASSERT( limits.max_concurrent > 0, "${api} must be allowed at least one concurrent call", ("api",api) );
+      _slots[ api ].reset( new detail::api_slots( api, limits ) );
+   }
+
+   bool api_executor::is_pooled( const string& api )const
+   {
+      return _slots.find( api ) != _slots.end();
+   }
+
+   std::map< string, api_call_stats > api_executor::get_stats()const
+   {
+      std::map< string, api_call_stats > result;
+      for( const auto& s : _slots )
+         result[ s.first ] = s.second->stats();
+      return result;
+   }
+
+   fc::thread& api_executor::next_worker()
+   {
+      return *_workers[ _next_worker++ % _workers.size() ];
+   }
+
+} } // wls::app
@@ -24,6 +24,9 @@
 #include <wls/app/api.hpp>
 #include <wls/app/api_access.hpp>
 #include <wls/app/application.hpp>
+#include <wls/app/block_notifier.hpp>
+#include <wls/app/discussion_cache.hpp>
+#include <wls/app/operation_stream.hpp>
 #include <wls/app/plugin.hpp>
 
 #include <wls/chain/wls_objects.hpp>
@@ -254,11 +257,11 @@ namespace detail {
          {
             _next_rebroadcast = hbn + REBROADCAST_RAND_INTERVAL();
             uint32_t n = 0;
-            for( const auto& trx : _chain_db->_pending_tx )
+            _chain_db->_pending_tx.for_each( [&]( const protocol::signed_transaction& trx )
             {
                _p2p_network->broadcast( graphene::net::trx_message( trx ) );
                ++n;
-            }
+            });
             if( n > 0 )
             {
                ilog( "Force rebroadcast ${n} transactions", ("n", n) );
@@ -294,6 +297,7 @@ namespace detail {
          }
          elog( "max-undo is ${n}", ("n", max_undo) );
          _chain_db->set_max_undo(max_undo);
+         _chain_db->set_undo_journal( _options->at("undo-journal").as<bool>() );
 
 
          if( _options->at("backtrace").as<string>() == "yes" )
@@ -328,6 +332,15 @@ namespace detail {
                _chain_db->wipe(_data_dir / "blockchain", _shared_dir, true);
 
             _chain_db->set_flush_interval( _options->at("flush").as<uint32_t>() );
+            _chain_db->set_replay_threads( _options->at("replay-threads").as<uint32_t>() );
+            _chain_db->set_signature_threads( _options->at("signature-threads").as<uint32_t>() );
+            _chain_db->set_cashout_threads( _options->at("cashout-threads").as<uint32_t>() );
+            _chain_db->set_single_apply_production( _options->at("single-apply-production").as<bool>() );
+            _chain_db->_pending_tx.set_limits( _options->at("transaction-pool-size").as<uint32_t>(),
+               uint64_t( _options->at("transaction-pool-max-mb").as<uint32_t>() ) * 1024 * 1024,
+               _options->at("transaction-pool-max-per-account").as<uint32_t>() );
+            _chain_db->get_signature_cache().set_max_size( _options->at("signature-cache-size").as<uint32_t>() );
+            _chain_db->get_recent_transaction_cache().set_max_size( uint64_t( _options->at("recent-transaction-cache-size").as<uint32_t>() ) * 1024 * 1024 );
 
             flat_map<uint32_t,block_id_type> loaded_checkpoints;
             if( _options->count("checkpoint") )
@@ -342,7 +355,20 @@ namespace detail {
             }
             _chain_db->add_checkpoints( loaded_checkpoints );
 
-            if( _options->count("replay-blockchain") )
+            if( _options->count("import-snapshot") )
+            {
+               ilog("Importing state snapshot on user request.");
+               optional< fc::sha256 > expected_digest;
+               if( _options->count("snapshot-digest") )
+                  expected_digest = fc::sha256( _options->at("snapshot-digest").as<string>() );
+               _chain_db->import_snapshot( _data_dir / "blockchain", _shared_dir, _shared_file_size, fc::path( _options->at("import-snapshot").as<string>() ), expected_digest );
+            }
+            else if( _options->count("import-block-log") )
+            {
+               ilog("Importing block log on user request.");
+               _chain_db->import_block_log( _data_dir / "blockchain", _shared_dir, _shared_file_size, fc::path( _options->at("import-block-log").as<string>() ) );
+            }
+            else if( _options->count("replay-blockchain") )
             {
                ilog("Replaying blockchain on user request.");
                _chain_db->reindex( _data_dir / "blockchain", _shared_dir, _shared_file_size );
@@ -369,11 +395,22 @@ namespace detail {
                }
             }
 
+            if( _options->count("export-snapshot") )
+               _chain_db->export_snapshot( fc::path( _options->at("export-snapshot").as<string>() ) );
+
             if( _options->count("force-validate") )
             {
                ilog( "All transaction signatures will be validated" );
                _force_validate = true;
             }
+
+            if( _options->at("discussion-cache-size").as<uint32_t>() > 0 )
+               _self->_discussion_cache = std::make_shared< discussion_cache >( *_chain_db,
+                  _options->at("discussion-cache-size").as<uint32_t>(), _options->at("discussion-cache-max-age").as<uint32_t>() );
+
+            _self->_operation_stream = std::make_shared< operation_stream >( *_chain_db, _self->_account_history_store,
+               _plugins_enabled.count( "account_history" ) > 0 && _self->_account_history_complete,
+               _options->at("operation-stream-queue").as<uint32_t>(), _options->at("operation-stream-frame-blocks").as<uint32_t>() );
          }
          else
          {
@@ -394,6 +431,8 @@ namespace detail {
          }
          _chain_db->show_free_memory( true );
 
+         _self->_block_notifier = std::make_shared< block_notifier >( *_chain_db, _options->at("block-notification-queue").as<uint32_t>() );
+
          if( _options->count( "force-tx-rebroadcast" ) )
          {
             ilog( "Force transaction rebroadcast" );
@@ -442,10 +481,43 @@ namespace detail {
             reset_p2p_node(_data_dir);
          }
 
+         reset_api_executor();
          reset_websocket_server();
          reset_websocket_tls_server();
       } FC_LOG_AND_RETHROW() }
 
+      /**
+       * Entries of rpc-pool-api are api[:max_concurrent[:max_queued]]. Concurrency defaults to the
+       * number of rpc threads and the queue to rpc-max-queued.
+       */
+      void reset_api_executor()
+      {
+         uint32_t threads = _options->at("rpc-threads").as<uint32_t>();
+         _api_executor = std::make_shared< api_executor >( threads );
+         if( threads == 0 )
+            return;
+
+         api_limits defaults;
+         defaults.max_concurrent = threads;
+         defaults.max_queued = _options->at("rpc-max-queued").as<uint32_t>();
+
+         for( const string& entry : _options->at("rpc-pool-api").as< vector<string> >() )
+         {
+            vector< string > parts;
+            boost::split( parts, entry, boost::is_any_of( ":" ) );
+            FC_ASSERT( parts.size() <= 3 && !parts[0].empty(), "Invalid rpc-pool-api entry ${e}", ("e",entry) );
+
+            api_limits limits = defaults;
+            if( parts.size() > 1 )
+               limits.max_concurrent = boost::lexical_cast< uint32_t >( parts[1] );
+            if( parts.size() > 2 )
+               limits.max_queued = boost::lexical_cast< uint32_t >( parts[2] );
+
+            _api_executor->add_api( parts[0], limits );
+            ilog( "Running ${api} on the rpc pool, ${c} concurrent and ${q} queued calls", ("api",parts[0])("c",limits.max_concurrent)("q",limits.max_queued) );
+         }
+      }
+
       optional< api_access_info > get_api_access_info(const string& username)const
       {
          optional< api_access_info > result;
@@ -682,13 +754,23 @@ namespace detail {
          {
             return _chain_db->with_read_lock( [&]()
             {
-               auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
-               if( !opt_block )
+               auto packed = _chain_db->fetch_packed_block_by_id(id.item_hash);
+               if( !packed.valid() )
                   elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
                      ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
-               FC_ASSERT( opt_block.valid() );
-               // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-               return block_message(std::move(*opt_block));
+               FC_ASSERT( packed.valid() );
+
+               // A block_message is the packed block followed by its id, so it can be built
+               // from the stored bytes without deserializing and repacking the block.
+               block_id_type block_id = id.item_hash;
+               message result;
+               result.msg_type = block_message_type;
+               result.data.reserve( packed.size() + sizeof( block_id ) );
+               result.data.insert( result.data.end(), packed.data(), packed.data() + packed.size() );
+               auto packed_id = fc::raw::pack( block_id );
+               result.data.insert( result.data.end(), packed_id.begin(), packed_id.end() );
+               result.size = (uint32_t)result.data.size();
+               return result;
             });
          }
          return _chain_db->with_read_lock( [&]()
@@ -973,6 +1055,7 @@ namespace detail {
       std::shared_ptr<graphene::net::node>             _p2p_network;
       std::shared_ptr<fc::http::websocket_server>      _websocket_server;
       std::shared_ptr<fc::http::websocket_tls_server>  _websocket_tls_server;
+      std::shared_ptr<api_executor>                    _api_executor;
 
       std::map<string, std::shared_ptr<abstract_plugin> > _plugins_available;
       std::map<string, std::shared_ptr<abstract_plugin> > _plugins_enabled;
@@ -1024,6 +1107,14 @@ void application::set_program_options(boost::program_options::options_descriptio
    default_plugins.push_back( "account_by_key" );
    std::string str_default_plugins = boost::algorithm::join( default_plugins, " " );
 
+   std::vector< std::string > default_pool_apis;
+   default_pool_apis.push_back( "database_api" );
+   default_pool_apis.push_back( "follow_api" );
+   default_pool_apis.push_back( "tag_api" );
+   default_pool_apis.push_back( "account_by_key_api" );
+   default_pool_apis.push_back( "private_message_api" );
+   std::string str_default_pool_apis = boost::algorithm::join( default_pool_apis, " " );
+
    configuration_file_options.add_options()
          ("p2p-endpoint", bpo::value<string>(), "Endpoint for P2P node to listen on")
          ("p2p-max-connections", bpo::value<uint32_t>(), "Maxmimum number of incoming connections on P2P endpoint")
@@ -1044,11 +1135,33 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("flush", bpo::value< uint32_t >()->default_value(100000), "Flush shared memory file to disk this many blocks")
          ("backtrace", bpo::value<string>()->default_value("yes"), "Whether to print backtrace on SIGSEGV")
          ("max-undo", bpo::value< uint32_t >()->default_value(10000), "MAX_UNDO_HISTORY, default = 10000")
+         ("undo-journal", bpo::value< bool >()->default_value(false), "Keep undo state of comments and accounts as packed before-images in per-block journals instead of object copies")
+         ("replay-threads", bpo::value< uint32_t >()->default_value(2), "Number of threads deserializing and hashing blocks during replay")
+         ("signature-threads", bpo::value< uint32_t >()->default_value(2), "Number of threads recovering transaction signature keys of incoming blocks, 0 to recover serially")
+         ("cashout-threads", bpo::value< uint32_t >()->default_value(2), "Number of threads computing comment payouts due in a block, 0 to pay each comment out in turn")
+         ("single-apply-production", bpo::value< bool >()->default_value(false), "Produce blocks by applying pending transactions once, straight into the block, instead of rebuilding and re-applying them")
+         ("transaction-pool-size", bpo::value< uint32_t >()->default_value(20000), "Maximum number of pending transactions, the newest of the account with the most pending bytes are evicted beyond it")
+         ("transaction-pool-max-mb", bpo::value< uint32_t >()->default_value(64), "Maximum size in MB of the pending transactions")
+         ("transaction-pool-max-per-account", bpo::value< uint32_t >()->default_value(1000), "Maximum number of pending transactions sent by one account")
+         ("signature-cache-size", bpo::value< uint32_t >()->default_value(100000), "Number of recovered signature keys and verified transactions to cache, 0 to disable")
+         ("discussion-cache-size", bpo::value< uint32_t >()->default_value(10000), "Number of discussions hydrated by the get_discussions_by_* queries to keep, 0 to disable")
+         ("discussion-cache-max-age", bpo::value< uint32_t >()->default_value(20), "Blocks after which a cached discussion is hydrated again to pick up new voter reputations")
+         ("block-notification-queue", bpo::value< uint32_t >()->default_value(16), "Applied blocks waiting for a blocking API subscriber callback before the oldest ones are dropped, this is not backpressure on its connection")
+         ("operation-stream-queue", bpo::value< uint32_t >()->default_value(64), "Applied blocks an operation stream subscription may fall behind before it is caught up from account history, or loses them when none is kept")
+         ("operation-stream-frame-blocks", bpo::value< uint32_t >()->default_value(100), "Maximum number of blocks sent in one operation stream frame")
+         ("recent-transaction-cache-size", bpo::value< uint32_t >()->default_value(64), "Size in MB of the cache of recent transaction bodies served to peers, 0 to disable")
+         ("rpc-threads", bpo::value< uint32_t >()->default_value(4), "Number of threads executing calls to pooled APIs, 0 to run every call on the thread that received it")
+         ("rpc-pool-api", bpo::value< vector<string> >()->composing()->default_value(default_pool_apis, str_default_pool_apis), "API to run on the rpc threads as api[:max_concurrent[:max_queued]], may be specified multiple times")
+         ("rpc-max-queued", bpo::value< uint32_t >()->default_value(1000), "Default number of calls to a pooled API waiting for a thread before new calls are rejected")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
          ("replay-blockchain", "Rebuild object graph by replaying all blocks")
          ("resync-blockchain", "Delete all blocks and re-sync with network from scratch")
+         ("import-snapshot", bpo::value<string>(), "Rebuild the chain state from a state snapshot file instead of replaying the block log")
+         ("snapshot-digest", bpo::value<string>(), "State digest the snapshot given to import-snapshot must have, as logged by the node that exported it")
+         ("import-block-log", bpo::value<string>(), "Rebuild the chain from a block_log (and block_log.index) copied from another node, validating every block")
+         ("export-snapshot", bpo::value<string>(), "Write the chain state at the last irreversible block to a state snapshot file on startup")
          ("force-validate", "Force validation of all transactions")
          ("read-only", "Node will not connect to p2p network and can only read from the chain state" )
          ("check-locks", "Check correctness of chainbase locking")
@@ -1128,6 +1241,11 @@ fc::api_ptr application::create_api_by_name( const api_context& ctx )
    return my->create_api_by_name( ctx );
 }
 
+std::shared_ptr< api_executor > application::get_api_executor()const
+{
+   return my->_api_executor;
+}
+
 void application::get_max_block_age( int32_t& result )
 {
    my->get_max_block_age( result );
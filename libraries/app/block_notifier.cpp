@@ -0,0 +1,181 @@
+#include <wls/app/block_notifier.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <mutex>
+
+namespace wls { namespace app {
+
+   namespace detail {
+
+      struct block_subscriber
+      {
+         block_subscriber( uint64_t i, const block_notifier::callback& c, uint32_t m ) : id( i ), cb( c ), max_queued( m ) {}
+
+         uint64_t                                  id = 0;
+         block_notifier::callback                  cb;
+         uint32_t                                  max_queued = 0;
+
+         std::deque< block_notification_ptr >      queue;
+         bool                                      draining = false;   ///< a drain task is scheduled or running
+         bool                                      removed = false;
+         uint64_t                                  delivered = 0;
+         bool                                      overflowed = false;   ///< blocks were dropped since the last delivery
+      };
+
+      typedef std::shared_ptr< block_subscriber > block_subscriber_ptr;
+
+      class block_notifier_impl
+      {
+         public:
+            block_notifier_impl() : thread( "block_notifier" ) {}
+
+            /// Runs on the thread applying blocks, under the database write lock
+            void on_block( const chain::prepared_block_ptr& b )
+            {
+               {
+                  std::lock_guard< std::mutex > guard( mutex );
+                  if( subscribers.empty() )
+                     return;
+               }
+
+               auto n = std::make_shared< block_notification >();
+               n->block = b;
+               n->header = fc::variant( signed_block_header( b->block() ) );
+               block_notification_ptr note = n;
+
+               std::lock_guard< std::mutex > guard( mutex );
+               ++stats.notifications;
+
+               for( const auto& entry : subscribers )
+               {
+                  auto s = entry.second;
+                  s->queue.push_back( note );
+                  if( s->queue.size() > s->max_queued )
+                  {
+                     s->queue.pop_front();
+                     if( !s->overflowed )
+                        wlog( "Block notification subscriber ${id} is blocking the notifier thread, dropping its oldest blocks", ("id", s->id) );
+                     s->overflowed = true;
+                  }
+
+                  if( !s->draining )
+                  {
+                     s->draining = true;
+                     auto impl = this;
+                     thread.async( [impl,s]() { impl->drain( s ); }, "block_notifier::drain" );
+                  }
+               }
+            }
+
+            /// Delivers the queued blocks of one subscriber in order, without holding the mutex in its callback
+            void drain( const block_subscriber_ptr& s )
+            {
+               while( true )
+               {
+                  block_notification_ptr note;
+                  {
+                     std::lock_guard< std::mutex > guard( mutex );
+                     if( s->removed || s->queue.empty() )
+                     {
+                        s->draining = false;
+                        return;
+                     }
+
+                     note = s->queue.front();
+                     s->queue.pop_front();
+                  }
+
+                  try
+                  {
+                     s->cb( note );
+                  }
+                  catch( ... )
+                  {
+                     std::lock_guard< std::mutex > guard( mutex );
+                     remove( s );
+                     ++stats.failed;
+                     s->draining = false;
+                     return;
+                  }
+
+                  std::lock_guard< std::mutex > guard( mutex );
+                  ++s->delivered;
+                  ++stats.delivered;
+                  s->overflowed = false;
+               }
+            }
+
+            void remove( const block_subscriber_ptr& s )
+            {
+               s->removed = true;
+               s->queue.clear();
+               subscribers.erase( s->id );
+            }
+
+            mutable std::mutex                              mutex;
+            uint32_t                                        max_queued = 0;
+            uint64_t                                        next_id = 1;
+            std::map< uint64_t, block_subscriber_ptr >      subscribers;
+            block_notifier_stats                            stats;
+
+            boost::signals2::scoped_connection              block_connection;
+
+            /// Declared last so it stops before the subscribers its tasks use are destroyed
+            fc::thread                                      thread;
+      };
+   }
+
+   block_notifier::block_notifier( chain::database& db, uint32_t max_queued )
+      : my( new detail::block_notifier_impl() )
+   {
+      my->max_queued = std::max( max_queued, 1u );
+
+      auto* impl = my.get();
+      my->block_connection = db.applied_prepared_block.connect( [impl]( const chain::prepared_block_ptr& b ){ impl->on_block( b ); } );
+   }
+
+   block_notifier::~block_notifier()
+   {
+      my->block_connection.disconnect();
+      my->thread.quit();
+   }
+
+   uint64_t block_notifier::subscribe( callback cb, uint32_t max_queued )
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      uint64_t id = my->next_id++;
+      my->subscribers[ id ] = std::make_shared< detail::block_subscriber >( id, cb, max_queued ? max_queued : my->max_queued );
+      return id;
+   }
+
+   void block_notifier::unsubscribe( uint64_t id )
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      auto itr = my->subscribers.find( id );
+      if( itr == my->subscribers.end() )
+         return;
+
+      auto s = itr->second;
+      my->remove( s );
+   }
+
+   block_notifier_stats block_notifier::get_stats()const
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      auto stats = my->stats;
+      for( const auto& entry : my->subscribers )
+      {
+         block_subscriber_stats s;
+         s.id = entry.first;
+         s.queued = entry.second->queue.size();
+         s.delivered = entry.second->delivered;
+         stats.subscribers.push_back( s );
+      }
+      return stats;
+   }
+
+} } // wls::app
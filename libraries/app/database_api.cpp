@@ -18,6 +18,7 @@
 
 #include <cfenv>
 #include <iostream>
+#include <mutex>
 
 #define GET_REQUIRED_FEES_MAX_RECURSION 4
 
@@ -67,17 +68,21 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       bool verify_authority( const signed_transaction& trx )const;
       bool verify_account_authority( const string& name_or_id, const flat_set<public_key_type>& signers )const;
 
-      // signal handlers
-      void on_applied_block( const chain::signed_block& b );
-
-      std::function<void(const fc::variant&)> _block_applied_callback;
-
       wls::chain::database&                _db;
       std::shared_ptr< wls::follow::follow_api > _follow_api;
+      std::shared_ptr< wls::follow::merged_feed > _feed_merger;   ///< set when the follow plugin merges feeds instead of writing feed_index
+      std::shared_ptr< tags::tag_ranking_index > _tag_ranking;   ///< serves the discussion queries when the tags plugin keeps them in memory
 
-      boost::signals2::scoped_connection       _block_applied_connection;
+      std::shared_ptr< block_notifier >        _block_notifier;
+      uint64_t                                 _block_applied_subscription = 0;
+
+      std::shared_ptr< operation_stream >      _operation_stream;
+      std::mutex                               _operation_subscriptions_mutex;
+      flat_set< uint64_t >                     _operation_subscriptions;   ///< only this session may unsubscribe them
 
       bool _disable_get_block = false;
+      std::shared_ptr< chain::account_history_store > _account_history_store;
+      std::shared_ptr< discussion_cache >                _discussion_cache;
 };
 
 applied_operation::applied_operation() {}
@@ -94,6 +99,17 @@ applied_operation::applied_operation( const operation_object& op_obj )
    op = fc::raw::unpack< operation >( op_obj.serialized_op );
 }
 
+applied_operation::applied_operation( const history_operation& op_obj )
+ : trx_id( op_obj.trx_id ),
+   block( op_obj.block ),
+   trx_in_block( op_obj.trx_in_block ),
+   op_in_trx( op_obj.op_in_trx ),
+   virtual_op( op_obj.virtual_op ),
+   timestamp( op_obj.timestamp )
+{
+   op = fc::raw::unpack< operation >( op_obj.serialized_op );
+}
+
 void find_accounts( set<string>& accounts, const discussion& d ) {
    accounts.insert( d.author );
 }
@@ -112,22 +128,48 @@ void database_api::set_block_applied_callback( std::function<void(const variant&
    });
 }
 
-void database_api_impl::on_applied_block( const chain::signed_block& b )
+block_notifier_stats database_api::get_block_notifier_stats()const
 {
-   try
-   {
-      _block_applied_callback( fc::variant(signed_block_header(b) ) );
-   }
-   catch( ... )
-   {
-      _block_applied_connection.release();
-   }
+   if( my->_block_notifier )
+      return my->_block_notifier->get_stats();
+   return block_notifier_stats();
+}
+
+uint64_t database_api::subscribe_operations( std::function<void(const variant& frame)> cb, const operation_stream_filter& filter, uint32_t start_block )
+{
+   FC_ASSERT( my->_operation_stream, "Operations are streamed by the write node" );
+
+   /// The stream removes the subscription when cb throws, as when the client went away
+   auto id = my->_operation_stream->subscribe( [cb]( const operation_stream_frame& f ){ cb( fc::variant( f ) ); }, filter, start_block );
+
+   std::lock_guard< std::mutex > guard( my->_operation_subscriptions_mutex );
+   my->_operation_subscriptions.insert( id );
+   return id;
+}
+
+void database_api::unsubscribe_operations( uint64_t id )
+{
+   std::lock_guard< std::mutex > guard( my->_operation_subscriptions_mutex );
+   FC_ASSERT( my->_operation_subscriptions.erase( id ), "Unknown operation subscription ${id}", ("id",id) );
+   my->_operation_stream->unsubscribe( id );
+}
+
+operation_stream_stats database_api::get_operation_stream_stats()const
+{
+   if( my->_operation_stream )
+      return my->_operation_stream->get_stats();
+   return operation_stream_stats();
 }
 
 void database_api_impl::set_block_applied_callback( std::function<void(const variant& block_header)> cb )
 {
-   _block_applied_callback = cb;
-   _block_applied_connection = connect_signal( _db.applied_block, *this, &database_api_impl::on_applied_block );
+   FC_ASSERT( _block_notifier, "Block notifications are not available" );
+
+   if( _block_applied_subscription )
+      _block_notifier->unsubscribe( _block_applied_subscription );
+
+   /// The notifier removes the subscription when cb throws, as when the client went away
+   _block_applied_subscription = _block_notifier->subscribe( [cb]( const block_notification_ptr& n ){ cb( n->header ); } );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -147,18 +189,34 @@ database_api_impl::database_api_impl( const wls::app::api_context& ctx )
    wlog("creating database api ${x}", ("x",int64_t(this)) );
 
    _disable_get_block = ctx.app._disable_get_block;
+   _account_history_store = ctx.app._account_history_store;
+   _discussion_cache = ctx.app._discussion_cache;
+   _block_notifier = ctx.app._block_notifier;
+   _operation_stream = ctx.app._operation_stream;
 
    try
    {
-      ctx.app.get_plugin< follow::follow_plugin >( FOLLOW_PLUGIN_NAME );
+      _feed_merger = ctx.app.get_plugin< follow::follow_plugin >( FOLLOW_PLUGIN_NAME )->feed_merger;
       _follow_api = std::make_shared< wls::follow::follow_api >( ctx );
    }
    catch( fc::assert_exception ) { ilog("Follow Plugin not loaded"); }
+
+   try
+   {
+      _tag_ranking = ctx.app.get_plugin< tags::tags_plugin >( TAGS_PLUGIN_NAME )->get_ranking_index();
+   }
+   catch( fc::assert_exception ) { ilog("Tags Plugin not loaded"); }
 }
 
 database_api_impl::~database_api_impl()
 {
    elog("freeing database api ${x}", ("x",int64_t(this)) );
+
+   if( _block_applied_subscription )
+      _block_notifier->unsubscribe( _block_applied_subscription );
+
+   for( auto id : _operation_subscriptions )
+      _operation_stream->unsubscribe( id );
 }
 
 void database_api::on_api_startup() {}
@@ -173,7 +231,7 @@ optional<block_header> database_api::get_block_header(uint32_t block_num)const
 {
    FC_ASSERT( !my->_disable_get_block, "get_block_header is disabled on this node." );
 
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_block_header( block_num );
    });
@@ -191,7 +249,7 @@ optional<signed_block_api_obj> database_api::get_block(uint32_t block_num)const
 {
    FC_ASSERT( !my->_disable_get_block, "get_block is disabled on this node." );
 
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_block( block_num );
    });
@@ -204,7 +262,10 @@ optional<signed_block_api_obj> database_api_impl::get_block(uint32_t block_num)c
 
 vector<applied_operation> database_api::get_ops_in_block(uint32_t block_num, bool only_virtual)const
 {
-   return my->_db.with_read_lock( [&]()
+   if( my->_account_history_store )
+      return my->get_ops_in_block( block_num, only_virtual );
+
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_ops_in_block( block_num, only_virtual );
    });
@@ -212,6 +273,18 @@ vector<applied_operation> database_api::get_ops_in_block(uint32_t block_num, boo
 
 vector<applied_operation> database_api_impl::get_ops_in_block(uint32_t block_num, bool only_virtual)const
 {
+   if( _account_history_store )
+   {
+      vector<applied_operation> result;
+      for( const auto& stored : _account_history_store->get_ops_in_block( block_num ) )
+      {
+         applied_operation temp( stored );
+         if( !only_virtual || is_virtual_operation(temp.op) )
+            result.push_back( std::move( temp ) );
+      }
+      return result;
+   }
+
    const auto& idx = _db.get_index< operation_index >().indices().get< by_location >();
    auto itr = idx.lower_bound( block_num );
    vector<applied_operation> result;
@@ -235,7 +308,7 @@ vector<applied_operation> database_api_impl::get_ops_in_block(uint32_t block_num
 
 fc::variant_object database_api::get_config()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_config();
    });
@@ -248,7 +321,7 @@ fc::variant_object database_api_impl::get_config()const
 
 dynamic_global_property_api_obj database_api::get_dynamic_global_properties()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_dynamic_global_properties();
    });
@@ -256,7 +329,7 @@ dynamic_global_property_api_obj database_api::get_dynamic_global_properties()con
 
 chain_properties database_api::get_chain_properties()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->_db.get_witness_schedule_object().median_props;
    });
@@ -269,7 +342,7 @@ dynamic_global_property_api_obj database_api_impl::get_dynamic_global_properties
 
 witness_schedule_api_obj database_api::get_witness_schedule()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->_db.get(witness_schedule_id_type());
    });
@@ -277,7 +350,7 @@ witness_schedule_api_obj database_api::get_witness_schedule()const
 
 hardfork_version database_api::get_hardfork_version()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->_db.get(hardfork_property_id_type()).current_hardfork_version;
    });
@@ -285,7 +358,7 @@ hardfork_version database_api::get_hardfork_version()const
 
 scheduled_hardfork database_api::get_next_scheduled_hardfork() const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       scheduled_hardfork shf;
       const auto& hpo = my->_db.get(hardfork_property_id_type());
@@ -297,7 +370,7 @@ scheduled_hardfork database_api::get_next_scheduled_hardfork() const
 
 reward_fund_api_obj database_api::get_reward_fund( string name )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       auto fund = my->_db.find< reward_fund_object, by_name >( name );
       FC_ASSERT( fund != nullptr, "Invalid reward fund name" );
@@ -314,7 +387,7 @@ reward_fund_api_obj database_api::get_reward_fund( string name )const
 
 vector<set<string>> database_api::get_key_references( vector<public_key_type> key )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_key_references( key );
    });
@@ -338,7 +411,7 @@ vector<set<string>> database_api_impl::get_key_references( vector<public_key_typ
 
 vector< extended_account > database_api::get_accounts( vector< string > names )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_accounts( names );
    });
@@ -375,7 +448,7 @@ vector< extended_account > database_api_impl::get_accounts( vector< string > nam
 
 vector<account_id_type> database_api::get_account_references( account_id_type account_id )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_account_references( account_id );
    });
@@ -400,7 +473,7 @@ vector<account_id_type> database_api_impl::get_account_references( account_id_ty
 
 vector<optional<account_api_obj>> database_api::lookup_account_names(const vector<string>& account_names)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->lookup_account_names( account_names );
    });
@@ -430,7 +503,7 @@ vector<optional<account_api_obj>> database_api_impl::lookup_account_names(const
 
 set<string> database_api::lookup_accounts(const string& lower_bound_name, uint32_t limit)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->lookup_accounts( lower_bound_name, limit );
    });
@@ -446,6 +519,7 @@ set<string> database_api_impl::lookup_accounts(const string& lower_bound_name, u
         limit-- && itr != accounts_by_name.end();
         ++itr )
    {
+      _db.check_preempt();
       result.insert(itr->name);
    }
 
@@ -454,7 +528,7 @@ set<string> database_api_impl::lookup_accounts(const string& lower_bound_name, u
 
 uint64_t database_api::get_account_count()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_account_count();
    });
@@ -467,7 +541,7 @@ uint64_t database_api_impl::get_account_count()const
 
 vector< withdraw_route > database_api::get_withdraw_routes( string account, withdraw_route_type type )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       vector< withdraw_route > result;
 
@@ -537,7 +611,7 @@ optional< account_bandwidth_api_obj > database_api::get_account_bandwidth( strin
 
 vector<optional<witness_api_obj>> database_api::get_witnesses(const vector<witness_id_type>& witness_ids)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_witnesses( witness_ids );
    });
@@ -557,7 +631,7 @@ vector<optional<witness_api_obj>> database_api_impl::get_witnesses(const vector<
 
 fc::optional<witness_api_obj> database_api::get_witness_by_account( string account_name ) const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_witness_by_account( account_name );
    });
@@ -565,7 +639,7 @@ fc::optional<witness_api_obj> database_api::get_witness_by_account( string accou
 
 vector< witness_api_obj > database_api::get_witnesses_by_vote( string from, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       //idump((from)(limit));
       FC_ASSERT( limit <= 100 );
@@ -587,6 +661,7 @@ vector< witness_api_obj > database_api::get_witnesses_by_vote( string from, uint
             result.size() < limit &&
             itr->votes > 0 )
       {
+         my->_db.check_preempt();
          result.push_back( witness_api_obj( *itr ) );
          ++itr;
       }
@@ -605,7 +680,7 @@ fc::optional<witness_api_obj> database_api_impl::get_witness_by_account( string
 
 set< account_name_type > database_api::lookup_witness_accounts( const string& lower_bound_name, uint32_t limit ) const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->lookup_witness_accounts( lower_bound_name, limit );
    });
@@ -633,7 +708,7 @@ set< account_name_type > database_api_impl::lookup_witness_accounts( const strin
 
 uint64_t database_api::get_witness_count()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_witness_count();
    });
@@ -652,7 +727,7 @@ uint64_t database_api_impl::get_witness_count()const
 
 std::string database_api::get_transaction_hex(const signed_transaction& trx)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_transaction_hex( trx );
    });
@@ -665,7 +740,7 @@ std::string database_api_impl::get_transaction_hex(const signed_transaction& trx
 
 set<public_key_type> database_api::get_required_signatures( const signed_transaction& trx, const flat_set<public_key_type>& available_keys )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_required_signatures( trx, available_keys );
    });
@@ -686,7 +761,7 @@ set<public_key_type> database_api_impl::get_required_signatures( const signed_tr
 
 set<public_key_type> database_api::get_potential_signatures( const signed_transaction& trx )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->get_potential_signatures( trx );
    });
@@ -729,7 +804,7 @@ set<public_key_type> database_api_impl::get_potential_signatures( const signed_t
 
 bool database_api::verify_authority( const signed_transaction& trx ) const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->verify_authority( trx );
    });
@@ -747,7 +822,7 @@ bool database_api_impl::verify_authority( const signed_transaction& trx )const
 
 bool database_api::verify_account_authority( const string& name_or_id, const flat_set<public_key_type>& signers )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       return my->verify_account_authority( name_or_id, signers );
    });
@@ -770,7 +845,7 @@ bool database_api_impl::verify_account_authority( const string& name, const flat
 
 discussion database_api::get_content( string author, string permlink )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       const auto& by_permlink_idx = my->_db.get_index< comment_index >().indices().get< by_permlink >();
       auto itr = by_permlink_idx.find( boost::make_tuple( author, permlink ) );
@@ -787,7 +862,7 @@ discussion database_api::get_content( string author, string permlink )const
 
 vector<vote_state> database_api::get_active_votes( string author, string permlink )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       vector<vote_state> result;
       const auto& comment = my->_db.get_comment( author, permlink );
@@ -820,7 +895,7 @@ vector<vote_state> database_api::get_active_votes( string author, string permlin
 
 vector<account_vote> database_api::get_account_votes( string voter )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       vector<account_vote> result;
 
@@ -856,16 +931,26 @@ u256 to256( const fc::uint128& t )
 
 void database_api::set_pending_payout( discussion& d )const
 {
-   asset pot;
-   pot = my->_db.get_reward_fund( my->_db.get_comment( d.author, d.permlink ) ).reward_balance;
+   set_pending_payout_value( d );
 
-   u256 total_r2 = 0;
-   total_r2 = to256( my->_db.get_reward_fund( my->_db.get_comment( d.author, d.permlink ) ).recent_claims );
+   if( d.body.size() > 1024*128 )
+      d.body = "body pruned due to size";
+   if( d.parent_author.size() > 0 && d.body.size() > 1024*16 )
+      d.body = "comment pruned due to size";
+
+   set_url(d);
+}
+
+void database_api::set_pending_payout_value( discussion& d )const
+{
+   const auto& c = my->_db.get< comment_object >( d.id );
+   const auto& rf = my->_db.get_reward_fund( c );
+   asset pot = rf.reward_balance;
+   u256 total_r2 = to256( rf.recent_claims );
 
    if( total_r2 > 0 )
    {
       uint128_t vshares;
-      const auto& rf = my->_db.get_reward_fund( my->_db.get_comment( d.author, d.permlink ) );
       vshares = d.net_rshares.value > 0 ? wls::chain::util::evaluate_reward_curve( d.net_rshares.value, rf.author_reward_curve, rf.content_constant ) : 0;
 
       u256 r2 = to256(vshares); //to256(abs_net_rshares);
@@ -881,14 +966,7 @@ void database_api::set_pending_payout( discussion& d )const
    }
 
    if( d.parent_author != WLS_ROOT_POST_PARENT )
-      d.cashout_time = my->_db.calculate_discussion_payout_time( my->_db.get< comment_object >( d.id ) );
-
-   if( d.body.size() > 1024*128 )
-      d.body = "body pruned due to size";
-   if( d.parent_author.size() > 0 && d.body.size() > 1024*16 )
-      d.body = "comment pruned due to size";
-
-   set_url(d);
+      d.cashout_time = my->_db.calculate_discussion_payout_time( c );
 }
 
 void database_api::set_url( discussion& d )const
@@ -902,7 +980,7 @@ void database_api::set_url( discussion& d )const
 
 vector<discussion> database_api::get_content_replies( string author, string permlink )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       account_name_type acc_name = account_name_type( author );
       const auto& by_permlink_idx = my->_db.get_index< comment_index >().indices().get< by_parent >();
@@ -926,7 +1004,7 @@ vector<discussion> database_api::get_content_replies( string author, string perm
  */
 vector<discussion> database_api::get_replies_by_last_update( account_name_type start_parent_author, string start_permlink, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       vector<discussion> result;
 
@@ -951,6 +1029,7 @@ vector<discussion> database_api::get_replies_by_last_update( account_name_type s
 
       while( itr != last_update_idx.end() && result.size() < limit && itr->parent_author == *parent_author )
       {
+         my->_db.check_preempt();
          result.push_back( *itr );
          set_pending_payout(result.back());
          result.back().active_votes = get_active_votes( itr->author, to_string( itr->permlink ) );
@@ -964,7 +1043,18 @@ vector<discussion> database_api::get_replies_by_last_update( account_name_type s
 
 map< uint32_t, applied_operation > database_api::get_account_history( string account, uint64_t from, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   if( my->_account_history_store )
+   {
+      FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
+      FC_ASSERT( from >= limit, "From must be greater than limit" );
+
+      map<uint32_t, applied_operation> result;
+      for( const auto& entry : my->_account_history_store->get_account_history( account, from, limit ) )
+         result.emplace( entry.first, applied_operation( entry.second ) );
+      return result;
+   }
+
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
       FC_ASSERT( from >= limit, "From must be greater than limit" );
@@ -986,10 +1076,18 @@ map< uint32_t, applied_operation > database_api::get_account_history( string acc
 }
 
 vector<pair<string,uint32_t> > database_api::get_tags_used_by_author( const string& author )const {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       const auto* acnt = my->_db.find_account( author );
       FC_ASSERT( acnt != nullptr );
+      if( my->_tag_ranking )
+      {
+         auto result = my->_tag_ranking->get_tags_used_by_author( acnt->id );
+         if( result.size() > 1000 )
+            result.resize( 1000 );
+         return result;
+      }
+
       const auto& tidx = my->_db.get_index<tags::author_tag_stats_index>().indices().get<tags::by_author_posts_tag>();
       auto itr = tidx.lower_bound( boost::make_tuple( acnt->id, 0 ) );
       vector<pair<string,uint32_t> > result;
@@ -1003,7 +1101,7 @@ vector<pair<string,uint32_t> > database_api::get_tags_used_by_author( const stri
 
 vector<tag_api_obj> database_api::get_trending_tags( string after, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       limit = std::min( limit, uint32_t(1000) );
       vector<tag_api_obj> result;
@@ -1011,6 +1109,26 @@ vector<tag_api_obj> database_api::get_trending_tags( string after, uint32_t limi
 
       const auto& nidx = my->_db.get_index<tags::tag_stats_index>().indices().get<tags::by_tag>();
 
+      if( my->_tag_ranking )
+      {
+         /// only the payout totals are kept in tag_stats_object
+         for( const auto& stats : my->_tag_ranking->get_trending_tags( after, limit ) )
+         {
+            tag_api_obj t;
+            t.name = stats.tag;
+            t.net_votes = stats.net_votes;
+            t.top_posts = stats.top_posts;
+            t.comments = stats.comments;
+            t.trending = stats.total_trending;
+
+            auto nitr = nidx.find( stats.tag );
+            if( nitr != nidx.end() )
+               t.total_payouts = nitr->total_payout;
+            result.push_back( t );
+         }
+         return result;
+      }
+
       const auto& ridx = my->_db.get_index<tags::tag_stats_index>().indices().get<tags::by_trending>();
       auto itr = ridx.begin();
       if( after != "" && nidx.size() )
@@ -1024,6 +1142,7 @@ vector<tag_api_obj> database_api::get_trending_tags( string after, uint32_t limi
 
       while( itr != ridx.end() && result.size() < limit )
       {
+         my->_db.check_preempt();
          result.push_back( tag_api_obj( *itr ) );
          ++itr;
       }
@@ -1033,11 +1152,28 @@ vector<tag_api_obj> database_api::get_trending_tags( string after, uint32_t limi
 
 discussion database_api::get_discussion( comment_id_type id, uint32_t truncate_body )const
 {
-   discussion d = my->_db.get(id);
-   set_url( d );
-   set_pending_payout( d );
-   d.active_votes = get_active_votes( d.author, d.permlink );
-   d.body_length = d.body.size();
+   optional< discussion > cached;
+   if( my->_discussion_cache )
+      cached = my->_discussion_cache->find( id );
+
+   discussion d;
+   if( cached )
+   {
+      d = std::move( *cached );
+      set_pending_payout_value( d );
+   }
+   else
+   {
+      d = my->_db.get(id);
+      set_url( d );
+      set_pending_payout( d );
+      d.active_votes = get_active_votes( d.author, d.permlink );
+      d.body_length = d.body.size();
+
+      if( my->_discussion_cache )
+         my->_discussion_cache->add( d );
+   }
+
    if( truncate_body ) {
       d.body = d.body.substr( 0, truncate_body );
 
@@ -1085,6 +1221,7 @@ vector<discussion> database_api::get_discussions( const discussion_query& query,
    uint64_t max_itr_count = 10 * query.limit;
    while( count > 0 && tidx_itr != tidx.end() )
    {
+      my->_db.check_preempt();
       ++itr_count;
       if( itr_count > max_itr_count )
       {
@@ -1122,9 +1259,72 @@ vector<discussion> database_api::get_discussions( const discussion_query& query,
    return result;
 }
 
+namespace {
+
+   tags::ranking_query make_ranking_query( tags::ranking_sort sort, const string& tag, comment_id_type parent, bool ignore_parent = false )
+   {
+      tags::ranking_query rq;
+      rq.sort = sort;
+      rq.tag = tag;
+      rq.parent = parent;
+      rq.ignore_parent = ignore_parent;
+      return rq;
+   }
+
+}
+
+vector<discussion> database_api::get_ranked_discussions( const discussion_query& query,
+                                                         tags::ranking_query rq,
+                                                         const std::function< bool( const comment_api_obj& ) >& filter )const
+{
+   vector<discussion> result;
+
+   if( query.start_author && query.start_permlink )
+      rq.start = my->_db.get_comment( *query.start_author, *query.start_permlink ).id;
+
+   uint32_t count = query.limit;
+   uint64_t itr_count = 0;
+   uint64_t filter_count = 0;
+   uint64_t exc_count = 0;
+   uint64_t max_itr_count = 10 * query.limit;
+   my->_tag_ranking->visit( rq, [&]( const tags::ranking_entry& entry ) -> bool
+   {
+      if( count == 0 )
+         return false;
+
+      ++itr_count;
+      if( itr_count > max_itr_count )
+      {
+         wlog( "Maximum iteration count exceeded serving query: ${q}", ("q", query) );
+         wlog( "count=${count}   itr_count=${itr_count}   filter_count=${filter_count}   exc_count=${exc_count}",
+               ("count", count)("itr_count", itr_count)("filter_count", filter_count)("exc_count", exc_count) );
+         return false;
+      }
+      try
+      {
+         result.push_back( get_discussion( entry.comment, query.truncate_body ) );
+
+         if( filter( result.back() ) )
+         {
+            result.pop_back();
+            ++filter_count;
+         }
+         else
+            --count;
+      }
+      catch ( const fc::exception& e )
+      {
+         ++exc_count;
+         edump((e.to_detail_string()));
+      }
+      return count > 0;
+   });
+   return result;
+}
+
 comment_id_type database_api::get_parent( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       comment_id_type parent;
       if( query.parent_author && query.parent_permlink ) {
@@ -1136,12 +1336,18 @@ comment_id_type database_api::get_parent( const discussion_query& query )const
 
 vector<discussion> database_api::get_discussions_by_payout( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       auto tag = fc::to_lower( query.tag );
       auto parent = get_parent( query );
 
+      if( my->_tag_ranking )
+      {
+         auto rq = make_ranking_query( tags::rank_by_payout, tag, parent, true );
+         return get_ranked_discussions( query, rq, []( const comment_api_obj& c ){ return c.net_rshares <= 0; } );
+      }
+
       const auto& tidx = my->_db.get_index<tags::tag_index>().indices().get<tags::by_net_rshares>();
       auto tidx_itr = tidx.lower_bound( tag );
 
@@ -1151,12 +1357,18 @@ vector<discussion> database_api::get_discussions_by_payout( const discussion_que
 
 vector<discussion> database_api::get_post_discussions_by_payout( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       auto tag = fc::to_lower( query.tag );
       auto parent = comment_id_type();
 
+      if( my->_tag_ranking )
+      {
+         auto rq = make_ranking_query( tags::rank_by_post_payout, tag, parent, true );
+         return get_ranked_discussions( query, rq, []( const comment_api_obj& c ){ return c.net_rshares <= 0; } );
+      }
+
       const auto& tidx = my->_db.get_index<tags::tag_index>().indices().get<tags::by_reward_fund_net_rshares>();
       auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, true ) );
 
@@ -1166,12 +1378,18 @@ vector<discussion> database_api::get_post_discussions_by_payout( const discussio
 
 vector<discussion> database_api::get_comment_discussions_by_payout( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       auto tag = fc::to_lower( query.tag );
       auto parent = comment_id_type(1);
 
+      if( my->_tag_ranking )
+      {
+         auto rq = make_ranking_query( tags::rank_by_comment_payout, tag, parent, true );
+         return get_ranked_discussions( query, rq, []( const comment_api_obj& c ){ return c.net_rshares <= 0; } );
+      }
+
       const auto& tidx = my->_db.get_index<tags::tag_index>().indices().get<tags::by_reward_fund_net_rshares>();
       auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, false ) );
 
@@ -1182,12 +1400,18 @@ vector<discussion> database_api::get_comment_discussions_by_payout( const discus
 vector<discussion> database_api::get_discussions_by_trending( const discussion_query& query )const
 {
 
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       auto tag = fc::to_lower( query.tag );
       auto parent = get_parent( query );
 
+      if( my->_tag_ranking )
+      {
+         auto rq = make_ranking_query( tags::rank_by_trending, tag, parent );
+         return get_ranked_discussions( query, rq, []( const comment_api_obj& c ){ return c.net_rshares <= 0; } );
+      }
+
       const auto& tidx = my->_db.get_index<tags::tag_index>().indices().get<tags::by_parent_trending>();
       auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, std::numeric_limits<double>::max() )  );
 
@@ -1197,12 +1421,18 @@ vector<discussion> database_api::get_discussions_by_trending( const discussion_q
 
 vector<discussion> database_api::get_discussions_by_created( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       auto tag = fc::to_lower( query.tag );
       auto parent = get_parent( query );
 
+      if( my->_tag_ranking )
+      {
+         auto rq = make_ranking_query( tags::rank_by_created, tag, parent );
+         return get_ranked_discussions( query, rq );
+      }
+
       const auto& tidx = my->_db.get_index<tags::tag_index>().indices().get<tags::by_parent_created>();
       auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, fc::time_point_sec::maximum() )  );
 
@@ -1212,12 +1442,18 @@ vector<discussion> database_api::get_discussions_by_created( const discussion_qu
 
 vector<discussion> database_api::get_discussions_by_active( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       auto tag = fc::to_lower( query.tag );
       auto parent = get_parent( query );
 
+      if( my->_tag_ranking )
+      {
+         auto rq = make_ranking_query( tags::rank_by_active, tag, parent );
+         return get_ranked_discussions( query, rq );
+      }
+
       const auto& tidx = my->_db.get_index<tags::tag_index>().indices().get<tags::by_parent_active>();
       auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, fc::time_point_sec::maximum() )  );
 
@@ -1227,7 +1463,7 @@ vector<discussion> database_api::get_discussions_by_active( const discussion_que
 
 vector<discussion> database_api::get_discussions_by_cashout( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       vector<discussion> result;
@@ -1235,6 +1471,13 @@ vector<discussion> database_api::get_discussions_by_cashout( const discussion_qu
       auto tag = fc::to_lower( query.tag );
       auto parent = get_parent( query );
 
+      if( my->_tag_ranking )
+      {
+         auto rq = make_ranking_query( tags::rank_by_cashout, tag, parent );
+         rq.min_cashout = fc::time_point::now() - fc::minutes(60);
+         return get_ranked_discussions( query, rq, []( const comment_api_obj& c ){ return c.net_rshares < 0; } );
+      }
+
       const auto& tidx = my->_db.get_index<tags::tag_index>().indices().get<tags::by_cashout>();
       auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, fc::time_point::now() - fc::minutes(60) ) );
 
@@ -1244,12 +1487,18 @@ vector<discussion> database_api::get_discussions_by_cashout( const discussion_qu
 
 vector<discussion> database_api::get_discussions_by_votes( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       auto tag = fc::to_lower( query.tag );
       auto parent = get_parent( query );
 
+      if( my->_tag_ranking )
+      {
+         auto rq = make_ranking_query( tags::rank_by_votes, tag, parent );
+         return get_ranked_discussions( query, rq );
+      }
+
       const auto& tidx = my->_db.get_index<tags::tag_index>().indices().get<tags::by_parent_net_votes>();
       auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, std::numeric_limits<int32_t>::max() )  );
 
@@ -1259,12 +1508,18 @@ vector<discussion> database_api::get_discussions_by_votes( const discussion_quer
 
 vector<discussion> database_api::get_discussions_by_children( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       auto tag = fc::to_lower( query.tag );
       auto parent = get_parent( query );
 
+      if( my->_tag_ranking )
+      {
+         auto rq = make_ranking_query( tags::rank_by_children, tag, parent );
+         return get_ranked_discussions( query, rq );
+      }
+
       const auto& tidx = my->_db.get_index<tags::tag_index>().indices().get<tags::by_parent_children>();
       auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, std::numeric_limits<int32_t>::max() )  );
 
@@ -1275,12 +1530,18 @@ vector<discussion> database_api::get_discussions_by_children( const discussion_q
 vector<discussion> database_api::get_discussions_by_hot( const discussion_query& query )const
 {
 
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       auto tag = fc::to_lower( query.tag );
       auto parent = get_parent( query );
 
+      if( my->_tag_ranking )
+      {
+         auto rq = make_ranking_query( tags::rank_by_hot, tag, parent );
+         return get_ranked_discussions( query, rq, []( const comment_api_obj& c ){ return c.net_rshares <= 0; } );
+      }
+
       const auto& tidx = my->_db.get_index<tags::tag_index>().indices().get<tags::by_parent_hot>();
       auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, std::numeric_limits<double>::max() )  );
 
@@ -1290,7 +1551,7 @@ vector<discussion> database_api::get_discussions_by_hot( const discussion_query&
 
 vector<discussion> database_api::get_discussions_by_feed( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       FC_ASSERT( my->_follow_api, "Node is not running the follow plugin" );
@@ -1299,6 +1560,41 @@ vector<discussion> database_api::get_discussions_by_feed( const discussion_query
 
       const auto& account = my->_db.get_account( query.tag );
 
+      if( my->_feed_merger )
+      {
+         uint32_t entry_id = 0;
+         comment_id_type start_comment;
+         if( start_author.size() || start_permlink.size() )
+         {
+            start_comment = my->_db.get_comment( start_author, start_permlink ).id;
+            entry_id = start_comment._id + 1;
+         }
+
+         auto feed = my->_feed_merger->get_feed( my->_db, account.name, entry_id, query.limit );
+         FC_ASSERT( entry_id == 0 || ( feed.size() && feed.front().comment == start_comment ), "Comment is not in account's feed" );
+
+         vector< discussion > result;
+         result.reserve( feed.size() );
+         for( auto& e : feed )
+         {
+            try
+            {
+               result.push_back( get_discussion( e.comment ) );
+               if( e.reblog_by.size() )
+               {
+                  result.back().first_reblogged_by = e.reblog_by.front();
+                  result.back().first_reblogged_on = e.reblog_on;
+                  result.back().reblogged_by = std::move( e.reblog_by );
+               }
+            }
+            catch ( const fc::exception& e )
+            {
+               edump((e.to_detail_string()));
+            }
+         }
+         return result;
+      }
+
       const auto& c_idx = my->_db.get_index< follow::feed_index >().indices().get< follow::by_comment >();
       const auto& f_idx = my->_db.get_index< follow::feed_index >().indices().get< follow::by_feed >();
       auto feed_itr = f_idx.lower_bound( account.name );
@@ -1340,7 +1636,7 @@ vector<discussion> database_api::get_discussions_by_feed( const discussion_query
 
 vector<discussion> database_api::get_discussions_by_blog( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       query.validate();
       FC_ASSERT( my->_follow_api, "Node is not running the follow plugin" );
@@ -1377,7 +1673,19 @@ vector<discussion> database_api::get_discussions_by_blog( const discussion_query
                continue;
             }
 
-            if( query.select_tags.size() ) {
+            if( query.select_tags.size() && my->_tag_ranking ) {
+               bool found = false;
+               for( const auto& tag : query.select_tags ) {
+                  if( my->_tag_ranking->has_tag( blog_itr->comment, tag ) ) {
+                     found = true; break;
+                  }
+               }
+               if( !found ) {
+                  ++blog_itr;
+                  continue;
+               }
+            }
+            else if( query.select_tags.size() ) {
                auto tag_itr = tag_idx.lower_bound( blog_itr->comment );
 
                bool found = false;
@@ -1412,7 +1720,7 @@ vector<discussion> database_api::get_discussions_by_blog( const discussion_query
 
 vector<discussion> database_api::get_discussions_by_comments( const discussion_query& query )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       vector< discussion > result;
 #ifndef IS_LOW_MEM
@@ -1436,6 +1744,7 @@ vector<discussion> database_api::get_discussions_by_comments( const discussion_q
 
       while( result.size() < query.limit && comment_itr != t_idx.end() )
       {
+         my->_db.check_preempt();
          if( comment_itr->author != start_author )
             break;
          if( comment_itr->parent_author.size() > 0 )
@@ -1457,6 +1766,13 @@ vector<discussion> database_api::get_discussions_by_comments( const discussion_q
    });
 }
 
+discussion_cache_stats database_api::get_discussion_cache_stats()const
+{
+   if( my->_discussion_cache )
+      return my->_discussion_cache->get_stats();
+   return discussion_cache_stats();
+}
+
 /**
  *  This call assumes root already stored as part of state, it will
  *  modify root.replies to contain links to the reply posts and then
@@ -1496,7 +1812,7 @@ void database_api::recursively_fetch_content( state& _state, discussion& root, s
 
 vector< account_name_type > database_api::get_active_witnesses()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       const auto& wso = my->_db.get_witness_schedule_object();
       size_t n = wso.current_shuffled_witnesses.size();
@@ -1511,7 +1827,7 @@ vector< account_name_type > database_api::get_active_witnesses()const
 vector<discussion>  database_api::get_discussions_by_author_before_date(
     string author, string start_permlink, time_point_sec before_date, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       try
       {
@@ -1536,6 +1852,7 @@ vector<discussion>  database_api::get_discussions_by_author_before_date(
 
          while( itr != didx.end() && itr->author ==  author && count < limit )
          {
+            my->_db.check_preempt();
             if( itr->parent_author.size() == 0 )
             {
                result.push_back( *itr );
@@ -1555,7 +1872,7 @@ vector<discussion>  database_api::get_discussions_by_author_before_date(
 
 state database_api::get_state( string path )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->_db.with_preemptible_read_lock( [&]()
    {
       state _state;
       _state.props         = get_dynamic_global_properties();
@@ -1920,7 +2237,21 @@ annotated_signed_transaction database_api::get_transaction( transaction_id_type
 #ifdef SKIP_BY_TX_ID
    FC_ASSERT( false, "This node's operator has disabled operation indexing by transaction_id" );
 #else
-   return my->_db.with_read_lock( [&](){
+   if( my->_account_history_store )
+   {
+      auto op = my->_account_history_store->find_transaction( id );
+      FC_ASSERT( op.valid(), "Unknown Transaction ${t}", ("t",id) );
+
+      auto blk = my->_db.with_read_lock( [&](){ return my->_db.fetch_block_by_number( op->block ); } );
+      FC_ASSERT( blk.valid() );
+      FC_ASSERT( blk->transactions.size() > op->trx_in_block );
+      annotated_signed_transaction result = blk->transactions[op->trx_in_block];
+      result.block_num       = op->block;
+      result.transaction_num = op->trx_in_block;
+      return result;
+   }
+
+   return my->_db.with_preemptible_read_lock( [&](){
       const auto& idx = my->_db.get_index<operation_index>().indices().get<by_transaction_id>();
       auto itr = idx.lower_bound( id );
       if( itr != idx.end() && itr->trx_id == id ) {
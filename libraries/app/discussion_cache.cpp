@@ -0,0 +1,232 @@
+#include <wls/app/discussion_cache.hpp>
+
+#include <wls/chain/comment_object.hpp>
+#include <wls/chain/operation_notification.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <mutex>
+#include <unordered_set>
+
+namespace wls { namespace app {
+
+   namespace detail {
+
+      using namespace boost::multi_index;
+      using namespace wls::protocol;
+      using chain::comment_id_type;
+
+      struct discussion_cache_entry
+      {
+         comment_id_type   comment;
+         uint32_t          block_num = 0;    ///< head block when it was hydrated
+         discussion        d;
+      };
+
+      typedef multi_index_container<
+         discussion_cache_entry,
+         indexed_by<
+            hashed_unique< member< discussion_cache_entry, comment_id_type, &discussion_cache_entry::comment > >,
+            sequenced<>    /// most recently used first
+         >
+      > discussion_cache_index;
+
+      typedef std::unordered_set< comment_id_type, boost::hash< comment_id_type > > comment_id_set;
+
+      /// Collects the comments whose hydrated discussions an operation changes
+      struct discussion_cache_visitor
+      {
+         discussion_cache_visitor( const chain::database& db, comment_id_set& touched ) : _db( db ), _touched( touched ) {}
+
+         typedef void result_type;
+
+         const chain::database&  _db;
+         comment_id_set&         _touched;
+
+         void touch( const account_name_type& author, const string& permlink, bool with_parents = false )const
+         {
+            const auto* c = _db.find_comment( author, permlink );
+            if( c == nullptr )
+               return;
+
+            _touched.insert( c->id );
+
+            /// replies change the children and active time of every comment above them
+            while( with_parents && c->parent_author.size() )
+            {
+               c = &_db.get_comment( c->parent_author, c->parent_permlink );
+               _touched.insert( c->id );
+            }
+         }
+
+         void operator()( const comment_operation& op )const                  { touch( op.author, op.permlink, true ); }
+         void operator()( const delete_comment_operation& op )const           { touch( op.author, op.permlink, true ); }
+         void operator()( const vote_operation& op )const                     { touch( op.author, op.permlink ); }
+         void operator()( const comment_options_operation& op )const          { touch( op.author, op.permlink ); }
+         void operator()( const author_reward_operation& op )const            { touch( op.author, op.permlink ); }
+         void operator()( const curation_reward_operation& op )const          { touch( op.comment_author, op.comment_permlink ); }
+         void operator()( const comment_reward_operation& op )const           { touch( op.author, op.permlink ); }
+         void operator()( const comment_payout_update_operation& op )const    { touch( op.author, op.permlink ); }
+         void operator()( const comment_benefactor_reward_operation& op )const{ touch( op.author, op.permlink ); }
+
+         template< typename Op >
+         void operator()( const Op& )const {}
+      };
+
+      class discussion_cache_impl
+      {
+         public:
+            discussion_cache_impl( chain::database& db ) : db( db ) {}
+
+            void on_block( const chain::signed_block& b )
+            {
+               std::lock_guard< std::mutex > guard( mutex );
+
+               /// the state of any comment may have gone back with a popped block
+               if( b.block_num() <= head_block_num )
+               {
+                  stats.invalidations += entries.size();
+                  entries.clear();
+               }
+               else
+               {
+                  for( const auto& id : touched )
+                     stats.invalidations += entries.erase( id );
+               }
+
+               touched.clear();
+               head_block_num = b.block_num();
+
+               // The pool is applied again after the block, touching what is still pending
+               pending_touched.clear();
+            }
+
+            /// Operations of pending transactions are undone rather than applied in a block
+            void on_operation( const chain::operation_notification& note )
+            {
+               note.op.visit( detail::discussion_cache_visitor( db, db.has_pending_state() ? pending_touched : touched ) );
+            }
+
+            /// Must be called holding mutex and a database read lock
+            bool has_pending_changes( comment_id_type comment )const
+            {
+               return pending_touched.find( comment ) != pending_touched.end();
+            }
+
+            chain::database&                          db;
+            mutable std::mutex                        mutex;
+            size_t                                    max_entries = 0;
+            uint32_t                                  max_age = 0;
+            uint32_t                                  head_block_num = 0;
+            mutable discussion_cache_index            entries;
+            mutable discussion_cache_stats            stats;
+
+            /// Only written while applying operations, under the database write lock
+            comment_id_set                            touched;            ///< by the block being applied
+            comment_id_set                            pending_touched;    ///< by pending transactions since the last block
+
+            boost::signals2::scoped_connection        pre_operation_connection;
+            boost::signals2::scoped_connection        operation_connection;
+            boost::signals2::scoped_connection        block_connection;
+      };
+   }
+
+   discussion_cache::discussion_cache( chain::database& db, size_t max_entries, uint32_t max_age )
+      : my( new detail::discussion_cache_impl( db ) )
+   {
+      my->max_entries = max_entries;
+      my->max_age = max_age;
+      my->head_block_num = db.head_block_num();
+
+      auto* impl = my.get();
+
+      /// A deleted comment can only be found before the operation is applied
+      my->pre_operation_connection = db.pre_apply_operation.connect( [impl]( const chain::operation_notification& note )
+      {
+         if( note.op.which() == operation::tag< delete_comment_operation >::value )
+            impl->on_operation( note );
+      });
+      my->operation_connection = db.post_apply_operation.connect( [impl]( const chain::operation_notification& note )
+      {
+         if( note.op.which() != operation::tag< delete_comment_operation >::value )
+            impl->on_operation( note );
+      });
+      my->block_connection = db.applied_block.connect( [impl]( const chain::signed_block& b ){ impl->on_block( b ); } );
+   }
+
+   discussion_cache::~discussion_cache() {}
+
+   optional< discussion > discussion_cache::find( chain::comment_id_type comment )const
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+
+      auto itr = my->entries.find( comment );
+      if( itr == my->entries.end() || my->has_pending_changes( comment ) )
+      {
+         ++my->stats.misses;
+         return optional< discussion >();
+      }
+
+      if( my->head_block_num - itr->block_num > my->max_age )
+      {
+         my->entries.erase( itr );
+         ++my->stats.expired;
+         ++my->stats.misses;
+         return optional< discussion >();
+      }
+
+      auto& lru = my->entries.get< 1 >();
+      lru.relocate( lru.begin(), my->entries.project< 1 >( itr ) );
+      ++my->stats.hits;
+      return itr->d;
+   }
+
+   void discussion_cache::add( const discussion& d )
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      if( my->max_entries == 0 || my->has_pending_changes( d.id ) )
+         return;
+
+      detail::discussion_cache_entry entry;
+      entry.comment = d.id;
+      entry.block_num = my->head_block_num;
+      entry.d = d;
+
+      auto& lru = my->entries.get< 1 >();
+      auto itr = my->entries.find( d.id );
+      if( itr != my->entries.end() )
+      {
+         my->entries.replace( itr, std::move( entry ) );
+         lru.relocate( lru.begin(), my->entries.project< 1 >( itr ) );
+      }
+      else
+      {
+         lru.push_front( std::move( entry ) );
+      }
+
+      while( my->entries.size() > my->max_entries )
+      {
+         lru.pop_back();
+         ++my->stats.evictions;
+      }
+   }
+
+   void discussion_cache::clear()
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      my->entries.clear();
+   }
+
+   discussion_cache_stats discussion_cache::get_stats()const
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      auto stats = my->stats;
+      stats.entries = my->entries.size();
+      stats.max_entries = my->max_entries;
+      return stats;
+   }
+
+} } // wls::app
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <wls/app/api_context.hpp>
+#include <wls/app/block_notifier.hpp>
 #include <wls/app/database_api.hpp>
 #include <wls/protocol/types.hpp>
 
@@ -38,6 +39,7 @@
 
 #include <functional>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -56,6 +58,7 @@ namespace wls { namespace app {
    {
       public:
          network_broadcast_api(const api_context& a);
+         ~network_broadcast_api();
 
          struct transaction_confirmation
          {
@@ -94,25 +97,32 @@ namespace wls { namespace app {
 
          void set_max_block_age( int32_t max_block_age );
 
+         /**
+          * @brief Size, limits and counters of the pool of transactions waiting to be included in a block
+          */
+         chain::transaction_pool_stats get_transaction_pool_stats()const;
+
          // implementation detail, not reflected
          bool check_max_block_age( int32_t max_block_age );
 
          /**
           * @brief Not reflected, thus not accessible to API clients.
           *
-          * This function is registered to receive the applied_block
-          * signal from the chain database when a block is received.
+          * This function is subscribed to the application's block
+          * notifier and called on its thread for each applied block.
           * It then dispatches callbacks to clients who have requested
           * to be notified when a particular txid is included in a block.
           */
-         void on_applied_block( const signed_block& b );
+         void on_applied_block( const block_notification_ptr& n );
 
          /// internal method, not exposed via JSON RPC
          void on_api_startup();
 
       private:
-         boost::signals2::scoped_connection             _applied_block_connection;
+         uint64_t                                       _applied_block_subscription = 0;
 
+         /// the callbacks are registered by API calls and confirmed on the block notifier thread
+         std::mutex                                         _callbacks_mutex;
          map<transaction_id_type,confirmation_callback>     _callbacks;
          map<time_point_sec, vector<transaction_id_type> >  _callbacks_expirations;
 
@@ -228,6 +238,7 @@ FC_API(wls::app::network_broadcast_api,
        (broadcast_transaction_synchronous)
        (broadcast_block)
        (set_max_block_age)
+       (get_transaction_pool_stats)
      )
 FC_API(wls::app::network_node_api,
        (get_info)
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/thread/future.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace wls { namespace app {
+
+   using std::string;
+
+   struct api_limits
+   {
+      uint32_t max_concurrent = 0;   ///< calls of the API running on the pool at once
+      uint32_t max_queued = 0;       ///< calls waiting for a free slot before new ones are rejected
+   };
+
+   struct api_call_stats
+   {
+      uint32_t running = 0;
+      uint32_t queued = 0;
+      uint64_t completed = 0;
+      uint64_t rejected = 0;
+   };
+
+   namespace detail {
+
+      /// Counting semaphore over the calls of one API, handing freed slots to waiters in order
+      class api_slots
+      {
+         public:
+            api_slots( const string& api, const api_limits& limits ) : _api( api ), _limits( limits ) {}
+
+            void acquire();
+            void release();
+            api_call_stats stats()const;
+
+         private:
+            string                                    _api;
+            api_limits                                _limits;
+            mutable std::mutex                        _mutex;
+            api_call_stats                            _stats;
+            std::deque< fc::promise< void >::ptr >    _waiters;
+      };
+
+      class api_slot_guard
+      {
+         public:
+            api_slot_guard( api_slots& slots ) : _slots( slots ) { _slots.acquire(); }
+            ~api_slot_guard() { _slots.release(); }
+
+         private:
+            api_slots& _slots;
+      };
+   }
+
+   /**
+    * Runs calls to read only APIs on a pool of worker threads instead of the thread that received
+    * them. The receiving thread waits on an fc future, so it keeps serving other connections and
+    * tasks while a slow query runs.
+    *
+    * Each pooled API has its own limit on concurrent calls and on calls waiting for a slot. Calls
+    * beyond that are rejected straight away, so one overloaded API cannot build a backlog that
+    * delays the others. APIs that were not added run inline as before.
+    *
+    * APIs must be added before calls are made; the set of pooled APIs is not locked.
+    */
+   class api_executor
+   {
+      public:
+         api_executor( uint32_t threads );
+         ~api_executor();
+
+         void add_api( const string& api, const api_limits& limits );
+         bool is_pooled( const string& api )const;
+
+         template< typename Lambda >
+         auto execute( const string& api, Lambda&& call ) -> decltype( call() )
+         {
+            auto itr = _slots.find( api );
+            if( itr == _slots.end() )
+               return call();
+
+            // The worker owns the call and its slot, so a waiter that is canceled neither frees the
+            // slot of a call still running nor takes the call away from the worker
+            auto state = std::make_shared< typename std::decay< Lambda >::type >( std::forward< Lambda >( call ) );
+            auto guard = std::make_shared< detail::api_slot_guard >( *itr->second );
+            auto result = next_worker().async( [state,guard]() mutable
+            {
+               auto slot = std::move( guard );
+               return (*state)();
+            }, "api_executor::execute" );
+            guard.reset();
+            return result.wait();
+         }
+
+         uint32_t threads()const { return _workers.size(); }
+         std::map< string, api_call_stats > get_stats()const;
+
+      private:
+         fc::thread& next_worker();
+
+         std::vector< std::shared_ptr< fc::thread > >             _workers;
+         std::atomic< uint32_t >                                  _next_worker;
+         std::map< string, std::unique_ptr< detail::api_slots > > _slots;
+   };
+
+   namespace detail {
+
+      /// Replaces every method of an fc::api vtable with one that runs on the executor
+      struct pooled_api_visitor
+      {
+         pooled_api_visitor( const std::shared_ptr< api_executor >& e, const string& a ) : executor( e ), api( a ) {}
+
+         template< typename R, typename... Args >
+         void operator()( const char* name, std::function< R( Args... ) >& method )const
+         {
+            auto call = method;
+            auto exec = executor;
+            auto api_name = api;
+            method = [exec,api_name,call]( Args... args ) -> R
+            {
+               return exec->execute( api_name, [call,args...]() -> R { return call( args... ); } );
+            };
+         }
+
+         std::shared_ptr< api_executor > executor;
+         string                          api;
+      };
+   }
+
+} }
+
+FC_REFLECT( wls::app::api_limits, (max_concurrent)(max_queued) )
+FC_REFLECT( wls::app::api_call_stats, (running)(queued)(completed)(rejected) )
@@ -25,6 +25,8 @@
 
 #include <wls/app/api_access.hpp>
 #include <wls/app/api_context.hpp>
+#include <wls/app/api_executor.hpp>
+#include <wls/chain/account_history_store.hpp>
 #include <wls/chain/database.hpp>
 
 #include <graphene/net/node.hpp>
@@ -37,6 +39,9 @@
 
 namespace wls { namespace app {
    namespace detail { class application_impl; }
+   class discussion_cache;
+   class block_notifier;
+   class operation_stream;
    using std::string;
 
    class abstract_plugin;
@@ -110,7 +115,13 @@ namespace wls { namespace app {
                // see http://en.cppreference.com/w/cpp/memory/shared_ptr/pointer_cast for example
                std::shared_ptr< Api > api = std::make_shared< Api >( ctx );
                api->on_api_startup();
-               return std::make_shared< fc::api< Api > >( api );
+               auto result = std::make_shared< fc::api< Api > >( api );
+
+               auto executor = ctx.app.get_api_executor();
+               if( executor && executor->is_pooled( ctx.api_name ) )
+                  (*result)->visit( detail::pooled_api_visitor( executor, ctx.api_name ) );
+
+               return result;
             } );
          }
 
@@ -119,12 +130,28 @@ namespace wls { namespace app {
           */
          fc::api_ptr create_api_by_name( const api_context& ctx );
 
+         /**
+          * Executor for calls to APIs registered through register_api_factory< Api >(), set up at
+          * startup from the rpc-threads and rpc-pool-api options.
+          */
+         std::shared_ptr< api_executor > get_api_executor()const;
+
          void get_max_block_age( int32_t& result );
 
          void connect_to_write_node();
 
          bool _read_only = true;
          bool _disable_get_block = false;
+         /// Set by the account_history plugin when it keeps history outside shared memory
+         std::shared_ptr< chain::account_history_store > _account_history_store;
+         /// Set by the account_history plugin when it keeps every operation, with no account range or operation filter
+         bool _account_history_complete = false;
+         /// Discussions hydrated by database_api, only kept in write mode
+         std::shared_ptr< discussion_cache > _discussion_cache;
+         /// Fans applied blocks out to the API sessions subscribed to them
+         std::shared_ptr< block_notifier > _block_notifier;
+         /// Streams the operations of applied blocks to API subscriptions, only kept in write mode
+         std::shared_ptr< operation_stream > _operation_stream;
          fc::optional< string > _remote_endpoint;
          fc::optional< fc::api< network_broadcast_api > > _remote_net_api;
          fc::optional< fc::api< login_api > > _remote_login;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <wls/protocol/operations.hpp>
+#include <wls/chain/account_history_store.hpp>
 #include <wls/chain/wls_object_types.hpp>
 
 namespace wls { namespace app {
@@ -9,6 +10,7 @@ struct applied_operation
 {
    applied_operation();
    applied_operation( const wls::chain::operation_object& op_obj );
+   applied_operation( const wls::chain::history_operation& op_obj );
 
    wls::protocol::transaction_id_type trx_id;
    uint32_t                               block = 0;
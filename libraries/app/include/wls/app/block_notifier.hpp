@@ -0,0 +1,72 @@
+#pragma once
+#include <wls/chain/database.hpp>
+
+#include <functional>
+#include <memory>
+
+namespace wls { namespace app {
+
+   namespace detail { class block_notifier_impl; }
+
+   /// What subscribers receive for each applied block, built once and shared by all of them
+   struct block_notification
+   {
+      chain::prepared_block_ptr  block;    ///< carries the id of each transaction
+      fc::variant                header;   ///< the signed_block_header, as sent to API clients
+   };
+
+   typedef std::shared_ptr< const block_notification > block_notification_ptr;
+
+   struct block_subscriber_stats
+   {
+      uint64_t id = 0;
+      uint64_t queued = 0;
+      uint64_t delivered = 0;
+   };
+
+   struct block_notifier_stats
+   {
+      uint64_t notifications = 0;    ///< blocks a notification was built for
+      uint64_t delivered = 0;
+      uint64_t failed = 0;           ///< subscribers removed because their callback threw
+      vector< block_subscriber_stats > subscribers;
+   };
+
+   /**
+    * Fans applied blocks out to API subscribers. For each block, the header variant is built once
+    * from the prepared block the database applied, and the same notification is queued for every
+    * subscriber instead of each of them copying the block and hashing its transactions.
+    *
+    * Callbacks run on the notifier thread, in block order for each subscriber, so a slow client
+    * never holds up block application. A subscriber whose callback throws is removed. Nothing is
+    * built while there are no subscribers. All methods are thread safe.
+    *
+    * There is no backpressure per client. An API callback hands the notice to its websocket
+    * connection and returns straight away, so a client reading slower than blocks arrive is not
+    * seen here and grows its connection's send buffer instead. max_queued only guards memory when
+    * a callback blocks the notifier thread: the oldest blocks beyond it are dropped, with a
+    * warning in the log. Subscribers share the notifier thread, so a callback that blocks delays
+    * every other subscriber.
+    */
+   class block_notifier
+   {
+      public:
+         typedef std::function< void( const block_notification_ptr& ) > callback;
+
+         block_notifier( chain::database& db, uint32_t max_queued );
+         ~block_notifier();
+
+         /// Returns the id to unsubscribe with, max_queued of 0 uses the notifier's default
+         uint64_t subscribe( callback cb, uint32_t max_queued = 0 );
+         void unsubscribe( uint64_t id );
+
+         block_notifier_stats get_stats()const;
+
+      private:
+         std::unique_ptr< detail::block_notifier_impl > my;
+   };
+
+} }
+
+FC_REFLECT( wls::app::block_subscriber_stats, (id)(queued)(delivered) )
+FC_REFLECT( wls::app::block_notifier_stats, (notifications)(delivered)(failed)(subscribers) )
@@ -1,5 +1,8 @@
 #pragma once
 #include <wls/app/applied_operation.hpp>
+#include <wls/app/block_notifier.hpp>
+#include <wls/app/discussion_cache.hpp>
+#include <wls/app/operation_stream.hpp>
 #include <wls/app/state.hpp>
 
 #include <wls/chain/database.hpp>
@@ -8,6 +11,7 @@
 #include <wls/chain/history_object.hpp>
 
 #include <wls/tags/tags_plugin.hpp>
+#include <wls/tags/tag_ranking_index.hpp>
 
 #include <wls/follow/follow_plugin.hpp>
 #include <wls/witness/witness_plugin.hpp>
@@ -102,6 +106,21 @@ class database_api
 
       void set_block_applied_callback( std::function<void(const variant& block_header)> cb );
 
+      /** Subscribers of the applied block notifications, with how far behind they are and the blocks they missed */
+      block_notifier_stats get_block_notifier_stats()const;
+
+      /**
+       * Streams the operations matching filter to cb as operation_stream_frame objects, from start_block,
+       * or from the next block applied when it is 0. Blocks before the head block are read from
+       * account history first, which must keep every operation from start_block on. Returns the
+       * id of the subscription.
+       */
+      uint64_t subscribe_operations( std::function<void(const variant& frame)> cb, const operation_stream_filter& filter, uint32_t start_block );
+      void unsubscribe_operations( uint64_t id );
+
+      /** Subscriptions to operations, with how far behind they are and how often they had to be caught up */
+      operation_stream_stats get_operation_stream_stats()const;
+
       vector<tag_api_obj> get_trending_tags( string after_tag, uint32_t limit )const;
 
       /**
@@ -303,6 +322,9 @@ class database_api
       vector<discussion> get_discussions_by_blog( const discussion_query& query )const;
       vector<discussion> get_discussions_by_comments( const discussion_query& query )const;
 
+      /** Hits and invalidations of the discussions kept between queries, empty when the cache is disabled */
+      discussion_cache_stats get_discussion_cache_stats()const;
+
       ///@}
 
       /**
@@ -359,6 +381,8 @@ class database_api
 
    private:
       void set_pending_payout( discussion& d )const;
+      /// The parts of set_pending_payout that change without an operation on the comment
+      void set_pending_payout_value( discussion& d )const;
       void set_url( discussion& d )const;
       discussion get_discussion( comment_id_type, uint32_t truncate_body = 0 )const;
 
@@ -377,6 +401,11 @@ class database_api
                                           const std::function< bool( const tags::tag_object& ) >& tag_exit = &database_api::tag_exit_default,
                                           bool ignore_parent = false
                                           )const;
+      /// get_discussions over the in-memory rankings of the tags plugin
+      vector<discussion> get_ranked_discussions( const discussion_query& q,
+                                                 tags::ranking_query rq,
+                                                 const std::function< bool( const comment_api_obj& ) >& filter = &database_api::filter_default
+                                                 )const;
       comment_id_type get_parent( const discussion_query& q )const;
 
       void recursively_fetch_content( state& _state, discussion& root, set<string>& referenced_accounts )const;
@@ -397,6 +426,10 @@ FC_REFLECT_ENUM( wls::app::withdraw_route_type, (incoming)(outgoing)(all) );
 FC_API(wls::app::database_api,
    // Subscriptions
    (set_block_applied_callback)
+   (get_block_notifier_stats)
+   (subscribe_operations)
+   (unsubscribe_operations)
+   (get_operation_stream_stats)
 
    // tags
    (get_trending_tags)
@@ -414,6 +447,7 @@ FC_API(wls::app::database_api,
    (get_discussions_by_feed)
    (get_discussions_by_blog)
    (get_discussions_by_comments)
+   (get_discussion_cache_stats)
 
    // Blocks and transactions
    (get_block_header)
@@ -0,0 +1,56 @@
+#pragma once
+#include <wls/app/state.hpp>
+
+#include <wls/chain/database.hpp>
+
+#include <memory>
+
+namespace wls { namespace app {
+
+   namespace detail { class discussion_cache_impl; }
+
+   struct discussion_cache_stats
+   {
+      uint64_t entries = 0;
+      uint64_t max_entries = 0;
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t expired = 0;          ///< entries found but hydrated more than max_age blocks ago
+      uint64_t invalidations = 0;    ///< entries dropped because their comment or its votes changed
+      uint64_t evictions = 0;        ///< least recently used entries dropped to stay under max_entries
+   };
+
+   /**
+    * Discussions hydrated by database_api, kept so the same posts are not rebuilt for every
+    * get_discussions_by_* query. An entry is dropped when an operation in a block touches its
+    * comment, its votes or one of its replies, and all entries are dropped when a block is
+    * popped. Entries older than max_age blocks are hydrated again, which bounds how stale the
+    * voter reputations they hold can get.
+    *
+    * Reads see the state of pending transactions, which may never be included in a block. A
+    * comment a pending transaction touched is neither served from nor added to the cache until
+    * the next block, when the pending state is applied again from the pool.
+    *
+    * Entries hold the untruncated body. Pending payouts change with the reward fund every block,
+    * so database_api recomputes them on each hit. All methods are thread safe.
+    */
+   class discussion_cache
+   {
+      public:
+         discussion_cache( chain::database& db, size_t max_entries, uint32_t max_age );
+         ~discussion_cache();
+
+         optional< discussion > find( chain::comment_id_type comment )const;
+         void add( const discussion& d );
+
+         void clear();
+
+         discussion_cache_stats get_stats()const;
+
+      private:
+         std::unique_ptr< detail::discussion_cache_impl > my;
+   };
+
+} }
+
+FC_REFLECT( wls::app::discussion_cache_stats, (entries)(max_entries)(hits)(misses)(expired)(invalidations)(evictions) )
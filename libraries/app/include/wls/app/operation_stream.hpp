@@ -0,0 +1,105 @@
+#pragma once
+#include <wls/app/applied_operation.hpp>
+
+#include <wls/chain/database.hpp>
+
+#include <functional>
+#include <memory>
+
+namespace wls { namespace app {
+
+   namespace detail { class operation_stream_impl; }
+
+   /// Operations a subscription receives, every field narrows it further
+   struct operation_stream_filter
+   {
+      flat_set< string >               operations;                ///< names as in JSON such as "transfer" or "author_reward", empty for all
+      flat_set< account_name_type >    accounts;                  ///< accounts the operation impacts, empty for all
+      bool                             real_operations = true;    ///< operations of transactions
+      bool                             virtual_operations = true;
+   };
+
+   /**
+    * Operations of consecutive blocks first_block to last_block, in the order get_ops_in_block
+    * returns them. A subscription is resumed from last_block + 1. A live frame starting at or
+    * before the last block of the previous frame replaces the blocks a fork switched out.
+    */
+   struct operation_stream_frame
+   {
+      uint64_t                      subscription = 0;
+      uint32_t                      first_block = 0;
+      uint32_t                      last_block = 0;
+      uint32_t                      last_irreversible_block = 0;
+      bool                          live = false;              ///< sent as the blocks were applied rather than read from history
+      vector< applied_operation >   operations;
+   };
+
+   struct operation_subscriber_stats
+   {
+      uint64_t id = 0;
+      uint32_t next_block = 0;
+      bool     catching_up = false;  ///< reading history rather than live blocks
+      uint64_t queued = 0;           ///< live blocks waiting to be sent
+      uint64_t frames = 0;
+      uint64_t operations = 0;
+      uint64_t fallbacks = 0;        ///< times it fell max_queued blocks behind and was caught up from history
+      uint64_t lost = 0;             ///< live blocks dropped while it was behind, when no history is kept
+   };
+
+   struct operation_stream_stats
+   {
+      uint64_t blocks = 0;           ///< live blocks recorded for the subscribers
+      uint64_t replayed_blocks = 0;
+      uint64_t frames = 0;
+      uint64_t operations = 0;
+      uint64_t fallbacks = 0;
+      uint64_t lost = 0;
+      uint64_t failed = 0;           ///< subscriptions removed because their callback threw or their history could not be read
+      vector< operation_subscriber_stats > subscribers;
+   };
+
+   /**
+    * Streams the operations of applied blocks to subscribers instead of having them poll
+    * get_ops_in_block for each block number.
+    *
+    * A subscription starting at or before the head block first reads history, in frames of up to
+    * max_frame_blocks blocks, from the account history store or the operation index, so it
+    * receives what get_ops_in_block would return. It then switches to live frames built from
+    * the operations notified while each block is applied, recorded once for every subscriber.
+    * A subscriber more than max_queued live blocks behind is caught up from history again, or
+    * loses its oldest blocks when no history is kept.
+    *
+    * Live frames hold every operation, so history is only read when it holds every operation
+    * too. Subscriptions may not start before the first block it holds.
+    *
+    * Callbacks run on the stream thread, in block order for each subscription. A subscription
+    * whose callback throws is removed. Only nodes applying blocks have live frames, so the
+    * application creates a stream in write mode only. All methods are thread safe.
+    */
+   class operation_stream
+   {
+      public:
+         typedef std::function< void( const operation_stream_frame& ) > callback;
+
+         /// history tells whether the account history plugin keeps every operation, with no account range or operation filter
+         operation_stream( chain::database& db, std::shared_ptr< chain::account_history_store > store, bool history,
+            uint32_t max_queued, uint32_t max_frame_blocks );
+         ~operation_stream();
+
+         /// Returns the id to unsubscribe with, start_block of 0 starts with the next block applied
+         /// Throws if start_block is before the first block history holds
+         uint64_t subscribe( callback cb, const operation_stream_filter& filter, uint32_t start_block );
+         void unsubscribe( uint64_t id );
+
+         operation_stream_stats get_stats()const;
+
+      private:
+         std::unique_ptr< detail::operation_stream_impl > my;
+   };
+
+} }
+
+FC_REFLECT( wls::app::operation_stream_filter, (operations)(accounts)(real_operations)(virtual_operations) )
+FC_REFLECT( wls::app::operation_stream_frame, (subscription)(first_block)(last_block)(last_irreversible_block)(live)(operations) )
+FC_REFLECT( wls::app::operation_subscriber_stats, (id)(next_block)(catching_up)(queued)(frames)(operations)(fallbacks)(lost) )
+FC_REFLECT( wls::app::operation_stream_stats, (blocks)(replayed_blocks)(frames)(operations)(fallbacks)(lost)(failed)(subscribers) )
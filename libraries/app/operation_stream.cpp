@@ -0,0 +1,505 @@
+#include <wls/app/operation_stream.hpp>
+#include <wls/app/impacted.hpp>
+
+#include <wls/protocol/operation_util_impl.hpp>
+
+#include <wls/chain/history_object.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <mutex>
+
+namespace wls { namespace app {
+
+   namespace detail {
+
+      /// An operation of a live block with the accounts it impacts, computed once for every subscriber
+      struct stream_operation
+      {
+         applied_operation                  op;
+         flat_set< account_name_type >      impacted;
+      };
+
+      struct live_block
+      {
+         uint64_t                      sequence = 0;   ///< order in which blocks were applied, fork switches included
+         uint32_t                      block_num = 0;
+         uint32_t                      last_irreversible_block = 0;
+         vector< stream_operation >    operations;
+      };
+
+      typedef std::shared_ptr< const live_block > live_block_ptr;
+
+      struct compiled_filter
+      {
+         compiled_filter( const operation_stream_filter& f ) : accounts( f.accounts ), real( f.real_operations ), virt( f.virtual_operations )
+         {
+            static const std::map< string, int64_t > tags = []()
+            {
+               std::map< string, int64_t > result;
+               for( int i = 0; i < operation::count(); ++i )
+               {
+                  operation op;
+                  op.set_which( i );
+                  string name;
+                  op.visit( fc::get_operation_name( name ) );
+                  result[ name ] = i;
+               }
+               return result;
+            }();
+
+            for( const auto& name : f.operations )
+            {
+               auto itr = tags.find( name );
+               FC_ASSERT( itr != tags.end(), "Unknown operation ${n}", ("n",name) );
+               operations.insert( itr->second );
+            }
+         }
+
+         /// impacted is only computed when accounts are filtered
+         template< typename Impacted >
+         bool matches( const operation& op, Impacted&& impacted )const
+         {
+            if( !( is_virtual_operation( op ) ? virt : real ) )
+               return false;
+            if( operations.size() && !operations.count( op.which() ) )
+               return false;
+            if( accounts.empty() )
+               return true;
+
+            const flat_set< account_name_type >& a = impacted();
+            for( const auto& name : a )
+               if( accounts.count( name ) )
+                  return true;
+            return false;
+         }
+
+         flat_set< int64_t >              operations;
+         flat_set< account_name_type >    accounts;
+         bool                             real = true;
+         bool                             virt = true;
+      };
+
+      struct operation_subscriber
+      {
+         operation_subscriber( uint64_t i, const operation_stream::callback& c, const operation_stream_filter& f )
+            : id( i ), cb( c ), filter( f ) {}
+
+         uint64_t                                  id = 0;
+         operation_stream::callback                cb;
+         compiled_filter                           filter;
+
+         uint32_t                                  next_block = 0;
+         bool                                      catching_up = false;
+         std::deque< live_block_ptr >              queue;
+         uint64_t                                  dropped_sequence = 0;   ///< of the newest live block dropped from the queue
+         bool                                      draining = false;       ///< a drain task is scheduled or running
+         bool                                      removed = false;
+
+         operation_subscriber_stats                stats;
+      };
+
+      typedef std::shared_ptr< operation_subscriber > operation_subscriber_ptr;
+
+      /// History read for one frame, along with the state it was read from
+      struct history_batch
+      {
+         uint32_t                      head_block = 0;
+         uint32_t                      last_irreversible_block = 0;
+         uint64_t                      sequence = 0;   ///< of the last live block applied when it was read
+         uint32_t                      last_block = 0;
+         vector< applied_operation >   operations;
+      };
+
+      class operation_stream_impl
+      {
+         public:
+            operation_stream_impl( chain::database& d ) : db( d ), thread( "operation_stream" ) {}
+
+            void on_pre_apply_block( const signed_block& b )
+            {
+               std::lock_guard< std::mutex > guard( mutex );
+               // Operations of pending transactions are undone rather than applied in a block
+               in_block = !subscribers.empty();
+               block_operations.clear();
+            }
+
+            void on_operation( const chain::operation_notification& note )
+            {
+               if( !in_block )
+                  return;
+
+               stream_operation s;
+               s.op.trx_id       = note.trx_id;
+               s.op.block        = note.block;
+               s.op.trx_in_block = note.trx_in_block;
+               s.op.op_in_trx    = note.op_in_trx;
+               s.op.virtual_op   = note.virtual_op;
+               s.op.timestamp    = db.head_block_time();
+               s.op.op           = note.op;
+               operation_get_impacted_accounts( note.op, s.impacted );
+               block_operations.push_back( std::move( s ) );
+            }
+
+            /// Runs on the thread applying blocks, under the database write lock
+            void on_block( const chain::prepared_block_ptr& b )
+            {
+               if( !in_block )
+                  return;
+               in_block = false;
+
+               auto block = std::make_shared< live_block >();
+               block->block_num = b->block_num();
+               block->last_irreversible_block = db.get_dynamic_global_properties().last_irreversible_block_num;
+               block->operations = std::move( block_operations );
+               block_operations.clear();
+
+               std::lock_guard< std::mutex > guard( mutex );
+               block->sequence = ++last_sequence;
+               ++stats.blocks;
+
+               live_block_ptr note = block;
+               for( const auto& entry : subscribers )
+               {
+                  auto s = entry.second;
+                  s->queue.push_back( note );
+                  if( s->queue.size() > max_queued )
+                  {
+                     s->dropped_sequence = s->queue.front()->sequence;
+                     s->queue.pop_front();
+
+                     // Dropped blocks are read again from history, if there is any
+                     if( history )
+                     {
+                        if( !s->catching_up )
+                        {
+                           s->catching_up = true;
+                           ++s->stats.fallbacks;
+                           ++stats.fallbacks;
+                        }
+                     }
+                     else
+                     {
+                        ++s->stats.lost;
+                        ++stats.lost;
+                     }
+                  }
+
+                  schedule( s );
+               }
+            }
+
+            /// Called with the mutex held
+            void schedule( const operation_subscriber_ptr& s )
+            {
+               if( s->draining )
+                  return;
+
+               s->draining = true;
+               auto impl = this;
+               thread.async( [impl,s]() { impl->drain( s ); }, "operation_stream::drain" );
+            }
+
+            /// Sends the frames of one subscription in order, without holding the mutex in its callback
+            void drain( const operation_subscriber_ptr& s )
+            {
+               while( true )
+               {
+                  operation_stream_frame frame;
+                  bool replay = false;
+                  vector< live_block_ptr > blocks;
+                  {
+                     std::lock_guard< std::mutex > guard( mutex );
+                     if( s->removed || ( !s->catching_up && s->queue.empty() ) )
+                     {
+                        s->draining = false;
+                        return;
+                     }
+
+                     replay = s->catching_up;
+                     if( !replay )
+                     {
+                        // Consecutive blocks are sent together, a fork switch starts a new frame
+                        while( s->queue.size() && blocks.size() < max_frame_blocks
+                           && ( blocks.empty() || s->queue.front()->block_num == blocks.back()->block_num + 1 ) )
+                        {
+                           blocks.push_back( s->queue.front() );
+                           s->queue.pop_front();
+                        }
+                        s->next_block = blocks.back()->block_num + 1;
+                     }
+                  }
+
+                  if( replay )
+                  {
+                     bool sent = false;
+                     try
+                     {
+                        sent = replay_frame( s, frame );
+                     }
+                     catch( const fc::exception& e )
+                     {
+                        wlog( "Operation stream ${id} could not read history: ${e}", ("id",s->id)("e",e.to_string()) );
+                        fail( s );
+                        return;
+                     }
+
+                     if( !sent )
+                        continue;
+                  }
+                  else
+                  {
+                     live_frame( s, blocks, frame );
+                  }
+
+                  frame.subscription = s->id;
+                  try
+                  {
+                     s->cb( frame );
+                  }
+                  catch( ... )
+                  {
+                     fail( s );
+                     return;
+                  }
+
+                  std::lock_guard< std::mutex > guard( mutex );
+                  ++s->stats.frames;
+                  s->stats.operations += frame.operations.size();
+                  ++stats.frames;
+                  stats.operations += frame.operations.size();
+               }
+            }
+
+            void live_frame( const operation_subscriber_ptr& s, const vector< live_block_ptr >& blocks, operation_stream_frame& frame )const
+            {
+               frame.live = true;
+               frame.first_block = blocks.front()->block_num;
+               frame.last_block = blocks.back()->block_num;
+               frame.last_irreversible_block = blocks.back()->last_irreversible_block;
+
+               for( const auto& b : blocks )
+                  for( const auto& o : b->operations )
+                     if( s->filter.matches( o.op.op, [&]() -> const flat_set< account_name_type >& { return o.impacted; } ) )
+                        frame.operations.push_back( o.op );
+            }
+
+            /**
+             * Reads the next frame of history. Once it reaches the head block, the live blocks
+             * applied since are sent next, unless some of them were already dropped.
+             */
+            bool replay_frame( const operation_subscriber_ptr& s, operation_stream_frame& frame )
+            {
+               uint32_t first = s->next_block;
+               auto batch = db.with_preemptible_read_lock( [&]()
+               {
+                  history_batch result;
+                  result.head_block = db.head_block_num();
+                  result.last_irreversible_block = db.get_dynamic_global_properties().last_irreversible_block_num;
+                  {
+                     std::lock_guard< std::mutex > guard( mutex );
+                     result.sequence = last_sequence;
+                  }
+
+                  result.last_block = std::min( result.head_block, first + max_frame_blocks - 1 );
+                  for( uint32_t num = first; num <= result.last_block; ++num )
+                     read_block( s->filter, num, result.operations );
+                  return result;
+               });
+
+               bool sent = first <= batch.last_block;
+               if( sent )
+               {
+                  frame.first_block = first;
+                  frame.last_block = batch.last_block;
+                  frame.last_irreversible_block = batch.last_irreversible_block;
+                  frame.operations = std::move( batch.operations );
+               }
+
+               std::lock_guard< std::mutex > guard( mutex );
+               if( sent )
+               {
+                  s->next_block = batch.last_block + 1;
+                  stats.replayed_blocks += batch.last_block - first + 1;
+               }
+
+               if( batch.last_block >= batch.head_block && s->dropped_sequence <= batch.sequence )
+               {
+                  while( s->queue.size() && s->queue.front()->sequence <= batch.sequence )
+                     s->queue.pop_front();
+                  s->catching_up = false;
+               }
+
+               return sent;
+            }
+
+            /// The operations of a block get_ops_in_block returns, read under the database read lock
+            void read_block( const compiled_filter& filter, uint32_t block_num, vector< applied_operation >& result )const
+            {
+               auto add = [&]( applied_operation&& op )
+               {
+                  flat_set< account_name_type > impacted;
+                  bool computed = false;
+                  auto get_impacted = [&]() -> const flat_set< account_name_type >&
+                  {
+                     if( !computed )
+                        operation_get_impacted_accounts( op.op, impacted );
+                     computed = true;
+                     return impacted;
+                  };
+
+                  if( filter.matches( op.op, get_impacted ) )
+                     result.push_back( std::move( op ) );
+               };
+
+               if( store )
+               {
+                  for( const auto& stored : store->get_ops_in_block( block_num ) )
+                     add( applied_operation( stored ) );
+                  return;
+               }
+
+               const auto& idx = db.get_index< chain::operation_index >().indices().get< chain::by_location >();
+               for( auto itr = idx.lower_bound( block_num ); itr != idx.end() && itr->block == block_num; ++itr )
+                  add( applied_operation( *itr ) );
+            }
+
+            /// The first block history holds, 0 when it is empty. Called under the database read lock.
+            uint32_t first_history_block()const
+            {
+               if( store )
+                  return store->first_block_num();
+
+               const auto& idx = db.get_index< chain::operation_index >().indices().get< chain::by_location >();
+               return idx.empty() ? 0 : idx.begin()->block;
+            }
+
+            /// Removes a subscription its drain task cannot serve anymore
+            void fail( const operation_subscriber_ptr& s )
+            {
+               std::lock_guard< std::mutex > guard( mutex );
+               remove( s );
+               ++stats.failed;
+               s->draining = false;
+            }
+
+            void remove( const operation_subscriber_ptr& s )
+            {
+               s->removed = true;
+               s->queue.clear();
+               subscribers.erase( s->id );
+            }
+
+            chain::database&                                      db;
+            std::shared_ptr< chain::account_history_store >       store;
+            bool                                                  history = false;
+            uint32_t                                              max_queued = 0;
+            uint32_t                                              max_frame_blocks = 0;
+
+            mutable std::mutex                                    mutex;
+            uint64_t                                              next_id = 1;
+            uint64_t                                              last_sequence = 0;
+            std::map< uint64_t, operation_subscriber_ptr >        subscribers;
+            operation_stream_stats                                stats;
+
+            /// Only used while applying blocks, under the database write lock
+            bool                                                  in_block = false;
+            vector< stream_operation >                            block_operations;
+
+            boost::signals2::scoped_connection                    pre_block_connection;
+            boost::signals2::scoped_connection                    operation_connection;
+            boost::signals2::scoped_connection                    block_connection;
+
+            /// Declared last so it stops before the subscribers its tasks use are destroyed
+            fc::thread                                            thread;
+      };
+   }
+
+   operation_stream::operation_stream( chain::database& db, std::shared_ptr< chain::account_history_store > store, bool history,
+      uint32_t max_queued, uint32_t max_frame_blocks )
+      : my( new detail::operation_stream_impl( db ) )
+   {
+      my->store = store;
+      my->history = history;
+      my->max_queued = std::max( max_queued, 1u );
+      my->max_frame_blocks = std::max( max_frame_blocks, 1u );
+
+      auto* impl = my.get();
+      my->pre_block_connection = db.pre_apply_block.connect( [impl]( const signed_block& b ){ impl->on_pre_apply_block( b ); } );
+      my->operation_connection = db.post_apply_operation.connect( [impl]( const chain::operation_notification& note ){ impl->on_operation( note ); } );
+      my->block_connection = db.applied_prepared_block.connect( [impl]( const chain::prepared_block_ptr& b ){ impl->on_block( b ); } );
+   }
+
+   operation_stream::~operation_stream()
+   {
+      my->pre_block_connection.disconnect();
+      my->operation_connection.disconnect();
+      my->block_connection.disconnect();
+      my->thread.quit();
+   }
+
+   uint64_t operation_stream::subscribe( callback cb, const operation_stream_filter& filter, uint32_t start_block )
+   {
+      auto s = std::make_shared< detail::operation_subscriber >( 0, cb, filter );
+
+      // Under the read lock no block is applied between choosing where to start and subscribing
+      return my->db.with_read_lock( [&]()
+      {
+         uint32_t head = my->db.head_block_num();
+         if( start_block == 0 )
+            start_block = head + 1;
+
+         FC_ASSERT( start_block <= head + 1, "Cannot start after the head block ${h}", ("start_block",start_block)("h",head) );
+         FC_ASSERT( start_block > head || my->history,
+            "Not every operation is kept on this node, start with the next block ${n}", ("start_block",start_block)("n",head + 1) );
+
+         if( start_block <= head )
+         {
+            uint32_t first = my->first_history_block();
+            FC_ASSERT( first != 0 && start_block >= first,
+               "History on this node starts at block ${f}", ("start_block",start_block)("f",first) );
+         }
+
+         std::lock_guard< std::mutex > guard( my->mutex );
+         s->id = my->next_id++;
+         s->next_block = start_block;
+         s->catching_up = start_block <= head;
+         my->subscribers[ s->id ] = s;
+
+         if( s->catching_up )
+            my->schedule( s );
+         return s->id;
+      });
+   }
+
+   void operation_stream::unsubscribe( uint64_t id )
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      auto itr = my->subscribers.find( id );
+      if( itr == my->subscribers.end() )
+         return;
+
+      auto s = itr->second;
+      my->remove( s );
+   }
+
+   operation_stream_stats operation_stream::get_stats()const
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      auto stats = my->stats;
+      for( const auto& entry : my->subscribers )
+      {
+         auto s = entry.second->stats;
+         s.id = entry.first;
+         s.next_block = entry.second->next_block;
+         s.catching_up = entry.second->catching_up;
+         s.queued = entry.second->queue.size();
+         stats.subscribers.push_back( s );
+      }
+      return stats;
+   }
+
+} } // wls::app
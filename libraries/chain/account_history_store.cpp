@@ -0,0 +1,693 @@
+#include <wls/chain/account_history_store.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+#include <deque>
+#include <fstream>
+
+#define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
+
+namespace wls { namespace chain { namespace detail {
+
+   struct op_record
+   {
+      transaction_id_type  trx_id;
+      uint16_t             op_in_trx = 0;
+      uint16_t             reserved = 0;
+      uint32_t             block = 0;
+      uint32_t             trx_in_block = 0;
+      uint32_t             timestamp = 0;
+      uint32_t             data_size = 0;
+      uint64_t             virtual_op = 0;
+      uint64_t             data_pos = 0;
+   };
+
+   struct account_record
+   {
+      account_name_type    account;
+      uint32_t             sequence = 0;
+      uint32_t             reserved = 0;
+      uint64_t             op = 0;
+      uint64_t             prev = 0;   ///< record with sequence - 1
+      uint64_t             skip = 0;   ///< record with sequence - lowbit( sequence )
+   };
+
+   struct trx_record
+   {
+      transaction_id_type  trx_id;
+      uint32_t             reserved = 0;
+      uint64_t             op = 0;
+      uint64_t             prev = 0;   ///< previous record in the same hash bucket
+   };
+
+   struct block_record
+   {
+      uint32_t             block_num = 0;
+      uint32_t             reserved = 0;
+      uint64_t             ops_end = 0;
+      uint64_t             accounts_end = 0;
+      uint64_t             trxs_end = 0;
+      uint64_t             data_end = 0;
+   };
+
+   /// Written on close so the heads do not have to be rebuilt from every record on open
+   struct history_heads
+   {
+      uint64_t                                           accounts = 0;
+      uint64_t                                           trxs = 0;
+      vector< std::pair< account_name_type, uint64_t > > account_heads;
+      vector< uint64_t >                                 trx_buckets;
+   };
+
+} } }
+
+FC_REFLECT( wls::chain::detail::history_heads, (accounts)(trxs)(account_heads)(trx_buckets) )
+
+namespace wls { namespace chain {
+
+   namespace bip = boost::interprocess;
+
+   namespace detail {
+
+      static const uint64_t npos = uint64_t(-1);
+      static const uint32_t trx_bucket_count = 1 << 20;
+
+      /**
+       * A file that is only appended to. Appended bytes are staged in memory until flush(), after
+       * which the whole file is read through a read only mapping.
+       */
+      class append_file
+      {
+         public:
+            void open( const fc::path& p )
+            {
+               path = p;
+               stream.open( path.generic_string().c_str(), LOG_WRITE );
+               FC_ASSERT( stream.good(), "Unable to open ${f}", ("f",path) );
+               remap();
+            }
+
+            void close()
+            {
+               stream.close();
+               region.reset();
+               staged.clear();
+               mapped = 0;
+            }
+
+            uint64_t size()const { return mapped + staged.size(); }
+
+            void append( const char* data, size_t size )
+            {
+               staged.insert( staged.end(), data, data + size );
+            }
+
+            /// Reads never straddle the end of the mapping because it always ends on a flush boundary
+            const char* read( uint64_t pos )const
+            {
+               if( pos < mapped )
+                  return (const char*)region->get_address() + pos;
+               return staged.data() + ( pos - mapped );
+            }
+
+            void flush()
+            {
+               if( staged.empty() )
+                  return;
+
+               stream.write( staged.data(), staged.size() );
+               stream.flush();
+               staged.clear();
+               remap();
+            }
+
+            void truncate( uint64_t new_size )
+            {
+               FC_ASSERT( staged.empty() );
+               if( new_size == mapped )
+                  return;
+
+               region.reset();
+               stream.close();
+               boost::filesystem::resize_file( path.generic_string(), new_size );
+               stream.open( path.generic_string().c_str(), LOG_WRITE );
+               remap();
+            }
+
+         private:
+            void remap()
+            {
+               mapped = fc::file_size( path );
+               region.reset();
+
+               if( mapped > 0 )
+               {
+                  bip::file_mapping mapping( path.generic_string().c_str(), bip::read_only );
+                  region.reset( new bip::mapped_region( mapping, bip::read_only, 0, mapped ) );
+               }
+            }
+
+            fc::path                                  path;
+            std::ofstream                             stream;
+            std::unique_ptr< bip::mapped_region >     region;
+            uint64_t                                  mapped = 0;
+            vector< char >                            staged;
+      };
+
+      template< typename Record >
+      class record_table : public append_file
+      {
+         public:
+            uint64_t count()const { return size() / sizeof( Record ); }
+
+            Record at( uint64_t i )const
+            {
+               Record r;
+               memcpy( (char*)&r, read( i * sizeof( Record ) ), sizeof( Record ) );
+               return r;
+            }
+
+            void push_back( const Record& r ) { append( (const char*)&r, sizeof( Record ) ); }
+
+            void resize( uint64_t n ) { truncate( n * sizeof( Record ) ); }
+      };
+
+      /// A reversible block together with the sequence assigned to each of its account entries
+      struct pending_block
+      {
+         history_block        block;
+         vector< uint32_t >   sequences;
+      };
+
+      class account_history_store_impl
+      {
+         public:
+            void open_tables();
+            void close_tables();
+            void truncate( uint64_t block_count );
+            void load_heads();
+            void save_heads();
+            void scan_heads( uint64_t accounts_from, uint64_t trxs_from );
+
+            uint32_t first_block()const { return blocks.count() ? blocks.at( 0 ).block_num : 0; }
+            uint32_t committed_head()const { return blocks.count() ? blocks.at( blocks.count() - 1 ).block_num : 0; }
+            uint32_t head()const { return pending.size() ? pending.back().block.block_num : committed_head(); }
+
+            uint32_t committed_sequence( const account_name_type& account )const;
+            uint32_t last_sequence( const account_name_type& account )const;
+            void     update_pending_sequences();
+            void     append_pending( history_block&& block );
+
+            uint64_t find_sequence( uint64_t index, uint32_t sequence )const;
+            void     append_block( const pending_block& b );
+            history_operation read_op( uint64_t index )const;
+
+            fc::path                                  dir;
+            bool                                      is_open = false;
+
+            append_file                               data;
+            record_table< op_record >                 ops;
+            record_table< account_record >            accounts;
+            record_table< trx_record >                trxs;
+            record_table< block_record >              blocks;
+
+            std::map< account_name_type, uint64_t >   account_heads;       ///< latest committed record of each account
+            vector< uint64_t >                        trx_buckets;
+
+            std::deque< pending_block >               pending;
+            std::map< account_name_type, uint32_t >   pending_sequences;   ///< latest reversible sequence of each account
+
+            mutable boost::shared_mutex               mutex;
+      };
+
+      void account_history_store_impl::open_tables()
+      {
+         fc::create_directories( dir );
+         data.open( dir / "ops.data" );
+         ops.open( dir / "ops.index" );
+         accounts.open( dir / "accounts.index" );
+         trxs.open( dir / "trx.index" );
+         blocks.open( dir / "blocks.index" );
+      }
+
+      void account_history_store_impl::close_tables()
+      {
+         data.close();
+         ops.close();
+         accounts.close();
+         trxs.close();
+         blocks.close();
+      }
+
+      /// Truncates every table to the sizes recorded after the first block_count blocks
+      void account_history_store_impl::truncate( uint64_t block_count )
+      {
+         block_record end;
+         if( block_count > 0 )
+            end = blocks.at( block_count - 1 );
+
+         // Heads saved past the new end would point at records that are about to be rewritten
+         if( accounts.count() > end.accounts_end || trxs.count() > end.trxs_end )
+            fc::remove( dir / "heads" );
+
+         blocks.resize( block_count );
+         ops.resize( end.ops_end );
+         accounts.resize( end.accounts_end );
+         trxs.resize( end.trxs_end );
+         data.truncate( end.data_end );
+      }
+
+      void account_history_store_impl::load_heads()
+      {
+         account_heads.clear();
+         trx_buckets.assign( trx_bucket_count, npos );
+
+         uint64_t accounts_from = 0;
+         uint64_t trxs_from = 0;
+         fc::path heads_file = dir / "heads";
+
+         if( fc::exists( heads_file ) )
+         {
+            try
+            {
+               vector< char > packed( fc::file_size( heads_file ) );
+               std::ifstream in( heads_file.generic_string().c_str(), std::ios::in | std::ios::binary );
+               in.read( packed.data(), packed.size() );
+
+               auto heads = fc::raw::unpack< history_heads >( packed );
+               if( heads.accounts <= accounts.count() && heads.trxs <= trxs.count() && heads.trx_buckets.size() == trx_bucket_count )
+               {
+                  account_heads.insert( heads.account_heads.begin(), heads.account_heads.end() );
+                  trx_buckets = std::move( heads.trx_buckets );
+                  accounts_from = heads.accounts;
+                  trxs_from = heads.trxs;
+               }
+            }
+            catch( const fc::exception& e )
+            {
+               wlog( "Ignoring unreadable account history heads: ${e}", ("e",e.to_detail_string()) );
+               account_heads.clear();
+               trx_buckets.assign( trx_bucket_count, npos );
+            }
+         }
+
+         scan_heads( accounts_from, trxs_from );
+      }
+
+      void account_history_store_impl::save_heads()
+      {
+         history_heads heads;
+         heads.accounts = accounts.count();
+         heads.trxs = trxs.count();
+         heads.account_heads.assign( account_heads.begin(), account_heads.end() );
+         heads.trx_buckets = trx_buckets;
+
+         auto packed = fc::raw::pack( heads );
+         fc::path tmp = dir / "heads.tmp";
+         {
+            std::ofstream out( tmp.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+            out.write( packed.data(), packed.size() );
+         }
+         fc::rename( tmp, dir / "heads" );
+      }
+
+      /// Brings the heads up to date with records appended after they were saved
+      void account_history_store_impl::scan_heads( uint64_t accounts_from, uint64_t trxs_from )
+      {
+         if( accounts.count() - accounts_from + trxs.count() - trxs_from > 1000000 )
+            ilog( "Rebuilding account history heads from ${n} records", ("n", accounts.count() - accounts_from + trxs.count() - trxs_from) );
+
+         for( uint64_t i = accounts_from; i < accounts.count(); ++i )
+            account_heads[ accounts.at( i ).account ] = i;
+
+         for( uint64_t i = trxs_from; i < trxs.count(); ++i )
+            trx_buckets[ trxs.at( i ).trx_id._hash[0] % trx_bucket_count ] = i;
+      }
+
+      uint32_t account_history_store_impl::committed_sequence( const account_name_type& account )const
+      {
+         auto itr = account_heads.find( account );
+         return itr != account_heads.end() ? accounts.at( itr->second ).sequence : 0;
+      }
+
+      uint32_t account_history_store_impl::last_sequence( const account_name_type& account )const
+      {
+         auto itr = pending_sequences.find( account );
+         return itr != pending_sequences.end() ? itr->second : committed_sequence( account );
+      }
+
+      void account_history_store_impl::update_pending_sequences()
+      {
+         pending_sequences.clear();
+         for( const auto& b : pending )
+            for( size_t i = 0; i < b.sequences.size(); ++i )
+               pending_sequences[ b.block.account_ops[i].first ] = b.sequences[i];
+      }
+
+      void account_history_store_impl::append_pending( history_block&& block )
+      {
+         pending_block b;
+         b.block = std::move( block );
+         b.sequences.reserve( b.block.account_ops.size() );
+
+         for( const auto& entry : b.block.account_ops )
+         {
+            FC_ASSERT( entry.second < b.block.operations.size() );
+            uint32_t sequence = last_sequence( entry.first ) + 1;
+            pending_sequences[ entry.first ] = sequence;
+            b.sequences.push_back( sequence );
+         }
+
+         pending.push_back( std::move( b ) );
+      }
+
+      /// Walks back from the record at index to the record with the given sequence of the same account
+      uint64_t account_history_store_impl::find_sequence( uint64_t index, uint32_t sequence )const
+      {
+         while( index != npos && sequence > 0 )
+         {
+            auto r = accounts.at( index );
+            if( r.sequence <= sequence )
+               return r.sequence == sequence ? index : npos;
+
+            uint32_t skip_sequence = r.sequence - ( r.sequence & ( ~r.sequence + 1 ) );
+            index = ( r.skip != npos && skip_sequence >= sequence ) ? r.skip : r.prev;
+         }
+
+         return npos;
+      }
+
+      void account_history_store_impl::append_block( const pending_block& b )
+      {
+         uint64_t first_op = ops.count();
+         transaction_id_type last_trx_id;
+
+         for( const auto& op : b.block.operations )
+         {
+            op_record r;
+            r.trx_id       = op.trx_id;
+            r.op_in_trx    = op.op_in_trx;
+            r.block        = op.block;
+            r.trx_in_block = op.trx_in_block;
+            r.timestamp    = op.timestamp.sec_since_epoch();
+            r.data_size    = op.serialized_op.size();
+            r.virtual_op   = op.virtual_op;
+            r.data_pos     = data.size();
+
+            // Only the first operation of each transaction is indexed, which is all get_transaction needs
+            if( op.trx_id != transaction_id_type() && op.trx_id != last_trx_id )
+            {
+               uint64_t& bucket = trx_buckets[ op.trx_id._hash[0] % trx_bucket_count ];
+
+               trx_record t;
+               t.trx_id = op.trx_id;
+               t.op     = ops.count();
+               t.prev   = bucket;
+
+               bucket = trxs.count();
+               trxs.push_back( t );
+               last_trx_id = op.trx_id;
+            }
+
+            data.append( op.serialized_op.data(), op.serialized_op.size() );
+            ops.push_back( r );
+         }
+
+         for( size_t i = 0; i < b.block.account_ops.size(); ++i )
+         {
+            const auto& account = b.block.account_ops[i].first;
+            auto head = account_heads.find( account );
+
+            account_record a;
+            a.account  = account;
+            a.sequence = b.sequences[i];
+            a.op       = first_op + b.block.account_ops[i].second;
+            a.prev     = head != account_heads.end() ? head->second : npos;
+            a.skip     = find_sequence( a.prev, a.sequence - ( a.sequence & ( ~a.sequence + 1 ) ) );
+
+            account_heads[ account ] = accounts.count();
+            accounts.push_back( a );
+         }
+
+         block_record end;
+         end.block_num    = b.block.block_num;
+         end.ops_end      = ops.count();
+         end.accounts_end = accounts.count();
+         end.trxs_end     = trxs.count();
+         end.data_end     = data.size();
+         blocks.push_back( end );
+      }
+
+      history_operation account_history_store_impl::read_op( uint64_t index )const
+      {
+         auto r = ops.at( index );
+
+         history_operation op;
+         op.trx_id       = r.trx_id;
+         op.block        = r.block;
+         op.trx_in_block = r.trx_in_block;
+         op.op_in_trx    = r.op_in_trx;
+         op.virtual_op   = r.virtual_op;
+         op.timestamp    = fc::time_point_sec( r.timestamp );
+
+         const char* bytes = data.read( r.data_pos );
+         op.serialized_op.assign( bytes, bytes + r.data_size );
+         return op;
+      }
+   }
+
+   account_history_store::account_history_store()
+      : my( new detail::account_history_store_impl() )
+   {}
+
+   account_history_store::~account_history_store()
+   {
+      close();
+   }
+
+   void account_history_store::open( const fc::path& dir )
+   {
+      try
+      {
+         boost::unique_lock< boost::shared_mutex > lock( my->mutex );
+         FC_ASSERT( !my->is_open );
+
+         my->dir = dir;
+         my->open_tables();
+
+         // A block is only committed once its record is complete, drop anything written after that
+         my->truncate( my->blocks.count() );
+         my->load_heads();
+         my->is_open = true;
+
+         ilog( "Opened account history store at block ${b}", ("b", my->committed_head()) );
+      }
+      FC_CAPTURE_LOG_AND_RETHROW( (dir) )
+   }
+
+   /// Reversible blocks are dropped; they are pushed again after the chain is reopened
+   void account_history_store::close()
+   {
+      boost::unique_lock< boost::shared_mutex > lock( my->mutex );
+      if( !my->is_open )
+         return;
+
+      my->save_heads();
+      my->close_tables();
+      my->pending.clear();
+      my->pending_sequences.clear();
+      my->is_open = false;
+   }
+
+   void account_history_store::push_block( history_block&& block )
+   {
+      try
+      {
+         boost::unique_lock< boost::shared_mutex > lock( my->mutex );
+         FC_ASSERT( my->is_open );
+
+         uint32_t block_num = block.block_num;
+
+         if( my->pending.size() && my->pending.back().block.block_num >= block_num )
+         {
+            while( my->pending.size() && my->pending.back().block.block_num >= block_num )
+               my->pending.pop_back();
+            my->update_pending_sequences();
+         }
+
+         if( my->pending.empty() && my->blocks.count() && block_num <= my->committed_head() )
+         {
+            uint32_t first = my->first_block();
+            wlog( "Truncating account history store from block ${n}", ("n",block_num) );
+
+            my->truncate( block_num > first ? block_num - first : 0 );
+            my->load_heads();
+         }
+
+         uint32_t head = my->head();
+         if( head && block_num > head + 1 )
+         {
+            wlog( "Account history store has no history for blocks ${f} to ${t}", ("f",head + 1)("t",block_num - 1) );
+
+            for( uint32_t n = head + 1; n < block_num; ++n )
+            {
+               history_block empty;
+               empty.block_num = n;
+               my->append_pending( std::move( empty ) );
+            }
+         }
+
+         my->append_pending( std::move( block ) );
+      }
+      FC_CAPTURE_AND_RETHROW( (block.block_num) )
+   }
+
+   void account_history_store::commit( uint32_t block_num )
+   {
+      try
+      {
+         boost::unique_lock< boost::shared_mutex > lock( my->mutex );
+         FC_ASSERT( my->is_open );
+
+         if( my->pending.empty() || my->pending.front().block.block_num > block_num )
+            return;
+
+         while( my->pending.size() && my->pending.front().block.block_num <= block_num )
+         {
+            my->append_block( my->pending.front() );
+            my->pending.pop_front();
+         }
+
+         my->data.flush();
+         my->ops.flush();
+         my->accounts.flush();
+         my->trxs.flush();
+         my->blocks.flush();
+
+         my->update_pending_sequences();
+      }
+      FC_CAPTURE_AND_RETHROW( (block_num) )
+   }
+
+   uint32_t account_history_store::head_block_num()const
+   {
+      boost::shared_lock< boost::shared_mutex > lock( my->mutex );
+      return my->head();
+   }
+
+   uint32_t account_history_store::committed_block_num()const
+   {
+      boost::shared_lock< boost::shared_mutex > lock( my->mutex );
+      return my->committed_head();
+   }
+
+   uint32_t account_history_store::first_block_num()const
+   {
+      boost::shared_lock< boost::shared_mutex > lock( my->mutex );
+      if( my->blocks.count() )
+         return my->first_block();
+      return my->pending.size() ? my->pending.front().block.block_num : 0;
+   }
+
+   vector< history_operation > account_history_store::get_ops_in_block( uint32_t block_num )const
+   {
+      boost::shared_lock< boost::shared_mutex > lock( my->mutex );
+      vector< history_operation > result;
+
+      if( my->pending.size() && block_num >= my->pending.front().block.block_num )
+      {
+         uint32_t index = block_num - my->pending.front().block.block_num;
+         if( index < my->pending.size() )
+            result = my->pending[ index ].block.operations;
+         return result;
+      }
+
+      uint32_t first = my->first_block();
+      if( my->blocks.count() == 0 || block_num < first || block_num > my->committed_head() )
+         return result;
+
+      uint64_t index = block_num - first;
+      uint64_t begin = index > 0 ? my->blocks.at( index - 1 ).ops_end : 0;
+      uint64_t end = my->blocks.at( index ).ops_end;
+
+      result.reserve( end - begin );
+      for( uint64_t i = begin; i < end; ++i )
+         result.push_back( my->read_op( i ) );
+
+      return result;
+   }
+
+   std::map< uint32_t, history_operation > account_history_store::get_account_history( const account_name_type& account, uint64_t from, uint32_t limit )const
+   {
+      boost::shared_lock< boost::shared_mutex > lock( my->mutex );
+      std::map< uint32_t, history_operation > result;
+
+      uint32_t last = my->last_sequence( account );
+      if( last == 0 )
+         return result;
+
+      uint32_t top = uint32_t( std::min< uint64_t >( from, last ) );
+      uint32_t bottom = top > limit ? top - limit : 0;
+
+      for( const auto& b : my->pending )
+      {
+         for( size_t i = 0; i < b.sequences.size(); ++i )
+         {
+            if( b.block.account_ops[i].first == account && b.sequences[i] >= bottom && b.sequences[i] <= top )
+               result[ b.sequences[i] ] = b.block.operations[ b.block.account_ops[i].second ];
+         }
+      }
+
+      uint32_t committed = my->committed_sequence( account );
+      if( committed == 0 || committed < bottom )
+         return result;
+
+      uint64_t index = my->find_sequence( my->account_heads.find( account )->second, std::min( top, committed ) );
+      while( index != detail::npos )
+      {
+         auto r = my->accounts.at( index );
+         if( r.sequence < bottom )
+            break;
+
+         result[ r.sequence ] = my->read_op( r.op );
+         index = r.prev;
+      }
+
+      return result;
+   }
+
+   fc::optional< history_operation > account_history_store::find_transaction( const transaction_id_type& id )const
+   {
+      boost::shared_lock< boost::shared_mutex > lock( my->mutex );
+
+      for( auto itr = my->pending.rbegin(); itr != my->pending.rend(); ++itr )
+      {
+         for( const auto& op : itr->block.operations )
+         {
+            if( op.trx_id == id )
+               return op;
+         }
+      }
+
+      if( !my->is_open )
+         return fc::optional< history_operation >();
+
+      uint64_t index = my->trx_buckets[ id._hash[0] % detail::trx_bucket_count ];
+      while( index != detail::npos )
+      {
+         auto r = my->trxs.at( index );
+         if( r.trx_id == id )
+            return my->read_op( r.op );
+         index = r.prev;
+      }
+
+      return fc::optional< history_operation >();
+   }
+
+} } // wls::chain
@@ -1,15 +1,90 @@
 #include <wls/chain/block_log.hpp>
+#include <wls/chain/prepared_block.hpp>
 #include <fstream>
+#include <mutex>
 #include <fc/io/raw.hpp>
 
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
 
 namespace wls { namespace chain {
 
+   namespace bip = boost::interprocess;
+
    namespace detail {
+
+      /**
+       * Read only mapping of block_log and block_log.index covering the first num_blocks
+       * blocks. It is never modified once created; growing the log creates a new mapping.
+       */
+      class block_log_mapping
+      {
+         public:
+            block_log_mapping( const fc::path& block_file, const fc::path& index_file, uint32_t blocks, uint64_t end )
+               : block_mapping( block_file.generic_string().c_str(), bip::read_only ),
+                 index_mapping( index_file.generic_string().c_str(), bip::read_only ),
+                 block_region( block_mapping, bip::read_only, 0, end ),
+                 index_region( index_mapping, bip::read_only, 0, sizeof( uint64_t ) * blocks ),
+                 num_blocks( blocks ),
+                 block_end( end )
+            {}
+
+            const char* block_data()const { return (const char*)block_region.get_address(); }
+
+            uint64_t pos( uint32_t block_num )const
+            {
+               return ((const uint64_t*)index_region.get_address())[ block_num - 1 ];
+            }
+
+            /// Size of the packed block, excluding the position that trails it
+            uint64_t packed_size( uint32_t block_num )const
+            {
+               uint64_t next = block_num < num_blocks ? pos( block_num + 1 ) : block_end;
+               return next - sizeof( uint64_t ) - pos( block_num );
+            }
+
+            bip::file_mapping    block_mapping;
+            bip::file_mapping    index_mapping;
+            bip::mapped_region   block_region;
+            bip::mapped_region   index_region;
+            uint32_t             num_blocks = 0;
+            uint64_t             block_end = 0;
+      };
+
       class block_log_impl {
          public:
+            std::mutex                                   mapping_mutex;
+            std::shared_ptr< const block_log_mapping >   mapping;
+            uint32_t                                     written_blocks = 0;
+            uint64_t                                     written_end = 0;
+
+            /**
+             * Returns a mapping that contains block_num, extending the current one if the block
+             * was appended after it was created, or nullptr if the block is not in the log.
+             */
+            std::shared_ptr< const block_log_mapping > get_mapping( uint32_t block_num )
+            {
+               std::lock_guard< std::mutex > guard( mapping_mutex );
+
+               if( block_num == 0 || block_num > written_blocks )
+                  return std::shared_ptr< const block_log_mapping >();
+
+               if( !mapping || mapping->num_blocks < block_num )
+                  mapping = std::make_shared< block_log_mapping >( block_file, index_file, written_blocks, written_end );
+
+               return mapping;
+            }
+
+            void set_written( uint32_t blocks, uint64_t end )
+            {
+               std::lock_guard< std::mutex > guard( mapping_mutex );
+               written_blocks = blocks;
+               written_end = end;
+            }
+
             optional< signed_block > head;
             block_id_type            head_id;
             std::fstream             block_stream;
@@ -77,6 +152,32 @@ namespace wls { namespace chain {
       };
    }
 
+   packed_block::packed_block( const signed_block& b )
+   {
+      auto data = std::make_shared< vector< char > >( fc::raw::pack( b ) );
+      _data = data->data();
+      _size = data->size();
+      _owner = std::move( data );
+   }
+
+   signed_block_header packed_block::unpack_header()const
+   {
+      FC_ASSERT( valid() );
+      signed_block_header result;
+      fc::datastream< const char* > ds( _data, _size );
+      fc::raw::unpack( ds, result );
+      return result;
+   }
+
+   signed_block packed_block::unpack()const
+   {
+      FC_ASSERT( valid() );
+      signed_block result;
+      fc::datastream< const char* > ds( _data, _size );
+      fc::raw::unpack( ds, result );
+      return result;
+   }
+
    block_log::block_log()
    :my( new detail::block_log_impl() )
    {
@@ -96,6 +197,13 @@ namespace wls { namespace chain {
       if( my->index_stream.is_open() )
          my->index_stream.close();
 
+      {
+         std::lock_guard< std::mutex > guard( my->mapping_mutex );
+         my->mapping.reset();
+         my->written_blocks = 0;
+         my->written_end = 0;
+      }
+
       my->block_file = file;
       my->index_file = fc::path( file.generic_string() + ".index" );
 
@@ -170,6 +278,11 @@ namespace wls { namespace chain {
          my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
          my->index_write = true;
       }
+
+      // Everything read through the mapping must be on disk
+      my->index_stream.flush();
+      if( my->head )
+         my->set_written( my->head->block_num(), fc::file_size( my->block_file ) );
    }
 
    void block_log::close()
@@ -183,6 +296,17 @@ namespace wls { namespace chain {
    }
 
    uint64_t block_log::append( const signed_block& b )
+   {
+      auto data = fc::raw::pack( b );
+      return append( b, b.id(), data.data(), data.size() );
+   }
+
+   uint64_t block_log::append( const prepared_block& b )
+   {
+      return append( b.block(), b.id(), b.packed().data(), b.packed_size() );
+   }
+
+   uint64_t block_log::append( const signed_block& b, const block_id_type& id, const char* data, size_t size )
    {
       try
       {
@@ -192,12 +316,17 @@ namespace wls { namespace chain {
          uint64_t pos = my->block_stream.tellp();
          uint64_t index_pos = my->index_stream.tellp();
          FC_ASSERT( index_pos == sizeof( uint64_t ) * uint64_t( b.block_num() - 1 ), "Append to index file occuring at wrong position.", ( "position", (uint64_t) my->index_stream.tellp() )( "expected",( b.block_num() - 1 ) * sizeof( uint64_t ) ) );
-         auto data = fc::raw::pack( b );
-         my->block_stream.write( data.data(), data.size() );
+         my->block_stream.write( data, size );
          my->block_stream.write( (char*)&pos, sizeof( pos ) );
          my->index_stream.write( (char*)&pos, sizeof( pos ) );
          my->head = b;
-         my->head_id = b.id();
+         my->head_id = id;
+
+         // Flush so the block is visible to readers of the mapping. The block is flushed before
+         // its index entry, so an index entry never refers to missing data.
+         my->block_stream.flush();
+         my->index_stream.flush();
+         my->set_written( b.block_num(), pos + size + sizeof( pos ) );
 
          return pos;
       }
@@ -230,10 +359,10 @@ namespace wls { namespace chain {
       try
       {
       optional< signed_block > b;
-      uint64_t pos = get_block_pos( block_num );
-      if( pos != npos )
+      auto packed = read_packed_block_by_num( block_num );
+      if( packed.valid() )
       {
-         b = read_block( pos ).first;
+         b = packed.unpack();
          FC_ASSERT( b->block_num() == block_num , "Wrong block was read from block log.", ( "returned", b->block_num() )( "expected", block_num ));
       }
       return b;
@@ -241,18 +370,30 @@ namespace wls { namespace chain {
       FC_LOG_AND_RETHROW()
    }
 
-   uint64_t block_log::get_block_pos( uint32_t block_num ) const
+   packed_block block_log::read_packed_block_by_num( uint32_t block_num )const
    {
       try
       {
-         my->check_index_read();
+         auto mapping = my->get_mapping( block_num );
+         if( !mapping )
+            return packed_block();
+
+         uint64_t pos = mapping->pos( block_num );
+         uint64_t size = mapping->packed_size( block_num );
+         FC_ASSERT( pos + size <= mapping->block_end, "Block log index is inconsistent with block log", ("block_num",block_num)("pos",pos)("size",size) );
+         return packed_block( mapping, mapping->block_data() + pos, size );
+      }
+      FC_LOG_AND_RETHROW()
+   }
 
-         if( !( my->head.valid() && block_num <= protocol::block_header::num_from_id( my->head_id ) && block_num > 0 ) )
+   uint64_t block_log::get_block_pos( uint32_t block_num ) const
+   {
+      try
+      {
+         auto mapping = my->get_mapping( block_num );
+         if( !mapping )
             return npos;
-         my->index_stream.seekg( sizeof( uint64_t ) * ( block_num - 1 ) );
-         uint64_t pos;
-         my->index_stream.read( (char*)&pos, sizeof( pos ) );
-         return pos;
+         return mapping->pos( block_num );
       }
       FC_LOG_AND_RETHROW()
    }
@@ -23,6 +23,7 @@
 #include <fc/uint128.hpp>
 #include <fc/container/deque.hpp>
 #include <fc/io/fstream.hpp>
+#include <fc/thread/thread_specific.hpp>
 
 #include <cstdint>
 #include <deque>
@@ -82,8 +83,20 @@ class database_impl
 database_impl::database_impl( database& self )
    : _self(self), _evaluator_registry(self) {}
 
+/// Tells chainbase which fc task a read runs in, as tasks yielding inside a read share its thread
+static const void* current_fc_task_key()
+{
+   static fc::task_specific_ptr< char > key;
+   if( !key.get() )
+      key.reset( new char() );
+   return key.get();
+}
+
 database::database()
-   : _my( new database_impl(*this) ) {}
+   : _my( new database_impl(*this) )
+{
+   chainbase::database::set_task_key_function( &current_fc_task_key );
+}
 
 database::~database()
 {
@@ -100,6 +113,26 @@ void database::open( const fc::path& data_dir, const fc::path& shared_mem_dir, u
       initialize_indexes();
       initialize_evaluators();
 
+      _signature_cache.clear();
+      _authority_change_revision = -1;
+      _authority_change_conn = on_object_change< account_authority_object >(
+         [this]( const object_change_notification< account_authority_object >& ) { on_authority_change(); } );
+
+      // Changes made while the pending state is popped come from blocks. This keeps account_object,
+      // the most often modified type, notifying on every change even when no plugin subscribes.
+      _pool_account_conn = on_object_change< account_object >(
+         [this]( const object_change_notification< account_object >& note )
+         {
+            if( !_pending_tx_session.valid() )
+               _pending_tx.account_changed( note.object.name );
+         } );
+      _pool_authority_conn = on_object_change< account_authority_object >(
+         [this]( const object_change_notification< account_authority_object >& note )
+         {
+            if( !_pending_tx_session.valid() )
+               _pending_tx.account_changed( note.object.account );
+         } );
+
       if( chainbase_flags & chainbase::database::read_write )
       {
          if( !find< dynamic_global_property_object >() )
@@ -118,6 +151,7 @@ void database::open( const fc::path& data_dir, const fc::path& shared_mem_dir, u
             undo_all();
             FC_ASSERT( revision() == head_block_num(), "Chainbase revision does not match head block num",
                ("rev", revision())("head_block", head_block_num()) );
+            chainbase::database::set_undo_journal( _undo_journal );
             validate_invariants();
          });
 
@@ -129,6 +163,11 @@ void database::open( const fc::path& data_dir, const fc::path& shared_mem_dir, u
 
             _fork_db.start_block( *head_block );
          }
+
+         with_read_lock( [&]()
+         {
+            load_recent_transactions();
+         });
       }
 
       with_read_lock( [&]()
@@ -155,47 +194,202 @@ void database::reindex( const fc::path& data_dir, const fc::path& shared_mem_dir
       ilog( "Replaying blocks..." );
 
 
+      // The merkle root is computed by the replay workers, so it is checked rather than skipped
       uint64_t skip_flags =
          skip_witness_signature |
          skip_transaction_signatures |
          skip_transaction_dupe_check |
          skip_tapos_check |
-         skip_merkle_check |
          skip_witness_schedule_check |
          skip_authority_check |
          skip_validate | /// no need to validate operations
          skip_validate_invariants |
          skip_block_log;
 
+      replay_pipeline pipeline( data_dir / "block_log", _replay_threads );
+
       with_write_lock( [&]()
       {
-         auto itr = _block_log.read_block( 0 );
          auto last_block_num = _block_log.head()->block_num();
 
-         while( itr.first.block_num() != last_block_num )
+         for( auto batch = pipeline.next_batch(); !batch->empty(); batch = pipeline.next_batch() )
          {
-            auto cur_block_num = itr.first.block_num();
-            if( cur_block_num % 100000 == 0 )
-               std::cerr << "   " << double( cur_block_num * 100 ) / last_block_num << "%   " << cur_block_num << " of " << last_block_num <<
-               "   (" << (get_free_memory() / (1024*1024)) << "M free)\n";
-            apply_block( itr.first, skip_flags );
-            itr = _block_log.read_block( itr.second );
+            auto apply_start = fc::time_point::now();
+
+            for( const auto& rb : *batch )
+            {
+               auto cur_block_num = rb.block->block_num();
+               if( cur_block_num % 100000 == 0 )
+                  std::cerr << "   " << double( cur_block_num * 100 ) / last_block_num << "%   " << cur_block_num << " of " << last_block_num <<
+                  "   (" << (get_free_memory() / (1024*1024)) << "M free)\n";
+               apply_block( rb, skip_flags );
+            }
+
+            pipeline.stats().apply.blocks += batch->size();
+            pipeline.stats().apply.busy += fc::time_point::now() - apply_start;
          }
 
-         apply_block( itr.first, skip_flags );
          set_revision( head_block_num() );
       });
 
+      _last_replay_stats = pipeline.stats();
+      FC_ASSERT( head_block_num() == _block_log.head()->block_num(), "Replay stopped before the end of the block log",
+         ("head",head_block_num())("block_log_head",_block_log.head()->block_num()) );
+
       if( _block_log.head()->block_num() )
          _fork_db.start_block( *_block_log.head() );
 
+      with_read_lock( [&]()
+      {
+         load_recent_transactions();
+      });
+
       auto end = fc::time_point::now();
       ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+      ilog( "Replay throughput (blocks/sec): read ${r}, hash ${h} on ${n} threads, apply ${a}",
+         ("r",_last_replay_stats.read.blocks_per_second())("h",_last_replay_stats.hash.blocks_per_second())
+         ("n",_last_replay_stats.worker_threads)("a",_last_replay_stats.apply.blocks_per_second()) );
    }
    FC_CAPTURE_AND_RETHROW( (data_dir)(shared_mem_dir) )
 
 }
 
+void database::import_block_log( const fc::path& data_dir, const fc::path& shared_mem_dir, uint64_t shared_file_size, const fc::path& source_block_log )
+{
+   try
+   {
+      ilog( "Importing blocks from ${f}", ("f", source_block_log) );
+      FC_ASSERT( fc::exists( source_block_log ) && fc::exists( source_block_log.generic_string() + ".index" ),
+         "Block log to import and its index must both exist" );
+      FC_ASSERT( fc::absolute( source_block_log ) != fc::absolute( data_dir / "block_log" ),
+         "Cannot import the block log the database is built from, use --replay-blockchain instead" );
+
+      wipe( data_dir, shared_mem_dir, true );
+      open( data_dir, shared_mem_dir, WLS_INIT_SUPPLY, shared_file_size, chainbase::database::read_write );
+      _fork_db.reset();    // override effect of _fork_db.start_block() call in open()
+
+      auto start = fc::time_point::now();
+
+      // Everything is checked. Blocks in a block log are irreversible, so they skip the fork
+      // database and are appended to our own block log once applied.
+      uint64_t skip_flags =
+         skip_fork_db |
+         skip_block_log;
+
+      replay_pipeline pipeline( source_block_log, _replay_threads, 1000, true );
+
+      with_write_lock( [&]()
+      {
+         for( auto batch = pipeline.next_batch(); !batch->empty(); batch = pipeline.next_batch() )
+         {
+            auto apply_start = fc::time_point::now();
+
+            for( const auto& rb : *batch )
+            {
+               auto cur_block_num = rb.block->block_num();
+               if( cur_block_num % 100000 == 0 )
+                  std::cerr << "   " << cur_block_num << " blocks imported   (" << (get_free_memory() / (1024*1024)) << "M free)\n";
+               apply_block( rb, skip_flags );
+               _block_log.append( *rb.block );
+            }
+            _block_log.flush();
+
+            pipeline.stats().apply.blocks += batch->size();
+            pipeline.stats().apply.busy += fc::time_point::now() - apply_start;
+         }
+
+         set_revision( head_block_num() );
+      });
+
+      _last_replay_stats = pipeline.stats();
+
+      if( _block_log.head() )
+         _fork_db.start_block( *_block_log.head() );
+
+      with_read_lock( [&]()
+      {
+         load_recent_transactions();
+      });
+
+      auto end = fc::time_point::now();
+      ilog( "Done importing ${n} blocks, elapsed time: ${t} sec", ("n", head_block_num())("t", double((end-start).count())/1000000.0 ) );
+      ilog( "Import throughput (blocks/sec): read ${r}, hash and recover signatures ${h} on ${w} threads, apply ${a}",
+         ("r",_last_replay_stats.read.blocks_per_second())("h",_last_replay_stats.hash.blocks_per_second())
+         ("w",_last_replay_stats.worker_threads)("a",_last_replay_stats.apply.blocks_per_second()) );
+   }
+   FC_CAPTURE_AND_RETHROW( (data_dir)(shared_mem_dir)(source_block_log) )
+}
+
+void database::import_snapshot( const fc::path& data_dir, const fc::path& shared_mem_dir, uint64_t shared_file_size, const fc::path& snapshot_file,
+   const optional< fc::sha256 >& expected_digest )
+{
+   try
+   {
+      auto header = read_state_snapshot_header( snapshot_file );
+      ilog( "Importing state snapshot at block ${n} from ${f}", ("n", header.head_block_num)("f", snapshot_file) );
+
+      auto state_digest = read_state_snapshot_footer( snapshot_file ).state_digest;
+      if( expected_digest )
+      {
+         FC_ASSERT( state_digest == *expected_digest, "Snapshot state digest ${d} is not the expected ${e}",
+            ("d", state_digest)("e", *expected_digest) );
+      }
+      else
+      {
+         wlog( "Snapshot state digest ${d} is not checked against a trusted digest, pass snapshot-digest to check it", ("d", state_digest) );
+      }
+
+      // Check the block log first, since open() would find the imported state unusable without it
+      {
+         block_log log;
+         log.open( data_dir / "block_log" );
+         auto head_block = log.read_block_by_num( header.head_block_num );
+         WLS_ASSERT( head_block.valid() && head_block->id() == header.head_block_id, block_log_exception,
+            "Block log does not contain the snapshot head block ${n}", ("n", header.head_block_num)("id", header.head_block_id) );
+      }
+
+      auto start = fc::time_point::now();
+      wipe( data_dir, shared_mem_dir, false );
+
+      init_schema();
+      chainbase::database::open( shared_mem_dir, chainbase::database::read_write, shared_file_size );
+      initialize_indexes();
+
+      with_write_lock( [&]()
+      {
+         import_state_snapshot( *this, snapshot_file, _replay_threads );
+         set_revision( head_block_num() );
+      });
+
+      chainbase::database::flush();
+      chainbase::database::close();
+
+      open( data_dir, shared_mem_dir, 0, shared_file_size, chainbase::database::read_write );
+
+      ilog( "Done importing state snapshot, elapsed time: ${t} sec", ("t", double( ( fc::time_point::now() - start ).count() ) / 1000000.0 ) );
+   }
+   FC_CAPTURE_AND_RETHROW( (data_dir)(shared_mem_dir)(snapshot_file)(expected_digest) )
+}
+
+void database::export_snapshot( const fc::path& snapshot_file )
+{
+   try
+   {
+      with_read_lock( [&]()
+      {
+         ilog( "Exporting state snapshot at block ${n} to ${f}", ("n", head_block_num())("f", snapshot_file) );
+         export_state_snapshot( *this, snapshot_file );
+      });
+   }
+   FC_CAPTURE_AND_RETHROW( (snapshot_file) )
+}
+
+void database::add_snapshot_index( std::shared_ptr< detail::abstract_snapshot_index > idx )
+{
+   // Indices are added again each time the database is opened
+   _snapshot_indices[ idx->name() ] = idx;
+}
+
 void database::wipe( const fc::path& data_dir, const fc::path& shared_mem_dir, bool include_blocks)
 {
    close();
@@ -312,16 +506,36 @@ optional<signed_block> database::fetch_block_by_number( uint32_t block_num )cons
    return b;
 } FC_LOG_AND_RETHROW() }
 
-const signed_transaction database::get_recent_transaction( const transaction_id_type& trx_id ) const
+packed_block database::fetch_packed_block_by_id( const block_id_type& id )const
 { try {
-   auto& index = get_index<transaction_index>().indices().get<by_trx_id>();
-   auto itr = index.find(trx_id);
-   FC_ASSERT(itr != index.end());
-   signed_transaction trx;
-   fc::raw::unpack( itr->packed_trx, trx );
-   return trx;;
+   auto b = _fork_db.fetch_block( id );
+   if( b )
+      return b->prepared->packed();
+
+   auto packed = _block_log.read_packed_block_by_num( protocol::block_header::num_from_id( id ) );
+   if( packed.valid() && packed.unpack_header().id() == id )
+      return packed;
+
+   return packed_block();
 } FC_CAPTURE_AND_RETHROW() }
 
+packed_block database::fetch_packed_block_by_number( uint32_t block_num )const
+{ try {
+   auto results = _fork_db.fetch_block_by_number( block_num );
+   if( results.size() == 1 )
+      return results[0]->prepared->packed();
+
+   return _block_log.read_packed_block_by_num( block_num );
+} FC_LOG_AND_RETHROW() }
+
+const signed_transaction database::get_recent_transaction( const transaction_id_type& trx_id ) const
+{ try {
+   FC_ASSERT( is_known_transaction( trx_id ), "Transaction is not known or has expired" );
+   auto trx = _recent_transaction_cache.find( trx_id );
+   FC_ASSERT( trx.valid(), "Transaction was evicted from the recent transaction cache" );
+   return *trx;
+} FC_CAPTURE_AND_RETHROW( (trx_id) ) }
+
 std::vector< block_id_type > database::get_block_ids_on_fork( block_id_type head_of_fork ) const
 { try {
    pair<fork_database::branch_type, fork_database::branch_type> branches = _fork_db.fetch_branch_from(head_block_id(), head_of_fork);
@@ -347,42 +561,42 @@ chain_id_type database::get_chain_id() const
 
 const witness_object& database::get_witness( const account_name_type& name ) const
 { try {
-   return get< witness_object, by_name >( name );
+   return get< witness_object, by_name_hash >( name );
 } FC_CAPTURE_AND_RETHROW( (name) ) }
 
 const witness_object* database::find_witness( const account_name_type& name ) const
 {
-   return find< witness_object, by_name >( name );
+   return find< witness_object, by_name_hash >( name );
 }
 
 const account_object& database::get_account( const account_name_type& name )const
 { try {
-   return get< account_object, by_name >( name );
+   return get< account_object, by_name_hash >( name );
 } FC_CAPTURE_AND_RETHROW( (name) ) }
 
 const account_object* database::find_account( const account_name_type& name )const
 {
-   return find< account_object, by_name >( name );
+   return find< account_object, by_name_hash >( name );
 }
 
 const comment_object& database::get_comment( const account_name_type& author, const shared_string& permlink )const
 { try {
-   return get< comment_object, by_permlink >( boost::make_tuple( author, permlink ) );
+   return get< comment_object, by_permlink_hash >( boost::make_tuple( author, permlink ) );
 } FC_CAPTURE_AND_RETHROW( (author)(permlink) ) }
 
 const comment_object* database::find_comment( const account_name_type& author, const shared_string& permlink )const
 {
-   return find< comment_object, by_permlink >( boost::make_tuple( author, permlink ) );
+   return find< comment_object, by_permlink_hash >( boost::make_tuple( author, permlink ) );
 }
 
 const comment_object& database::get_comment( const account_name_type& author, const string& permlink )const
 { try {
-   return get< comment_object, by_permlink >( boost::make_tuple( author, permlink) );
+   return get< comment_object, by_permlink_hash >( boost::make_tuple( author, permlink) );
 } FC_CAPTURE_AND_RETHROW( (author)(permlink) ) }
 
 const comment_object* database::find_comment( const account_name_type& author, const string& permlink )const
 {
-   return find< comment_object, by_permlink >( boost::make_tuple( author, permlink ) );
+   return find< comment_object, by_permlink_hash >( boost::make_tuple( author, permlink ) );
 }
 
 const dynamic_global_property_object&database::get_dynamic_global_properties() const
@@ -450,6 +664,11 @@ bool database::before_last_checkpoint()const
  * @return true if we switched forks as a result of this push.
  */
 bool database::push_block(const signed_block& new_block, uint32_t skip)
+{
+   return push_block( prepared_block::create( new_block ), skip );
+}
+
+bool database::push_block(const prepared_block_ptr& new_block, uint32_t skip)
 {
    //fc::time_point begin_time = fc::time_point::now();
 
@@ -458,13 +677,13 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
    {
       with_write_lock( [&]()
       {
-         detail::without_pending_transactions( *this, std::move(_pending_tx), [&]()
+         detail::without_pending_transactions( *this, [&]()
          {
             try
             {
                result = _push_block(new_block);
             }
-            FC_CAPTURE_AND_RETHROW( (new_block) )
+            FC_CAPTURE_AND_RETHROW( (new_block->block()) )
          });
       });
    });
@@ -492,7 +711,7 @@ void database::_maybe_warn_multiple_production( uint32_t height )const
    return;
 }
 
-bool database::_push_block(const signed_block& new_block)
+bool database::_push_block(const prepared_block_ptr& new_block)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
    //uint32_t skip_undo_db = skip & skip_undo_block;
@@ -510,7 +729,7 @@ bool database::_push_block(const signed_block& new_block)
          if( new_head->data.block_num() > head_block_num() )
          {
             // wlog( "Switching to fork: ${id}", ("id",new_head->data.id()) );
-            auto branches = _fork_db.fetch_branch_from(new_head->data.id(), head_block_id());
+            auto branches = _fork_db.fetch_branch_from(new_head->id, head_block_id());
 
             // pop blocks until we hit the forked block
             while( head_block_id() != branches.second.back()->data.previous )
@@ -524,7 +743,7 @@ bool database::_push_block(const signed_block& new_block)
                 try
                 {
                    auto session = start_undo_session( true );
-                   apply_block( (*ritr)->data, skip );
+                   apply_block( (*ritr)->prepared, skip );
                    session.push();
                 }
                 catch ( const fc::exception& e ) { except = e; }
@@ -534,7 +753,7 @@ bool database::_push_block(const signed_block& new_block)
                    // remove the rest of branches.first from the fork_db, those blocks are invalid
                    while( ritr != branches.first.rend() )
                    {
-                      _fork_db.remove( (*ritr)->data.id() );
+                      _fork_db.remove( (*ritr)->id );
                       ++ritr;
                    }
                    _fork_db.set_head( branches.second.front() );
@@ -547,7 +766,7 @@ bool database::_push_block(const signed_block& new_block)
                    for( auto ritr = branches.second.rbegin(); ritr != branches.second.rend(); ++ritr )
                    {
                       auto session = start_undo_session( true );
-                      apply_block( (*ritr)->data, skip );
+                      apply_block( (*ritr)->prepared, skip );
                       session.push();
                    }
                    throw *except;
@@ -569,7 +788,7 @@ bool database::_push_block(const signed_block& new_block)
    catch( const fc::exception& e )
    {
       elog("Failed to push new block:\n${e}", ("e", e.to_detail_string()));
-      _fork_db.remove(new_block.id());
+      _fork_db.remove(new_block->id());
       throw;
    }
 
@@ -614,28 +833,61 @@ void database::push_transaction( const signed_transaction& trx, uint32_t skip )
 
 void database::_push_transaction( const signed_transaction& trx )
 {
-   // If this is the first transaction pushed after applying a block, start a new undo session.
-   // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
-   if( !_pending_tx_session.valid() )
-      _pending_tx_session = start_undo_session( true );
+   auto trx_id = trx.id();
+   FC_ASSERT( !_pending_tx.contains( trx_id ), "Duplicate transaction check failed", ("trx_ix", trx_id) );
 
-   // Create a temporary undo session as a child of _pending_tx_session.
-   // The temporary session will be discarded by the destructor if
-   // _apply_transaction fails.  If we make it to merge(), we
-   // apply the changes.
+   // Refuse spam before spending an apply on it
+   _pending_tx.check_sender( trx );
 
-   auto temp_session = start_undo_session( true );
-   _apply_transaction( trx );
-   _pending_tx.push_back( trx );
+   auto push = [&]()
+   {
+      // If this is the first transaction pushed after applying a block, start a new undo session.
+      // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
+      if( !_pending_tx_session.valid() )
+         _pending_tx_session = start_undo_session( true );
 
-   notify_changed_objects();
-   // The transaction applied successfully. Merge its changes into the pending block session.
-   temp_session.squash();
+      // Create a temporary undo session as a child of _pending_tx_session.
+      // The temporary session will be discarded by the destructor if
+      // _apply_transaction fails or the pool has no room for it.  If we
+      // make it to merge(), we apply the changes.
+
+      auto temp_session = start_undo_session( true );
+      _apply_transaction( trx );
+      _pending_tx.add( trx, trx_id );
+
+      notify_changed_objects();
+      // The transaction applied successfully. Merge its changes into the pending block session.
+      temp_session.squash();
+   };
+
+   try
+   {
+      push();
+   }
+   catch( const fc::exception& )
+   {
+      // It may build on pool transactions that were kept across the last block without being applied again
+      if( _pending_tx.unapplied() == 0 )
+         throw;
+
+      _pending_tx.apply_unapplied( [&]( const signed_transaction& t ) { apply_pending_transaction( t ); } );
+      push();
+   }
 
    // notify anyone listening to pending transactions
    notify_on_pending_transaction( trx );
 }
 
+void database::apply_pending_transaction( const signed_transaction& trx )
+{
+   if( !_pending_tx_session.valid() )
+      _pending_tx_session = start_undo_session( true );
+
+   auto temp_session = start_undo_session( true );
+   _apply_transaction( trx );
+   temp_session.squash();
+}
+
 signed_block database::generate_block(
    fc::time_point_sec when,
    const account_name_type& witness_owner,
@@ -673,6 +925,9 @@ signed_block database::_generate_block(
    if( !(skip & skip_witness_signature) )
       FC_ASSERT( witness_obj.signing_key == block_signing_private_key.get_public_key() );
 
+   if( _single_apply_production )
+      return _generate_block_in_place( when, witness_owner, block_signing_private_key )->block();
+
    static const size_t max_block_header_size = fc::raw::pack_size( signed_block_header() ) + 4;
    auto maximum_block_size = get_dynamic_global_properties().maximum_block_size; //WLS_MAX_BLOCK_SIZE;
    size_t total_block_size = max_block_header_size;
@@ -692,26 +947,28 @@ signed_block database::_generate_block(
       // the value of the "when" variable is known, which means we need to
       // re-apply pending transactions in this method.
       //
-      _pending_tx_session.reset();
+      pop_pending_state();
       _pending_tx_session = start_undo_session( true );
 
       uint64_t postponed_tx_count = 0;
+      vector< transaction_id_type > failed_tx_ids;
       // pop pending state (reset to head block state)
-      for( const signed_transaction& tx : _pending_tx )
+      _pending_tx.for_each( [&]( const signed_transaction& tx )
       {
          // Only include transactions that have not expired yet for currently generating block,
          // this should clear problem transactions and allow block production to continue
 
          if( tx.expiration < when )
-            continue;
+            return;
 
-         uint64_t new_total_size = total_block_size + fc::raw::pack_size( tx );
+         uint64_t tx_size = fc::raw::pack_size( tx );
+         uint64_t new_total_size = total_block_size + tx_size;
 
          // postpone transaction if it would make block too big
          if( new_total_size >= maximum_block_size )
          {
             postponed_tx_count++;
-            continue;
+            return;
          }
 
          try
@@ -720,33 +977,171 @@ signed_block database::_generate_block(
             _apply_transaction( tx );
             temp_session.squash();
 
-            total_block_size += fc::raw::pack_size( tx );
+            total_block_size = new_total_size;
             pending_block.transactions.push_back( tx );
          }
          catch ( const fc::exception& e )
          {
-            // Do nothing, transaction will not be re-applied
+            // The transaction will not be re-applied, and is dropped from the pool below
             //wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
             //wlog( "The transaction was ${t}", ("t", tx) );
+            failed_tx_ids.push_back( tx.id() );
          }
+      });
+
+      // Otherwise it would stay until it expires unless a block changes one of its accounts
+      for( const auto& id : failed_tx_ids )
+         _pending_tx.remove( id );
+
+      if( postponed_tx_count > 0 )
+      {
+         wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
       }
+
+      pop_pending_state();
+   });
+
+   // The pending state is popped until the push_block() call below
+   // restores the pool transactions the block does not include.
+
+   fill_block_header( pending_block, when, witness_owner );
+   pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+
+   if( !(skip & skip_witness_signature) )
+      pending_block.sign( block_signing_private_key );
+
+   auto prepared = prepared_block::create( std::move( pending_block ) );
+
+   // TODO:  Move this to _push_block() so session is restored.
+   if( !(skip & skip_block_size_check) )
+   {
+      FC_ASSERT( prepared->packed_size() <= WLS_MAX_BLOCK_SIZE );
+   }
+
+   push_block( prepared, skip );
+
+   return prepared->block();
+}
+
+prepared_block_ptr database::_generate_block_in_place(
+   fc::time_point_sec when,
+   const account_name_type& witness_owner,
+   const fc::ecc::private_key& block_signing_private_key
+   )
+{
+   uint32_t skip = get_node_properties().skip_flags;
+
+   static const size_t max_block_header_size = fc::raw::pack_size( signed_block_header() ) + 4;
+   auto maximum_block_size = get_dynamic_global_properties().maximum_block_size;
+   size_t total_block_size = max_block_header_size;
+
+   prepared_block_ptr prepared;
+
+   with_write_lock( [&]()
+   {
+      // Pops the pending state, which was applied outside of any block. On the way out, the
+      // pool is brought up to date with the new head, or the old one if producing failed.
+      detail::pending_transactions_restorer restore_pending( *this );
+
+      auto session = start_undo_session( true );
+      detail::block_phase_timer timer( _block_phase_stats.get(), _signal_time );
+
+      signed_block pending_block;
+      fill_block_header( pending_block, when, witness_owner );
+
+      // The block is signed once its transactions are known
+      const auto& signing_witness = begin_block( skip | skip_witness_signature, pending_block );
+      timer.end_phase( &block_phase_stats::validate_header );
+
+      uint64_t postponed_tx_count = 0;
+      vector< transaction_id_type > failed_tx_ids;
+      _pending_tx.for_each( [&]( const signed_transaction& tx )
+      {
+         if( tx.expiration < when )
+            return;
+
+         uint64_t tx_size = fc::raw::pack_size( tx );
+         uint64_t new_total_size = total_block_size + tx_size;
+
+         // postpone transaction if it would make block too big
+         if( new_total_size >= maximum_block_size )
+         {
+            postponed_tx_count++;
+            return;
+         }
+
+         // A failing transaction only undoes its own session, the block goes on without it
+         try
+         {
+            auto temp_session = start_undo_session( true );
+            apply_transaction( tx, skip );
+            temp_session.squash();
+         }
+         catch( const fc::exception& e )
+         {
+            dlog( "Transaction failed while producing block ${n} in place: ${e}", ("n", pending_block.block_num())("e", e.to_string()) );
+            failed_tx_ids.push_back( tx.id() );
+            return;
+         }
+
+         total_block_size = new_total_size;
+         pending_block.transactions.push_back( tx );
+         ++_current_trx_in_block;
+      });
+
+      // Otherwise it would stay until it expires unless a block changes one of its accounts
+      for( const auto& id : failed_tx_ids )
+         _pending_tx.remove( id );
+      timer.end_phase( &block_phase_stats::apply_transactions );
+
       if( postponed_tx_count > 0 )
       {
          wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
       }
 
-      _pending_tx_session.reset();
+      pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+
+      if( !(skip & skip_witness_signature) )
+         pending_block.sign( block_signing_private_key );
+
+      auto block = prepared_block::create( std::move( pending_block ) );
+
+      if( !(skip & skip_block_size_check) )
+      {
+         FC_ASSERT( block->packed_size() <= WLS_MAX_BLOCK_SIZE );
+      }
+      FC_ASSERT( block->packed_size() <= get_dynamic_global_properties().maximum_block_size, "Block Size is too Big",
+         ("block_size", block->packed_size())("max", get_dynamic_global_properties().maximum_block_size) );
+
+      // update_last_irreversible_block writes blocks to the block log from the fork database
+      if( !(skip & skip_fork_db) )
+         _fork_db.push_block( block );
+
+      try
+      {
+         finish_block( block, signing_witness, timer );
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Failed to produce block in place:\n${e}", ("e", e.to_detail_string()) );
+         _fork_db.remove( block->id() );
+         throw;
+      }
+
+      session.push();
+      prepared = std::move( block );
+
+      maybe_flush( prepared->block_num() );
+      show_free_memory( false );
    });
 
-   // We have temporarily broken the invariant that
-   // _pending_tx_session is the result of applying _pending_tx, as
-   // _pending_tx now consists of the set of postponed transactions.
-   // However, the push_block() call below will re-create the
-   // _pending_tx_session.
+   return prepared;
+}
 
+void database::fill_block_header( signed_block& pending_block, fc::time_point_sec when, const account_name_type& witness_owner )const
+{
    pending_block.previous = head_block_id();
    pending_block.timestamp = when;
-   pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
    pending_block.witness = witness_owner;
 
    const auto& witness = get_witness( witness_owner );
@@ -768,19 +1163,6 @@ signed_block database::_generate_block(
       // Make vote match binary configuration. This is vote to not apply the new hardfork.
       pending_block.extensions.insert( block_header_extensions( hardfork_version_vote( _hardfork_versions[ hfp.last_hardfork ], _hardfork_times[ hfp.last_hardfork ] ) ) );
    }
-
-   if( !(skip & skip_witness_signature) )
-      pending_block.sign( block_signing_private_key );
-
-   // TODO:  Move this to _push_block() so session is restored.
-   if( !(skip & skip_block_size_check) )
-   {
-      FC_ASSERT( fc::raw::pack_size(pending_block) <= WLS_MAX_BLOCK_SIZE );
-   }
-
-   push_block( pending_block, skip );
-
-   return pending_block;
 }
 
 /**
@@ -791,7 +1173,7 @@ void database::pop_block()
 {
    try
    {
-      _pending_tx_session.reset();
+      pop_pending_state();
       auto head_id = head_block_id();
 
       /// save the head block so we can recover its transactions
@@ -803,6 +1185,9 @@ void database::pop_block()
 
       _popped_tx.insert( _popped_tx.begin(), head_block->transactions.begin(), head_block->transactions.end() );
 
+      // undo does not notify object changes, so any pool transaction may be affected
+      _pending_tx.all_changed();
+
    }
    FC_CAPTURE_AND_RETHROW()
 }
@@ -811,11 +1196,42 @@ void database::clear_pending()
 {
    try
    {
-      assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
-      _pending_tx.clear();
-      _pending_tx_session.reset();
+      _pending_tx.clear();
+      _pending_tx_session.reset();
+   }
+   FC_CAPTURE_AND_RETHROW()
+}
+
+void database::pop_pending_state()
+{
+   _pending_tx_session.reset();
+   _pending_tx.state_popped();
+}
+
+void database::restore_pending_transactions()
+{
+   try
+   {
+      // Before the popped transactions enter the pending state and become known
+      _pending_tx.remove_stale( head_block_time(), [&]( const transaction_id_type& id ) { return is_known_transaction( id ); } );
+
+      for( const auto& tx : _popped_tx )
+      {
+         try
+         {
+            if( !is_known_transaction( tx.id() ) )
+               _push_transaction( tx );
+         }
+         catch( const fc::exception& ) {}
+      }
+      _popped_tx.clear();
+
+      _pending_tx.revalidate( [&]( const signed_transaction& tx ) { apply_pending_transaction( tx ); } );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Failed to restore pending transactions: ${e}", ("e", e.to_detail_string()) );
    }
-   FC_CAPTURE_AND_RETHROW()
 }
 
 void database::notify_pre_apply_operation( operation_notification& note )
@@ -825,12 +1241,12 @@ void database::notify_pre_apply_operation( operation_notification& note )
    note.trx_in_block = _current_trx_in_block;
    note.op_in_trx    = _current_op_in_trx;
 
-   WLS_TRY_NOTIFY( pre_apply_operation, note )
+   time_signal( [&]() { WLS_TRY_NOTIFY( pre_apply_operation, note ) } );
 }
 
 void database::notify_post_apply_operation( const operation_notification& note )
 {
-   WLS_TRY_NOTIFY( post_apply_operation, note )
+   time_signal( [&]() { WLS_TRY_NOTIFY( post_apply_operation, note ) } );
 }
 
 inline const void database::push_virtual_operation( const operation& op, bool force )
@@ -848,9 +1264,15 @@ inline const void database::push_virtual_operation( const operation& op, bool fo
    notify_post_apply_operation( note );
 }
 
-void database::notify_applied_block( const signed_block& block )
+void database::notify_pre_apply_block( const signed_block& block )
+{
+   time_signal( [&]() { WLS_TRY_NOTIFY( pre_apply_block, block ) } );
+}
+
+void database::notify_applied_block( const prepared_block_ptr& block )
 {
-   WLS_TRY_NOTIFY( applied_block, block )
+   time_signal( [&]() { WLS_TRY_NOTIFY( applied_block, block->block() ) } );
+   time_signal( [&]() { WLS_TRY_NOTIFY( applied_prepared_block, block ) } );
 }
 
 void database::notify_on_pending_transaction( const signed_transaction& tx )
@@ -860,17 +1282,12 @@ void database::notify_on_pending_transaction( const signed_transaction& tx )
 
 void database::notify_on_pre_apply_transaction( const signed_transaction& tx )
 {
-   WLS_TRY_NOTIFY( on_pre_apply_transaction, tx )
+   time_signal( [&]() { WLS_TRY_NOTIFY( on_pre_apply_transaction, tx ) } );
 }
 
 void database::notify_on_applied_transaction( const signed_transaction& tx )
 {
-   WLS_TRY_NOTIFY( on_applied_transaction, tx )
-}
-
-void database::notify_on_change( boost::any obj )
-{
-  WLS_TRY_NOTIFY( on_change, obj )
+   time_signal( [&]() { WLS_TRY_NOTIFY( on_applied_transaction, tx ) } );
 }
 
 account_name_type database::get_scheduled_witness( uint32_t slot_num )const
@@ -1407,6 +1824,17 @@ share_type database::cashout_comment_helper( util::comment_reward_context& ctx,
          }
       }
 
+      finish_comment_cashout( comment );
+
+      return claimed_reward;
+   } FC_CAPTURE_AND_RETHROW( (comment) )
+}
+
+/// Resets the rshares and cashout time of a comment once it has been paid out
+void database::finish_comment_cashout( const comment_object& comment )
+{
+   try
+   {
       modify( comment, [&]( comment_object& c )
       {
          /**
@@ -1446,8 +1874,147 @@ share_type database::cashout_comment_helper( util::comment_reward_context& ctx,
 #endif
          }
       }
+   } FC_CAPTURE_AND_RETHROW( (comment) )
+}
 
-      return claimed_reward;
+/**
+ * Everything cashout_comment_helper computes before it writes to the database. The split of
+ * the reward is only read from the comment, its votes and the reward fund snapshot taken at
+ * the start of process_comment_cashout, none of which the payout of another comment changes,
+ * so plans for all due comments can be computed at once.
+ */
+struct comment_payout_plan
+{
+   const comment_object*                                 comment = nullptr;
+   size_t                                                fund = 0;
+   bool                                                  rewarded = false;
+   share_type                                            claimed_reward = 0;
+   share_type                                            author_tokens = 0;       ///< after curators and beneficiaries
+   share_type                                            curation_tokens = 0;     ///< claimed by curators
+   share_type                                            total_beneficiary = 0;
+   vector< std::pair< account_id_type, share_type > >    curators;                ///< in by_comment_weight_voter order
+   vector< std::pair< account_name_type, share_type > >  beneficiaries;
+};
+
+comment_payout_plan database::plan_comment_payout( util::comment_reward_context ctx, const comment_object& comment )const
+{
+   try
+   {
+      comment_payout_plan plan;
+      plan.comment = &comment;
+      plan.fund = get_reward_fund( comment ).id._id;
+
+      if( comment.net_rshares <= 0 )
+         return plan;
+
+      fill_comment_reward_context_local_state( ctx, comment );
+
+      const auto& rf = get_reward_fund( comment );
+      ctx.reward_curve = rf.author_reward_curve;
+      ctx.content_constant = rf.content_constant;
+
+      const share_type reward = util::get_rshare_reward( ctx );
+      uint128_t reward_tokens = uint128_t( reward.value );
+
+      if( reward_tokens == 0 )
+         return plan;
+
+      plan.rewarded = true;
+      share_type curation_tokens = ( ( reward_tokens * get_curation_rewards_percent( comment ) ) / WLS_100_PERCENT ).to_uint64();
+      share_type author_tokens = reward_tokens.to_uint64() - curation_tokens;
+
+      // Same split as pay_curators
+      share_type unclaimed_rewards = curation_tokens;
+
+      if( !comment.allow_curation_rewards )
+      {
+         unclaimed_rewards = 0;
+         curation_tokens = 0;
+      }
+      else if( comment.total_vote_weight > 0 )
+      {
+         uint128_t total_weight( comment.total_vote_weight );
+         const auto& cvidx = get_index< comment_vote_index >().indices().get< by_comment_weight_voter >();
+         for( auto itr = cvidx.lower_bound( comment.id ); itr != cvidx.end() && itr->comment == comment.id; ++itr )
+         {
+            uint128_t weight( itr->weight );
+            auto claim = ( ( curation_tokens.value * weight ) / total_weight ).to_uint64();
+            if( claim > 0 )
+            {
+               unclaimed_rewards -= claim;
+               plan.curators.emplace_back( itr->voter, claim );
+            }
+         }
+      }
+
+      curation_tokens -= unclaimed_rewards;
+      author_tokens += unclaimed_rewards;
+      plan.claimed_reward = author_tokens + curation_tokens;
+
+      for( auto& b : comment.beneficiaries )
+      {
+         auto benefactor_tokens = ( author_tokens * b.weight ) / WLS_100_PERCENT;
+         plan.beneficiaries.emplace_back( b.account, benefactor_tokens );
+         plan.total_beneficiary += benefactor_tokens;
+      }
+
+      plan.author_tokens = author_tokens - plan.total_beneficiary;
+      plan.curation_tokens = curation_tokens;
+      return plan;
+   } FC_CAPTURE_AND_RETHROW( (comment) )
+}
+
+/// Makes the writes of cashout_comment_helper, in the same order, from a precomputed plan
+share_type database::apply_comment_payout( const comment_payout_plan& plan )
+{
+   const auto& comment = *plan.comment;
+
+   try
+   {
+      if( plan.rewarded )
+      {
+         for( const auto& c : plan.curators )
+         {
+            const auto& voter = get( c.first );
+            auto reward = create_vesting( voter, asset( c.second, WLS_SYMBOL ), true );
+            push_virtual_operation( curation_reward_operation( voter.name, reward, comment.author, to_string( comment.permlink ) ) );
+
+            #ifndef IS_LOW_MEM
+               modify( voter, [&]( account_object& a )
+               {
+                  a.curation_rewards += c.second;
+               });
+            #endif
+         }
+
+         for( const auto& b : plan.beneficiaries )
+         {
+            auto vest_created = create_vesting( get_account( b.first ), b.second, true );
+            push_virtual_operation( comment_benefactor_reward_operation( b.first, comment.author, to_string( comment.permlink ), vest_created ) );
+         }
+
+         const auto& author = get_account( comment.author );
+         auto vest_created = create_vesting( author, plan.author_tokens, true );
+         adjust_total_payout( comment, asset( plan.author_tokens, WLS_SYMBOL ), asset( plan.curation_tokens, WLS_SYMBOL ), asset( plan.total_beneficiary, WLS_SYMBOL ) );
+         push_virtual_operation( author_reward_operation( comment.author, to_string( comment.permlink ), asset( 0, WLS_SYMBOL ), vest_created ) );
+         push_virtual_operation( comment_reward_operation( comment.author, to_string( comment.permlink ), asset( plan.claimed_reward, WLS_SYMBOL ) ) );
+
+#ifndef IS_LOW_MEM
+         modify( comment, [&]( comment_object& c )
+         {
+            c.author_rewards += plan.author_tokens;
+         });
+
+         modify( get_account( comment.author ), [&]( account_object& a )
+         {
+            a.posting_rewards += plan.author_tokens;
+         });
+#endif
+      }
+
+      finish_comment_cashout( comment );
+
+      return plan.claimed_reward;
    } FC_CAPTURE_AND_RETHROW( (comment) )
 }
 
@@ -1497,6 +2064,7 @@ void database::process_comment_cashout()
 //   const auto& com_by_root = get_index< comment_index >().indices().get< by_root >();
 
    auto current = cidx.begin();
+   vector< const comment_object* > due;
    //  add all rshares about to be cashed out to the reward funds. This ensures equal satoshi per rshare payment
 
    while( current != cidx.end() && current->cashout_time <= head_block_time() )
@@ -1507,6 +2075,7 @@ void database::process_comment_cashout()
          funds[ rf.id._id ].recent_claims += util::evaluate_reward_curve( current->net_rshares.value, rf.author_reward_curve, rf.content_constant );
       }
 
+      due.push_back( &*current );
       ++current;
    }
 
@@ -1526,14 +2095,72 @@ void database::process_comment_cashout()
     * the global state updated each payout. After the hardfork, each payout is done
     * against a reward fund state that is snapshotted before all payouts in the block.
     */
-   while( current != cidx.end() && current->cashout_time <= head_block_time() )
+   if( _cashout_threads.empty() )
+   {
+      while( current != cidx.end() && current->cashout_time <= head_block_time() )
+      {
+         auto fund_id = get_reward_fund( *current ).id._id;
+         ctx.total_reward_shares2 = funds[ fund_id ].recent_claims;
+         ctx.total_reward_fund_steem = funds[ fund_id ].reward_balance;
+         funds[ fund_id ].steem_awarded += cashout_comment_helper( ctx, *current );
+
+         current = cidx.begin();
+      }
+   }
+   else
    {
-      auto fund_id = get_reward_fund( *current ).id._id;
-      ctx.total_reward_shares2 = funds[ fund_id ].recent_claims;
-      ctx.total_reward_fund_steem = funds[ fund_id ].reward_balance;
-      funds[ fund_id ].steem_awarded += cashout_comment_helper( ctx, *current );
+      /*
+       * Paying a comment out moves it to the end of by_cashout_time, so the loop above pays
+       * the due comments in the order they were collected in. Plans are computed on the
+       * worker threads while this thread waits, so nothing writes to the database meanwhile,
+       * and are then applied in that order.
+       */
+      vector< comment_payout_plan > plans( due.size() );
+      auto plan_range = [&]( size_t first, size_t last )
+      {
+         for( size_t i = first; i < last; ++i )
+         {
+            util::comment_reward_context comment_ctx;
+            const auto& fund = funds[ get_reward_fund( *due[i] ).id._id ];
+            comment_ctx.total_reward_shares2 = fund.recent_claims;
+            comment_ctx.total_reward_fund_steem = fund.reward_balance;
+            plans[i] = plan_comment_payout( comment_ctx, *due[i] );
+         }
+      };
+
+      // Below _min_parallel_payouts the cost of handing work to the threads outweighs the work itself
+      if( due.size() < _min_parallel_payouts )
+      {
+         plan_range( 0, due.size() );
+      }
+      else
+      {
+         vector< fc::future< void > > futures;
+         size_t slice = ( due.size() + _cashout_threads.size() - 1 ) / _cashout_threads.size();
+         for( size_t w = 0; w < _cashout_threads.size(); ++w )
+         {
+            size_t first = w * slice;
+            size_t last = std::min( first + slice, due.size() );
+            if( first >= last )
+               break;
+
+            futures.push_back( _cashout_threads[w]->async( [&,first,last]() { plan_range( first, last ); }, "plan comment payouts" ) );
+         }
+
+         // Every worker must be done with plans before an error unwinds it
+         std::exception_ptr error;
+         for( auto& f : futures )
+         {
+            try { f.wait(); }
+            catch( ... ) { if( !error ) error = std::current_exception(); }
+         }
+
+         if( error )
+            std::rethrow_exception( error );
+      }
 
-      current = cidx.begin();
+      for( const auto& plan : plans )
+         funds[ plan.fund ].steem_awarded += apply_comment_payout( plan );
    }
 
    // Write the cached fund state back to the database
@@ -2046,18 +2673,35 @@ void database::set_flush_interval( uint32_t flush_blocks )
    _next_flush_block = 0;
 }
 
+void database::set_cashout_threads( uint32_t cashout_threads, uint32_t min_parallel )
+{
+   _min_parallel_payouts = std::max( min_parallel, 1u );
+   _cashout_threads.clear();
+   _cashout_threads.reserve( cashout_threads );
+   for( uint32_t i = 0; i < cashout_threads; ++i )
+      _cashout_threads.push_back( std::make_shared< fc::thread >( "cashout_worker_" + fc::to_string( i ) ) );
+}
+
+void database::set_signature_threads( uint32_t signature_threads )
+{
+   _signature_threads.clear();
+   _signature_threads.reserve( signature_threads );
+   for( uint32_t i = 0; i < signature_threads; ++i )
+      _signature_threads.push_back( std::make_shared< fc::thread >( "signature_worker_" + fc::to_string( i ) ) );
+}
+
 //////////////////// private methods ////////////////////
 
-void database::apply_block( const signed_block& next_block, uint32_t skip )
+void database::apply_block( const prepared_block_ptr& next_block, uint32_t skip )
 { try {
    //fc::time_point begin_time = fc::time_point::now();
 
-   auto block_num = next_block.block_num();
+   auto block_num = next_block->block_num();
    if( _checkpoints.size() && _checkpoints.rbegin()->second != block_id_type() )
    {
       auto itr = _checkpoints.find( block_num );
       if( itr != _checkpoints.end() )
-         FC_ASSERT( next_block.id() == itr->second, "Block did not match checkpoint", ("checkpoint",*itr)("block_id",next_block.id()) );
+         FC_ASSERT( next_block->id() == itr->second, "Block did not match checkpoint", ("checkpoint",*itr)("block_id",next_block->id()) );
 
       if( _checkpoints.rbegin()->first >= block_num )
          skip = skip_witness_signature
@@ -2075,10 +2719,24 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
               ;
    }
 
-   detail::with_skip_flags( *this, skip, [&]()
+   if( !( skip & ( skip_transaction_signatures | skip_authority_check ) ) &&
+       !( _replay_block && _replay_block->signature_keys.size() ) )
+      recover_signature_keys( *next_block );
+
+   _applying_block = next_block.get();
+   try
    {
-      _apply_block( next_block );
-   } );
+      detail::with_skip_flags( *this, skip, [&]()
+      {
+         _apply_block( next_block );
+      } );
+   }
+   catch( ... )
+   {
+      _applying_block = nullptr;
+      throw;
+   }
+   _applying_block = nullptr;
 
    /*try
    {
@@ -2090,6 +2748,13 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
 
    //fc::time_point end_time = fc::time_point::now();
    //fc::microseconds dt = end_time - begin_time;
+   maybe_flush( block_num );
+   show_free_memory( false );
+
+} FC_CAPTURE_AND_RETHROW( (next_block->block()) ) }
+
+void database::maybe_flush( uint32_t block_num )
+{
    if( _flush_blocks != 0 )
    {
       if( _next_flush_block == 0 )
@@ -2116,10 +2781,70 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
          chainbase::database::flush();
       }
    }
+}
+
+void database::apply_block( const replay_block& next_block, uint32_t skip )
+{
+   _replay_block = &next_block;
+
+   try
+   {
+      apply_block( next_block.block, skip );
+   }
+   catch( ... )
+   {
+      _replay_block = nullptr;
+      throw;
+   }
 
-   show_free_memory( false );
+   _replay_block = nullptr;
+}
+
+/**
+ * Recovers the signature keys of every transaction in the block into the signature cache on
+ * the signature worker threads, so _apply_transaction only has to evaluate authorities.
+ * Transactions whose keys cannot be recovered are left to the serial path, which reports the
+ * error in context.
+ */
+void database::recover_signature_keys( const prepared_block& next_block )
+{ try {
+   const auto& trxs = next_block.block().transactions;
+   const auto& prepared = next_block.transactions();
+   if( _signature_threads.empty() || trxs.empty() )
+      return;
 
-} FC_CAPTURE_AND_RETHROW( (next_block) ) }
+   vector< fc::future< void > > futures;
+
+   size_t slice = ( trxs.size() + _signature_threads.size() - 1 ) / _signature_threads.size();
+   for( size_t w = 0; w < _signature_threads.size(); ++w )
+   {
+      size_t first = w * slice;
+      size_t last = std::min( first + slice, trxs.size() );
+      if( first >= last )
+         break;
+
+      futures.push_back( _signature_threads[w]->async( [&,first,last]()
+      {
+         for( size_t i = first; i < last; ++i )
+         {
+            try
+            {
+               _signature_cache.get_signature_keys_for_digest( trxs[i], prepared[i].sig_digest );
+            }
+            catch( const fc::exception& ) {}
+         }
+      }, "recover signature keys" ) );
+   }
+
+   for( auto& f : futures )
+      f.wait();
+} FC_CAPTURE_AND_RETHROW() }
+
+void database::on_authority_change()
+{
+   _signature_cache.invalidate_verified();
+   _authority_change_revision = std::max( _authority_change_revision, revision() );
+}
 
 void database::show_free_memory( bool force )
 {
@@ -2139,20 +2864,83 @@ void database::show_free_memory( bool force )
    }
 }
 
-void database::_apply_block( const signed_block& next_block )
+namespace detail {
+
+   /**
+    * Charges the time since the previous phase ended to a field of block_phase_stats, less the
+    * time spent in signal handlers meanwhile, which goes to plugin_signals. Does nothing when
+    * stats is null.
+    */
+   class block_phase_timer
+   {
+      public:
+         block_phase_timer( block_phase_stats* stats, const fc::microseconds& signal_time )
+            : _stats( stats ), _signal_time( signal_time )
+         {
+            if( _stats )
+            {
+               _start = _phase_start = fc::time_point::now();
+               _start_signals = _phase_signals = _signal_time;
+            }
+         }
+
+         void end_phase( fc::microseconds block_phase_stats::* phase )
+         {
+            if( !_stats )
+               return;
+
+            auto now = fc::time_point::now();
+            _stats->*phase += ( now - _phase_start ) - ( _signal_time - _phase_signals );
+            _phase_start = now;
+            _phase_signals = _signal_time;
+         }
+
+         void finish( uint64_t transactions )
+         {
+            if( !_stats )
+               return;
+
+            _stats->blocks++;
+            _stats->transactions += transactions;
+            _stats->total += fc::time_point::now() - _start;
+            _stats->plugin_signals += _signal_time - _start_signals;
+         }
+
+      private:
+         block_phase_stats*         _stats;
+         const fc::microseconds&    _signal_time;
+         fc::time_point             _start;
+         fc::time_point             _phase_start;
+         fc::microseconds           _start_signals;
+         fc::microseconds           _phase_signals;
+   };
+}
+
+void database::set_block_phase_timing( bool enabled )
+{
+   _signal_time = fc::microseconds();
+   if( enabled )
+      _block_phase_stats.reset( new block_phase_stats() );
+   else
+      _block_phase_stats.reset();
+}
+
+void database::_apply_block( const prepared_block_ptr& prepared )
 { try {
+   const signed_block& next_block = prepared->block();
+   detail::block_phase_timer timer( _block_phase_stats.get(), _signal_time );
+
    uint32_t next_block_num = next_block.block_num();
-   //block_id_type next_block_id = next_block.id();
 
    uint32_t skip = get_node_properties().skip_flags;
 
    if( !( skip & skip_merkle_check ) )
    {
-      auto merkle_root = next_block.calculate_merkle_root();
+      const auto& merkle_root = prepared->merkle_root();
 
       try
       {
-         FC_ASSERT( next_block.transaction_merkle_root == merkle_root, "Merkle check failed", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",merkle_root)("next_block",next_block)("id",next_block.id()) );
+         FC_ASSERT( next_block.transaction_merkle_root == merkle_root, "Merkle check failed", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",merkle_root)("next_block",next_block)("id",prepared->id()) );
       }
       catch( fc::assert_exception& e )
       {
@@ -2164,13 +2952,10 @@ void database::_apply_block( const signed_block& next_block )
       }
    }
 
-   const witness_object& signing_witness = validate_block_header(skip, next_block);
-
-   _current_block_num    = next_block_num;
-   _current_trx_in_block = 0;
+   const witness_object& signing_witness = begin_block( skip, next_block );
 
    const auto& gprops = get_dynamic_global_properties();
-   auto block_size = fc::raw::pack_size( next_block );
+   auto block_size = prepared->packed_size();
    FC_ASSERT( block_size <= gprops.maximum_block_size, "Block Size is too Big", ("next_block_num",next_block_num)("block_size", block_size)("max",gprops.maximum_block_size) );
 
    if( block_size < WLS_MIN_BLOCK_SIZE )
@@ -2179,10 +2964,38 @@ void database::_apply_block( const signed_block& next_block )
          ("next_block_num",next_block_num)("block_size", block_size)("min",WLS_MIN_BLOCK_SIZE)
       );
    }
+   timer.end_phase( &block_phase_stats::validate_header );
+
+   for( const auto& trx : next_block.transactions )
+   {
+      /* We do not need to push the undo state for each transaction
+       * because they either all apply and are valid or the
+       * entire block fails to apply.  We only need an "undo" state
+       * for transactions when validating broadcast transactions or
+       * when building a block.
+       */
+      apply_transaction( trx, skip );
+      ++_current_trx_in_block;
+   }
+   timer.end_phase( &block_phase_stats::apply_transactions );
+
+   finish_block( prepared, signing_witness, timer );
+} //FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
+FC_CAPTURE_LOG_AND_RETHROW( (prepared->block_num()) )
+}
+
+const witness_object& database::begin_block( uint32_t skip, const signed_block& next_block )
+{
+   const witness_object& signing_witness = validate_block_header(skip, next_block);
+
+   _current_block_num    = next_block.block_num();
+   _current_trx_in_block = 0;
+
+   notify_pre_apply_block( next_block );
 
    /// modify current witness so transaction evaluators can know who included the transaction,
    /// this is mostly for POW operations which must pay the current_witness
-   modify( gprops, [&]( dynamic_global_property_object& dgp ){
+   modify( get_dynamic_global_properties(), [&]( dynamic_global_property_object& dgp ){
       dgp.current_witness = next_block.witness;
    });
 
@@ -2197,41 +3010,45 @@ void database::_apply_block( const signed_block& next_block )
       ("witness",witness)("next_block.witness",next_block.witness)("hardfork_state", hardfork_state)
    );
 
+   return signing_witness;
+}
 
-   for( const auto& trx : next_block.transactions )
-   {
-      /* We do not need to push the undo state for each transaction
-       * because they either all apply and are valid or the
-       * entire block fails to apply.  We only need an "undo" state
-       * for transactions when validating broadcast transactions or
-       * when building a block.
-       */
-      apply_transaction( trx, skip );
-      ++_current_trx_in_block;
-   }
+void database::finish_block( const prepared_block_ptr& prepared, const witness_object& signing_witness, detail::block_phase_timer& timer )
+{
+   const signed_block& next_block = prepared->block();
+   const block_id_type& next_block_id = prepared->id();
 
-   update_global_dynamic_data(next_block);
+   update_global_dynamic_data( next_block, next_block_id );
    update_signing_witness(signing_witness, next_block);
 
    update_last_irreversible_block();
 
-   create_block_summary(next_block);
+   create_block_summary( next_block, next_block_id );
    clear_expired_transactions();
+   timer.end_phase( &block_phase_stats::update_global_properties );
+
    update_witness_schedule(*this);
+   timer.end_phase( &block_phase_stats::update_witness_schedule );
 
    clear_null_account_balance();
    process_funds();
+   timer.end_phase( &block_phase_stats::process_funds );
+
    process_comment_cashout();
+   timer.end_phase( &block_phase_stats::process_comment_cashout );
+
    process_vesting_withdrawals();
+   timer.end_phase( &block_phase_stats::process_vesting_withdrawals );
 
    process_hardforks();
+   timer.end_phase( &block_phase_stats::process_hardforks );
 
    // notify observers that the block has been applied
-   notify_applied_block( next_block );
+   notify_applied_block( prepared );
 
-   notify_changed_objects();
-} //FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
-FC_CAPTURE_LOG_AND_RETHROW( (next_block.block_num()) )
+   time_signal( [&]() { notify_changed_objects(); } );
+
+   timer.finish( next_block.transactions.size() );
 }
 
 void database::process_header_extensions( const signed_block& next_block )
@@ -2291,7 +3108,12 @@ void database::apply_transaction(const signed_transaction& trx, uint32_t skip)
 
 void database::_apply_transaction(const signed_transaction& trx)
 { try {
-   _current_trx_id = trx.id();
+   // Transactions of a block being applied were hashed when the block was prepared
+   const prepared_transaction* prepared = nullptr;
+   if( _applying_block && _current_trx_in_block < _applying_block->transactions().size() )
+      prepared = &_applying_block->transactions()[ _current_trx_in_block ];
+
+   _current_trx_id = prepared ? prepared->id : trx.id();
    uint32_t skip = get_node_properties().skip_flags;
 
    if( !(skip&skip_validate) )   /* issue #505 explains why this skip_flag is disabled */
@@ -2299,7 +3121,7 @@ void database::_apply_transaction(const signed_transaction& trx)
 
    auto& trx_idx = get_index<transaction_index>();
    const chain_id_type& chain_id = WLS_CHAIN_ID;
-   auto trx_id = trx.id();
+   auto trx_id = _current_trx_id;
    // idump((trx_id)(skip&skip_transaction_dupe_check));
    FC_ASSERT( (skip & skip_transaction_dupe_check) ||
               trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end(),
@@ -2311,9 +3133,26 @@ void database::_apply_transaction(const signed_transaction& trx)
       auto get_owner   = [&]( const string& name ) { return authority( get< account_authority_object, by_account >( name ).owner );  };
       auto get_posting = [&]( const string& name ) { return authority( get< account_authority_object, by_account >( name ).posting );  };
 
+      bool use_verified = _authority_change_revision <= int64_t( last_non_undoable_block_num() );
+      digest_type trx_digest;
+      if( use_verified )
+         trx_digest = prepared ? prepared->merkle_digest : trx.merkle_digest();
+
       try
       {
-         trx.verify_authority( chain_id, get_active, get_owner, get_posting, WLS_MAX_SIG_CHECK_DEPTH );
+         if( !use_verified || !_signature_cache.is_verified( trx_digest ) )
+         {
+            // import_block_log recovers the keys of the whole block on the replay workers
+            bool have_replay_keys = _replay_block && _current_trx_in_block < _replay_block->signature_keys.size() &&
+                                    _replay_block->signature_keys[ _current_trx_in_block ].valid();
+            wls::protocol::verify_authority( trx.operations,
+               have_replay_keys ? *_replay_block->signature_keys[ _current_trx_in_block ] :
+               prepared ? _signature_cache.get_signature_keys_for_digest( trx, prepared->sig_digest ) : _signature_cache.get_signature_keys( trx, chain_id ),
+               get_active, get_owner, get_posting, WLS_MAX_SIG_CHECK_DEPTH );
+
+            if( use_verified )
+               _signature_cache.set_verified( trx_digest );
+         }
       }
       catch( protocol::tx_missing_active_auth& e )
       {
@@ -2349,8 +3188,11 @@ void database::_apply_transaction(const signed_transaction& trx)
       create<transaction_object>([&](transaction_object& transaction) {
          transaction.trx_id = trx_id;
          transaction.expiration = trx.expiration;
-         fc::raw::pack( transaction.packed_trx, trx );
       });
+
+      // Pending transactions may never be included, and would evict the bodies of those that were
+      if( !has_pending_state() )
+         _recent_transaction_cache.add( trx_id, trx );
    }
 
    notify_on_pre_apply_transaction( trx );
@@ -2382,7 +3224,12 @@ const witness_object& database::validate_block_header( uint32_t skip, const sign
    const witness_object& witness = get_witness( next_block.witness );
 
    if( !(skip&skip_witness_signature) )
-      FC_ASSERT( next_block.validate_signee( witness.signing_key ) );
+   {
+      if( _replay_block && _replay_block->signee.valid() )
+         FC_ASSERT( *_replay_block->signee == witness.signing_key );
+      else
+         FC_ASSERT( next_block.validate_signee( witness.signing_key ) );
+   }
 
    if( !(skip&skip_witness_schedule_check) )
    {
@@ -2398,15 +3245,15 @@ const witness_object& database::validate_block_header( uint32_t skip, const sign
    return witness;
 } FC_CAPTURE_AND_RETHROW() }
 
-void database::create_block_summary(const signed_block& next_block)
+void database::create_block_summary( const signed_block& next_block, const block_id_type& next_block_id )
 { try {
    block_summary_id_type sid( next_block.block_num() & 0xffff );
    modify( get< block_summary_object >( sid ), [&](block_summary_object& p) {
-         p.block_id = next_block.id();
+         p.block_id = next_block_id;
    });
 } FC_CAPTURE_AND_RETHROW() }
 
-void database::update_global_dynamic_data( const signed_block& b )
+void database::update_global_dynamic_data( const signed_block& b, const block_id_type& b_id )
 { try {
    const dynamic_global_property_object& _dgp =
       get_dynamic_global_properties();
@@ -2447,7 +3294,7 @@ void database::update_global_dynamic_data( const signed_block& b )
       }
 
       dgp.head_block_number = b.block_num();
-      dgp.head_block_id = b.id();
+      dgp.head_block_id = b_id;
       dgp.time = b.timestamp;
       dgp.current_aslot += missed_blocks+1;
    } );
@@ -2542,7 +3389,7 @@ void database::update_last_irreversible_block()
          {
             shared_ptr< fork_item > block = _fork_db.fetch_block_on_main_branch_by_number( log_head_num+1 );
             FC_ASSERT( block, "Current fork in the fork database does not contain the last_irreversible_block" );
-            _block_log.append( block->data );
+            _block_log.append( *block->prepared );
             log_head_num++;
          }
 
@@ -2561,8 +3408,46 @@ void database::clear_expired_transactions()
    const auto& dedupe_index = transaction_idx.indices().get< by_expiration >();
    while( ( !dedupe_index.empty() ) && ( head_block_time() > dedupe_index.begin()->expiration ) )
       remove( *dedupe_index.begin() );
+
+   _recent_transaction_cache.remove_expired( head_block_time() );
 }
 
+/**
+ * Refills the recent transaction cache from the blocks that can still hold unexpired
+ * transactions. Blocks older than WLS_MAX_TIME_UNTIL_EXPIRATION before the head block can not.
+ */
+void database::load_recent_transactions()
+{ try {
+   _recent_transaction_cache.clear();
+   if( _recent_transaction_cache.get_max_size() == 0 )
+      return;
+
+   auto now = head_block_time();
+   uint32_t loaded = 0;
+
+   for( uint32_t num = head_block_num(); num > 0; --num )
+   {
+      auto block = _block_log.read_block_by_num( num );
+      if( !block.valid() || block->timestamp + WLS_MAX_TIME_UNTIL_EXPIRATION < now )
+         break;
+
+      for( const auto& trx : block->transactions )
+      {
+         if( trx.expiration < now )
+            continue;
+
+         auto trx_id = trx.id();
+         if( is_known_transaction( trx_id ) )
+         {
+            _recent_transaction_cache.add( trx_id, trx );
+            ++loaded;
+         }
+      }
+   }
+
+   ilog( "Loaded ${n} recent transactions from the block log", ("n", loaded) );
+} FC_CAPTURE_AND_RETHROW() }
+
 void database::adjust_balance( const account_object& a, const asset& delta )
 {
    modify( a, [&]( account_object& acnt )
@@ -23,7 +23,7 @@ void fork_database::pop_block()
 
 void     fork_database::start_block(signed_block b)
 {
-   auto item = std::make_shared<fork_item>(std::move(b));
+   auto item = std::make_shared<fork_item>(prepared_block::create(std::move(b)));
    _index.insert(item);
    _head = item;
 }
@@ -32,7 +32,7 @@ void     fork_database::start_block(signed_block b)
  * Pushes the block into the fork database and caches it if it doesn't link
  *
  */
-shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
+shared_ptr<fork_item>  fork_database::push_block(const prepared_block_ptr& b)
 {
    auto item = std::make_shared<fork_item>(b);
    try {
@@ -40,8 +40,8 @@ shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
    }
    catch ( const unlinkable_block_exception& e )
    {
-      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",b.id())("num",b.block_num()) );
-      wlog( "Head: ${num}, ${id}", ("num",_head->data.block_num())("id",_head->data.id()) );
+      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",b->id())("num",b->block_num()) );
+      wlog( "Head: ${num}, ${id}", ("num",_head->num)("id",_head->id) );
       throw;
       _unlinked_index.insert( item );
    }
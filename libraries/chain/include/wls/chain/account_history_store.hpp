@@ -0,0 +1,97 @@
+#pragma once
+#include <wls/protocol/types.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/optional.hpp>
+#include <fc/time.hpp>
+
+namespace wls { namespace chain {
+
+   using namespace wls::protocol;
+
+   namespace detail { class account_history_store_impl; }
+
+   /// One operation as recorded by the account history store
+   struct history_operation
+   {
+      transaction_id_type  trx_id;
+      uint32_t             block = 0;
+      uint32_t             trx_in_block = 0;
+      uint16_t             op_in_trx = 0;
+      uint64_t             virtual_op = 0;
+      fc::time_point_sec   timestamp;
+      vector< char >       serialized_op;
+   };
+
+   /// The operations of one block and the accounts whose history each of them belongs to
+   struct history_block
+   {
+      uint32_t                                           block_num = 0;
+      vector< history_operation >                        operations;
+      vector< std::pair< account_name_type, uint32_t > > account_ops;   ///< account and index into operations, in apply order
+   };
+
+   /**
+    * Account history kept in append-only files next to the block log rather than in shared memory.
+    *
+    * The store is made of fixed width tables that are only ever appended to and are read through
+    * read only memory mappings:
+    *
+    *   ops.data        packed operations
+    *   ops.index       one record per operation with its location and the range of its bytes in ops.data
+    *   accounts.index  one record per (account, sequence), linking back to the account's previous record
+    *   trx.index       one record per transaction, chained into hash buckets by transaction id
+    *   blocks.index    one record per block with the size of every table after the block, written last
+    *
+    * A block is committed once its record is in blocks.index, so after a crash the other tables are
+    * truncated back to the sizes in the last block record. Blocks that may still be undone are kept
+    * in memory until commit() is called with a block number at or past them.
+    *
+    * Every account record also points at the record with sequence `sequence - lowbit(sequence)`, so a
+    * sequence number is found in O(log^2 n) steps without an index over all of them.
+    *
+    * Readers take a shared lock on the store only; they never touch the chainbase database.
+    */
+   class account_history_store
+   {
+      public:
+         account_history_store();
+         ~account_history_store();
+
+         void open( const fc::path& dir );
+         void close();
+
+         /**
+          * Adds a block on top of the reversible blocks. Any reversible block at or above its
+          * number is dropped first. A block at or below the last committed block truncates the
+          * store back to before it, as happens when the chain is reindexed.
+          */
+         void push_block( history_block&& block );
+
+         /// Writes every reversible block at or below block_num to disk
+         void commit( uint32_t block_num );
+
+         uint32_t head_block_num()const;
+         uint32_t committed_block_num()const;
+         /// The first block recorded, 0 when the store is empty
+         uint32_t first_block_num()const;
+
+         vector< history_operation > get_ops_in_block( uint32_t block_num )const;
+
+         /**
+          * Returns the entries for account with the highest sequence at or below from and the
+          * limit entries before it, keyed by sequence.
+          */
+         std::map< uint32_t, history_operation > get_account_history( const account_name_type& account, uint64_t from, uint32_t limit )const;
+
+         /// Returns the first operation of the transaction, which carries its block and position
+         fc::optional< history_operation > find_transaction( const transaction_id_type& id )const;
+
+      private:
+         std::unique_ptr< detail::account_history_store_impl > my;
+   };
+
+} }
+
+FC_REFLECT( wls::chain::history_operation, (trx_id)(block)(trx_in_block)(op_in_trx)(virtual_op)(timestamp)(serialized_op) )
+FC_REFLECT( wls::chain::history_block, (block_num)(operations)(account_ops) )
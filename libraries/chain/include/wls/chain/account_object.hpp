@@ -9,6 +9,7 @@
 #include <wls/chain/shared_authority.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 
 #include <numeric>
 
@@ -115,6 +116,7 @@ namespace wls { namespace chain {
 
 
    struct by_name;
+   struct by_name_hash;
    struct by_proxy;
    struct by_last_post;
    struct by_next_vesting_withdrawal;
@@ -134,6 +136,8 @@ namespace wls { namespace chain {
             member< account_object, account_id_type, &account_object::id > >,
          ordered_unique< tag< by_name >,
             member< account_object, account_name_type, &account_object::name > >,
+         hashed_unique< tag< by_name_hash >, /// point lookups, by_name is kept for range scans
+            member< account_object, account_name_type, &account_object::name > >,
          ordered_unique< tag< by_proxy >,
             composite_key< account_object,
                member< account_object, account_name_type, &account_object::proxy >,
@@ -202,13 +206,8 @@ namespace wls { namespace chain {
       indexed_by <
          ordered_unique< tag< by_id >,
             member< account_authority_object, account_authority_id_type, &account_authority_object::id > >,
-         ordered_unique< tag< by_account >,
-            composite_key< account_authority_object,
-               member< account_authority_object, account_name_type, &account_authority_object::account >,
-               member< account_authority_object, account_authority_id_type, &account_authority_object::id >
-            >,
-            composite_key_compare< std::less< account_name_type >, std::less< account_authority_id_type > >
-         >,
+         hashed_unique< tag< by_account >,
+            member< account_authority_object, account_name_type, &account_authority_object::account > >,
          ordered_unique< tag< by_last_owner_update >,
             composite_key< account_authority_object,
                member< account_authority_object, time_point_sec, &account_authority_object::last_owner_update >,
@@ -238,6 +237,7 @@ FC_REFLECT( wls::chain::account_object,
              (asb_for_sale)(asb_to)(asb_price)
           )
 CHAINBASE_SET_INDEX_TYPE( wls::chain::account_object, wls::chain::account_index )
+CHAINBASE_SET_UNDO_JOURNAL_CODEC( wls::chain::account_object, wls::chain::raw_undo_journal_codec< wls::chain::account_object > )
 
 FC_REFLECT( wls::chain::account_authority_object,
              (id)(account)(owner)(active)(posting)(last_owner_update)
@@ -8,6 +8,35 @@ namespace wls { namespace chain {
 
    namespace detail { class block_log_impl; }
 
+   class prepared_block;
+
+   /**
+    * The packed bytes of a single block. When the block comes from the block log the bytes
+    * point directly into the memory mapping, which is kept alive for as long as any
+    * packed_block referencing it exists.
+    */
+   class packed_block
+   {
+      public:
+         packed_block() {}
+         packed_block( std::shared_ptr< const void > owner, const char* data, size_t size )
+            : _owner( std::move( owner ) ), _data( data ), _size( size ) {}
+         explicit packed_block( const signed_block& b );
+
+         const char* data()const { return _data; }
+         size_t      size()const { return _size; }
+         bool        valid()const { return _data != nullptr; }
+
+         /// Deserializes only the header, which is a prefix of the packed block
+         signed_block_header unpack_header()const;
+         signed_block        unpack()const;
+
+      private:
+         std::shared_ptr< const void > _owner;
+         const char*                   _data = nullptr;
+         size_t                        _size = 0;
+   };
+
    /* The block log is an external append only log of the blocks. Blocks should only be written
     * to the log after they irreverisble as the log is append only. The log is a doubly linked
     * list of blocks. There is a secondary index file of only block positions that enables O(1)
@@ -31,6 +60,10 @@ namespace wls { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * Reads go through a read only memory mapping of both files, so they do not disturb the write
+    * streams and may be issued from several threads at once. The mapping is extended when a read
+    * asks for a block appended after it was created.
     */
 
    class block_log {
@@ -43,10 +76,18 @@ namespace wls { namespace chain {
          bool is_open()const;
 
          uint64_t append( const signed_block& b );
+         /// Writes the bytes the block was prepared from instead of packing it again
+         uint64_t append( const prepared_block& b );
          void flush();
          std::pair< signed_block, uint64_t > read_block( uint64_t file_pos )const;
          optional< signed_block > read_block_by_num( uint32_t block_num )const;
 
+         /**
+          * Return the packed bytes of a block without deserializing it. The result is invalid
+          * if the block is not in the log.
+          */
+         packed_block read_packed_block_by_num( uint32_t block_num )const;
+
          /**
           * Return offset of block in file, or block_log::npos if it does not exist.
           */
@@ -58,6 +99,7 @@ namespace wls { namespace chain {
 
       private:
          void construct_index();
+         uint64_t append( const signed_block& b, const block_id_type& id, const char* data, size_t size );
 
          std::unique_ptr<detail::block_log_impl> my;
    };
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+namespace wls { namespace chain {
+
+   /**
+    * Time spent in each phase of database::_apply_block, summed over the blocks applied since
+    * timing was enabled. Plugin signal handlers run inside several phases; their time is moved
+    * out of the phase that fired them and into plugin_signals, so the phases add up to total.
+    */
+   struct block_phase_stats
+   {
+      uint64_t          blocks = 0;
+      uint64_t          transactions = 0;
+
+      fc::microseconds  total;
+      fc::microseconds  validate_header;               ///< merkle root, header, size and header extensions
+      fc::microseconds  apply_transactions;
+      fc::microseconds  update_global_properties;      ///< dynamic global properties, signing witness, irreversibility, block summary, expired transactions
+      fc::microseconds  update_witness_schedule;
+      fc::microseconds  process_funds;
+      fc::microseconds  process_comment_cashout;
+      fc::microseconds  process_vesting_withdrawals;
+      fc::microseconds  process_hardforks;
+      fc::microseconds  plugin_signals;                ///< block, transaction and operation signals
+   };
+
+} }
+
+FC_REFLECT( wls::chain::block_phase_stats,
+            (blocks)(transactions)(total)(validate_header)(apply_transactions)(update_global_properties)
+            (update_witness_schedule)(process_funds)(process_comment_cashout)(process_vesting_withdrawals)
+            (process_hardforks)(plugin_signals) )
@@ -7,6 +7,7 @@
 #include <wls/chain/witness_objects.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 
 
 namespace wls { namespace chain {
@@ -168,6 +169,7 @@ namespace wls { namespace chain {
 
    struct by_cashout_time; /// cashout_time
    struct by_permlink; /// author, perm
+   struct by_permlink_hash; /// author, perm
    struct by_root;
    struct by_parent;
    struct by_active; /// parent_auth, active
@@ -202,6 +204,14 @@ namespace wls { namespace chain {
             >,
             composite_key_compare< std::less< account_name_type >, strcmp_less >
          >,
+         hashed_unique< tag< by_permlink_hash >, /// point lookups, by_permlink is kept for range scans
+            composite_key< comment_object,
+               member< comment_object, account_name_type, &comment_object::author >,
+               member< comment_object, shared_string, &comment_object::permlink >
+            >,
+            composite_key_hash< boost::hash< account_name_type >, chainbase::strcmp_hash >,
+            composite_key_equal_to< std::equal_to< account_name_type >, chainbase::strcmp_equal_to >
+         >,
          ordered_unique< tag< by_root >,
             composite_key< comment_object,
                member< comment_object, comment_id_type, &comment_object::root_comment >,
@@ -254,6 +264,7 @@ FC_REFLECT( wls::chain::comment_object,
              (beneficiaries)
           )
 CHAINBASE_SET_INDEX_TYPE( wls::chain::comment_object, wls::chain::comment_index )
+CHAINBASE_SET_UNDO_JOURNAL_CODEC( wls::chain::comment_object, wls::chain::raw_undo_journal_codec< wls::chain::comment_object > )
 
 FC_REFLECT( wls::chain::comment_vote_object,
              (id)(voter)(comment)(weight)(rshares)(vote_percent)(last_update)(num_changes)
@@ -7,18 +7,26 @@
 #include <wls/chain/node_property_object.hpp>
 #include <wls/chain/fork_database.hpp>
 #include <wls/chain/block_log.hpp>
+#include <wls/chain/prepared_block.hpp>
+#include <wls/chain/block_phase_stats.hpp>
+#include <wls/chain/replay_pipeline.hpp>
+#include <wls/chain/recent_transaction_cache.hpp>
+#include <wls/chain/signature_cache.hpp>
+#include <wls/chain/transaction_pool.hpp>
+#include <wls/chain/state_snapshot.hpp>
 #include <wls/chain/operation_notification.hpp>
+#include <wls/chain/object_change_notification.hpp>
+#include <wls/chain/database_exceptions.hpp>
 
 #include <wls/protocol/protocol.hpp>
 
 //#include <graphene/db2/database.hpp>
 #include <fc/signals.hpp>
 #include <fc/log/logger.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <map>
 
-#include <boost/any.hpp>
-
 namespace wls { namespace chain {
 
    using wls::protocol::signed_transaction;
@@ -30,6 +38,8 @@ namespace wls { namespace chain {
 
    class database_impl;
    class custom_operation_interpreter;
+   namespace detail { class block_phase_timer; }
+   struct comment_payout_plan;
 
    namespace util {
       struct comment_reward_context;
@@ -88,6 +98,19 @@ namespace wls { namespace chain {
           */
          void reindex( const fc::path& data_dir, const fc::path& shared_mem_dir, uint64_t shared_file_size = (1024l*1024l*1024l*8l) );
 
+         /**
+          * @brief Rebuild the database and block log from a block log copied from another node
+          *
+          * Unlike @ref reindex, which trusts its own block log, every block is fully validated. Block
+          * ids, merkle roots and the witness and transaction signature keys are computed on the replay
+          * worker threads ahead of the apply stage. Blocks are appended to our block log as they are
+          * applied. The database is open when this function returns.
+          *
+          * If a block fails validation the import stops with its error. Only the blocks before it are
+          * in our block log, and the state should be rebuilt from them with @ref reindex.
+          */
+         void import_block_log( const fc::path& data_dir, const fc::path& shared_mem_dir, uint64_t shared_file_size, const fc::path& source_block_log );
+
          /**
           * @brief wipe Delete database from disk, and potentially the raw chain as well.
           * @param include_blocks If true, delete the raw chain as well as the database.
@@ -97,6 +120,25 @@ namespace wls { namespace chain {
          void wipe(const fc::path& data_dir, const fc::path& shared_mem_dir, bool include_blocks);
          void close(bool rewind = true);
 
+         /**
+          * @brief Rebuild the database from a state snapshot instead of replaying the block log
+          *
+          * The block log must already hold the snapshot's head block. Blocks after it are left to be
+          * synced. The database is open when this function returns.
+          *
+          * When expected_digest is given, the snapshot's state digest must match it before anything
+          * is wiped. Without it, the snapshot is only checked for damage, see state_snapshot.hpp.
+          */
+         void import_snapshot( const fc::path& data_dir, const fc::path& shared_mem_dir, uint64_t shared_file_size, const fc::path& snapshot_file,
+            const optional< fc::sha256 >& expected_digest = optional< fc::sha256 >() );
+
+         /// Write the state at the head block to a snapshot file, see state_snapshot.hpp
+         void export_snapshot( const fc::path& snapshot_file );
+
+         /// Called by add_core_index and add_plugin_index for every index
+         void add_snapshot_index( std::shared_ptr< detail::abstract_snapshot_index > idx );
+         const std::map< std::string, std::shared_ptr< detail::abstract_snapshot_index > >& get_snapshot_indices()const { return _snapshot_indices; }
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -109,6 +151,15 @@ namespace wls { namespace chain {
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+
+         /**
+          * Packed form of a block. Irreversible blocks are served straight from the block log
+          * mapping without deserializing; reversible blocks are packed from the fork database.
+          * The result is invalid if the block is unknown.
+          */
+         packed_block               fetch_packed_block_by_id( const block_id_type& id )const;
+         packed_block               fetch_packed_block_by_number( uint32_t num )const;
+         /// Body of a known transaction that has not expired, from the recent transaction cache
          const signed_transaction   get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -153,9 +204,10 @@ namespace wls { namespace chain {
          bool                                   before_last_checkpoint()const;
 
          bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
+         bool push_block( const prepared_block_ptr& b, uint32_t skip = skip_nothing );
          void push_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          void _maybe_warn_multiple_production( uint32_t height )const;
-         bool _push_block( const signed_block& b );
+         bool _push_block( const prepared_block_ptr& b );
          void _push_transaction( const signed_transaction& trx );
 
          signed_block generate_block(
@@ -169,10 +221,28 @@ namespace wls { namespace chain {
             const account_name_type& witness_owner,
             const fc::ecc::private_key& block_signing_private_key
             );
+         /**
+          * Builds the block inside its own undo session, applying each pending transaction once
+          * in the context of the block, then finishes and commits that session as the applied
+          * block. A pending transaction that fails is undone in its own session and left out, so
+          * observers see the block applied once, as when it is rebuilt.
+          */
+         prepared_block_ptr _generate_block_in_place(
+            const fc::time_point_sec when,
+            const account_name_type& witness_owner,
+            const fc::ecc::private_key& block_signing_private_key
+            );
 
          void pop_block();
          void clear_pending();
 
+         /// Pops the state of the pending transactions, keeping them in the pool
+         void pop_pending_state();
+         /// True while the state of pending transactions is applied, which no block has included
+         bool has_pending_state()const { return _pending_tx_session.valid(); }
+         /// Pushes the transactions of popped blocks and applies again the pool transactions the new blocks may have invalidated
+         void restore_pending_transactions();
+
          /**
           *  This method is used to track applied operations during the evaluation of a block, these
           *  operations should include any operation actually included in a transaction as well
@@ -182,12 +252,21 @@ namespace wls { namespace chain {
          void notify_pre_apply_operation( operation_notification& note );
          void notify_post_apply_operation( const operation_notification& note );
          inline const void push_virtual_operation( const operation& op, bool force = false ); // vops are not needed for low mem. Force will push them on low mem.
-         void notify_applied_block( const signed_block& block );
+         void notify_pre_apply_block( const signed_block& block );
+         void notify_applied_block( const prepared_block_ptr& block );
          void notify_on_pending_transaction( const signed_transaction& tx );
          void notify_on_pre_apply_transaction( const signed_transaction& tx );
          void notify_on_applied_transaction( const signed_transaction& tx );
 
-         void notify_on_change( boost::any obj );
+         template< typename ObjectType >
+         void notify_on_change( const ObjectType& obj, object_change_kind kind )
+         {
+            auto* sig = find_object_change_signal< ObjectType >();
+            if( sig == nullptr )
+               return;
+
+            WLS_TRY_NOTIFY( sig->signal, object_change_notification< ObjectType >( obj, kind ) )
+         }
 
          /**
           *  This signal is emitted for plugins to process every operation after it has been fully applied.
@@ -195,6 +274,13 @@ namespace wls { namespace chain {
          fc::signal<void(const operation_notification&)> pre_apply_operation;
          fc::signal<void(const operation_notification&)> post_apply_operation;
 
+         /**
+          *  This signal is emitted once a block's header has been validated, before any of its
+          *  transactions or virtual operations are applied. Operations notified between this
+          *  signal and applied_block belong to the block.
+          */
+         fc::signal<void(const signed_block&)>           pre_apply_block;
+
          /**
           *  This signal is emitted after all operations and virtual operation for a
           *  block have been applied but before the get_applied_operations() are cleared.
@@ -205,6 +291,13 @@ namespace wls { namespace chain {
           */
          fc::signal<void(const signed_block&)>           applied_block;
 
+         /**
+          *  Emitted right after applied_block with the same block, together with its packed
+          *  bytes, id and transaction ids. Handlers may keep the pointer to use after the
+          *  write lock is released.
+          */
+         fc::signal<void(const prepared_block_ptr&)>     applied_prepared_block;
+
          /**
           * This signal is emitted any time a new transaction is added to the pending
           * block state.
@@ -235,9 +328,24 @@ namespace wls { namespace chain {
          //fc::signal<void(const vector<const object*>&)>  removed_objects;
 
          /**
-          * on CUD (Create, Update, Delete)
+          * Subscribes to creation and modification of objects of one type. Nothing is done on
+          * the write path for types nobody has subscribed to. The database itself always
+          * subscribes to account_object and account_authority_object, for the signature cache
+          * and the transaction pool, so every change to those two types is notified.
           */
-         fc::signal<void(boost::any)>     on_change;
+         template< typename ObjectType >
+         boost::signals2::connection on_object_change( const std::function< void( const object_change_notification< ObjectType >& ) >& handler )
+         {
+            const uint16_t type_id = ObjectType::type_id;
+            if( type_id >= _object_change_signals.size() )
+               _object_change_signals.resize( type_id + 1 );
+
+            auto& sig = _object_change_signals[ type_id ];
+            if( !sig )
+               sig.reset( new detail::object_change_signal< ObjectType >() );
+
+            return static_cast< detail::object_change_signal< ObjectType >* >( sig.get() )->signal.connect( handler );
+         }
 
 
          //////////////////// db_witness_schedule.cpp ////////////////////
@@ -312,6 +420,9 @@ namespace wls { namespace chain {
          void process_vesting_withdrawals();
          share_type pay_curators( const comment_object& c, share_type& max_rewards );
          share_type cashout_comment_helper( util::comment_reward_context& ctx, const comment_object& comment );
+         comment_payout_plan plan_comment_payout( util::comment_reward_context ctx, const comment_object& comment )const;
+         share_type apply_comment_payout( const comment_payout_plan& plan );
+         void finish_comment_cashout( const comment_object& comment );
          void process_comment_cashout();
          void process_funds();
 
@@ -348,7 +459,7 @@ namespace wls { namespace chain {
          /** when popping a block, the transactions that were removed get cached here so they
           * can be reapplied at the proper time */
          std::deque< signed_transaction >       _popped_tx;
-         vector< signed_transaction >           _pending_tx;
+         transaction_pool                       _pending_tx;
 
          void retally_comment_children();
          void retally_witness_votes();
@@ -369,6 +480,15 @@ namespace wls { namespace chain {
          const std::string& get_json_schema() const;
 
          void set_flush_interval( uint32_t flush_blocks );
+
+         /**
+          * Produce blocks by applying pending transactions once, straight into the block, instead of
+          * rebuilding the pending state and then applying the finished block again.
+          */
+         void set_single_apply_production( bool enable ) {
+            _single_apply_production = enable;
+         }
+         bool get_single_apply_production()const { return _single_apply_production; }
          void show_free_memory( bool force );
 
          void set_max_undo( uint32_t max_undo ) {
@@ -376,20 +496,66 @@ namespace wls { namespace chain {
          }
          uint32_t get_max_undo()const { return _max_undo; }
 
+         /**
+          * Keep the undo state of objects with an undo journal codec, such as comments and accounts, as
+          * packed before-images instead of copies in undo maps. Takes effect when the database is opened.
+          */
+         void set_undo_journal( bool enable ) {
+            _undo_journal = enable;
+         }
+         bool get_undo_journal()const { return _undo_journal; }
+
+         /// Number of worker threads used to deserialize and hash blocks during reindex, and to rebuild indices from a snapshot
+         void set_replay_threads( uint32_t replay_threads ) {
+            _replay_threads = replay_threads;
+         }
+         uint32_t get_replay_threads()const { return _replay_threads; }
+
+         /**
+          * Number of worker threads recovering transaction signature keys ahead of block
+          * application. Zero recovers keys serially while each transaction is applied.
+          */
+         void set_signature_threads( uint32_t signature_threads );
+         uint32_t get_signature_threads()const { return _signature_threads.size(); }
+
+         /**
+          * Number of worker threads computing the payouts of comments due in a block before
+          * any of them is applied. Zero pays each comment out in turn with cashout_comment_helper.
+          * Blocks with fewer than min_parallel due comments compute them on the calling thread.
+          */
+         void set_cashout_threads( uint32_t cashout_threads, uint32_t min_parallel = 16 );
+         uint32_t get_cashout_threads()const { return _cashout_threads.size(); }
+
+         /// Recovered signature keys and verify_authority results shared by pending transactions and blocks
+         signature_cache& get_signature_cache() { return _signature_cache; }
+         const signature_cache& get_signature_cache()const { return _signature_cache; }
+
+         /// Bodies of the unexpired transactions known to the dedupe index, served to peers
+         recent_transaction_cache& get_recent_transaction_cache() { return _recent_transaction_cache; }
+         const recent_transaction_cache& get_recent_transaction_cache()const { return _recent_transaction_cache; }
+
+         /// Per-stage throughput of the most recent reindex
+         const replay_stats& get_last_replay_stats()const { return _last_replay_stats; }
+
+         /// Starts timing each phase of block application from zero, or stops timing
+         void set_block_phase_timing( bool enabled );
+         /// Null unless block phase timing is enabled
+         const block_phase_stats* get_block_phase_stats()const { return _block_phase_stats.get(); }
+
 
 
          template<typename ObjectType, typename Modifier>
          void modify( const ObjectType& obj, Modifier&& m )
          {
             chainbase::database::_modify(obj, m);
-            notify_on_change( obj ); // notify observers
+            notify_on_change( obj, object_modified ); // notify observers
          }
 
          template<typename ObjectType, typename Constructor>
          const ObjectType& create( Constructor&& con )
          {
             const ObjectType& new_obj = chainbase::database::_create<ObjectType>(con);
-            notify_on_change( new_obj ); // notify observers
+            notify_on_change( new_obj, object_created ); // notify observers
 
             return new_obj;
          }
@@ -408,10 +574,24 @@ namespace wls { namespace chain {
       private:
          optional< chainbase::database::session > _pending_tx_session;
 
-         void apply_block( const signed_block& next_block, uint32_t skip = skip_nothing );
+         template< typename ObjectType >
+         detail::object_change_signal< ObjectType >* find_object_change_signal()const
+         {
+            const uint16_t type_id = ObjectType::type_id;
+            if( type_id >= _object_change_signals.size() )
+               return nullptr;
+            return static_cast< detail::object_change_signal< ObjectType >* >( _object_change_signals[ type_id ].get() );
+         }
+
+         void apply_block( const prepared_block_ptr& next_block, uint32_t skip = skip_nothing );
+         void apply_block( const replay_block& next_block, uint32_t skip );
+         void recover_signature_keys( const prepared_block& next_block );
+         void on_authority_change();
          void apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
-         void _apply_block( const signed_block& next_block );
+         void _apply_block( const prepared_block_ptr& next_block );
          void _apply_transaction( const signed_transaction& trx );
+         /// Applies a transaction on top of the pending state, which is left unchanged if it fails
+         void apply_pending_transaction( const signed_transaction& trx );
          void apply_operation( const operation& op );
 
 
@@ -419,14 +599,21 @@ namespace wls { namespace chain {
          ///@{
 
          const witness_object& validate_block_header( uint32_t skip, const signed_block& next_block )const;
-         void create_block_summary(const signed_block& next_block);
+         /// Everything applying a block does before its transactions, returns the signing witness
+         const witness_object& begin_block( uint32_t skip, const signed_block& next_block );
+         /// Everything applying a block does after its transactions, up to notifying observers
+         void finish_block( const prepared_block_ptr& next_block, const witness_object& signing_witness, detail::block_phase_timer& timer );
+         void fill_block_header( signed_block& b, fc::time_point_sec when, const account_name_type& witness_owner )const;
+         void maybe_flush( uint32_t block_num );
+         void create_block_summary( const signed_block& next_block, const block_id_type& next_block_id );
 
          void clear_null_account_balance();
 
-         void update_global_dynamic_data( const signed_block& b );
+         void update_global_dynamic_data( const signed_block& b, const block_id_type& b_id );
          void update_signing_witness(const witness_object& signing_witness, const signed_block& new_block);
          void update_last_irreversible_block();
          void clear_expired_transactions();
+         void load_recent_transactions();
          void process_header_extensions( const signed_block& next_block );
 
          void init_hardforks();
@@ -449,6 +636,9 @@ namespace wls { namespace chain {
 
          fc::signal< void() >          _plugin_index_signal;
 
+         /// Ordered by name, which is the order indices are written to snapshots in
+         std::map< std::string, std::shared_ptr< detail::abstract_snapshot_index > >   _snapshot_indices;
+
          transaction_id_type           _current_trx_id;
          uint32_t                      _current_block_num    = 0;
          uint16_t                      _current_trx_in_block = 0;
@@ -460,6 +650,7 @@ namespace wls { namespace chain {
          node_property_object              _node_property_object;
 
          uint32_t                      _flush_blocks = 0;
+         bool                          _single_apply_production = false;
          uint32_t                      _next_flush_block = 0;
 
          uint32_t                      _last_free_gb_printed = 0;
@@ -469,6 +660,52 @@ namespace wls { namespace chain {
 
 
          uint32_t                      _max_undo = WLS_MAX_UNDO_HISTORY;
+         bool                          _undo_journal = false;
+
+         /// Indexed by object type id, null for types without subscribers
+         vector< std::unique_ptr< detail::object_change_signal_base > >   _object_change_signals;
+
+         uint32_t                      _replay_threads = 2;
+         replay_stats                  _last_replay_stats;
+
+         template< typename Lambda >
+         void time_signal( Lambda&& l )
+         {
+            if( !_block_phase_stats )
+            {
+               l();
+               return;
+            }
+
+            auto start = fc::time_point::now();
+            l();
+            _signal_time += fc::time_point::now() - start;
+         }
+
+         std::unique_ptr< block_phase_stats >   _block_phase_stats;
+         fc::microseconds                       _signal_time;   ///< running total of time spent in signal handlers while timing
+
+         vector< std::shared_ptr< fc::thread > >   _signature_threads;
+         vector< std::shared_ptr< fc::thread > >   _cashout_threads;
+         uint32_t                                  _min_parallel_payouts = 16;
+         signature_cache                           _signature_cache;
+         recent_transaction_cache                  _recent_transaction_cache;
+         boost::signals2::scoped_connection        _authority_change_conn;
+         boost::signals2::scoped_connection        _pool_account_conn;
+         boost::signals2::scoped_connection        _pool_authority_conn;
+
+         /**
+          * Highest revision in which an account authority was created or modified. Cached
+          * verify_authority results are only used once this revision is irreversible, as an
+          * undo could otherwise restore authorities without any change being signalled.
+          */
+         int64_t                                   _authority_change_revision = -1;
+
+         /// Block being applied, whose transaction ids and digests _apply_transaction uses
+         const prepared_block*         _applying_block = nullptr;
+
+         /// Block being applied from the replay pipeline, carrying any signature keys recovered off thread
+         const replay_block*           _replay_block = nullptr;
    };
 
 } }
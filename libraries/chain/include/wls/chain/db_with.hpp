@@ -40,63 +40,24 @@ struct skip_flags_restorer
  * Class used to help the without_pending_transactions
  * implementation.
  *
- * TODO:  Change the name of this class to better reflect the fact
- * that it restores popped transactions as well as pending transactions.
+ * Pops the pending state and, once done, pushes the
+ * transactions of popped blocks and brings the
+ * transaction pool up to date.
  */
 struct pending_transactions_restorer
 {
-   pending_transactions_restorer( database& db, std::vector<signed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+   pending_transactions_restorer( database& db )
+      : _db(db)
    {
-      _db.clear_pending();
+      _db.pop_pending_state();
    }
 
    ~pending_transactions_restorer()
    {
-      for( const auto& tx : _db._popped_tx )
-      {
-         try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
-         } catch ( const fc::exception&  ) {
-         }
-      }
-      _db._popped_tx.clear();
-      for( const signed_transaction& tx : _pending_transactions )
-      {
-         try
-         {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
-         }
-         catch( const transaction_exception& e )
-         {
-            dlog( "Pending transaction became invalid after switching to block ${b} ${n} ${t}",
-               ("b", _db.head_block_id())("n", _db.head_block_num())("t", _db.head_block_time()) );
-            dlog( "The invalid transaction caused exception ${e}", ("e", e.to_detail_string()) );
-            dlog( "${t}", ("t", tx) );
-         }
-         catch( const fc::exception& e )
-         {
-
-            /*
-            dlog( "Pending transaction became invalid after switching to block ${b} ${n} ${t}",
-               ("b", _db.head_block_id())("n", _db.head_block_num())("t", _db.head_block_time()) );
-            dlog( "The invalid pending transaction caused exception ${e}", ("e", e.to_detail_string() ) );
-            dlog( "${t}", ("t", tx) );
-            */
-         }
-      }
+      _db.restore_pending_transactions();
    }
 
    database& _db;
-   std::vector< signed_transaction > _pending_transactions;
 };
 
 /**
@@ -118,18 +79,17 @@ void with_skip_flags(
 }
 
 /**
- * Empty pending_transactions, call callback,
- * then reset pending_transactions after callback is done.
+ * Pop the pending state, call callback,
+ * then restore pending transactions after callback is done.
  *
  * Pending transactions which no longer validate will be culled.
  */
 template< typename Lambda >
 void without_pending_transactions(
    database& db,
-   std::vector<signed_transaction>&& pending_transactions,
    Lambda callback )
 {
-    pending_transactions_restorer restorer( db, std::move(pending_transactions) );
+    pending_transactions_restorer restorer( db );
     callback();
     return;
 }
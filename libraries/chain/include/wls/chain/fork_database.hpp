@@ -1,5 +1,5 @@
 #pragma once
-#include <wls/protocol/block.hpp>
+#include <wls/chain/prepared_block.hpp>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
@@ -17,8 +17,8 @@ namespace wls { namespace chain {
 
    struct fork_item
    {
-      fork_item( signed_block d )
-      :num(d.block_num()),id(d.id()),data( std::move(d) ){}
+      fork_item( prepared_block_ptr p )
+      :num(p->block_num()),id(p->id()),prepared( std::move(p) ),data( prepared->block() ){}
 
       block_id_type previous_id()const { return data.previous; }
 
@@ -30,7 +30,8 @@ namespace wls { namespace chain {
        */
       bool                  invalid = false;
       block_id_type         id;
-      signed_block          data;
+      prepared_block_ptr    prepared;
+      const signed_block&   data;     ///< the block of prepared
    };
    typedef shared_ptr<fork_item> item_ptr;
 
@@ -65,7 +66,7 @@ namespace wls { namespace chain {
          /**
           *  @return the new head block ( the longest fork )
           */
-         shared_ptr<fork_item>            push_block(const signed_block& b);
+         shared_ptr<fork_item>            push_block(const prepared_block_ptr& b);
          shared_ptr<fork_item>            head()const { return _head; }
          void                             pop_block();
 
@@ -1,13 +1,97 @@
 #pragma once
 
 #include <wls/chain/database.hpp>
+#include <wls/chain/state_snapshot.hpp>
+
+#include <fc/io/datastream.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/core/demangle.hpp>
 
 namespace wls { namespace chain {
 
+namespace detail {
+
+   template< typename MultiIndexType >
+   class snapshot_index : public abstract_snapshot_index
+   {
+      public:
+         typedef typename MultiIndexType::value_type value_type;
+
+         snapshot_index( std::string name ) : _name( std::move( name ) ) {}
+
+         virtual std::string name()const override { return _name; }
+
+         virtual uint64_t size( const database& db )const override
+         {
+            return db.get_index< MultiIndexType >().indices().size();
+         }
+
+         virtual int64_t next_id( const database& db )const override
+         {
+            return db.get_index< MultiIndexType >().next_id()._id;
+         }
+
+         virtual void set_next_id( database& db, int64_t next_id )const override
+         {
+            db.get_mutable_index< MultiIndexType >().set_next_id( typename value_type::id_type( next_id ) );
+         }
+
+         virtual fc::sha256 pack( const database& db, size_t chunk_size, const std::function< void( uint32_t, const vector< char >& ) >& on_chunk )const override
+         {
+            fc::sha256::encoder enc;
+            vector< char > chunk;
+            uint32_t objects = 0;
+
+            for( const auto& obj : db.get_index< MultiIndexType >().indices() )
+            {
+               size_t offset = chunk.size();
+               chunk.resize( offset + fc::raw::pack_size( obj ) );
+               fc::datastream< char* > ds( chunk.data() + offset, chunk.size() - offset );
+               fc::raw::pack( ds, obj );
+               enc.write( chunk.data() + offset, chunk.size() - offset );
+
+               ++objects;
+               if( chunk.size() >= chunk_size )
+               {
+                  on_chunk( objects, chunk );
+                  chunk.clear();
+                  objects = 0;
+               }
+            }
+
+            if( objects )
+               on_chunk( objects, chunk );
+
+            return enc.result();
+         }
+
+         virtual void unpack( database& db, uint32_t objects, const char* data, size_t size )const override
+         {
+            auto& idx = db.get_mutable_index< MultiIndexType >();
+            fc::datastream< const char* > ds( data, size );
+
+            // The packed object includes its id, which replaces the one assigned by emplace
+            for( uint32_t i = 0; i < objects; ++i )
+               idx.emplace( [&]( value_type& v ) { fc::raw::unpack( ds, v ); } );
+
+            FC_ASSERT( ds.remaining() == 0, "Snapshot chunk of ${i} has trailing data", ("i", _name) );
+         }
+
+      private:
+         std::string _name;
+   };
+
+} // detail
+
 template< typename MultiIndexType >
 void _add_index_impl( database& db )
 {
    db.add_index< MultiIndexType >();
+
+   typedef typename MultiIndexType::value_type value_type;
+   db.add_snapshot_index( std::make_shared< detail::snapshot_index< MultiIndexType > >(
+      boost::core::demangle( typeid( value_type ).name() ) ) );
 }
 
 template< typename MultiIndexType >
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <fc/signals.hpp>
+
+#include <cstdint>
+
+namespace wls { namespace chain {
+
+enum object_change_kind
+{
+   object_created,
+   object_modified
+};
+
+/**
+ * Passed to subscribers of database::on_object_change. The object is referenced in place in
+ * shared memory and is only valid for the duration of the callback.
+ */
+template< typename ObjectType >
+struct object_change_notification
+{
+   object_change_notification( const ObjectType& o, object_change_kind k ) : id( o.id ), kind( k ), object( o ) {}
+
+   static const uint16_t               type = ObjectType::type_id;
+
+   typename ObjectType::id_type        id;
+   object_change_kind                  kind;
+   const ObjectType&                   object;
+};
+
+/// Defined so type may be bound to a reference, as BOOST_CHECK_EQUAL and std::max do
+template< typename ObjectType >
+const uint16_t object_change_notification< ObjectType >::type;
+
+namespace detail {
+
+   struct object_change_signal_base
+   {
+      virtual ~object_change_signal_base() {}
+   };
+
+   template< typename ObjectType >
+   struct object_change_signal : public object_change_signal_base
+   {
+      fc::signal< void( const object_change_notification< ObjectType >& ) > signal;
+   };
+
+} // detail
+
+} }
@@ -0,0 +1,71 @@
+#pragma once
+#include <wls/chain/block_log.hpp>
+
+#include <memory>
+
+namespace wls { namespace chain {
+
+   using namespace wls::protocol;
+
+   class prepared_block;
+   typedef std::shared_ptr< const prepared_block > prepared_block_ptr;
+
+   /// The hashes of a transaction in a prepared block, computed over its slice of the packed block
+   struct prepared_transaction
+   {
+      transaction_id_type  id;
+      digest_type          sig_digest;       ///< signed by each of the transaction's signatures
+      digest_type          merkle_digest;    ///< of the signed transaction, a leaf of the merkle tree
+      uint32_t             packed_size = 0;  ///< of the signed transaction
+   };
+
+   /**
+    * A block together with its packed bytes and every hash applying it needs, computed once.
+    *
+    * A block built locally is packed once. A block read from the block log or received as
+    * bytes is unpacked once and keeps those bytes. In both cases the block id, the merkle root
+    * and the id, signature digest and merkle digest of each transaction are then hashed
+    * directly over slices of the packed bytes, since a packed signed_transaction is its packed
+    * transaction followed by its signatures.
+    *
+    * Prepared blocks are immutable and shared: the fork database, apply_block, the
+    * applied_prepared_block signal and the block log all use the same instance.
+    */
+   class prepared_block
+   {
+      public:
+         static prepared_block_ptr create( signed_block b );
+         static prepared_block_ptr create( const packed_block& packed );
+
+         const signed_block&                    block()const         { return _block; }
+         const packed_block&                    packed()const        { return _packed; }
+         size_t                                 packed_size()const   { return _packed.size(); }
+
+         uint32_t                               block_num()const     { return _block.block_num(); }
+         const block_id_type&                   id()const            { return _id; }
+         const checksum_type&                   merkle_root()const   { return _merkle_root; }
+         const vector< prepared_transaction >&  transactions()const  { return _transactions; }
+
+      private:
+         prepared_block() {}
+
+         /// Byte offsets of one transaction in the packed block
+         struct transaction_slice
+         {
+            size_t begin = 0;
+            size_t signatures = 0;  ///< where the signatures of the transaction start
+            size_t end = 0;
+         };
+
+         void hash( size_t header_size, const vector< transaction_slice >& slices );
+
+         signed_block                     _block;
+         packed_block                     _packed;
+         block_id_type                    _id;
+         checksum_type                    _merkle_root;
+         vector< prepared_transaction >   _transactions;
+   };
+
+} }
+
+FC_REFLECT( wls::chain::prepared_transaction, (id)(sig_digest)(merkle_digest)(packed_size) )
@@ -0,0 +1,56 @@
+#pragma once
+#include <wls/protocol/transaction.hpp>
+
+#include <memory>
+
+namespace wls { namespace chain {
+
+   using namespace wls::protocol;
+
+   namespace detail { class recent_transaction_cache_impl; }
+
+   struct recent_transaction_cache_stats
+   {
+      uint64_t entries = 0;
+      uint64_t bytes = 0;
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0;     ///< entries dropped before expiring to stay under the size limit
+   };
+
+   /**
+    * Packed bodies of recently applied transactions, kept in process memory so the p2p layer can
+    * serve them to peers until they expire. Whether a transaction is known is decided by the
+    * transaction_index in shared memory; this cache only holds the bodies and may miss entries
+    * that were evicted to stay under its size limit.
+    *
+    * database fills it as the transactions of blocks are applied, leaving out pending ones, and
+    * rebuilds it from the block log when opened. All methods are thread safe.
+    */
+   class recent_transaction_cache
+   {
+      public:
+         explicit recent_transaction_cache( size_t max_bytes = 64 * 1024 * 1024 );
+         ~recent_transaction_cache();
+
+         /// Maximum total size of the packed transactions, the entries expiring first are evicted beyond it
+         void   set_max_size( size_t max_bytes );
+         size_t get_max_size()const;
+
+         void add( const transaction_id_type& id, const signed_transaction& trx );
+         optional< signed_transaction > find( const transaction_id_type& id )const;
+
+         /// Drops the transactions with an expiration before now, as clear_expired_transactions does
+         void remove_expired( time_point_sec now );
+
+         void clear();
+
+         recent_transaction_cache_stats get_stats()const;
+
+      private:
+         std::unique_ptr< detail::recent_transaction_cache_impl > my;
+   };
+
+} }
+
+FC_REFLECT( wls::chain::recent_transaction_cache_stats, (entries)(bytes)(hits)(misses)(evictions) )
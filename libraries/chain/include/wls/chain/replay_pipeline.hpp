@@ -0,0 +1,83 @@
+#pragma once
+#include <wls/chain/prepared_block.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+
+namespace wls { namespace chain {
+
+   using namespace wls::protocol;
+
+   namespace detail { class replay_pipeline_impl; }
+
+   /**
+    * A block read back from the block log, prepared with the hashes that would otherwise
+    * be computed on the apply thread.
+    *
+    * When the pipeline recovers signatures, signee and signature_keys hold the keys that
+    * signed the block and each of its transactions. A key that could not be recovered is
+    * left empty, so applying the block recovers it again and reports the error in context.
+    */
+   struct replay_block
+   {
+      prepared_block_ptr                              block;
+      optional< public_key_type >                     signee;
+      vector< optional< flat_set< public_key_type > > > signature_keys;
+   };
+
+   struct replay_stage_stats
+   {
+      uint64_t          blocks = 0;
+      fc::microseconds  busy;
+
+      double blocks_per_second()const
+      {
+         return busy.count() > 0 ? double( blocks ) * 1000000.0 / double( busy.count() ) : 0.0;
+      }
+   };
+
+   struct replay_stats
+   {
+      replay_stage_stats   read;    ///< raw block bytes read from block_log
+      replay_stage_stats   hash;    ///< deserialization, block id, transaction ids, merkle root and any signature recovery
+      replay_stage_stats   apply;   ///< state transitions on the database thread
+      fc::microseconds     elapsed;
+      uint32_t             worker_threads = 0;
+   };
+
+   /**
+    * Streams blocks out of a block log for database::reindex in three overlapping stages.
+    *
+    * A reader thread pulls raw block bytes out of block_log in batches using the offsets in
+    * block_log.index. A pool of worker threads prepares each block of a batch from its bytes,
+    * which stay in the batch. The consumer applies the previous batch while the
+    * next one is being read and hashed.
+    *
+    * The pipeline opens its own streams on the block log files, so the database's block_log
+    * instance is not touched from the reader thread. With recover_signatures the workers also
+    * recover the block and transaction signature keys, which database::import_block_log uses
+    * to verify a block log from another node at close to reindex speed.
+    */
+   class replay_pipeline
+   {
+      public:
+         replay_pipeline( const fc::path& block_log_file, uint32_t worker_threads, uint32_t batch_size = 1000, bool recover_signatures = false );
+         ~replay_pipeline();
+
+         /**
+          * Returns the next batch of prepared blocks in block number order. An empty batch
+          * means the end of the block log has been reached.
+          */
+         std::shared_ptr< vector< replay_block > > next_batch();
+
+         /// Stats for the read and hash stages; the consumer is responsible for the apply stage.
+         replay_stats& stats();
+
+      private:
+         std::unique_ptr< detail::replay_pipeline_impl > my;
+   };
+
+} }
+
+FC_REFLECT( wls::chain::replay_stage_stats, (blocks)(busy) )
+FC_REFLECT( wls::chain::replay_stats, (read)(hash)(apply)(elapsed)(worker_threads) )
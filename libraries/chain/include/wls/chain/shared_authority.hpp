@@ -102,3 +102,20 @@ namespace wls { namespace chain {
 
 FC_REFLECT_TYPENAME( wls::chain::shared_authority::account_authority_map)
 FC_REFLECT( wls::chain::shared_authority, (weight_threshold)(account_auths)(key_auths) )
+
+namespace fc { namespace raw {
+
+   /// Packed as an authority, so the encoding does not depend on the interprocess containers
+   template< typename Stream > inline void pack( Stream& s, const wls::chain::shared_authority& a )
+   {
+      pack( s, wls::protocol::authority( a ) );
+   }
+
+   template< typename Stream > inline void unpack( Stream& s, wls::chain::shared_authority& a )
+   {
+      wls::protocol::authority auth;
+      unpack( s, auth );
+      a = auth;
+   }
+
+} } // fc::raw
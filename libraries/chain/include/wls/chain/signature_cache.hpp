@@ -0,0 +1,67 @@
+#pragma once
+#include <wls/protocol/transaction.hpp>
+
+#include <memory>
+
+namespace wls { namespace chain {
+
+   using namespace wls::protocol;
+
+   namespace detail { class signature_cache_impl; }
+
+   struct signature_cache_stats
+   {
+      uint64_t key_hits = 0;
+      uint64_t key_misses = 0;
+      uint64_t verified_hits = 0;
+      uint64_t verified_misses = 0;
+      uint64_t invalidations = 0;
+   };
+
+   /**
+    * Bounded LRU caches for the two expensive parts of checking a transaction's signatures.
+    *
+    * Recovered public keys are keyed on (signature digest, signature). They are a pure function
+    * of the key and never need invalidating. Successful verify_authority results are keyed on
+    * the digest of the whole signed transaction and are dropped whenever account authorities
+    * change.
+    *
+    * A transaction is usually checked when it enters the pending state, again when the pending
+    * state is rebuilt, and again when the block including it is produced or received. With the
+    * cache the keys are recovered only the first time.
+    *
+    * All methods are thread safe. Keys are recovered outside the lock.
+    */
+   class signature_cache
+   {
+      public:
+         explicit signature_cache( size_t max_size = 100000 );
+         ~signature_cache();
+
+         /// Maximum number of entries in each of the key and verified caches
+         void   set_max_size( size_t max_size );
+         size_t get_max_size()const;
+
+         /// Same result and errors as signed_transaction::get_signature_keys
+         flat_set< public_key_type > get_signature_keys( const signed_transaction& trx, const chain_id_type& chain_id );
+         /// Same with the signature digest of the transaction already computed
+         flat_set< public_key_type > get_signature_keys_for_digest( const signed_transaction& trx, const digest_type& sig_digest );
+
+         /// True if the signed transaction with this merkle digest passed verify_authority under the current authorities
+         bool is_verified( const digest_type& trx_digest );
+         void set_verified( const digest_type& trx_digest );
+
+         /// Forget every verify_authority result. Recovered keys are kept.
+         void invalidate_verified();
+
+         void clear();
+
+         signature_cache_stats get_stats()const;
+
+      private:
+         std::unique_ptr< detail::signature_cache_impl > my;
+   };
+
+} }
+
+FC_REFLECT( wls::chain::signature_cache_stats, (key_hits)(key_misses)(verified_hits)(verified_misses)(invalidations) )
@@ -0,0 +1,101 @@
+#pragma once
+#include <wls/protocol/types.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/filesystem.hpp>
+
+#include <functional>
+
+namespace wls { namespace chain {
+
+   using namespace wls::protocol;
+
+   class database;
+
+   /**
+    * A state snapshot holds every object of the indices added with add_core_index and
+    * add_plugin_index at one block. Objects are packed with fc::raw, so a snapshot does not
+    * depend on the layout of the shared memory file and can be moved between builds.
+    *
+    * +--------+--------+---------+---------+-----+--------+-----------------+
+    * | Header | Chunk  | Chunk   | Chunk   | ... | Footer | Pos of Footer   |
+    * +--------+--------+---------+---------+-----+--------+-----------------+
+    *
+    * Each index is written as a run of zstd compressed chunks of packed objects. The footer
+    * lists where the run of each index starts, together with a digest of its packed objects.
+    * The state digest covers the name, next id and digest of every index.
+    *
+    * The digests are stored in the snapshot itself, so on their own they only detect a damaged
+    * file. A snapshot from an untrusted source is only checked against what it should contain
+    * when its state digest is compared with one obtained from a trusted node, which
+    * import_snapshot does when given an expected digest.
+    */
+   struct snapshot_header
+   {
+      uint64_t          magic = 0;
+      uint32_t          version = 0;
+      chain_id_type     chain_id;
+      uint32_t          head_block_num = 0;
+      block_id_type     head_block_id;
+   };
+
+   struct snapshot_index_info
+   {
+      std::string       name;
+      int64_t           next_id = 0;
+      uint64_t          objects = 0;
+      uint64_t          offset = 0;       ///< file position of the first chunk
+      fc::sha256        digest;
+   };
+
+   struct snapshot_footer
+   {
+      vector< snapshot_index_info > indices;
+      fc::sha256                    state_digest;
+   };
+
+   namespace detail {
+
+      /**
+       * Packs and unpacks the objects of one index. database keeps one for each index added
+       * through add_core_index and add_plugin_index, see snapshot_index in index.hpp.
+       */
+      class abstract_snapshot_index
+      {
+         public:
+            virtual ~abstract_snapshot_index() {}
+
+            virtual std::string name()const = 0;
+            virtual uint64_t    size( const database& db )const = 0;
+            virtual int64_t     next_id( const database& db )const = 0;
+            virtual void        set_next_id( database& db, int64_t next_id )const = 0;
+
+            /// Calls on_chunk( object count, packed objects ) about every chunk_size bytes, returns the digest of all packed objects
+            virtual fc::sha256  pack( const database& db, size_t chunk_size, const std::function< void( uint32_t, const vector< char >& ) >& on_chunk )const = 0;
+            virtual void        unpack( database& db, uint32_t objects, const char* data, size_t size )const = 0;
+      };
+
+   } // detail
+
+   /**
+    * Writes the state of db to file. Must be called with a read lock and an empty undo stack,
+    * such as right after database::open.
+    */
+   void export_state_snapshot( const database& db, const fc::path& file );
+
+   snapshot_header read_state_snapshot_header( const fc::path& file );
+   snapshot_footer read_state_snapshot_footer( const fc::path& file );
+
+   /**
+    * Loads a snapshot into the empty indices of db, rebuilding the indices on up to threads worker
+    * threads. The digest of every rebuilt index is checked against the snapshot. Must be called
+    * with a write lock. Indices in the snapshot that db does not have are skipped, while indices
+    * db has that are missing from the snapshot are an error.
+    */
+   snapshot_header import_state_snapshot( database& db, const fc::path& file, uint32_t threads );
+
+} }
+
+FC_REFLECT( wls::chain::snapshot_header, (magic)(version)(chain_id)(head_block_num)(head_block_id) )
+FC_REFLECT( wls::chain::snapshot_index_info, (name)(next_id)(objects)(offset)(digest) )
+FC_REFLECT( wls::chain::snapshot_footer, (indices)(state_digest) )
@@ -13,6 +13,9 @@ namespace wls { namespace chain {
     * The purpose of this object is to enable the detection of duplicate transactions. When a transaction is included
     * in a block a transaction_object is added. At the end of block processing all transaction_objects that have
     * expired can be removed from the index.
+    *
+    * Only the id and expiration are kept in shared memory. The transaction bodies served to peers are kept in
+    * database's recent_transaction_cache.
     */
    class transaction_object : public object< transaction_object_type, transaction_object >
    {
@@ -21,14 +24,12 @@ namespace wls { namespace chain {
       public:
          template< typename Constructor, typename Allocator >
          transaction_object( Constructor&& c, allocator< Allocator > a )
-            : packed_trx( a )
          {
             c( *this );
          }
 
          id_type              id;
 
-         bip::vector< char, allocator< char > > packed_trx;
          transaction_id_type  trx_id;
          time_point_sec       expiration;
    };
@@ -47,5 +48,5 @@ namespace wls { namespace chain {
 
 } } // wls::chain
 
-FC_REFLECT( wls::chain::transaction_object, (id)(packed_trx)(trx_id)(expiration) )
+FC_REFLECT( wls::chain::transaction_object, (id)(trx_id)(expiration) )
 CHAINBASE_SET_INDEX_TYPE( wls::chain::transaction_object, wls::chain::transaction_index )
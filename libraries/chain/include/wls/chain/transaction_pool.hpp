@@ -0,0 +1,115 @@
+#pragma once
+#include <wls/protocol/transaction.hpp>
+
+#include <functional>
+#include <memory>
+
+namespace wls { namespace chain {
+
+   using namespace wls::protocol;
+
+   namespace detail { class transaction_pool_impl; }
+
+   struct transaction_pool_stats
+   {
+      uint64_t transactions = 0;
+      uint64_t bytes = 0;
+      uint64_t senders = 0;
+      uint64_t unapplied = 0;        ///< kept across blocks and not yet applied to the pending state again
+
+      uint64_t max_transactions = 0;
+      uint64_t max_bytes = 0;
+      uint64_t max_per_sender = 0;
+
+      uint64_t added = 0;
+      uint64_t rejected = 0;         ///< refused because their sender was at its limit or they would have been evicted
+      uint64_t evicted = 0;          ///< dropped from the sender with the most bytes to make room
+      uint64_t expired = 0;
+      uint64_t included = 0;         ///< left the pool in a block
+      uint64_t revalidated = 0;      ///< applied again after a block
+      uint64_t invalidated = 0;      ///< dropped because they failed when applied again
+      uint64_t kept = 0;             ///< carried over a block without being applied again
+   };
+
+   /**
+    * Transactions waiting to be included in a block, indexed by id, arrival order, expiration and
+    * sender. The sender of a transaction is the first account whose authority its first operation
+    * requires.
+    *
+    * A transaction joins the pool once it applied to the pending state. Each sender may have at most
+    * max_per_sender transactions in the pool; beyond max_transactions or max_bytes, the newest
+    * transaction of the sender holding the most bytes is evicted. Evicted transactions stay in the
+    * pending state until the next block.
+    *
+    * Pushing a block pops the pending state. Afterwards, remove_stale drops the transactions that
+    * expired or were included, and revalidate applies again only those requiring the authority of
+    * an account the blocks changed. The others are kept without being applied; apply_unapplied
+    * applies them when a new transaction fails without them. Block production removes the
+    * transactions that fail in the block, whether or not a block changed their accounts.
+    *
+    * database calls everything but get_stats under its write lock. Callbacks run with the pool
+    * locked and may only call account_changed.
+    */
+   class transaction_pool
+   {
+      public:
+         typedef std::function< void( const signed_transaction& ) > apply_callback;
+
+         transaction_pool( size_t max_transactions = 20000, size_t max_bytes = 64 * 1024 * 1024, uint32_t max_per_sender = 1000 );
+         ~transaction_pool();
+
+         void set_limits( size_t max_transactions, size_t max_bytes, uint32_t max_per_sender );
+
+         size_t size()const;
+         bool   empty()const;
+         bool   contains( const transaction_id_type& id )const;
+
+         /// Throws if the sender of the transaction is at its limit, so it is refused before being applied
+         void check_sender( const signed_transaction& trx )const;
+
+         /// Adds a transaction that was just applied to the pending state, throws if it would be evicted itself
+         void add( const signed_transaction& trx, const transaction_id_type& id );
+
+         /// Drops a transaction that failed while a block was being produced, counted as invalidated
+         void remove( const transaction_id_type& id );
+
+         void clear();
+
+         /// Calls f on each transaction in arrival order
+         void for_each( const apply_callback& f )const;
+
+         /// The pending state was popped, no transaction is applied to it anymore
+         void state_popped();
+
+         /// Applies every transaction not applied to the pending state, in arrival order, dropping those apply throws for
+         void apply_unapplied( const apply_callback& apply );
+         size_t unapplied()const;
+
+         /// Records an account whose state a block changed
+         void account_changed( const account_name_type& name );
+
+         /// Makes the next revalidate apply every transaction again, as when blocks were popped
+         void all_changed();
+
+         /// Drops the transactions that expire by now and those is_known returns true for, as blocks included them
+         void remove_stale( time_point_sec now, const std::function< bool( const transaction_id_type& ) >& is_known );
+
+         /**
+          * Applies again, in arrival order, the unapplied transactions requiring the authority of an
+          * account changed since the last call. When one of them fails, every transaction still
+          * unapplied is applied first and it is tried again before being dropped.
+          */
+         void revalidate( const apply_callback& apply );
+
+         transaction_pool_stats get_stats()const;
+
+      private:
+         std::unique_ptr< detail::transaction_pool_impl > my;
+   };
+
+} }
+
+FC_REFLECT( wls::chain::transaction_pool_stats,
+   (transactions)(bytes)(senders)(unapplied)
+   (max_transactions)(max_bytes)(max_per_sender)
+   (added)(rejected)(evicted)(expired)(included)(revalidated)(invalidated)(kept) )
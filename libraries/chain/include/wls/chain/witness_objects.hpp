@@ -6,6 +6,7 @@
 #include <wls/chain/wls_object_types.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 
 namespace wls { namespace chain {
 
@@ -157,6 +158,7 @@ namespace wls { namespace chain {
 
    struct by_vote_name;
    struct by_name;
+   struct by_name_hash;
    struct by_work;
    struct by_schedule_time;
    /**
@@ -168,6 +170,7 @@ namespace wls { namespace chain {
          ordered_unique< tag< by_id >, member< witness_object, witness_id_type, &witness_object::id > >,
          ordered_non_unique< tag< by_work >, member< witness_object, digest_type, &witness_object::last_work > >,
          ordered_unique< tag< by_name >, member< witness_object, account_name_type, &witness_object::owner > >,
+         hashed_unique< tag< by_name_hash >, member< witness_object, account_name_type, &witness_object::owner > >,
          ordered_unique< tag< by_vote_name >,
             composite_key< witness_object,
                member< witness_object, share_type, &witness_object::votes >,
@@ -142,6 +142,38 @@ namespace fc
       namespace bip = chainbase::bip;
       using chainbase::allocator;
 
+      template< typename Stream > inline void pack( Stream& s, const wls::chain::shared_string& str )
+      {
+         pack( s, unsigned_int( (uint32_t)str.size() ) );
+         if( str.size() )
+            s.write( str.data(), str.size() );
+      }
+
+      template< typename Stream > inline void unpack( Stream& s, wls::chain::shared_string& str )
+      {
+         unsigned_int size;
+         unpack( s, size );
+         str.resize( size.value );
+         if( size.value )
+            s.read( &str[0], size.value );
+      }
+
+      template< typename Stream, typename T > inline void pack( Stream& s, const bip::vector< T, allocator< T > >& v )
+      {
+         pack( s, unsigned_int( (uint32_t)v.size() ) );
+         for( const auto& item : v )
+            pack( s, item );
+      }
+
+      template< typename Stream, typename T > inline void unpack( Stream& s, bip::vector< T, allocator< T > >& v )
+      {
+         unsigned_int size;
+         unpack( s, size );
+         v.resize( size.value );
+         for( auto& item : v )
+            unpack( s, item );
+      }
+
       template< typename T > inline void pack( wls::chain::buffer_type& raw, const T& v )
       {
          auto size = pack_size( v );
@@ -166,6 +198,31 @@ namespace fc
    }
 }
 
+namespace wls { namespace chain {
+
+/**
+ * Undo journal codec for reflected objects, see CHAINBASE_SET_UNDO_JOURNAL_CODEC. The reflection must
+ * cover every member of the object.
+ */
+template< typename T >
+struct raw_undo_journal_codec
+{
+   static void pack( std::vector< char >& out, const T& v )
+   {
+      out.resize( fc::raw::pack_size( v ) );
+      fc::datastream< char* > ds( out.data(), out.size() );
+      fc::raw::pack( ds, v );
+   }
+
+   static void unpack( T& v, const char* data, size_t size )
+   {
+      fc::datastream< const char* > ds( data, size );
+      fc::raw::unpack( ds, v );
+   }
+};
+
+} } // wls::chain
+
 namespace fc {
 
 }
@@ -0,0 +1,113 @@
+#include <wls/chain/prepared_block.hpp>
+
+#include <wls/protocol/config.hpp>
+
+#include <fc/io/datastream.hpp>
+#include <fc/io/raw.hpp>
+
+namespace wls { namespace chain {
+
+   /**
+    * Packs the block piece by piece, which produces the same bytes as packing it whole, to
+    * learn where the header and each transaction and its signatures end.
+    */
+   prepared_block_ptr prepared_block::create( signed_block b )
+   { try {
+      std::shared_ptr< prepared_block > result( new prepared_block() );
+      result->_block = std::move( b );
+      const auto& block = result->_block;
+
+      auto data = std::make_shared< vector< char > >( fc::raw::pack_size( block ) );
+      fc::datastream< char* > ds( data->data(), data->size() );
+
+      fc::raw::pack( ds, static_cast< const signed_block_header& >( block ) );
+      size_t header_size = ds.tellp();
+
+      fc::raw::pack( ds, fc::unsigned_int( block.transactions.size() ) );
+      vector< transaction_slice > slices( block.transactions.size() );
+      for( size_t i = 0; i < block.transactions.size(); ++i )
+      {
+         slices[i].begin = ds.tellp();
+         fc::raw::pack( ds, static_cast< const transaction& >( block.transactions[i] ) );
+         slices[i].signatures = ds.tellp();
+         fc::raw::pack( ds, block.transactions[i].signatures );
+         slices[i].end = ds.tellp();
+      }
+      FC_ASSERT( ds.tellp() == data->size() );
+
+      result->_packed = packed_block( data, data->data(), data->size() );
+      result->hash( header_size, slices );
+      return result;
+   } FC_CAPTURE_AND_RETHROW() }
+
+   prepared_block_ptr prepared_block::create( const packed_block& packed )
+   { try {
+      FC_ASSERT( packed.valid() );
+      std::shared_ptr< prepared_block > result( new prepared_block() );
+      result->_packed = packed;
+      auto& block = result->_block;
+
+      fc::datastream< const char* > ds( packed.data(), packed.size() );
+
+      fc::raw::unpack( ds, static_cast< signed_block_header& >( block ) );
+      size_t header_size = ds.tellp();
+
+      fc::unsigned_int count;
+      fc::raw::unpack( ds, count );
+      FC_ASSERT( count.value <= ds.remaining(), "Block claims more transactions than it has bytes", ("count",count.value) );
+
+      block.transactions.resize( count.value );
+      vector< transaction_slice > slices( count.value );
+      for( size_t i = 0; i < block.transactions.size(); ++i )
+      {
+         slices[i].begin = ds.tellp();
+         fc::raw::unpack( ds, static_cast< transaction& >( block.transactions[i] ) );
+         slices[i].signatures = ds.tellp();
+         fc::raw::unpack( ds, block.transactions[i].signatures );
+         slices[i].end = ds.tellp();
+      }
+      FC_ASSERT( ds.remaining() == 0, "Unexpected bytes after the block", ("remaining",ds.remaining()) );
+
+      result->hash( header_size, slices );
+      return result;
+   } FC_CAPTURE_AND_RETHROW() }
+
+   /// Each hash matches the signed_block or signed_transaction method named in the comment
+   void prepared_block::hash( size_t header_size, const vector< transaction_slice >& slices )
+   {
+      static const chain_id_type chain_id = WLS_CHAIN_ID;
+      const char* data = _packed.data();
+
+      // signed_block_header::id()
+      _id = signed_block_header::id_from_hash( fc::sha224::hash( data, header_size ), _block.block_num() );
+
+      _transactions.resize( slices.size() );
+      vector< digest_type > leaves;
+      leaves.reserve( slices.size() );
+
+      for( size_t i = 0; i < slices.size(); ++i )
+      {
+         const auto& s = slices[i];
+         auto& t = _transactions[i];
+         uint32_t unsigned_size = s.signatures - s.begin;
+
+         // transaction::id()
+         t.id = transaction::id_from_digest( digest_type::hash( data + s.begin, unsigned_size ) );
+
+         // transaction::sig_digest()
+         digest_type::encoder enc;
+         fc::raw::pack( enc, chain_id );
+         enc.write( data + s.begin, unsigned_size );
+         t.sig_digest = enc.result();
+
+         // signed_transaction::merkle_digest()
+         t.packed_size = s.end - s.begin;
+         t.merkle_digest = digest_type::hash( data + s.begin, t.packed_size );
+         leaves.push_back( t.merkle_digest );
+      }
+
+      // signed_block::calculate_merkle_root()
+      _merkle_root = signed_block::calculate_merkle_root( std::move( leaves ) );
+   }
+
+} } // wls::chain
@@ -0,0 +1,142 @@
+#include <wls/chain/recent_transaction_cache.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+#include <mutex>
+
+namespace wls { namespace chain {
+
+   namespace detail {
+
+      using namespace boost::multi_index;
+
+      struct recent_transaction_entry
+      {
+         transaction_id_type  trx_id;
+         time_point_sec       expiration;
+         vector< char >       packed_trx;
+      };
+
+      typedef multi_index_container<
+         recent_transaction_entry,
+         indexed_by<
+            hashed_unique< member< recent_transaction_entry, transaction_id_type, &recent_transaction_entry::trx_id >, std::hash< transaction_id_type > >,
+            ordered_non_unique< member< recent_transaction_entry, time_point_sec, &recent_transaction_entry::expiration > >
+         >
+      > recent_transaction_index;
+
+      class recent_transaction_cache_impl
+      {
+         public:
+            void trim()
+            {
+               auto& by_expiration = entries.get< 1 >();
+               while( bytes > max_bytes && !by_expiration.empty() )
+               {
+                  bytes -= by_expiration.begin()->packed_trx.size();
+                  by_expiration.erase( by_expiration.begin() );
+                  ++stats.evictions;
+               }
+            }
+
+            mutable std::mutex                        mutex;
+            size_t                                    max_bytes = 0;
+            size_t                                    bytes = 0;
+            recent_transaction_index                  entries;
+            mutable recent_transaction_cache_stats    stats;
+      };
+   }
+
+   recent_transaction_cache::recent_transaction_cache( size_t max_bytes )
+      : my( new detail::recent_transaction_cache_impl() )
+   {
+      my->max_bytes = max_bytes;
+   }
+
+   recent_transaction_cache::~recent_transaction_cache() {}
+
+   void recent_transaction_cache::set_max_size( size_t max_bytes )
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      my->max_bytes = max_bytes;
+      my->trim();
+   }
+
+   size_t recent_transaction_cache::get_max_size()const
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      return my->max_bytes;
+   }
+
+   void recent_transaction_cache::add( const transaction_id_type& id, const signed_transaction& trx )
+   {
+      {
+         std::lock_guard< std::mutex > guard( my->mutex );
+         if( my->max_bytes == 0 || my->entries.find( id ) != my->entries.end() )
+            return;
+      }
+
+      // Pending transactions are applied again with every block, so packing is skipped above when already cached
+      detail::recent_transaction_entry entry{ id, trx.expiration, fc::raw::pack( trx ) };
+      size_t size = entry.packed_trx.size();
+
+      std::lock_guard< std::mutex > guard( my->mutex );
+      if( my->entries.insert( std::move( entry ) ).second )
+      {
+         my->bytes += size;
+         my->trim();
+      }
+   }
+
+   optional< signed_transaction > recent_transaction_cache::find( const transaction_id_type& id )const
+   {
+      vector< char > packed;
+      {
+         std::lock_guard< std::mutex > guard( my->mutex );
+         auto itr = my->entries.find( id );
+         if( itr == my->entries.end() )
+         {
+            ++my->stats.misses;
+            return optional< signed_transaction >();
+         }
+
+         ++my->stats.hits;
+         packed = itr->packed_trx;
+      }
+
+      return fc::raw::unpack< signed_transaction >( packed );
+   }
+
+   void recent_transaction_cache::remove_expired( time_point_sec now )
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      auto& by_expiration = my->entries.get< 1 >();
+      while( !by_expiration.empty() && by_expiration.begin()->expiration < now )
+      {
+         my->bytes -= by_expiration.begin()->packed_trx.size();
+         by_expiration.erase( by_expiration.begin() );
+      }
+   }
+
+   void recent_transaction_cache::clear()
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      my->entries.clear();
+      my->bytes = 0;
+   }
+
+   recent_transaction_cache_stats recent_transaction_cache::get_stats()const
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      auto stats = my->stats;
+      stats.entries = my->entries.size();
+      stats.bytes = my->bytes;
+      return stats;
+   }
+
+} } // wls::chain
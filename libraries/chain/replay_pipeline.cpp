@@ -0,0 +1,259 @@
+#include <wls/chain/replay_pipeline.hpp>
+
+#include <wls/protocol/config.hpp>
+
+#include <fc/io/datastream.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <fstream>
+
+namespace wls { namespace chain {
+
+   namespace detail {
+
+      /// Packed bytes for a contiguous run of blocks, as read from block_log
+      struct raw_batch
+      {
+         vector< char >                            data;
+         vector< std::pair< uint64_t, uint64_t > > blocks;   ///< offset into data and packed size of each block
+      };
+
+      typedef std::shared_ptr< raw_batch >                  raw_batch_ptr;
+      typedef std::shared_ptr< vector< replay_block > >     replay_batch_ptr;
+
+      class replay_pipeline_impl
+      {
+         public:
+            replay_pipeline_impl( const fc::path& block_log_file, uint32_t worker_threads, uint32_t batch_size, bool recover_signatures );
+            ~replay_pipeline_impl();
+
+            raw_batch_ptr  read_batch();
+            void           start_read();
+            void           start_hash( const raw_batch_ptr& raw );
+            replay_batch_ptr finish_hash();
+
+            std::ifstream                                   block_stream;
+            std::ifstream                                   index_stream;
+            uint64_t                                        block_file_size = 0;
+            uint32_t                                        num_blocks = 0;
+            uint32_t                                        next_block_num = 1;
+            uint32_t                                        batch_size = 0;
+            bool                                            recover_signatures = false;
+
+            std::shared_ptr< fc::thread >                   reader;
+            vector< std::shared_ptr< fc::thread > >         workers;
+
+            fc::future< raw_batch_ptr >                     pending_read;
+            vector< fc::future< void > >                    pending_hash;
+            vector< int64_t >                               hash_times;
+            replay_batch_ptr                                hashing;
+            bool                                            started = false;
+
+            replay_stats                                    stats;
+            fc::time_point                                  start_time;
+      };
+
+      replay_pipeline_impl::replay_pipeline_impl( const fc::path& block_log_file, uint32_t worker_threads, uint32_t size, bool recover )
+         : batch_size( std::max( size, 1u ) ),
+           recover_signatures( recover )
+      {
+         fc::path index_file( block_log_file.generic_string() + ".index" );
+
+         block_stream.exceptions( std::ifstream::failbit | std::ifstream::badbit );
+         index_stream.exceptions( std::ifstream::failbit | std::ifstream::badbit );
+         block_stream.open( block_log_file.generic_string().c_str(), std::ios::in | std::ios::binary );
+         index_stream.open( index_file.generic_string().c_str(), std::ios::in | std::ios::binary );
+
+         block_file_size = fc::file_size( block_log_file );
+         num_blocks = fc::file_size( index_file ) / sizeof( uint64_t );
+
+         worker_threads = std::max( worker_threads, 1u );
+         reader = std::make_shared< fc::thread >( "replay_reader" );
+         workers.resize( worker_threads );
+         for( uint32_t i = 0; i < worker_threads; ++i )
+            workers[i] = std::make_shared< fc::thread >( "replay_worker_" + fc::to_string( i ) );
+
+         stats.worker_threads = worker_threads;
+         start_time = fc::time_point::now();
+      }
+
+      replay_pipeline_impl::~replay_pipeline_impl()
+      {
+         // Let in-flight tasks finish before their threads and streams go away
+         try
+         {
+            if( pending_read.valid() )
+               pending_read.wait();
+         }
+         catch( ... ) {}
+
+         for( auto& f : pending_hash )
+         {
+            try { f.wait(); }
+            catch( ... ) {}
+         }
+      }
+
+      /**
+       * Runs on the reader thread. Block i occupies [ pos(i), pos(i+1) - 8 ) in block_log, the
+       * trailing 8 bytes being the back pointer, so a whole batch can be read with one call.
+       */
+      raw_batch_ptr replay_pipeline_impl::read_batch()
+      {
+         auto start = fc::time_point::now();
+         auto result = std::make_shared< raw_batch >();
+
+         if( next_block_num > num_blocks )
+            return result;
+
+         uint32_t count = std::min( batch_size, num_blocks - next_block_num + 1 );
+
+         vector< uint64_t > pos( count + 1 );
+         index_stream.seekg( sizeof( uint64_t ) * ( next_block_num - 1 ) );
+         index_stream.read( (char*)pos.data(), sizeof( uint64_t ) * count );
+
+         if( next_block_num + count <= num_blocks )
+            index_stream.read( (char*)&pos[ count ], sizeof( uint64_t ) );
+         else
+            pos[ count ] = block_file_size;
+
+         uint64_t begin = pos[0];
+         uint64_t end = pos[ count ] - sizeof( uint64_t );
+         FC_ASSERT( end > begin && pos[ count ] <= block_file_size, "Block log index is inconsistent with block log" );
+
+         result->data.resize( end - begin );
+         block_stream.seekg( begin );
+         block_stream.read( result->data.data(), result->data.size() );
+
+         result->blocks.reserve( count );
+         for( uint32_t i = 0; i < count; ++i )
+            result->blocks.emplace_back( pos[i] - begin, pos[i+1] - pos[i] - sizeof( uint64_t ) );
+
+         next_block_num += count;
+
+         stats.read.blocks += count;
+         stats.read.busy += fc::time_point::now() - start;
+         return result;
+      }
+
+      void replay_pipeline_impl::start_read()
+      {
+         pending_read = reader->async( [this]() { return read_batch(); }, "replay read_batch" );
+      }
+
+      /**
+       * Splits the batch into one contiguous slice per worker. Each worker prepares its blocks
+       * into preallocated slots. Prepared blocks keep the raw batch alive as long as they refer
+       * to its bytes.
+       */
+      void replay_pipeline_impl::start_hash( const raw_batch_ptr& raw )
+      {
+         hashing = std::make_shared< vector< replay_block > >( raw->blocks.size() );
+         pending_hash.clear();
+         hash_times.assign( workers.size(), 0 );
+
+         size_t slice = ( raw->blocks.size() + workers.size() - 1 ) / workers.size();
+         replay_batch_ptr out = hashing;
+
+         for( size_t w = 0; w < workers.size(); ++w )
+         {
+            size_t first = w * slice;
+            size_t last = std::min( first + slice, raw->blocks.size() );
+            if( first >= last )
+               break;
+
+            pending_hash.push_back( workers[w]->async( [this,raw,out,first,last,w]()
+            {
+               auto start = fc::time_point::now();
+               for( size_t i = first; i < last; ++i )
+               {
+                  replay_block& rb = (*out)[i];
+                  rb.block = prepared_block::create( packed_block( raw, raw->data.data() + raw->blocks[i].first, raw->blocks[i].second ) );
+
+                  if( recover_signatures )
+                  {
+                     const auto& block = rb.block->block();
+                     try
+                     {
+                        rb.signee = public_key_type( block.signee() );
+                     }
+                     catch( const fc::exception& ) {}
+
+                     rb.signature_keys.resize( block.transactions.size() );
+                     for( size_t t = 0; t < block.transactions.size(); ++t )
+                     {
+                        try
+                        {
+                           rb.signature_keys[t] = block.transactions[t].get_signature_keys_for_digest( rb.block->transactions()[t].sig_digest );
+                        }
+                        catch( const fc::exception& ) {}
+                     }
+                  }
+               }
+               hash_times[w] = ( fc::time_point::now() - start ).count();
+            }, "replay hash_batch" ) );
+         }
+      }
+
+      replay_batch_ptr replay_pipeline_impl::finish_hash()
+      {
+         for( auto& f : pending_hash )
+            f.wait();
+         pending_hash.clear();
+
+         // Slices run concurrently, so the slowest one is the wall time of the stage
+         int64_t slowest = 0;
+         for( int64_t t : hash_times )
+            slowest = std::max( slowest, t );
+
+         stats.hash.blocks += hashing->size();
+         stats.hash.busy += fc::microseconds( slowest );
+
+         replay_batch_ptr result = hashing;
+         hashing.reset();
+         return result;
+      }
+   }
+
+   replay_pipeline::replay_pipeline( const fc::path& block_log_file, uint32_t worker_threads, uint32_t batch_size, bool recover_signatures )
+      : my( new detail::replay_pipeline_impl( block_log_file, worker_threads, batch_size, recover_signatures ) )
+   {}
+
+   replay_pipeline::~replay_pipeline() {}
+
+   /**
+    * While the caller applies the batch returned here, the following batch is being hashed
+    * and the one after that is being read.
+    */
+   std::shared_ptr< vector< replay_block > > replay_pipeline::next_batch()
+   {
+      try
+      {
+         if( !my->started )
+         {
+            my->started = true;
+            my->start_read();
+            my->start_hash( my->pending_read.wait() );
+            my->start_read();
+         }
+
+         auto result = my->finish_hash();
+         if( result->empty() )
+            return result;
+
+         my->start_hash( my->pending_read.wait() );
+         my->start_read();
+
+         my->stats.elapsed = fc::time_point::now() - my->start_time;
+         return result;
+      }
+      FC_LOG_AND_RETHROW()
+   }
+
+   replay_stats& replay_pipeline::stats()
+   {
+      return my->stats;
+   }
+
+} } // wls::chain
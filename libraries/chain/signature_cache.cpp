@@ -0,0 +1,213 @@
+#include <wls/chain/signature_cache.hpp>
+
+#include <wls/protocol/exceptions.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <cstring>
+#include <mutex>
+
+namespace wls { namespace chain {
+
+   namespace detail {
+
+      using namespace boost::multi_index;
+
+      struct signature_key
+      {
+         digest_type       digest;
+         signature_type    signature;
+
+         bool operator == ( const signature_key& o )const
+         {
+            return digest == o.digest && signature == o.signature;
+         }
+      };
+
+      struct signature_key_hash
+      {
+         size_t operator()( const signature_key& k )const
+         {
+            // The r value at the start of a signature is effectively random
+            size_t h;
+            std::memcpy( &h, k.signature.begin() + 1, sizeof( h ) );
+            return h ^ std::hash< digest_type >()( k.digest );
+         }
+      };
+
+      struct recovered_key_entry
+      {
+         signature_key     key;
+         public_key_type   public_key;
+      };
+
+      struct verified_entry
+      {
+         digest_type       trx_digest;
+      };
+
+      /// Front of the sequenced index is the most recently used entry
+      typedef multi_index_container<
+         recovered_key_entry,
+         indexed_by<
+            sequenced<>,
+            hashed_unique< member< recovered_key_entry, signature_key, &recovered_key_entry::key >, signature_key_hash >
+         >
+      > recovered_key_index;
+
+      typedef multi_index_container<
+         verified_entry,
+         indexed_by<
+            sequenced<>,
+            hashed_unique< member< verified_entry, digest_type, &verified_entry::trx_digest >, std::hash< digest_type > >
+         >
+      > verified_index;
+
+      template< typename Index >
+      void trim( Index& idx, size_t max_size )
+      {
+         while( idx.size() > max_size )
+            idx.pop_back();
+      }
+
+      template< typename Index, typename Itr >
+      void touch( Index& idx, Itr itr )
+      {
+         idx.relocate( idx.begin(), idx.template project< 0 >( itr ) );
+      }
+
+      class signature_cache_impl
+      {
+         public:
+            mutable std::mutex      mutex;
+            size_t                  max_size = 0;
+            recovered_key_index     keys;
+            verified_index          verified;
+            signature_cache_stats   stats;
+      };
+   }
+
+   signature_cache::signature_cache( size_t max_size )
+      : my( new detail::signature_cache_impl() )
+   {
+      my->max_size = max_size;
+   }
+
+   signature_cache::~signature_cache() {}
+
+   void signature_cache::set_max_size( size_t max_size )
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      my->max_size = max_size;
+      detail::trim( my->keys, max_size );
+      detail::trim( my->verified, max_size );
+   }
+
+   size_t signature_cache::get_max_size()const
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      return my->max_size;
+   }
+
+   flat_set< public_key_type > signature_cache::get_signature_keys( const signed_transaction& trx, const chain_id_type& chain_id )
+   {
+      return get_signature_keys_for_digest( trx, trx.sig_digest( chain_id ) );
+   }
+
+   flat_set< public_key_type > signature_cache::get_signature_keys_for_digest( const signed_transaction& trx, const digest_type& d )
+   { try {
+      flat_set< public_key_type > result;
+
+      for( const auto& sig : trx.signatures )
+      {
+         detail::signature_key k{ d, sig };
+         optional< public_key_type > key;
+
+         {
+            std::lock_guard< std::mutex > guard( my->mutex );
+            auto& idx = my->keys.get< 1 >();
+            auto itr = idx.find( k );
+            if( itr != idx.end() )
+            {
+               key = itr->public_key;
+               detail::touch( my->keys, itr );
+               ++my->stats.key_hits;
+            }
+            else
+            {
+               ++my->stats.key_misses;
+            }
+         }
+
+         if( !key )
+         {
+            key = public_key_type( fc::ecc::public_key( sig, d ) );
+
+            std::lock_guard< std::mutex > guard( my->mutex );
+            if( my->max_size )
+            {
+               my->keys.push_front( detail::recovered_key_entry{ k, *key } );
+               detail::trim( my->keys, my->max_size );
+            }
+         }
+
+         WLS_ASSERT(
+            result.insert( *key ).second,
+            tx_duplicate_sig,
+            "Duplicate Signature detected" );
+      }
+
+      return result;
+   } FC_CAPTURE_AND_RETHROW() }
+
+   bool signature_cache::is_verified( const digest_type& trx_digest )
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      auto& idx = my->verified.get< 1 >();
+      auto itr = idx.find( trx_digest );
+      if( itr == idx.end() )
+      {
+         ++my->stats.verified_misses;
+         return false;
+      }
+
+      detail::touch( my->verified, itr );
+      ++my->stats.verified_hits;
+      return true;
+   }
+
+   void signature_cache::set_verified( const digest_type& trx_digest )
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      if( my->max_size == 0 )
+         return;
+
+      my->verified.push_front( detail::verified_entry{ trx_digest } );
+      detail::trim( my->verified, my->max_size );
+   }
+
+   void signature_cache::invalidate_verified()
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      if( my->verified.size() )
+         ++my->stats.invalidations;
+      my->verified.clear();
+   }
+
+   void signature_cache::clear()
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      my->keys.clear();
+      my->verified.clear();
+   }
+
+   signature_cache_stats signature_cache::get_stats()const
+   {
+      std::lock_guard< std::mutex > guard( my->mutex );
+      return my->stats;
+   }
+
+} } // wls::chain
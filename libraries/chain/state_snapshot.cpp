@@ -0,0 +1,251 @@
+#include <wls/chain/state_snapshot.hpp>
+#include <wls/chain/database.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <zstd.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace wls { namespace chain {
+
+   namespace detail {
+
+      const uint64_t snapshot_magic      = 0x50414e5353534c57ull;   // "WLSSSNAP"
+      const uint32_t snapshot_version    = 2;   // 2: transaction_object no longer holds the packed transaction
+      const size_t   snapshot_chunk_size = 4 * 1024 * 1024;
+      const int      snapshot_zstd_level = 3;
+
+      template< typename T >
+      void write_packed( std::ofstream& out, const T& v )
+      {
+         auto data = fc::raw::pack( v );
+         uint32_t size = data.size();
+         out.write( (const char*)&size, sizeof( size ) );
+         out.write( data.data(), data.size() );
+      }
+
+      template< typename T >
+      T read_packed( std::ifstream& in )
+      {
+         uint32_t size = 0;
+         in.read( (char*)&size, sizeof( size ) );
+         vector< char > data( size );
+         in.read( data.data(), data.size() );
+         FC_ASSERT( in.good(), "Unexpected end of snapshot file" );
+         return fc::raw::unpack< T >( data );
+      }
+
+      struct chunk_header
+      {
+         uint32_t objects = 0;
+         uint32_t size = 0;
+         uint32_t compressed_size = 0;
+      };
+
+      fc::sha256 state_digest( const vector< snapshot_index_info >& indices )
+      {
+         fc::sha256::encoder enc;
+         for( const auto& info : indices )
+         {
+            fc::raw::pack( enc, info.name );
+            fc::raw::pack( enc, info.next_id );
+            fc::raw::pack( enc, info.digest );
+         }
+         return enc.result();
+      }
+
+      snapshot_footer read_footer( std::ifstream& in )
+      {
+         uint64_t footer_pos = 0;
+         in.seekg( -int64_t( sizeof( footer_pos ) ), std::ios::end );
+         in.read( (char*)&footer_pos, sizeof( footer_pos ) );
+         in.seekg( footer_pos );
+         return read_packed< snapshot_footer >( in );
+      }
+
+      /// Rebuilds one index from its run of chunks, using its own stream so indices can load in parallel
+      void import_index( database& db, const fc::path& file, const snapshot_index_info& info, const abstract_snapshot_index& idx )
+      {
+         std::ifstream in( file.generic_string(), std::ios::in | std::ios::binary );
+         in.seekg( info.offset );
+
+         vector< char > compressed;
+         vector< char > data;
+         uint64_t objects = 0;
+
+         while( objects < info.objects )
+         {
+            chunk_header chunk;
+            in.read( (char*)&chunk, sizeof( chunk ) );
+            compressed.resize( chunk.compressed_size );
+            in.read( compressed.data(), compressed.size() );
+            FC_ASSERT( in.good(), "Unexpected end of snapshot file in ${i}", ("i", info.name) );
+
+            data.resize( chunk.size );
+            size_t size = ZSTD_decompress( data.data(), data.size(), compressed.data(), compressed.size() );
+            FC_ASSERT( !ZSTD_isError( size ) && size == chunk.size, "Corrupt snapshot chunk in ${i}", ("i", info.name) );
+
+            idx.unpack( db, chunk.objects, data.data(), data.size() );
+            objects += chunk.objects;
+         }
+
+         idx.set_next_id( db, info.next_id );
+
+         // Packing the rebuilt index again checks the objects made it through unchanged
+         auto digest = idx.pack( db, snapshot_chunk_size, []( uint32_t, const vector< char >& ) {} );
+         FC_ASSERT( digest == info.digest, "Digest of rebuilt index ${i} does not match snapshot", ("i", info.name) );
+      }
+
+   } // detail
+
+   void export_state_snapshot( const database& db, const fc::path& file )
+   {
+      FC_ASSERT( db.revision() == db.head_block_num(), "State snapshots can only be exported when there is no undo state" );
+
+      fc::path tmp_file = file.generic_string() + ".tmp";
+      std::ofstream out( tmp_file.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+
+      snapshot_header header;
+      header.magic = detail::snapshot_magic;
+      header.version = detail::snapshot_version;
+      header.chain_id = db.get_chain_id();
+      header.head_block_num = db.head_block_num();
+      header.head_block_id = db.head_block_id();
+      detail::write_packed( out, header );
+
+      snapshot_footer footer;
+      vector< char > compressed;
+
+      for( const auto& item : db.get_snapshot_indices() )
+      {
+         const auto& idx = *item.second;
+         snapshot_index_info info;
+         info.name = idx.name();
+         info.next_id = idx.next_id( db );
+         info.offset = out.tellp();
+
+         info.digest = idx.pack( db, detail::snapshot_chunk_size, [&]( uint32_t objects, const vector< char >& data )
+         {
+            compressed.resize( ZSTD_compressBound( data.size() ) );
+            size_t size = ZSTD_compress( compressed.data(), compressed.size(), data.data(), data.size(), detail::snapshot_zstd_level );
+            FC_ASSERT( !ZSTD_isError( size ), "Unable to compress snapshot chunk: ${e}", ("e", ZSTD_getErrorName( size )) );
+
+            detail::chunk_header chunk;
+            chunk.objects = objects;
+            chunk.size = data.size();
+            chunk.compressed_size = size;
+            out.write( (const char*)&chunk, sizeof( chunk ) );
+            out.write( compressed.data(), size );
+            info.objects += objects;
+         });
+
+         footer.indices.push_back( info );
+      }
+
+      footer.state_digest = detail::state_digest( footer.indices );
+
+      uint64_t footer_pos = out.tellp();
+      detail::write_packed( out, footer );
+      out.write( (const char*)&footer_pos, sizeof( footer_pos ) );
+      out.close();
+      FC_ASSERT( !out.fail(), "Unable to write snapshot file ${f}", ("f", tmp_file) );
+
+      fc::rename( tmp_file, file );
+
+      ilog( "Wrote ${n} indices at block ${b} to ${f}, state digest ${d}",
+         ("n", footer.indices.size())("b", header.head_block_num)("f", file)("d", footer.state_digest) );
+   }
+
+   snapshot_header read_state_snapshot_header( const fc::path& file )
+   {
+      std::ifstream in( file.generic_string(), std::ios::in | std::ios::binary );
+      FC_ASSERT( in.good(), "Unable to open snapshot file ${f}", ("f", file) );
+
+      auto header = detail::read_packed< snapshot_header >( in );
+      FC_ASSERT( header.magic == detail::snapshot_magic, "${f} is not a state snapshot", ("f", file) );
+      FC_ASSERT( header.version == detail::snapshot_version, "Unsupported snapshot version ${v}", ("v", header.version) );
+      return header;
+   }
+
+   snapshot_footer read_state_snapshot_footer( const fc::path& file )
+   {
+      read_state_snapshot_header( file );
+
+      std::ifstream in( file.generic_string(), std::ios::in | std::ios::binary );
+      auto footer = detail::read_footer( in );
+      FC_ASSERT( footer.state_digest == detail::state_digest( footer.indices ), "Snapshot footer is corrupt" );
+      return footer;
+   }
+
+   snapshot_header import_state_snapshot( database& db, const fc::path& file, uint32_t threads )
+   {
+      auto header = read_state_snapshot_header( file );
+      FC_ASSERT( header.chain_id == db.get_chain_id(), "Snapshot is from another chain", ("chain_id", header.chain_id) );
+
+      auto footer = read_state_snapshot_footer( file );
+
+      typedef std::pair< const snapshot_index_info*, const detail::abstract_snapshot_index* > import_task;
+      vector< import_task > work;
+      for( const auto& info : footer.indices )
+      {
+         auto itr = db.get_snapshot_indices().find( info.name );
+         if( itr == db.get_snapshot_indices().end() )
+         {
+            wlog( "Skipping ${i} in snapshot, its plugin is not enabled", ("i", info.name) );
+            continue;
+         }
+
+         FC_ASSERT( itr->second->size( db ) == 0, "Snapshots can only be imported into an empty database" );
+         work.emplace_back( &info, itr->second.get() );
+      }
+
+      for( const auto& item : db.get_snapshot_indices() )
+      {
+         auto found = std::find_if( work.begin(), work.end(), [&]( const import_task& w ) { return w.second == item.second.get(); } );
+         FC_ASSERT( found != work.end(), "Snapshot has no ${i}, was it exported with fewer plugins enabled?", ("i", item.first) );
+      }
+
+      // The largest indices are started first so they do not end up queued behind small ones
+      std::sort( work.begin(), work.end(), []( const import_task& a, const import_task& b )
+      {
+         return a.first->objects > b.first->objects;
+      });
+
+      threads = std::max< uint32_t >( threads, 1 );
+      vector< std::shared_ptr< fc::thread > > pool;
+      for( uint32_t i = 0; i < threads; ++i )
+         pool.push_back( std::make_shared< fc::thread >( "snapshot_worker_" + fc::to_string( i ) ) );
+
+      vector< fc::future< void > > futures;
+      for( size_t i = 0; i < work.size(); ++i )
+      {
+         auto w = work[i];
+         futures.push_back( pool[ i % pool.size() ]->async( [&db,&file,w]()
+         {
+            detail::import_index( db, file, *w.first, *w.second );
+         }, "import snapshot index" ) );
+      }
+
+      // Every worker must be done with the database before an error unwinds it
+      std::exception_ptr error;
+      for( auto& f : futures )
+      {
+         try { f.wait(); }
+         catch( ... ) { if( !error ) error = std::current_exception(); }
+      }
+
+      if( error )
+         std::rethrow_exception( error );
+
+      FC_ASSERT( db.head_block_num() == header.head_block_num && db.head_block_id() == header.head_block_id,
+         "Imported state is not at the snapshot head block" );
+
+      ilog( "Imported ${n} indices at block ${b}", ("n", work.size())("b", header.head_block_num) );
+
+      return header;
+   }
+
+} } // wls::chain
@@ -0,0 +1,415 @@
+#include <wls/chain/transaction_pool.hpp>
+
+#include <wls/protocol/operations.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+#include <mutex>
+#include <set>
+
+namespace wls { namespace chain {
+
+   namespace detail {
+
+      using namespace boost::multi_index;
+
+      struct pool_entry
+      {
+         transaction_id_type              id;
+         uint64_t                         sequence = 0;     ///< arrival order
+         time_point_sec                   expiration;
+         account_name_type                sender;
+         flat_set< account_name_type >    accounts;         ///< every account whose authority it requires
+         uint32_t                         packed_size = 0;
+         uint64_t                         applied_in = 0;   ///< generation of the pending state it was last applied to
+         signed_transaction               trx;
+      };
+
+      struct by_sequence;
+      struct by_expiration;
+      struct by_sender;
+
+      typedef multi_index_container<
+         pool_entry,
+         indexed_by<
+            hashed_unique< member< pool_entry, transaction_id_type, &pool_entry::id >, std::hash< transaction_id_type > >,
+            ordered_unique< tag< by_sequence >, member< pool_entry, uint64_t, &pool_entry::sequence > >,
+            ordered_non_unique< tag< by_expiration >, member< pool_entry, time_point_sec, &pool_entry::expiration > >,
+            ordered_unique< tag< by_sender >,
+               composite_key< pool_entry,
+                  member< pool_entry, account_name_type, &pool_entry::sender >,
+                  member< pool_entry, uint64_t, &pool_entry::sequence >
+               >
+            >
+         >
+      > pool_index;
+
+      struct sender_entry
+      {
+         sender_entry( const account_name_type& s ) : sender( s ) {}
+
+         account_name_type sender;
+         uint32_t          transactions = 0;
+         uint64_t          bytes = 0;
+      };
+
+      typedef multi_index_container<
+         sender_entry,
+         indexed_by<
+            ordered_unique< member< sender_entry, account_name_type, &sender_entry::sender > >,
+            ordered_non_unique< member< sender_entry, uint64_t, &sender_entry::bytes > >
+         >
+      > sender_index;
+
+      account_name_type get_sender( const signed_transaction& trx )
+      {
+         if( trx.operations.empty() )
+            return account_name_type();
+
+         flat_set< account_name_type > active, owner, posting;
+         vector< authority > other;
+         operation_get_required_authorities( trx.operations.front(), active, owner, posting, other );
+
+         if( active.size() )
+            return *active.begin();
+         if( owner.size() )
+            return *owner.begin();
+         if( posting.size() )
+            return *posting.begin();
+         if( other.size() && other.front().account_auths.size() )
+            return other.front().account_auths.begin()->first;
+         return account_name_type();
+      }
+
+      class transaction_pool_impl
+      {
+         public:
+            void erase( pool_index::iterator itr )
+            {
+               bytes -= itr->packed_size;
+               if( itr->applied_in != generation )
+                  --unapplied;
+
+               auto s = senders.find( itr->sender );
+               if( s->transactions == 1 )
+                  senders.erase( s );
+               else
+                  senders.modify( s, [&]( sender_entry& e )
+                  {
+                     --e.transactions;
+                     e.bytes -= itr->packed_size;
+                  });
+
+               entries.erase( itr );
+            }
+
+            template< typename Iterator >
+            void erase( Iterator itr )
+            {
+               erase( entries.project< 0 >( itr ) );
+            }
+
+            bool apply_entry( pool_index::iterator itr, const transaction_pool::apply_callback& apply )
+            {
+               try
+               {
+                  apply( itr->trx );
+               }
+               catch( const fc::exception& )
+               {
+                  return false;
+               }
+
+               entries.modify( itr, [&]( pool_entry& e ) { e.applied_in = generation; } );
+               --unapplied;
+               ++stats.revalidated;
+               return true;
+            }
+
+            void apply_unapplied( const transaction_pool::apply_callback& apply )
+            {
+               auto& by_sequence_idx = entries.get< by_sequence >();
+               for( auto itr = by_sequence_idx.begin(); unapplied > 0 && itr != by_sequence_idx.end(); )
+               {
+                  auto next = std::next( itr );
+                  if( itr->applied_in != generation )
+                  {
+                     auto entry = entries.project< 0 >( itr );
+                     if( !apply_entry( entry, apply ) )
+                     {
+                        erase( entry );
+                        ++stats.invalidated;
+                     }
+                  }
+                  itr = next;
+               }
+            }
+
+            bool touches_changed( const pool_entry& e )const
+            {
+               if( all_changed )
+                  return true;
+
+               for( const auto& a : e.accounts )
+                  if( changed.count( a ) )
+                     return true;
+
+               return false;
+            }
+
+            mutable std::recursive_mutex              mutex;
+            size_t                                    max_transactions = 0;
+            size_t                                    max_bytes = 0;
+            uint32_t                                  max_per_sender = 0;
+
+            pool_index                                entries;
+            sender_index                              senders;
+            size_t                                    bytes = 0;
+            uint64_t                                  next_sequence = 0;
+            uint64_t                                  generation = 1;
+            size_t                                    unapplied = 0;
+
+            std::set< account_name_type >             changed;
+            bool                                      all_changed = false;
+
+            mutable transaction_pool_stats            stats;
+      };
+   }
+
+   transaction_pool::transaction_pool( size_t max_transactions, size_t max_bytes, uint32_t max_per_sender )
+      : my( new detail::transaction_pool_impl() )
+   {
+      set_limits( max_transactions, max_bytes, max_per_sender );
+   }
+
+   transaction_pool::~transaction_pool() {}
+
+   void transaction_pool::set_limits( size_t max_transactions, size_t max_bytes, uint32_t max_per_sender )
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      my->max_transactions = max_transactions;
+      my->max_bytes = max_bytes;
+      my->max_per_sender = max_per_sender;
+   }
+
+   size_t transaction_pool::size()const
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      return my->entries.size();
+   }
+
+   bool transaction_pool::empty()const
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      return my->entries.empty();
+   }
+
+   bool transaction_pool::contains( const transaction_id_type& id )const
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      return my->entries.find( id ) != my->entries.end();
+   }
+
+   void transaction_pool::check_sender( const signed_transaction& trx )const
+   {
+      auto sender = detail::get_sender( trx );
+
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      auto itr = my->senders.find( sender );
+      bool full = itr != my->senders.end() && itr->transactions >= my->max_per_sender;
+      if( full )
+         ++my->stats.rejected;
+      FC_ASSERT( !full, "Too many pending transactions from ${a}", ("a",sender)("max",my->max_per_sender) );
+   }
+
+   void transaction_pool::add( const signed_transaction& trx, const transaction_id_type& id )
+   {
+      detail::pool_entry entry;
+      entry.id = id;
+      entry.expiration = trx.expiration;
+      entry.sender = detail::get_sender( trx );
+      entry.packed_size = fc::raw::pack_size( trx );
+      entry.trx = trx;
+
+      flat_set< account_name_type > owner, posting;
+      vector< authority > other;
+      trx.get_required_authorities( entry.accounts, owner, posting, other );
+      entry.accounts.insert( owner.begin(), owner.end() );
+      entry.accounts.insert( posting.begin(), posting.end() );
+
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      entry.sequence = my->next_sequence++;
+      entry.applied_in = my->generation;
+
+      auto sender = entry.sender;
+      auto size = entry.packed_size;
+      FC_ASSERT( my->entries.insert( std::move( entry ) ).second, "Transaction is already pending", ("id",id) );
+
+      auto s = my->senders.find( sender );
+      if( s == my->senders.end() )
+         s = my->senders.insert( detail::sender_entry{ sender } ).first;
+      my->senders.modify( s, [&]( detail::sender_entry& e )
+      {
+         ++e.transactions;
+         e.bytes += size;
+      });
+      my->bytes += size;
+      ++my->stats.added;
+
+      while( my->entries.size() > my->max_transactions || my->bytes > my->max_bytes )
+      {
+         // the newest transaction of the sender holding the most bytes
+         const auto& largest = *my->senders.get< 1 >().rbegin();
+         auto& by_sender = my->entries.get< detail::by_sender >();
+         auto victim = std::prev( by_sender.upper_bound( boost::make_tuple( largest.sender ) ) );
+
+         bool self = victim->id == id;
+         my->erase( victim );
+
+         if( self )
+         {
+            --my->stats.added;
+            ++my->stats.rejected;
+         }
+         else
+         {
+            ++my->stats.evicted;
+         }
+         FC_ASSERT( !self, "Transaction pool is full", ("sender",sender)("transactions",my->entries.size())("bytes",my->bytes) );
+      }
+   }
+
+   void transaction_pool::remove( const transaction_id_type& id )
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      auto itr = my->entries.find( id );
+      if( itr == my->entries.end() )
+         return;
+
+      my->erase( itr );
+      ++my->stats.invalidated;
+   }
+
+   void transaction_pool::clear()
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      my->entries.clear();
+      my->senders.clear();
+      my->bytes = 0;
+      my->unapplied = 0;
+      my->changed.clear();
+      my->all_changed = false;
+   }
+
+   void transaction_pool::for_each( const apply_callback& f )const
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      for( const auto& e : my->entries.get< detail::by_sequence >() )
+         f( e.trx );
+   }
+
+   void transaction_pool::state_popped()
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      ++my->generation;
+      my->unapplied = my->entries.size();
+   }
+
+   void transaction_pool::apply_unapplied( const apply_callback& apply )
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      my->apply_unapplied( apply );
+   }
+
+   size_t transaction_pool::unapplied()const
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      return my->unapplied;
+   }
+
+   void transaction_pool::account_changed( const account_name_type& name )
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      if( my->entries.size() && !my->all_changed )
+         my->changed.insert( name );
+   }
+
+   void transaction_pool::all_changed()
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      my->all_changed = true;
+      my->changed.clear();
+   }
+
+   void transaction_pool::remove_stale( time_point_sec now, const std::function< bool( const transaction_id_type& ) >& is_known )
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+
+      auto& by_expiration = my->entries.get< detail::by_expiration >();
+      while( by_expiration.size() && by_expiration.begin()->expiration <= now )
+      {
+         my->erase( by_expiration.begin() );
+         ++my->stats.expired;
+      }
+
+      auto& by_sequence = my->entries.get< detail::by_sequence >();
+      for( auto itr = by_sequence.begin(); itr != by_sequence.end(); )
+      {
+         auto next = std::next( itr );
+         if( is_known( itr->id ) )
+         {
+            my->erase( itr );
+            ++my->stats.included;
+         }
+         itr = next;
+      }
+   }
+
+   void transaction_pool::revalidate( const apply_callback& apply )
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+
+      vector< uint64_t > changed;
+      for( const auto& e : my->entries.get< detail::by_sequence >() )
+         if( e.applied_in != my->generation && my->touches_changed( e ) )
+            changed.push_back( e.sequence );
+
+      my->changed.clear();
+      my->all_changed = false;
+
+      auto& by_sequence = my->entries.get< detail::by_sequence >();
+      for( auto sequence : changed )
+      {
+         auto itr = by_sequence.find( sequence );
+         if( itr == by_sequence.end() || itr->applied_in == my->generation )
+            continue;
+
+         // It may build on a transaction that was kept, which is applied before trying it again
+         if( !my->apply_entry( my->entries.project< 0 >( itr ), apply ) )
+            my->apply_unapplied( apply );
+      }
+
+      my->stats.kept += my->unapplied;
+   }
+
+   transaction_pool_stats transaction_pool::get_stats()const
+   {
+      std::lock_guard< std::recursive_mutex > guard( my->mutex );
+      auto stats = my->stats;
+      stats.transactions = my->entries.size();
+      stats.bytes = my->bytes;
+      stats.senders = my->senders.size();
+      stats.unapplied = my->unapplied;
+      stats.max_transactions = my->max_transactions;
+      stats.max_bytes = my->max_bytes;
+      stats.max_per_sender = my->max_per_sender;
+      return stats;
+   }
+
+} } // wls::chain
@@ -391,7 +391,7 @@ void comment_evaluator::do_apply( const comment_operation& o )
 { try {
    FC_ASSERT( o.title.size() + o.body.size() + o.json_metadata.size(), "Cannot update comment because nothing appears to be changing." );
 
-   const auto& by_permlink_idx = _db.get_index< comment_index >().indices().get< by_permlink >();
+   const auto& by_permlink_idx = _db.get_index< comment_index >().indices().get< by_permlink_hash >();
    auto itr = by_permlink_idx.find( boost::make_tuple( o.author, o.permlink ) );
 
    const auto& auth = _db.get_account( o.author ); /// prove it exists
@@ -5,7 +5,9 @@
 #include <boost/interprocess/containers/set.hpp>
 #include <boost/interprocess/containers/flat_map.hpp>
 #include <boost/interprocess/containers/deque.hpp>
+#include <boost/interprocess/containers/list.hpp>
 #include <boost/interprocess/containers/string.hpp>
+#include <boost/interprocess/containers/vector.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/interprocess/sync/interprocess_sharable_mutex.hpp>
 #include <boost/interprocess/sync/sharable_lock.hpp>
@@ -16,15 +18,20 @@
 #include <boost/chrono.hpp>
 #include <boost/config.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/thread.hpp>
 #include <boost/throw_exception.hpp>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <list>
 #include <stdexcept>
+#include <type_traits>
 #include <typeindex>
 #include <typeinfo>
 
@@ -32,6 +39,10 @@
    #define CHAINBASE_NUM_RW_LOCKS 10
 #endif
 
+#ifndef CHAINBASE_UNDO_JOURNAL_CHUNK_SIZE
+   #define CHAINBASE_UNDO_JOURNAL_CHUNK_SIZE (64*1024)
+#endif
+
 #ifdef CHAINBASE_CHECK_LOCKING
    #define CHAINBASE_REQUIRE_READ_LOCK(m, t) require_read_lock(m, typeid(t).name())
    #define CHAINBASE_REQUIRE_WRITE_LOCK(m, t) require_write_lock(m, typeid(t).name())
@@ -78,10 +89,43 @@ namespace chainbase {
          }
    };
 
+   /**
+    * Hash and equality matching strcmp_less, for hashed_unique indices keyed on a shared_string.
+    * Lookups can pass a std::string without copying it into the segment.
+    */
+   struct strcmp_hash
+   {
+      std::size_t operator()( const shared_string& s )const { return hash( s.c_str() ); }
+      std::size_t operator()( const std::string& s )const { return hash( s.c_str() ); }
+
+      private:
+         inline std::size_t hash( const char* s )const
+         {
+            return boost::hash_range( s, s + std::strlen( s ) );
+         }
+   };
+
+   struct strcmp_equal_to
+   {
+      bool operator()( const shared_string& a, const shared_string& b )const { return std::strcmp( a.c_str(), b.c_str() ) == 0; }
+      bool operator()( const shared_string& a, const std::string& b )const { return std::strcmp( a.c_str(), b.c_str() ) == 0; }
+      bool operator()( const std::string& a, const shared_string& b )const { return std::strcmp( a.c_str(), b.c_str() ) == 0; }
+   };
+
    typedef boost::interprocess::interprocess_sharable_mutex read_write_mutex;
    typedef boost::interprocess::sharable_lock< read_write_mutex > read_lock;
    typedef boost::unique_lock< read_write_mutex > write_lock;
 
+   /**
+    *  Thrown out of index accessors inside database::with_preemptible_read_lock when a writer
+    *  is waiting for the lock.
+    */
+   class read_preempted : public std::runtime_error
+   {
+      public:
+         read_preempted() : std::runtime_error( "read preempted by a waiting writer" ) {}
+   };
+
    /**
     *  Object ID type that includes the type of the object it references
     */
@@ -96,6 +140,10 @@ namespace chainbase {
          friend bool operator > ( const oid& a, const oid& b ) { return a._id > b._id; }
          friend bool operator == ( const oid& a, const oid& b ) { return a._id == b._id; }
          friend bool operator != ( const oid& a, const oid& b ) { return a._id != b._id; }
+
+         /// Found by boost::hash, so ids can key hashed containers
+         friend std::size_t hash_value( const oid& o ) { return boost::hash< int64_t >()( o._id ); }
+
          int64_t _id = 0;
    };
 
@@ -123,6 +171,125 @@ namespace chainbase {
    template<typename Constructor, typename Allocator> \
    OBJECT_TYPE( Constructor&& c, Allocator&&  ) { c(*this); }
 
+   /**
+    *  Lets generic_index keep the undo state of OBJECT_TYPE in an undo_journal. CODEC_TYPE must provide
+    *
+    *     static void pack( std::vector< char >& out, const OBJECT_TYPE& v );
+    *     static void unpack( OBJECT_TYPE& v, const char* data, size_t size );
+    *
+    *  where unpack overwrites every member of v, including the id, with the values that were packed.
+    *  This macro must be used at global scope and OBJECT_TYPE and CODEC_TYPE must be fully qualified
+    */
+   #define CHAINBASE_SET_UNDO_JOURNAL_CODEC( OBJECT_TYPE, CODEC_TYPE ) \
+   namespace chainbase { template<> struct undo_journal_codec<OBJECT_TYPE> { typedef CODEC_TYPE type; }; }
+
+   template<typename T>
+   struct undo_journal_codec { typedef void type; };
+
+   /**
+    *  Append-only log of the changes made to an index during one undo revision.
+    *
+    *  Each record is either the id of a created object or the packed image of an object before its
+    *  first change in the revision, followed by a fixed size trailer so the log can be read back to
+    *  front. Records are appended to a list of chunks that is spliced onto the previous revision on
+    *  squash and freed a chunk at a time on commit.
+    */
+   class undo_journal
+   {
+      public:
+         enum record_type : uint8_t
+         {
+            created,
+            before_image
+         };
+
+         typedef bip::vector< char, allocator< char > >              chunk_type;
+         typedef bip::list< chunk_type, allocator< chunk_type > >    chunk_list;
+
+         template<typename T>
+         undo_journal( allocator<T> al )
+         :_chunks( allocator< chunk_type >( al.get_segment_manager() ) ){}
+
+         void append( record_type type, int64_t id, const char* data = nullptr, uint32_t size = 0 )
+         {
+            size_t needed = size + sizeof( trailer );
+
+            if( _chunks.empty() || _chunks.back().capacity() - _chunks.back().size() < needed )
+            {
+               // Chunks start small, since most revisions only touch a few objects, and double up to the limit
+               size_t capacity = _chunks.empty() ? 1024 : std::min< size_t >( _chunks.back().capacity() * 2, CHAINBASE_UNDO_JOURNAL_CHUNK_SIZE );
+               _chunks.emplace_back( _chunks.get_allocator() );
+               _chunks.back().reserve( std::max( capacity, needed ) );
+            }
+
+            trailer t;
+            t.id = id;
+            t.size = size;
+            t.type = type;
+
+            auto& chunk = _chunks.back();
+            chunk.insert( chunk.end(), data, data + size );
+            chunk.insert( chunk.end(), (const char*)&t, (const char*)&t + sizeof( t ) );
+            _size += needed;
+         }
+
+         /**
+          *  Calls visitor( record_type, id, data, size ) on every record, newest first
+          */
+         template<typename Visitor>
+         void replay( Visitor&& visitor )const
+         {
+            for( auto chunk = _chunks.rbegin(); chunk != _chunks.rend(); ++chunk )
+            {
+               size_t pos = chunk->size();
+               while( pos > 0 )
+               {
+                  trailer t;
+                  pos -= sizeof( t );
+                  std::memcpy( &t, chunk->data() + pos, sizeof( t ) );
+                  pos -= t.size;
+                  visitor( record_type( t.type ), t.id, chunk->data() + pos, t.size );
+               }
+            }
+         }
+
+         /**
+          *  Moves the records of other after the records of this journal. Small journals are copied into
+          *  the free space of the last chunk rather than spliced, so squashing many small revisions does
+          *  not leave behind a long list of small chunks.
+          */
+         void splice( undo_journal& other )
+         {
+            if( !_chunks.empty() && other._size <= _chunks.back().capacity() - _chunks.back().size() )
+            {
+               for( const auto& chunk : other._chunks )
+                  _chunks.back().insert( _chunks.back().end(), chunk.begin(), chunk.end() );
+               other._chunks.clear();
+            }
+            else
+            {
+               _chunks.splice( _chunks.end(), other._chunks );
+            }
+
+            _size += other._size;
+            other._size = 0;
+         }
+
+         /** bytes of records in the journal */
+         size_t size()const { return _size; }
+
+      private:
+         struct trailer
+         {
+            int64_t     id;
+            uint32_t    size;
+            uint8_t     type;
+         };
+
+         chunk_list  _chunks;
+         size_t      _size = 0;
+   };
+
    template< typename value_type >
    class undo_state
    {
@@ -135,7 +302,9 @@ namespace chainbase {
          undo_state( allocator<T> al )
          :old_values( id_value_allocator_type( al.get_segment_manager() ) ),
           removed_values( id_value_allocator_type( al.get_segment_manager() ) ),
-          new_ids( id_allocator_type( al.get_segment_manager() ) ){}
+          new_ids( id_allocator_type( al.get_segment_manager() ) ),
+          journal( al ),
+          journaled_ids( id_allocator_type( al.get_segment_manager() ) ){}
 
          typedef boost::interprocess::map< id_type, value_type, std::less<id_type>, id_value_allocator_type >  id_value_type_map;
          typedef boost::interprocess::set< id_type, std::less<id_type>, id_allocator_type >                    id_type_set;
@@ -145,6 +314,10 @@ namespace chainbase {
          id_type_set                  new_ids;
          id_type                      old_next_id = 0;
          int64_t                      revision = 0;
+
+         /** used instead of the maps above when the index keeps an undo journal */
+         undo_journal                 journal;
+         id_type_set                  journaled_ids;   ///< objects that already have a record in journal
    };
 
    /**
@@ -185,6 +358,8 @@ namespace chainbase {
          typedef typename index_type::value_type                       value_type;
          typedef bip::allocator< generic_index, segment_manager_type > allocator_type;
          typedef undo_state< value_type >                              undo_state_type;
+         typedef typename undo_journal_codec< value_type >::type       journal_codec;
+         typedef std::integral_constant< bool, !std::is_void< journal_codec >::value > has_journal_codec;
 
          generic_index( allocator<value_type> a )
          :_stack(a),_indices( a ),_size_of_value_type( sizeof(typename MultiIndexType::node_type) ),_size_of_this(sizeof(*this)){}
@@ -309,6 +484,11 @@ namespace chainbase {
          void undo() {
             if( !enabled() ) return;
 
+            if( _undo_journal ) {
+               undo_journal_head( has_journal_codec() );
+               return;
+            }
+
             const auto& head = _stack.back();
 
             for( auto& item : head.old_values ) {
@@ -350,6 +530,20 @@ namespace chainbase {
             auto& state = _stack.back();
             auto& prev_state = _stack[_stack.size()-2];
 
+            if( _undo_journal ) {
+               // Replaying both journals newest first undoes both revisions, so they can simply be concatenated
+               prev_state.journal.splice( state.journal );
+
+               if( prev_state.journaled_ids.empty() )
+                  prev_state.journaled_ids.swap( state.journaled_ids );
+               else
+                  prev_state.journaled_ids.insert( state.journaled_ids.begin(), state.journaled_ids.end() );
+
+               _stack.pop_back();
+               --_revision;
+               return;
+            }
+
             // An object's relationship to a state can be:
             // in new_ids            : new
             // in old_values (was=X) : upd(was=X)
@@ -467,6 +661,30 @@ namespace chainbase {
             _revision = revision;
          }
 
+         /**
+          *  Keeps undo state as an undo_journal of packed before-images instead of copies of the objects.
+          *  Only takes effect when the value_type has an undo_journal_codec, returns whether it did.
+          */
+         bool set_undo_journal( bool enable )
+         {
+            enable = enable && has_journal_codec::value;
+            if( enable == _undo_journal ) return enable;
+            if( _stack.size() != 0 ) BOOST_THROW_EXCEPTION( std::logic_error("cannot change undo backend while there is an existing undo stack") );
+            _undo_journal = enable;
+            return enable;
+         }
+
+         bool undo_journal_enabled()const { return _undo_journal; }
+
+         typename value_type::id_type next_id()const { return _next_id; }
+
+         /** Used when objects are loaded with their ids from elsewhere, such as a state snapshot */
+         void set_next_id( typename value_type::id_type next_id )
+         {
+            if( _stack.size() != 0 ) BOOST_THROW_EXCEPTION( std::logic_error("cannot set next id while there is an existing undo stack") );
+            _next_id = next_id;
+         }
+
          void remove_object( int64_t id )
          {
             const value_type* val = find( typename value_type::id_type(id) );
@@ -480,6 +698,11 @@ namespace chainbase {
          void on_modify( const value_type& v ) {
             if( !enabled() ) return;
 
+            if( _undo_journal ) {
+               journal_before_image( v, has_journal_codec() );
+               return;
+            }
+
             auto& head = _stack.back();
 
             if( head.new_ids.find( v.id ) != head.new_ids.end() )
@@ -495,6 +718,11 @@ namespace chainbase {
          void on_remove( const value_type& v ) {
             if( !enabled() ) return;
 
+            if( _undo_journal ) {
+               journal_before_image( v, has_journal_codec() );
+               return;
+            }
+
             auto& head = _stack.back();
             if( head.new_ids.count(v.id) ) {
                head.new_ids.erase( v.id );
@@ -518,9 +746,62 @@ namespace chainbase {
             if( !enabled() ) return;
             auto& head = _stack.back();
 
+            if( _undo_journal ) {
+               head.journal.append( undo_journal::created, v.id._id );
+               head.journaled_ids.insert( v.id );
+               return;
+            }
+
             head.new_ids.insert( v.id );
          }
 
+         /**
+          *  Only the first change to an object in a revision is recorded. Whether the object was created
+          *  or existed before, replaying that record restores it to its state at the start of the revision.
+          */
+         void journal_before_image( const value_type& v, std::true_type ) {
+            auto& head = _stack.back();
+            if( !head.journaled_ids.insert( v.id ).second )
+               return;
+
+            std::vector< char > image;
+            journal_codec::pack( image, v );
+            head.journal.append( undo_journal::before_image, v.id._id, image.data(), image.size() );
+         }
+
+         void journal_before_image( const value_type&, std::false_type ) {}
+
+         void undo_journal_head( std::true_type ) {
+            const auto& head = _stack.back();
+
+            head.journal.replay( [&]( undo_journal::record_type type, int64_t id, const char* data, uint32_t size ) {
+               auto itr = _indices.find( typename value_type::id_type( id ) );
+
+               if( type == undo_journal::created ) {
+                  // Objects created and removed in the same revision are already gone
+                  if( itr != _indices.end() )
+                     _indices.erase( itr );
+               } else if( itr != _indices.end() ) {
+                  auto ok = _indices.modify( itr, [&]( value_type& v ) {
+                     journal_codec::unpack( v, data, size );
+                  });
+                  if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
+               } else {
+                  auto constructor = [&]( value_type& v ) {
+                     journal_codec::unpack( v, data, size );
+                  };
+                  bool ok = _indices.emplace( constructor, _indices.get_allocator() ).second;
+                  if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not restore object, most likely a uniqueness constraint was violated" ) );
+               }
+            });
+
+            _next_id = head.old_next_id;
+            _stack.pop_back();
+            --_revision;
+         }
+
+         void undo_journal_head( std::false_type ) {}
+
          boost::interprocess::deque< undo_state_type, allocator<undo_state_type> > _stack;
 
          /**
@@ -534,6 +815,7 @@ namespace chainbase {
          index_type                      _indices;
          uint32_t                        _size_of_value_type = 0;
          uint32_t                        _size_of_this = 0;
+         bool                            _undo_journal = false;
    };
 
    class abstract_session {
@@ -581,6 +863,7 @@ namespace chainbase {
          virtual void    squash()const = 0;
          virtual void    commit( int64_t revision )const = 0;
          virtual void    undo_all()const = 0;
+         virtual bool    set_undo_journal( bool enable ) = 0;
          virtual uint32_t type_id()const  = 0;
 
          virtual void remove_object( int64_t id ) = 0;
@@ -608,6 +891,7 @@ namespace chainbase {
          virtual void     squash()const  override { _base.squash(); }
          virtual void     commit( int64_t revision )const  override { _base.commit(revision); }
          virtual void     undo_all() const override {_base.undo_all(); }
+         virtual bool     set_undo_journal( bool enable ) override { return _base.set_undo_journal( enable ); }
          virtual uint32_t type_id()const override { return BaseIndex::value_type::type_id; }
 
          virtual void     remove_object( int64_t id ) override { return _base.remove_object( id ); }
@@ -747,6 +1031,16 @@ namespace chainbase {
              for( auto i : _index_list ) i->set_revision( revision );
          }
 
+         /**
+          *  Switches the indices that have an undo_journal_codec between undo journals and the default
+          *  undo maps. Requires an empty undo stack, so call it after adding the indices and undo_all().
+          */
+         void set_undo_journal( bool enable )
+         {
+             CHAINBASE_REQUIRE_WRITE_LOCK( "set_undo_journal", bool );
+             for( auto i : _index_list ) i->set_undo_journal( enable );
+         }
+
 
          template<typename MultiIndexType>
          void add_index() {
@@ -799,6 +1093,7 @@ namespace chainbase {
          const generic_index<MultiIndexType>& get_index()const
          {
             CHAINBASE_REQUIRE_READ_LOCK("get_index", typename MultiIndexType::value_type);
+            check_read_preempted();
             typedef generic_index<MultiIndexType> index_type;
             typedef index_type*                   index_type_ptr;
 
@@ -829,6 +1124,7 @@ namespace chainbase {
          auto get_index()const -> decltype( ((generic_index<MultiIndexType>*)( nullptr ))->indicies().template get<ByIndex>() )
          {
             CHAINBASE_REQUIRE_READ_LOCK("get_index", typename MultiIndexType::value_type);
+            check_read_preempted();
             typedef generic_index<MultiIndexType> index_type;
             typedef index_type*                   index_type_ptr;
 
@@ -924,6 +1220,10 @@ namespace chainbase {
          template< typename Lambda >
          auto with_read_lock( Lambda&& callback, uint64_t wait_micro = 1000000 ) -> decltype( (*(Lambda*)nullptr)() )
          {
+            // Nested inside with_preemptible_read_lock in this task, which already holds the lock
+            if( find_read_state() )
+               return callback();
+
             read_lock lock( _rw_manager->current_lock(), bip::defer_lock_type() );
 #ifdef CHAINBASE_CHECK_LOCKING
             BOOST_ATTRIBUTE_UNUSED
@@ -955,23 +1255,90 @@ namespace chainbase {
             int_incrementer ii( _write_lock_count );
 #endif
 
-            if( !wait_micro )
-            {
-               lock.lock();
-            }
-            else
             {
-               while( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
+               write_waiter waiter( _write_waiters );
+
+               if( !wait_micro )
                {
-                  _rw_manager->next_lock();
-                  std::cerr << "Lock timeout, moving to lock " << _rw_manager->current_lock_num() << std::endl;
-                  lock = write_lock( _rw_manager->current_lock(), boost::defer_lock_t() );
+                  lock.lock();
+               }
+               else
+               {
+                  while( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
+                  {
+                     _rw_manager->next_lock();
+                     std::cerr << "Lock timeout, moving to lock " << _rw_manager->current_lock_num() << std::endl;
+                     lock = write_lock( _rw_manager->current_lock(), boost::defer_lock_t() );
+                  }
                }
             }
 
             return callback();
          }
 
+         /**
+          *  Runs callback under a read lock that a writer does not have to wait out.
+          *
+          *  While a writer is waiting for the lock, every index access made by callback throws
+          *  read_preempted, so the read lock is released at the next access instead of when the
+          *  call completes. Once the writer is done, callback is run again from the start against
+          *  the new state. A result is only returned from a run that no writer interrupted, so it
+          *  is always consistent with a single state of the database.
+          *
+          *  Because it may be run more than once, callback must not have side effects outside of
+          *  its result. After max_retries preemptions it is run under a plain read lock.
+          *
+          *  Only get_index, and the get and find calls made through it, check for a waiting writer.
+          *  A loop that walks an index it already holds must call check_preempt() itself, or the
+          *  writer waits until the loop ends.
+          */
+         template< typename Lambda >
+         auto with_preemptible_read_lock( Lambda&& callback, uint32_t max_retries = 3, uint64_t wait_micro = 1000000 ) -> decltype( (*(Lambda*)nullptr)() )
+         {
+            typedef decltype( (*(Lambda*)nullptr)() ) result_type;
+
+            // Nested reads are restarted along with the outermost one
+            if( find_read_state() )
+               return callback();
+
+            for( uint32_t attempt = 0; ; ++attempt )
+            {
+               bool preempted = false;
+
+               try
+               {
+                  return with_read_lock( [&]() -> result_type
+                  {
+                     read_state_scope scope( this, attempt < max_retries, preempted );
+                     return call_unless_preempted( callback, std::is_void< result_type >() );
+                  }, wait_micro );
+               }
+               catch( ... )
+               {
+                  // The callback may have caught and wrapped read_preempted, so rely on the flag
+                  if( !preempted )
+                     throw;
+               }
+
+               ++_read_preemptions;
+            }
+         }
+
+         /// Number of times a preemptible read has been restarted to let a writer in
+         uint64_t get_read_preemptions()const { return _read_preemptions.load(); }
+
+         /// Gives way to a waiting writer as index accesses do, for loops over an index already fetched
+         void check_preempt()const { check_read_preempted(); }
+
+         /**
+          *  Returns a key for the task running on the current thread. A preemptible read is only
+          *  seen by reads made in the task that started it, so a task that runs while another one
+          *  yields inside its callback still locks for itself and is never preempted in its place.
+          *  Without one, all reads made on a thread are treated as the same task.
+          */
+         typedef const void* (*task_key_function)();
+         static void set_task_key_function( task_key_function f ) { task_key() = f; }
+
          template< typename IndexExtensionType, typename Lambda >
          void for_each_index_extension( Lambda&& callback )const
          {
@@ -988,6 +1355,118 @@ namespace chainbase {
          }
 
       private:
+         /// A preemptible read in progress on the current thread
+         struct read_state
+         {
+            const database*   db = nullptr;
+            const void*       task = nullptr;
+            bool              preemptible = false;
+            bool              preempted = false;
+         };
+
+         static task_key_function& task_key()
+         {
+            static task_key_function f = nullptr;
+            return f;
+         }
+
+         static const void* current_task_key()
+         {
+            auto f = task_key();
+            return f ? f() : nullptr;
+         }
+
+         /// Tasks sharing a thread interleave, so each read is found by its task rather than by nesting
+         static std::list< read_state >& thread_read_states()
+         {
+            static thread_local std::list< read_state > states;
+            return states;
+         }
+
+         /// The preemptible read of this database held by the current task, if any
+         read_state* find_read_state()const
+         {
+            auto& states = thread_read_states();
+            if( BOOST_LIKELY( states.empty() ) )
+               return nullptr;
+
+            const void* task = current_task_key();
+            for( auto& state : states )
+               if( state.db == this && state.task == task )
+                  return &state;
+            return nullptr;
+         }
+
+         class read_state_scope
+         {
+            public:
+               read_state_scope( const database* db, bool preemptible, bool& preempted )
+                  : _preempted( preempted )
+               {
+                  read_state state;
+                  state.db = db;
+                  state.task = current_task_key();
+                  state.preemptible = preemptible;
+                  auto& states = thread_read_states();
+                  _state = states.insert( states.end(), state );
+               }
+
+               ~read_state_scope()
+               {
+                  _preempted = _state->preempted;
+                  thread_read_states().erase( _state );
+               }
+
+            private:
+               std::list< read_state >::iterator   _state;
+               bool&                               _preempted;
+         };
+
+         class write_waiter
+         {
+            public:
+               write_waiter( std::atomic< uint32_t >& waiters ) : _waiters( waiters ) { ++_waiters; }
+               ~write_waiter() { --_waiters; }
+
+            private:
+               std::atomic< uint32_t >& _waiters;
+         };
+
+         void check_read_preempted()const
+         {
+            if( BOOST_LIKELY( _write_waiters.load( std::memory_order_relaxed ) == 0 ) )
+               return;
+
+            auto state = find_read_state();
+            if( state && state->preemptible )
+            {
+               state->preempted = true;
+               BOOST_THROW_EXCEPTION( read_preempted() );
+            }
+         }
+
+         void throw_if_preempted()const
+         {
+            auto state = find_read_state();
+            if( state && state->preempted )
+               BOOST_THROW_EXCEPTION( read_preempted() );
+         }
+
+         template< typename Lambda >
+         auto call_unless_preempted( Lambda& callback, std::false_type ) -> decltype( callback() )
+         {
+            auto result = callback();
+            throw_if_preempted();
+            return result;
+         }
+
+         template< typename Lambda >
+         void call_unless_preempted( Lambda& callback, std::true_type )
+         {
+            callback();
+            throw_if_preempted();
+         }
+
          unique_ptr<bip::managed_mapped_file>                        _segment;
          unique_ptr<bip::managed_mapped_file>                        _meta;
          read_write_mutex_manager*                                   _rw_manager = nullptr;
@@ -1008,6 +1487,9 @@ namespace chainbase {
 
          int32_t                                                     _read_lock_count = 0;
          int32_t                                                     _write_lock_count = 0;
+
+         std::atomic< uint32_t >                                     _write_waiters{ 0 };
+         std::atomic< uint64_t >                                     _read_preemptions{ 0 };
          bool                                                        _enable_require_locking = false;
    };
 
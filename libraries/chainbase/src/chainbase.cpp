@@ -117,6 +117,9 @@ namespace chainbase {
       _segment.reset();
       _meta.reset();
       _data_dir = bfs::path();
+      // The indices lived in the segment, so they have to be added again if the database is reopened
+      _index_list.clear();
+      _index_map.clear();
    }
 
    void database::wipe( const bfs::path& dir )
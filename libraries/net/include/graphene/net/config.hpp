@@ -57,6 +57,15 @@
 
 #define GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
 
+/**
+ * stcp_socket reads and decrypts up to this many bytes per socket read and
+ * encrypts up to this many bytes per socket write.  peer_connection packs
+ * queued messages into writes of up to GRAPHENE_NET_MAX_SEND_BATCH_SIZE.
+ */
+#define GRAPHENE_NET_STCP_READ_BUFFER_SIZE                   (64 * 1024)
+#define GRAPHENE_NET_STCP_WRITE_BUFFER_SIZE                  (256 * 1024)
+#define GRAPHENE_NET_MAX_SEND_BATCH_SIZE                     (1024 * 1024)
+
 /**
  * When we receive a message from the network, we advertise it to
  * our peers and save a copy in a cache were we will find it if
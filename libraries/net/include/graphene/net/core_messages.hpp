@@ -37,6 +37,7 @@
 #include <fc/io/enum_type.hpp>
 
 
+#include <cstring>
 #include <vector>
 
 namespace graphene { namespace net {
@@ -44,6 +45,7 @@ namespace graphene { namespace net {
   using wls::protocol::block_id_type;
   using wls::protocol::transaction_id_type;
   using wls::protocol::signed_block;
+  using wls::protocol::signed_block_header;
 
   typedef fc::ecc::public_key_data node_id_t;
   typedef fc::ripemd160 item_hash_t;
@@ -86,6 +88,9 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compact_block_message_type                   = 5018,
+    fetch_compact_block_transactions_message_type = 5019,
+    compact_block_transactions_message_type      = 5020,
     core_message_type_last                       = 5099
   };
 
@@ -115,6 +120,56 @@ namespace graphene { namespace net {
 
    };
 
+  /// First 8 bytes of a transaction id, identifying a transaction within a compact block
+  inline uint64_t compact_short_id( const transaction_id_type& id )
+  {
+    uint64_t short_id;
+    memcpy( &short_id, id._hash, sizeof( short_id ) );
+    return short_id;
+  }
+
+  /**
+   * Sent instead of a block_message to peers that advertised "compact_blocks" in their hello
+   * user data. The receiver looks the transactions up in its message cache by short id and
+   * asks for the ones it does not have with fetch_compact_block_transactions_message. The
+   * rebuilt block must hash to the message the receiver requested, so a short id collision
+   * only costs a round trip.
+   */
+  struct compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    compact_block_message() {}
+    compact_block_message( const signed_block& blk, const block_id_type& id ) :
+      header( blk ),
+      block_id( id )
+    {
+      short_ids.reserve( blk.transactions.size() );
+      for( const auto& trx : blk.transactions )
+        short_ids.push_back( compact_short_id( trx.id() ) );
+    }
+
+    signed_block_header    header;
+    block_id_type          block_id;
+    std::vector<uint64_t>  short_ids;
+  };
+
+  struct fetch_compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type          block_id;
+    std::vector<uint32_t>  indexes;     ///< positions in the block, ascending
+  };
+
+  struct compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type                    block_id;
+    std::vector<signed_transaction>  transactions;  ///< in the order of the requested indexes
+  };
+
   struct item_ids_inventory_message
   {
     static const core_message_type_enum type;
@@ -421,10 +476,16 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compact_block_message_type)
+                 (fetch_compact_block_transactions_message_type)
+                 (compact_block_transactions_message_type)
                  (core_message_type_last) )
 
 FC_REFLECT( graphene::net::trx_message, (trx) )
 FC_REFLECT( graphene::net::block_message, (block)(block_id) )
+FC_REFLECT( graphene::net::compact_block_message, (header)(block_id)(short_ids) )
+FC_REFLECT( graphene::net::fetch_compact_block_transactions_message, (block_id)(indexes) )
+FC_REFLECT( graphene::net::compact_block_transactions_message, (block_id)(transactions) )
 
 FC_REFLECT( graphene::net::item_id, (item_type)
                                (item_hash) )
@@ -24,6 +24,7 @@
 #pragma once
 #include <fc/network/tcp_socket.hpp>
 #include <graphene/net/message.hpp>
+#include <graphene/net/stcp_socket.hpp>
 
 namespace graphene { namespace net {
 
@@ -52,6 +53,8 @@ namespace graphene { namespace net {
        void connect_to(const fc::ip::endpoint& remote_endpoint);
 
        void send_message(const message& message_to_send);
+       /// sends the messages in order with as few socket writes as possible
+       void send_messages(const std::vector<message>& messages_to_send);
        void close_connection();
        void destroy_connection();
 
@@ -61,6 +64,7 @@ namespace graphene { namespace net {
        fc::time_point get_last_message_received_time() const;
        fc::time_point get_connection_time() const;
        fc::sha512     get_shared_secret() const;
+       stcp_socket_stats get_socket_stats() const;
      private:
        std::unique_ptr<detail::message_oriented_connection_impl> my;
   };
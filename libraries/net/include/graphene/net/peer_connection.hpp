@@ -208,6 +208,7 @@ namespace graphene { namespace net
       fc::optional<std::string> platform;
       fc::optional<uint32_t> bitness;
       fc::optional<wls::protocol::chain_id_type> chain_id;
+      bool             supports_compact_blocks = false; /// peer advertised "compact_blocks" in its hello user data
 
       // for inbound connections, these fields record what the peer sent us in
       // its hello message.  For outbound, they record what we sent the peer
@@ -255,6 +256,16 @@ namespace graphene { namespace net
       timestamped_items_set_type inventory_advertised_to_peer;
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
+
+      /// a compact block from this peer waiting for the transactions we asked for with fetch_compact_block_transactions_message
+      struct compact_block_in_progress
+      {
+        compact_block_message                         compact;
+        std::vector<fc::optional<signed_transaction>> transactions;
+        std::vector<uint32_t>                         requested_indexes;
+        bool                                          requested_all = false; /// set once we asked for every transaction after a short id collision
+      };
+      fc::optional<compact_block_in_progress> pending_compact_block;
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
@@ -294,6 +305,7 @@ namespace graphene { namespace net
 
       uint64_t get_total_bytes_sent() const;
       uint64_t get_total_bytes_received() const;
+      stcp_socket_stats get_socket_stats() const;
 
       fc::time_point get_last_message_sent_time() const;
       fc::time_point get_last_message_received_time() const;
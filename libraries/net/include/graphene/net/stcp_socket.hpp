@@ -25,12 +25,30 @@
 #include <fc/network/tcp_socket.hpp>
 #include <fc/crypto/aes.hpp>
 #include <fc/crypto/elliptic.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <memory>
 
 namespace graphene { namespace net {
 
+/** Traffic through one stcp_socket, in plaintext bytes */
+struct stcp_socket_stats
+{
+  uint64_t          bytes_read = 0;
+  uint64_t          bytes_written = 0;
+  uint64_t          socket_reads = 0;     ///< calls into the tcp socket, each at most one syscall
+  uint64_t          socket_writes = 0;
+  fc::microseconds  decrypt_time;
+  fc::microseconds  encrypt_time;
+};
+
 /**
  *  Uses ECDH to negotiate a aes key for communicating
  *  with other nodes on the network.
+ *
+ *  Reads pull as much as the socket has, up to GRAPHENE_NET_STCP_READ_BUFFER_SIZE,
+ *  and decrypt it in one pass into a buffer that later reads are served from.
  */
 class stcp_socket : public virtual fc::iostream
 {
@@ -56,6 +74,7 @@ class stcp_socket : public virtual fc::iostream
     using istream::get;
     void             get( char& c ) { read( &c, 1 ); }
     fc::sha512       get_shared_secret() const { return _shared_secret; }
+    const stcp_socket_stats& get_stats() const { return _stats; }
   private:
     void do_key_exchange();
 
@@ -68,6 +87,10 @@ class stcp_socket : public virtual fc::iostream
     fc::aes_decoder      _recv_aes;
     std::shared_ptr<char> _read_buffer;
     std::shared_ptr<char> _write_buffer;
+    std::unique_ptr<char[]> _decrypted_buffer;
+    size_t               _decrypted_begin = 0; /// next byte of _decrypted_buffer to hand out
+    size_t               _decrypted_end = 0;
+    stcp_socket_stats    _stats;
 #ifndef NDEBUG
     bool _read_buffer_in_use;
     bool _write_buffer_in_use;
@@ -77,3 +100,5 @@ class stcp_socket : public virtual fc::iostream
 typedef std::shared_ptr<stcp_socket> stcp_socket_ptr;
 
 } } // graphene::net
+
+FC_REFLECT( graphene::net::stcp_socket_stats, (bytes_read)(bytes_written)(socket_reads)(socket_writes)(decrypt_time)(encrypt_time) )
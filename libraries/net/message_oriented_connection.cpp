@@ -69,6 +69,7 @@ namespace graphene { namespace net {
 
       void read_loop();
       void start_read_loop();
+      void write_messages(const message* messages_to_send, size_t number_of_messages);
     public:
       fc::tcp_socket& get_socket();
       void accept();
@@ -80,6 +81,7 @@ namespace graphene { namespace net {
       ~message_oriented_connection_impl();
 
       void send_message(const message& message_to_send);
+      void send_messages(const std::vector<message>& messages_to_send);
       void close_connection();
       void destroy_connection();
 
@@ -90,6 +92,7 @@ namespace graphene { namespace net {
       fc::time_point get_last_message_received_time() const;
       fc::time_point get_connection_time() const { return _connected_time; }
       fc::sha512 get_shared_secret() const;
+      stcp_socket_stats get_socket_stats() const;
     };
 
     message_oriented_connection_impl::message_oriented_connection_impl(message_oriented_connection* self,
@@ -229,6 +232,20 @@ namespace graphene { namespace net {
     void message_oriented_connection_impl::send_message(const message& message_to_send)
     {
       VERIFY_CORRECT_THREAD();
+      write_messages(&message_to_send, 1);
+    }
+
+    void message_oriented_connection_impl::send_messages(const std::vector<message>& messages_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (!messages_to_send.empty())
+        write_messages(messages_to_send.data(), messages_to_send.size());
+    }
+
+    /** packs the messages, each padded to a multiple of 16 bytes, into one buffer so they go out in as few socket writes as possible */
+    void message_oriented_connection_impl::write_messages(const message* messages_to_send, size_t number_of_messages)
+    {
+      VERIFY_CORRECT_THREAD();
 #if 0 // this gets too verbose
 #ifndef NDEBUG
       fc::optional<fc::ip::endpoint> remote_endpoint;
@@ -255,22 +272,34 @@ namespace graphene { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
-        if( message_to_send.size > MAX_MESSAGE_SIZE )
-           elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        char* paddingSpace = padded_message.get() + sizeof(message_header) + message_to_send.size;
-        size_t toClean = size_with_padding - size_of_message_and_header;
-        memset(paddingSpace, 0, toClean);
-
-        _sock.write(padded_message.get(), size_with_padding);
+        size_t total_size_with_padding = 0;
+        for (size_t i = 0; i < number_of_messages; ++i)
+        {
+          if( messages_to_send[i].size > MAX_MESSAGE_SIZE )
+             elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
+          //pad the message we send to a multiple of 16 bytes
+          total_size_with_padding += 16 * ((sizeof(message_header) + messages_to_send[i].size + 15) / 16);
+        }
+        std::unique_ptr<char[]> padded_messages(new char[total_size_with_padding]);
+
+        char* next_message = padded_messages.get();
+        for (size_t i = 0; i < number_of_messages; ++i)
+        {
+          const message& message_to_send = messages_to_send[i];
+          size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
+          size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
+
+          memcpy(next_message, (char*)&message_to_send, sizeof(message_header));
+          memcpy(next_message + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
+          char* paddingSpace = next_message + size_of_message_and_header;
+          size_t toClean = size_with_padding - size_of_message_and_header;
+          memset(paddingSpace, 0, toClean);
+          next_message += size_with_padding;
+        }
+
+        _sock.write(padded_messages.get(), total_size_with_padding);
         _sock.flush();
-        _bytes_sent += size_with_padding;
+        _bytes_sent += total_size_with_padding;
         _last_message_sent_time = fc::time_point::now();
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" );
     }
@@ -339,6 +368,12 @@ namespace graphene { namespace net {
       return _sock.get_shared_secret();
     }
 
+    stcp_socket_stats message_oriented_connection_impl::get_socket_stats() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _sock.get_stats();
+    }
+
   } // end namespace graphene::net::detail
 
 
@@ -376,6 +411,11 @@ namespace graphene { namespace net {
     my->send_message(message_to_send);
   }
 
+  void message_oriented_connection::send_messages(const std::vector<message>& messages_to_send)
+  {
+    my->send_messages(messages_to_send);
+  }
+
   void message_oriented_connection::close_connection()
   {
     my->close_connection();
@@ -413,5 +453,9 @@ namespace graphene { namespace net {
   {
     return my->get_shared_secret();
   }
+  stcp_socket_stats message_oriented_connection::get_socket_stats() const
+  {
+    return my->get_socket_stats();
+  }
 
 } } // end namespace graphene::net
@@ -177,6 +177,7 @@ namespace graphene { namespace net {
                         const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
       message get_message( const message_hash_type& hash_of_message_to_lookup );
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
+      fc::optional<signed_transaction> get_transaction_by_short_id( uint64_t short_id ) const;
       size_t size() const { return _message_cache.size(); }
     };
 
@@ -221,6 +222,23 @@ namespace graphene { namespace net {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    fc::optional<signed_transaction> blockchain_tied_message_cache::get_transaction_by_short_id( uint64_t short_id ) const
+    {
+      // the contents hash of a transaction is its id, so the short id is the leading bytes of the index key
+      fc::uint160_t first_possible_id;
+      memcpy( first_possible_id._hash, &short_id, sizeof( short_id ) );
+
+      const auto& contents_index = _message_cache.get<message_contents_hash_index>();
+      for( auto iter = contents_index.lower_bound( first_possible_id );
+           iter != contents_index.end() && compact_short_id( iter->message_contents_hash ) == short_id;
+           ++iter )
+      {
+        if( iter->message_body.msg_type == trx_message_type )
+          return iter->message_body.as<trx_message>().trx;
+      }
+      return fc::optional<signed_transaction>();
+    }
+
     // when requesting items from peers, we want to prioritize any blocks before
     // transactions, but otherwise request items in the order we heard about them
     struct prioritized_item_id
@@ -487,6 +505,14 @@ namespace graphene { namespace net {
 
       blockchain_tied_message_cache _message_cache; /// cache message we have received and might be required to provide to other peers via inventory requests
 
+      /// the last block we sent in compact form, so its short ids are computed once for all peers and its transactions can be served by index
+      fc::optional<std::pair<graphene::net::block_message, compact_block_message>> _last_compact_block;
+      uint64_t _compact_blocks_sent = 0;
+      uint64_t _compact_blocks_received = 0;
+      uint64_t _compact_blocks_completed_from_cache = 0; /// received compact blocks that needed no transactions from the peer
+      uint64_t _compact_block_transactions_requested = 0;
+      uint64_t _compact_block_transactions_sent = 0;
+
       fc::rate_limiting_group _rate_limiter;
 
       uint32_t _last_reported_number_of_connections; // number of connections last reported to the client (to avoid sending duplicate messages)
@@ -632,6 +658,19 @@ namespace graphene { namespace net {
 
       void on_connection_closed(peer_connection* originating_peer) override;
 
+      void on_compact_block_message(peer_connection* originating_peer,
+                                    const compact_block_message& compact_block_message_received);
+
+      void on_fetch_compact_block_transactions_message(peer_connection* originating_peer,
+                                                       const fetch_compact_block_transactions_message& fetch_compact_block_transactions_message_received);
+
+      void on_compact_block_transactions_message(peer_connection* originating_peer,
+                                                 const compact_block_transactions_message& compact_block_transactions_message_received);
+
+      const compact_block_message& get_compact_block(const graphene::net::block_message& block_message_to_send);
+      void request_compact_block_transactions(peer_connection* originating_peer, std::vector<uint32_t> indexes);
+      void try_to_complete_compact_block(peer_connection* originating_peer);
+
       void send_sync_block_to_node_delegate(const graphene::net::block_message& block_message_to_send);
       void process_backlog_of_sync_blocks();
       void trigger_process_backlog_of_sync_blocks();
@@ -1776,6 +1815,15 @@ namespace graphene { namespace net {
       case core_message_type_enum::get_current_connections_reply_message_type:
         on_get_current_connections_reply_message(originating_peer, received_message.as<get_current_connections_reply_message>());
         break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_compact_block_transactions_message_type:
+        on_fetch_compact_block_transactions_message(originating_peer, received_message.as<fetch_compact_block_transactions_message>());
+        break;
+      case core_message_type_enum::compact_block_transactions_message_type:
+        on_compact_block_transactions_message(originating_peer, received_message.as<compact_block_transactions_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -1820,6 +1868,7 @@ namespace graphene { namespace net {
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
       user_data["chain_id"] = WLS_CHAIN_ID;
+      user_data["compact_blocks"] = true;
 
       return user_data;
     }
@@ -1845,6 +1894,8 @@ namespace graphene { namespace net {
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>();
       if (user_data.contains("chain_id"))
         originating_peer->chain_id = user_data["chain_id"].as<wls::protocol::chain_id_type>();
+      if (user_data.contains("compact_blocks"))
+        originating_peer->supports_compact_blocks = user_data["compact_blocks"].as<bool>();
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -2722,6 +2773,10 @@ namespace graphene { namespace net {
 
       fc::optional<message> last_block_message_sent;
 
+      // blocks still in our message cache were just announced, so an in-sync peer most likely has
+      // their transactions already and gets them in compact form
+      bool send_compact_blocks = originating_peer->supports_compact_blocks && !originating_peer->peer_needs_sync_items_from_us;
+
       std::list<message> reply_messages;
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
@@ -2731,6 +2786,13 @@ namespace graphene { namespace net {
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
                ("id", requested_message.id()));
+          if (send_compact_blocks && requested_message.msg_type == block_message_type)
+          {
+            last_block_message_sent = requested_message;
+            reply_messages.push_back(get_compact_block(requested_message.as<graphene::net::block_message>()));
+            ++_compact_blocks_sent;
+            continue;
+          }
           reply_messages.push_back(requested_message);
           if (fetch_items_message_received.item_type == block_message_type)
             last_block_message_sent = requested_message;
@@ -2779,6 +2841,160 @@ namespace graphene { namespace net {
       }
     }
 
+    const compact_block_message& node_impl::get_compact_block(const graphene::net::block_message& block_message_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (!_last_compact_block || _last_compact_block->first.block_id != block_message_to_send.block_id)
+        _last_compact_block = std::make_pair(block_message_to_send, compact_block_message(block_message_to_send.block, block_message_to_send.block_id));
+      return _last_compact_block->second;
+    }
+
+    void node_impl::on_compact_block_message(peer_connection* originating_peer, const compact_block_message& compact_block_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      ++_compact_blocks_received;
+      dlog("received compact block ${id} with ${n} transactions from peer ${endpoint}",
+           ("id", compact_block_message_received.block_id)
+           ("n", compact_block_message_received.short_ids.size())
+           ("endpoint", originating_peer->get_remote_endpoint()));
+
+      peer_connection::compact_block_in_progress pending;
+      pending.compact = compact_block_message_received;
+      pending.transactions.reserve(compact_block_message_received.short_ids.size());
+
+      std::vector<uint32_t> missing_indexes;
+      for (uint32_t i = 0; i < compact_block_message_received.short_ids.size(); ++i)
+      {
+        pending.transactions.push_back(_message_cache.get_transaction_by_short_id(compact_block_message_received.short_ids[i]));
+        if (!pending.transactions.back())
+          missing_indexes.push_back(i);
+      }
+      originating_peer->pending_compact_block = pending;
+
+      if (missing_indexes.empty())
+      {
+        ++_compact_blocks_completed_from_cache;
+        try_to_complete_compact_block(originating_peer);
+      }
+      else
+        request_compact_block_transactions(originating_peer, missing_indexes);
+    }
+
+    void node_impl::request_compact_block_transactions(peer_connection* originating_peer, std::vector<uint32_t> indexes)
+    {
+      VERIFY_CORRECT_THREAD();
+      peer_connection::compact_block_in_progress& pending = *originating_peer->pending_compact_block;
+      _compact_block_transactions_requested += indexes.size();
+      pending.requested_indexes = indexes;
+
+      fetch_compact_block_transactions_message request;
+      request.block_id = pending.compact.block_id;
+      request.indexes = std::move(indexes);
+      originating_peer->send_message(request);
+    }
+
+    void node_impl::try_to_complete_compact_block(peer_connection* originating_peer)
+    {
+      VERIFY_CORRECT_THREAD();
+      peer_connection::compact_block_in_progress& pending = *originating_peer->pending_compact_block;
+
+      signed_block block;
+      static_cast<signed_block_header&>(block) = pending.compact.header;
+      block.transactions.reserve(pending.transactions.size());
+      for (const fc::optional<signed_transaction>& trx : pending.transactions)
+        block.transactions.push_back(*trx);
+
+      // a short id collision picked the wrong transaction from our cache, so ask for all of them.  If the
+      // peer's own transactions still don't match the header, the block is handed on as is and rejected there
+      if (block.calculate_merkle_root() != block.transaction_merkle_root && !pending.requested_all)
+      {
+        wlog("compact block ${id} from peer ${endpoint} does not match its merkle root, requesting all of its transactions",
+             ("id", pending.compact.block_id)("endpoint", originating_peer->get_remote_endpoint()));
+        pending.requested_all = true;
+        std::vector<uint32_t> all_indexes(pending.transactions.size());
+        for (uint32_t i = 0; i < all_indexes.size(); ++i)
+          all_indexes[i] = i;
+        request_compact_block_transactions(originating_peer, all_indexes);
+        return;
+      }
+
+      originating_peer->pending_compact_block.reset();
+
+      // built the same way the sender built its block_message, so it hashes to the item we requested
+      message block_message_received(graphene::net::block_message(std::move(block)));
+      process_block_message(originating_peer, block_message_received, block_message_received.id());
+    }
+
+    void node_impl::on_fetch_compact_block_transactions_message(peer_connection* originating_peer,
+                                                                const fetch_compact_block_transactions_message& fetch_compact_block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const block_id_type& block_id = fetch_compact_block_transactions_message_received.block_id;
+
+      fc::optional<graphene::net::block_message> requested_block;
+      if (_last_compact_block && _last_compact_block->first.block_id == block_id)
+        requested_block = _last_compact_block->first;
+      else
+      {
+        try
+        {
+          requested_block = _delegate->get_item(item_id(block_message_type, block_id)).as<graphene::net::block_message>();
+        }
+        catch (fc::key_not_found_exception&)
+        {
+          // the peer will time out its request for the block and fetch it from someone else
+          wlog("peer ${endpoint} requested transactions of compact block ${id}, which we no longer have",
+               ("endpoint", originating_peer->get_remote_endpoint())("id", block_id));
+          return;
+        }
+      }
+
+      compact_block_transactions_message reply;
+      reply.block_id = block_id;
+      reply.transactions.reserve(fetch_compact_block_transactions_message_received.indexes.size());
+      for (uint32_t index : fetch_compact_block_transactions_message_received.indexes)
+      {
+        if (index >= requested_block->block.transactions.size())
+        {
+          wlog("peer ${endpoint} requested transaction ${index} of compact block ${id}, which has only ${n}",
+               ("endpoint", originating_peer->get_remote_endpoint())("index", index)("id", block_id)
+               ("n", requested_block->block.transactions.size()));
+          disconnect_from_peer(originating_peer, "You requested a transaction that is not in the block");
+          return;
+        }
+        reply.transactions.push_back(requested_block->block.transactions[index]);
+      }
+
+      _compact_block_transactions_sent += reply.transactions.size();
+      originating_peer->send_message(reply);
+    }
+
+    void node_impl::on_compact_block_transactions_message(peer_connection* originating_peer,
+                                                          const compact_block_transactions_message& compact_block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (!originating_peer->pending_compact_block ||
+          originating_peer->pending_compact_block->compact.block_id != compact_block_transactions_message_received.block_id)
+      {
+        wlog("peer ${endpoint} sent transactions for compact block ${id}, which we are not waiting for",
+             ("endpoint", originating_peer->get_remote_endpoint())("id", compact_block_transactions_message_received.block_id));
+        return;
+      }
+
+      peer_connection::compact_block_in_progress& pending = *originating_peer->pending_compact_block;
+      if (compact_block_transactions_message_received.transactions.size() != pending.requested_indexes.size())
+      {
+        disconnect_from_peer(originating_peer, "You sent a different number of transactions than I requested");
+        return;
+      }
+
+      for (size_t i = 0; i < pending.requested_indexes.size(); ++i)
+        pending.transactions[pending.requested_indexes[i]] = compact_block_transactions_message_received.transactions[i];
+      pending.requested_indexes.clear();
+
+      try_to_complete_compact_block(originating_peer);
+    }
+
     void node_impl::on_item_not_available_message( peer_connection* originating_peer, const item_not_available_message& item_not_available_message_received )
     {
       VERIFY_CORRECT_THREAD();
@@ -4882,6 +5098,7 @@ namespace graphene { namespace net {
         peer_details["lastrecv"] = peer->get_last_message_received_time().sec_since_epoch();
         peer_details["bytessent"] = peer->get_total_bytes_sent();
         peer_details["bytesrecv"] = peer->get_total_bytes_received();
+        peer_details["socket_stats"] = fc::variant(peer->get_socket_stats());
         peer_details["conntime"] = peer->get_connection_time();
         peer_details["pingtime"] = "";
         peer_details["pingwait"] = "";
@@ -5079,6 +5296,14 @@ namespace graphene { namespace net {
       info["node_public_key"] = _node_public_key;
       info["node_id"] = _node_id;
       info["firewalled"] = _is_firewalled;
+
+      fc::mutable_variant_object compact_blocks;
+      compact_blocks["sent"] = _compact_blocks_sent;
+      compact_blocks["received"] = _compact_blocks_received;
+      compact_blocks["completed_from_cache"] = _compact_blocks_completed_from_cache;
+      compact_blocks["transactions_requested"] = _compact_block_transactions_requested;
+      compact_blocks["transactions_sent"] = _compact_block_transactions_sent;
+      info["compact_blocks"] = compact_blocks;
       return info;
     }
     fc::variant_object node_impl::network_get_usage_stats() const
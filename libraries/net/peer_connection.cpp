@@ -293,20 +293,33 @@ namespace graphene { namespace net
 #endif
       while (!_queued_messages.empty())
       {
-        _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        // take as many queued messages as fit in one batch (but always at least one), so a
+        // peer syncing from us gets its blocks in a few large writes instead of one per block
+        std::vector<std::unique_ptr<queued_message>> messages_in_batch;
+        std::vector<message> messages_to_send;
+        size_t batch_size = 0;
+        while (!_queued_messages.empty() &&
+               (messages_to_send.empty() || batch_size < GRAPHENE_NET_MAX_SEND_BATCH_SIZE))
+        {
+          messages_in_batch.emplace_back(std::move(_queued_messages.front()));
+          _queued_messages.pop();
+          messages_in_batch.back()->transmission_start_time = fc::time_point::now();
+          messages_to_send.emplace_back(messages_in_batch.back()->get_message(_node));
+          batch_size += messages_to_send.back().size;
+        }
+
         try
         {
-          //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
-          //     "to send message of type ${type} for peer ${endpoint}",
-          //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-          _message_connection.send_message(message_to_send);
-          //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
+          //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_messages() "
+          //     "to send ${count} messages for peer ${endpoint}",
+          //     ("count", messages_to_send.size())("endpoint", get_remote_endpoint()));
+          _message_connection.send_messages(messages_to_send);
+          //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_messages() completed normally for peer ${endpoint}",
           //     ("endpoint", get_remote_endpoint()));
         }
         catch (const fc::canceled_exception&)
         {
-          dlog("message_oriented_connection::send_message() was canceled, rethrowing canceled_exception");
+          dlog("message_oriented_connection::send_messages() was canceled, rethrowing canceled_exception");
           throw;
         }
         catch (const fc::exception& send_error)
@@ -324,15 +337,17 @@ namespace graphene { namespace net
         }
         catch (const std::exception& e)
         {
-          elog("message_oriented_exception::send_message() threw a std::exception(): ${what}", ("what", e.what()));
+          elog("message_oriented_exception::send_messages() threw a std::exception(): ${what}", ("what", e.what()));
         }
         catch (...)
         {
-          elog("message_oriented_exception::send_message() threw an unhandled exception");
+          elog("message_oriented_exception::send_messages() threw an unhandled exception");
+        }
+        for (const std::unique_ptr<queued_message>& sent_message : messages_in_batch)
+        {
+          sent_message->transmission_finish_time = fc::time_point::now();
+          _total_queued_messages_size -= sent_message->get_size_in_queue();
         }
-        _queued_messages.front()->transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
-        _queued_messages.pop();
       }
       //dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
@@ -415,6 +430,12 @@ namespace graphene { namespace net
       return _message_connection.get_total_bytes_received();
     }
 
+    stcp_socket_stats peer_connection::get_socket_stats() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _message_connection.get_socket_stats();
+    }
+
     fc::time_point peer_connection::get_last_message_sent_time() const
     {
       VERIFY_CORRECT_THREAD();
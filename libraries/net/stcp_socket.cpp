@@ -33,6 +33,7 @@
 #include <fc/exception/exception.hpp>
 
 #include <graphene/net/stcp_socket.hpp>
+#include <graphene/net/config.hpp>
 
 namespace graphene { namespace net {
 
@@ -81,13 +82,15 @@ void stcp_socket::bind( const fc::ip::endpoint& local_endpoint )
 }
 
 /**
- *   This method must read at least 16 bytes at a time from
- *   the underlying TCP socket so that it can decrypt them. It
- *   will buffer any left-over.
+ *   Ciphertext is read from the TCP socket in multiples of 16 bytes,
+ *   as much as is available up to GRAPHENE_NET_STCP_READ_BUFFER_SIZE,
+ *   and decrypted in one pass.  Reads are served from the decrypted
+ *   buffer until it runs dry, so a message header and body usually
+ *   cost a single socket read.
  */
 size_t stcp_socket::readsome( char* buffer, size_t len )
 { try {
-    assert( len > 0 && (len % 16) == 0 );
+    assert( len > 0 );
 
 #ifndef NDEBUG
     // This code was written with the assumption that you'd only be making one call to readsome 
@@ -100,20 +103,37 @@ size_t stcp_socket::readsome( char* buffer, size_t len )
     } buffer_in_use_checker(_read_buffer_in_use);
 #endif
 
-    const size_t read_buffer_length = 4096;
-    if (!_read_buffer)
-      _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
-
-    len = std::min<size_t>(read_buffer_length, len);
-
-    size_t s = _sock.readsome( _read_buffer, len, 0 );
-    if( s % 16 ) 
+    if (_decrypted_begin == _decrypted_end)
     {
-      _sock.read(_read_buffer, 16 - (s%16), s);
-      s += 16-(s%16);
+      const size_t read_buffer_length = GRAPHENE_NET_STCP_READ_BUFFER_SIZE;
+      if (!_read_buffer)
+      {
+        _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
+        _decrypted_buffer.reset(new char[read_buffer_length]);
+      }
+
+      size_t s = _sock.readsome( _read_buffer, read_buffer_length, 0 );
+      ++_stats.socket_reads;
+      if( s % 16 ) 
+      {
+        _sock.read(_read_buffer, 16 - (s%16), s);
+        ++_stats.socket_reads;
+        s += 16-(s%16);
+      }
+
+      fc::time_point decrypt_start = fc::time_point::now();
+      _recv_aes.decode( _read_buffer.get(), s, _decrypted_buffer.get() );
+      _stats.decrypt_time += fc::time_point::now() - decrypt_start;
+
+      _decrypted_begin = 0;
+      _decrypted_end = s;
     }
-    _recv_aes.decode( _read_buffer.get(), s, buffer );
-    return s;
+
+    len = std::min<size_t>(_decrypted_end - _decrypted_begin, len);
+    memcpy(buffer, _decrypted_buffer.get() + _decrypted_begin, len);
+    _decrypted_begin += len;
+    _stats.bytes_read += len;
+    return len;
 } FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
 
 size_t stcp_socket::readsome( const std::shared_ptr<char>& buf, size_t len, size_t offset ) 
@@ -123,7 +143,7 @@ size_t stcp_socket::readsome( const std::shared_ptr<char>& buf, size_t len, size
 
 bool stcp_socket::eof()const
 {
-  return _sock.eof();
+  return _decrypted_begin == _decrypted_end && _sock.eof();
 }
 
 size_t stcp_socket::writesome( const char* buffer, size_t len )
@@ -141,20 +161,19 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
     } buffer_in_use_checker(_write_buffer_in_use);
 #endif
 
-    const std::size_t write_buffer_length = 4096;
+    const std::size_t write_buffer_length = GRAPHENE_NET_STCP_WRITE_BUFFER_SIZE;
     if (!_write_buffer)
       _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
     len = std::min<size_t>(write_buffer_length, len);
-    memset(_write_buffer.get(), 0, len); // just in case aes.encode screws up
-    /**
-     * every sizeof(crypt_buf) bytes the aes channel
-     * has an error and doesn't decrypt properly...  disable
-     * for now because we are going to upgrade to something
-     * better.
-     */
+
+    fc::time_point encrypt_start = fc::time_point::now();
     uint32_t ciphertext_len = _send_aes.encode( buffer, len, _write_buffer.get() );
+    _stats.encrypt_time += fc::time_point::now() - encrypt_start;
     assert(ciphertext_len == len);
+
     _sock.write( _write_buffer, ciphertext_len );
+    ++_stats.socket_writes;
+    _stats.bytes_written += ciphertext_len;
     return ciphertext_len;
 } FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
 
@@ -4,6 +4,7 @@
 
 #include <wls/protocol/config.hpp>
 
+#include <wls/chain/account_history_store.hpp>
 #include <wls/chain/database.hpp>
 #include <wls/chain/operation_notification.hpp>
 #include <wls/chain/history_object.hpp>
@@ -36,6 +37,10 @@ class account_history_plugin_impl
       }
 
       void on_operation( const operation_notification& note );
+      void on_pre_apply_block( const signed_block& b );
+      void on_applied_block( const signed_block& b );
+      void store_operation( const operation_notification& note, const flat_set< account_name_type >& impacted );
+      bool is_tracked( const account_name_type& item )const;
 
       account_history_plugin& _self;
       flat_map< account_name_type, account_name_type > _tracked_accounts;
@@ -43,6 +48,10 @@ class account_history_plugin_impl
       bool                                             _blacklist = false;
       flat_set< string >                               _op_list;
       bool                                             _prune = true;
+
+      std::shared_ptr< account_history_store >         _store;
+      history_block                                    _block;
+      bool                                             _in_block = false;
 };
 
 account_history_plugin_impl::~account_history_plugin_impl()
@@ -151,6 +160,49 @@ struct operation_visitor_filter : operation_visitor
    }
 };
 
+struct operation_name_visitor
+{
+   typedef string result_type;
+
+   template< typename T >
+   string operator()( const T& )const
+   {
+      return fc::get_typename< T >::name();
+   }
+};
+
+bool account_history_plugin_impl::is_tracked( const account_name_type& item )const
+{
+   auto itr = _tracked_accounts.lower_bound( item );
+
+   /*
+    * The map containing the ranges uses the key as the lower bound and the value as the upper bound.
+    * Because of this, if a value exists with the range (key, value], then calling lower_bound on
+    * the map will return the key of the next pair. Under normal circumstances of those ranges not
+    * intersecting, the value we are looking for will not be present in range that is returned via
+    * lower_bound.
+    *
+    * Consider the following example using ranges ["a","c"], ["g","i"]
+    * If we are looking for "bob", it should be tracked because it is in the lower bound.
+    * However, lower_bound( "bob" ) returns an iterator to ["g","i"]. So we need to decrement the iterator
+    * to get the correct range.
+    *
+    * If we are looking for "g", lower_bound( "g" ) will return ["g","i"], so we need to make sure we don't
+    * decrement.
+    *
+    * If the iterator points to the end, we should check the previous (equivalent to rbegin)
+    *
+    * And finally if the iterator is at the beginning, we should not decrement it for obvious reasons
+    */
+   if( itr != _tracked_accounts.begin() &&
+       ( ( itr != _tracked_accounts.end() && itr->first != item  ) || itr == _tracked_accounts.end() ) )
+   {
+      --itr;
+   }
+
+   return !_tracked_accounts.size() || (itr != _tracked_accounts.end() && itr->first <= item && item <= itr->second );
+}
+
 void account_history_plugin_impl::on_operation( const operation_notification& note )
 {
    flat_set<account_name_type> impacted;
@@ -159,35 +211,14 @@ void account_history_plugin_impl::on_operation( const operation_notification& no
    const operation_object* new_obj = nullptr;
    app::operation_get_impacted_accounts( note.op, impacted );
 
-   for( const auto& item : impacted ) {
-      auto itr = _tracked_accounts.lower_bound( item );
-
-      /*
-       * The map containing the ranges uses the key as the lower bound and the value as the upper bound.
-       * Because of this, if a value exists with the range (key, value], then calling lower_bound on
-       * the map will return the key of the next pair. Under normal circumstances of those ranges not
-       * intersecting, the value we are looking for will not be present in range that is returned via
-       * lower_bound.
-       *
-       * Consider the following example using ranges ["a","c"], ["g","i"]
-       * If we are looking for "bob", it should be tracked because it is in the lower bound.
-       * However, lower_bound( "bob" ) returns an iterator to ["g","i"]. So we need to decrement the iterator
-       * to get the correct range.
-       *
-       * If we are looking for "g", lower_bound( "g" ) will return ["g","i"], so we need to make sure we don't
-       * decrement.
-       *
-       * If the iterator points to the end, we should check the previous (equivalent to rbegin)
-       *
-       * And finally if the iterator is at the beginning, we should not decrement it for obvious reasons
-       */
-      if( itr != _tracked_accounts.begin() &&
-          ( ( itr != _tracked_accounts.end() && itr->first != item  ) || itr == _tracked_accounts.end() ) )
-      {
-         --itr;
-      }
+   if( _store )
+   {
+      store_operation( note, impacted );
+      return;
+   }
 
-      if( !_tracked_accounts.size() || (itr != _tracked_accounts.end() && itr->first <= item && item <= itr->second ) )
+   for( const auto& item : impacted ) {
+      if( is_tracked( item ) )
       {
          if(_filter_content)
          {
@@ -201,6 +232,55 @@ void account_history_plugin_impl::on_operation( const operation_notification& no
    }
 }
 
+void account_history_plugin_impl::store_operation( const operation_notification& note, const flat_set< account_name_type >& impacted )
+{
+   // Operations of pending transactions are undone rather than applied in a block
+   if( !_in_block )
+      return;
+
+   if( _filter_content && ( _op_list.find( note.op.visit( operation_name_visitor() ) ) != _op_list.end() ) == _blacklist )
+      return;
+
+   uint32_t op_index = _block.operations.size();
+   bool stored = false;
+
+   for( const auto& item : impacted )
+   {
+      if( !is_tracked( item ) )
+         continue;
+
+      if( !stored )
+      {
+         history_operation op;
+         op.trx_id        = note.trx_id;
+         op.block         = note.block;
+         op.trx_in_block  = note.trx_in_block;
+         op.op_in_trx     = note.op_in_trx;
+         op.virtual_op    = note.virtual_op;
+         op.timestamp     = database().head_block_time();
+         op.serialized_op = fc::raw::pack( note.op );
+         _block.operations.push_back( std::move( op ) );
+         stored = true;
+      }
+
+      _block.account_ops.emplace_back( item, op_index );
+   }
+}
+
+void account_history_plugin_impl::on_pre_apply_block( const signed_block& b )
+{
+   _block = history_block();
+   _block.block_num = b.block_num();
+   _in_block = true;
+}
+
+void account_history_plugin_impl::on_applied_block( const signed_block& b )
+{
+   _in_block = false;
+   _store->push_block( std::move( _block ) );
+   _store->commit( database().last_non_undoable_block_num() );
+}
+
 } // end namespace detail
 
 account_history_plugin::account_history_plugin( application* app )
@@ -227,7 +307,8 @@ void account_history_plugin::plugin_set_program_options(
          ("track-account-range", boost::program_options::value< vector< string > >()->composing()->multitoken(), "Defines a range of accounts to track as a json pair [\"from\",\"to\"] [from,to] Can be specified multiple times")
          ("history-whitelist-ops", boost::program_options::value< vector< string > >()->composing(), "Defines a list of operations which will be explicitly logged.")
          ("history-blacklist-ops", boost::program_options::value< vector< string > >()->composing(), "Defines a list of operations which will be explicitly ignored.")
-         ("history-disable-pruning", boost::program_options::value< bool >()->default_value( false ), "Disables automatic account history trimming" );
+         ("history-disable-pruning", boost::program_options::value< bool >()->default_value( false ), "Disables automatic account history trimming" )
+         ("history-store", boost::program_options::value< string >()->default_value( "shared-memory" ), "Where account history is kept: shared-memory, or file to keep it in append-only files under data-dir/account_history. The file store is not pruned." )
          ;
    cfg.add(cli);
 }
@@ -278,10 +359,34 @@ void account_history_plugin::plugin_initialize(const boost::program_options::var
       ilog( "Account History: blacklisting ops ${o}", ("o", my->_op_list) );
    }
 
+   app()._account_history_complete = my->_tracked_accounts.empty() && !my->_filter_content;
+
    if( options.count( "history-disable-pruning" ) )
    {
       my->_prune = options[ "history-disable-pruning" ].as< bool >();
    }
+
+   if( options.count( "history-store" ) && options.at( "history-store" ).as< string >() != "shared-memory" )
+   {
+      FC_ASSERT( options.at( "history-store" ).as< string >() == "file", "Unknown history-store ${s}", ("s", options.at( "history-store" ).as< string >()) );
+
+      fc::path data_dir = fc::current_path();
+      if( options.count( "data-dir" ) )
+      {
+         data_dir = options[ "data-dir" ].as< boost::filesystem::path >();
+         if( data_dir.is_relative() )
+            data_dir = fc::current_path() / data_dir;
+      }
+
+      my->_store = std::make_shared< account_history_store >();
+      my->_store->open( data_dir / "account_history" );
+      app()._account_history_store = my->_store;
+
+      database().pre_apply_block.connect( [&]( const signed_block& b ){ my->on_pre_apply_block( b ); } );
+      database().applied_block.connect( [&]( const signed_block& b ){ my->on_applied_block( b ); } );
+
+      ilog( "Account History: keeping history in ${d}", ("d", data_dir / "account_history") );
+   }
 }
 
 void account_history_plugin::plugin_startup()
@@ -291,6 +396,12 @@ void account_history_plugin::plugin_startup()
    ilog( "account_history plugin: plugin_startup() end" );
 }
 
+void account_history_plugin::plugin_shutdown()
+{
+   if( my->_store )
+      my->_store->close();
+}
+
 flat_map< account_name_type, account_name_type > account_history_plugin::tracked_accounts() const
 {
    return my->_tracked_accounts;
@@ -74,7 +74,7 @@ class account_history_plugin : public wls::app::plugin
          boost::program_options::options_description& cfg) override;
       virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
-
+      virtual void plugin_shutdown() override;
 
       flat_map< account_name_type, account_name_type > tracked_accounts()const; /// map start_range to end_range
 
@@ -42,7 +42,7 @@ namespace wls {
                        return _self->database();
                     }
 
-                    void on_change(boost::any obj);
+                    void on_comment_change(const chain::object_change_notification<chain::comment_object> &note);
 
                     void on_applied_block(const chain::signed_block &b);
 
@@ -56,24 +56,22 @@ namespace wls {
 
                 changelog_impl::changelog_impl(changelog_plugin *self) : _self(self) {}
 
-                void changelog_impl::on_change(boost::any obj) {
+                void changelog_impl::on_comment_change(const chain::object_change_notification<chain::comment_object> &note) {
                    chain::database &db = database();
 
-                   if (obj.type() == typeid(wls::chain::comment_object)) {
-                      chain::comment_object obj_comment_object = boost::any_cast<wls::chain::comment_object>(obj);
-                      string content = fc::json::to_string(std::make_pair("comment_object", obj_comment_object));
-                      uint32_t height = db.head_block_num();
+                   // serialize straight from shared memory, same ["comment_object", {...}] layout as before
+                   fc::variants entry{fc::variant("comment_object"), fc::variant(note.object)};
+                   string content = fc::json::to_string(entry);
+                   uint32_t height = db.head_block_num();
 
-                      if (buffer_map.find(height) == buffer_map.end()) {
-                         // not found, insert new one here
-                         changelog_block buffer_new = changelog_block();
-                         buffer_map[height] = buffer_new;
-                      }
-
-                      changelog_block &buffer = buffer_map[height];
-                      buffer.push_back(content);
+                   if (buffer_map.find(height) == buffer_map.end()) {
+                      // not found, insert new one here
+                      changelog_block buffer_new = changelog_block();
+                      buffer_map[height] = buffer_new;
                    }
 
+                   changelog_block &buffer = buffer_map[height];
+                   buffer.push_back(content);
                 }
 
                 void changelog_impl::on_applied_block(const chain::signed_block &b) {
@@ -142,7 +140,8 @@ namespace wls {
                // connect needed signals
                my->_applied_block_conn = db.applied_block.connect(
                        [this](const chain::signed_block &b) { my->on_applied_block(b); });
-               my->_on_change_conn = db.on_change.connect([this](boost::any obj) { my->on_change(obj); });
+               my->_on_change_conn = db.on_object_change<chain::comment_object>(
+                       [this](const chain::object_change_notification<chain::comment_object> &note) { my->on_comment_change(note); });
             }
 
             void changelog_plugin::plugin_startup() {
@@ -1,6 +1,7 @@
 #include <wls/chain/account_object.hpp>
 
 #include <wls/follow/follow_api.hpp>
+#include <wls/follow/follow_plugin.hpp>
 
 namespace wls { namespace follow {
 
@@ -34,6 +35,8 @@ class follow_api_impl
 
       vector< account_reputation > get_account_reputations( string lower_bound_name, uint32_t limit )const;
 
+      std::shared_ptr< merged_feed > get_feed_merger()const;
+
       wls::app::application& app;
 };
 
@@ -100,17 +103,42 @@ follow_count_api_obj follow_api_impl::get_follow_count( string& account )const
    return result;
 }
 
+std::shared_ptr< merged_feed > follow_api_impl::get_feed_merger()const
+{
+   auto plugin = app.get_plugin< follow_plugin >( FOLLOW_PLUGIN_NAME );
+   return plugin ? plugin->feed_merger : std::shared_ptr< merged_feed >();
+}
+
 vector< feed_entry > follow_api_impl::get_feed_entries( string account, uint32_t entry_id, uint16_t limit )const
 {
    FC_ASSERT( limit <= 500, "Cannot retrieve more than 500 feed entries at a time." );
 
-   if( entry_id == 0 )
-      entry_id = ~0;
-
    vector< feed_entry > results;
    results.reserve( limit );
 
    const auto& db = *app.chain_database();
+
+   auto merger = get_feed_merger();
+   if( merger )
+   {
+      for( auto& e : merger->get_feed( db, account, entry_id, limit ) )
+      {
+         const auto& comment = db.get( e.comment );
+         feed_entry entry;
+         entry.author = comment.author;
+         entry.permlink = to_string( comment.permlink );
+         entry.reblog_by = std::move( e.reblog_by );
+         entry.reblog_on = e.reblog_on;
+         entry.entry_id = e.entry_id;
+         results.push_back( entry );
+      }
+
+      return results;
+   }
+
+   if( entry_id == 0 )
+      entry_id = ~0;
+
    const auto& feed_idx = db.get_index< feed_index >().indices().get< by_feed >();
    auto itr = feed_idx.lower_bound( boost::make_tuple( account, entry_id ) );
 
@@ -142,13 +170,30 @@ vector< comment_feed_entry > follow_api_impl::get_feed( string account, uint32_t
 {
    FC_ASSERT( limit <= 500, "Cannot retrieve more than 500 feed entries at a time." );
 
-   if( entry_id == 0 )
-      entry_id = ~0;
-
    vector< comment_feed_entry > results;
    results.reserve( limit );
 
    const auto& db = *app.chain_database();
+
+   auto merger = get_feed_merger();
+   if( merger )
+   {
+      for( auto& e : merger->get_feed( db, account, entry_id, limit ) )
+      {
+         comment_feed_entry entry;
+         entry.comment = db.get( e.comment );
+         entry.reblog_by = std::move( e.reblog_by );
+         entry.reblog_on = e.reblog_on;
+         entry.entry_id = e.entry_id;
+         results.push_back( entry );
+      }
+
+      return results;
+   }
+
+   if( entry_id == 0 )
+      entry_id = ~0;
+
    const auto& feed_idx = db.get_index< feed_index >().indices().get< by_feed >();
    auto itr = feed_idx.lower_bound( boost::make_tuple( account, entry_id ) );
 
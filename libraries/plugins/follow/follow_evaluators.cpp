@@ -165,7 +165,7 @@ void reblog_evaluator::do_apply( const reblog_operation& o )
       const auto& idx = db.get_index< follow_index >().indices().get< by_following_follower >();
       auto itr = idx.find( o.account );
 
-      if( db.head_block_time() >= _plugin->start_feeds )
+      if( !_plugin->merge_feeds && db.head_block_time() >= _plugin->start_feeds )
       {
          while( itr != idx.end() && itr->following == o.account )
          {
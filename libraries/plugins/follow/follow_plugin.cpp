@@ -194,7 +194,7 @@ struct post_operation_visitor
 
          const auto& feed_idx = db.get_index< feed_index >().indices().get< by_feed >();
 
-         if( db.head_block_time() >= _plugin.start_feeds )
+         if( !_plugin.merge_feeds && db.head_block_time() >= _plugin.start_feeds )
          {
             while( itr != idx.end() && itr->following == op.author )
             {
@@ -349,6 +349,8 @@ void follow_plugin::plugin_set_program_options(
    cli.add_options()
       ("follow-max-feed-size", boost::program_options::value< uint32_t >()->default_value( 500 ), "Set the maximum size of cached feed for an account" )
       ("follow-start-feeds", boost::program_options::value< uint32_t >()->default_value( 0 ), "Block time (in epoch seconds) when to start calculating feeds" )
+      ("follow-feed-mode", boost::program_options::value< string >()->default_value( "fan-out" ), "fan-out to write posts into every follower's feed as blocks are applied, merge to build feeds from blogs when they are read" )
+      ("follow-feed-cache-size", boost::program_options::value< uint32_t >()->default_value( 1000 ), "Number of accounts whose first feed page is cached in merge mode" )
       ;
    cfg.add( cli );
 }
@@ -380,6 +382,20 @@ void follow_plugin::plugin_initialize( const boost::program_options::variables_m
       {
          start_feeds = fc::time_point_sec( options[ "follow-start-feeds" ].as< uint32_t >() );
       }
+
+      if( options.count( "follow-feed-mode" ) )
+      {
+         const string& mode = options[ "follow-feed-mode" ].as< string >();
+         FC_ASSERT( mode == "fan-out" || mode == "merge", "Unknown follow-feed-mode ${m}", ("m",mode) );
+         merge_feeds = mode == "merge";
+      }
+
+      if( merge_feeds )
+      {
+         uint32_t cache_size = options.count( "follow-feed-cache-size" ) ? options[ "follow-feed-cache-size" ].as< uint32_t >() : 1000;
+         feed_merger = std::make_shared< merged_feed >( cache_size );
+         ilog( "Building follow feeds from blogs when they are read" );
+      }
    }
    FC_CAPTURE_AND_RETHROW()
 }
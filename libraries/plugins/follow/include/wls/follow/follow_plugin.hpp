@@ -5,6 +5,7 @@
 #include <fc/thread/future.hpp>
 
 #include <wls/follow/follow_api.hpp>
+#include <wls/follow/merged_feed.hpp>
 
 namespace wls { namespace follow {
 using wls::app::application;
@@ -29,6 +30,10 @@ class follow_plugin : public wls::app::plugin
       std::unique_ptr<detail::follow_plugin_impl> my;
       uint32_t max_feed_size = 500;
       fc::time_point_sec start_feeds;
+
+      /// Feeds are merged from blogs when read rather than written to feed_index, see merged_feed
+      bool merge_feeds = false;
+      std::shared_ptr< merged_feed > feed_merger;
 };
 
 } } //wls::follow
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <wls/chain/database.hpp>
+#include <wls/chain/wls_object_types.hpp>
+
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace wls { namespace follow {
+
+using namespace wls::chain;
+
+/// One entry of a feed built from the blogs of the accounts followed
+struct merged_feed_entry
+{
+   comment_id_type               comment;
+   uint32_t                      entry_id = 0;   ///< the comment id plus one, so that zero still starts at the newest entry
+   time_point_sec                time;           ///< time of the newest post or reblog of the comment among the followed accounts
+   vector< account_name_type >   reblog_by;   ///< followed accounts that reblogged the comment
+   time_point_sec                reblog_on;
+};
+
+/**
+ * Builds feeds when they are read instead of copying every post and reblog into the feed of each
+ * follower as it is applied.
+ *
+ * A feed is a k-way merge of the blog_index entries of every account followed with the blog
+ * flag, newest first, and by comment id among entries of the same second. A comment that several
+ * followed accounts posted or reblogged appears once, at its newest occurrence. Paging with the
+ * entry_id of an entry returns the entries from that one on, as in fan-out mode.
+ *
+ * The first page of recently read feeds is cached until the head block changes.
+ */
+class merged_feed
+{
+   public:
+      merged_feed( uint32_t cache_size ) : _cache_size( cache_size ) {}
+
+      /// Must be called while holding a read lock on db
+      vector< merged_feed_entry > get_feed( const database& db, const account_name_type& account, uint32_t entry_id, uint16_t limit );
+
+   private:
+      vector< merged_feed_entry > merge( const database& db, const account_name_type& account, uint32_t entry_id, uint16_t limit )const;
+
+      struct cached_feed
+      {
+         block_id_type                                      head_block_id;
+         bool                                               complete = false;   ///< entries holds the whole feed
+         vector< merged_feed_entry >                        entries;
+         std::list< account_name_type >::iterator           lru;
+      };
+
+      uint32_t                                              _cache_size = 0;
+      std::mutex                                            _cache_mutex;
+      std::map< account_name_type, cached_feed >            _cache;
+      std::list< account_name_type >                        _lru;   ///< most recently read first
+};
+
+} } // wls::follow
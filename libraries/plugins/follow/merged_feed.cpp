@@ -0,0 +1,212 @@
+#include <wls/follow/merged_feed.hpp>
+#include <wls/follow/follow_objects.hpp>
+
+#include <wls/chain/comment_object.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <set>
+
+namespace wls { namespace follow {
+
+namespace detail
+{
+   typedef blog_index::index< by_blog >::type::const_iterator blog_iterator;
+
+   /// An entry in the blog of one followed account
+   struct blog_cursor
+   {
+      time_point_sec       time;
+      comment_id_type      comment;
+      account_name_type    account;
+      bool                 last = false;   ///< last entry of its second in the blog, popping it moves to the next
+      blog_iterator        next;           ///< first entry of the blog's next second
+
+      bool operator < ( const blog_cursor& other )const
+      {
+         // priority_queue pops the largest, so this puts the newest entry on top
+         if( time != other.time )
+            return time < other.time;
+         return comment < other.comment;
+      }
+   };
+
+   inline time_point_sec entry_time( const database& db, const blog_object& b )
+   {
+      return b.reblogged_on != time_point_sec() ? b.reblogged_on : db.get( b.comment ).created;
+   }
+}
+
+vector< merged_feed_entry > merged_feed::merge( const database& db, const account_name_type& account, uint32_t entry_id, uint16_t limit )const
+{
+   vector< account_name_type > followed;
+   const auto& follow_idx = db.get_index< follow_index >().indices().get< by_follower_following >();
+   for( auto itr = follow_idx.lower_bound( account ); itr != follow_idx.end() && itr->follower == account; ++itr )
+   {
+      if( itr->what & ( 1 << blog ) )
+         followed.push_back( itr->following );
+   }
+
+   const auto& blog_idx = db.get_index< blog_index >().indices().get< by_blog >();
+   const auto& comment_blog_idx = db.get_index< blog_index >().indices().get< by_comment >();
+
+   // Time of the newest post or reblog of the comment among the followed accounts
+   auto newest_entry = [&]( comment_id_type comment ) -> time_point_sec
+   {
+      time_point_sec newest;
+      for( auto itr = comment_blog_idx.lower_bound( comment ); itr != comment_blog_idx.end() && itr->comment == comment; ++itr )
+      {
+         if( std::binary_search( followed.begin(), followed.end(), itr->account ) )
+            newest = std::max( newest, detail::entry_time( db, *itr ) );
+      }
+      return newest;
+   };
+
+   // Entries after the cutoff, in feed order, were returned before the one entry_id refers to
+   detail::blog_cursor cutoff;
+   cutoff.time = time_point_sec::maximum();
+   cutoff.comment = comment_id_type( std::numeric_limits< int64_t >::max() );
+   if( entry_id != 0 )
+   {
+      cutoff.comment = comment_id_type( entry_id - 1 );
+      const auto* comment = db.find( cutoff.comment );
+      FC_ASSERT( comment != nullptr, "Unknown feed entry ${e}", ("e",entry_id) );
+      cutoff.time = newest_entry( cutoff.comment );
+      if( cutoff.time == time_point_sec() )
+         cutoff.time = comment->created;
+   }
+
+   std::priority_queue< detail::blog_cursor > heads;
+
+   /*
+    * Pushes the entries of the newest second of a blog not after the cutoff. Blogs are in time
+    * order but not in comment order within a second, so its entries are all pushed at once for
+    * the heap to order them.
+    */
+   auto push_second = [&]( detail::blog_iterator itr, const account_name_type& a )
+   {
+      while( itr != blog_idx.end() && itr->account == a )
+      {
+         auto time = detail::entry_time( db, *itr );
+         auto end = std::next( itr );
+         while( end != blog_idx.end() && end->account == a && detail::entry_time( db, *end ) == time )
+            ++end;
+
+         if( time <= cutoff.time )
+         {
+            vector< detail::blog_cursor > second;
+            for( ; itr != end; ++itr )
+            {
+               detail::blog_cursor c;
+               c.time = time;
+               c.comment = itr->comment;
+               c.account = a;
+               c.next = end;
+               if( !( cutoff < c ) )
+                  second.push_back( c );
+            }
+
+            if( second.size() )
+            {
+               second.back().last = true;
+               for( const auto& c : second )
+                  heads.push( c );
+               return;
+            }
+         }
+
+         itr = end;
+      }
+   };
+
+   for( const auto& a : followed )
+      push_second( blog_idx.lower_bound( a ), a );
+
+   vector< merged_feed_entry > results;
+   results.reserve( limit );
+   std::set< comment_id_type > seen;
+
+   while( !heads.empty() && results.size() < limit )
+   {
+      detail::blog_cursor top = heads.top();
+      heads.pop();
+      if( top.last )
+         push_second( top.next, top.account );
+
+      if( !seen.insert( top.comment ).second )
+         continue;
+
+      // The comment is only listed at its newest occurrence, which may be on an earlier page
+      if( newest_entry( top.comment ) > top.time )
+         continue;
+
+      const auto& comment = db.get( top.comment );
+      merged_feed_entry entry;
+      entry.comment = top.comment;
+      entry.entry_id = uint32_t( top.comment._id + 1 );
+      entry.time = top.time;
+
+      for( auto itr = comment_blog_idx.lower_bound( top.comment ); itr != comment_blog_idx.end() && itr->comment == top.comment; ++itr )
+      {
+         if( itr->account != comment.author && std::binary_search( followed.begin(), followed.end(), itr->account ) )
+            entry.reblog_by.push_back( itr->account );
+      }
+
+      if( top.account != comment.author )
+         entry.reblog_on = top.time;
+
+      results.push_back( std::move( entry ) );
+   }
+
+   return results;
+}
+
+vector< merged_feed_entry > merged_feed::get_feed( const database& db, const account_name_type& account, uint32_t entry_id, uint16_t limit )
+{
+   if( entry_id != 0 || _cache_size == 0 )
+      return merge( db, account, entry_id, limit );
+
+   block_id_type head_block_id = db.head_block_id();
+
+   {
+      std::lock_guard< std::mutex > guard( _cache_mutex );
+      auto itr = _cache.find( account );
+      if( itr != _cache.end() && itr->second.head_block_id == head_block_id
+         && ( itr->second.complete || itr->second.entries.size() >= limit ) )
+      {
+         _lru.splice( _lru.begin(), _lru, itr->second.lru );
+         const auto& entries = itr->second.entries;
+         return vector< merged_feed_entry >( entries.begin(), entries.begin() + std::min< size_t >( limit, entries.size() ) );
+      }
+   }
+
+   auto result = merge( db, account, 0, limit );
+
+   std::lock_guard< std::mutex > guard( _cache_mutex );
+   auto itr = _cache.find( account );
+   if( itr == _cache.end() )
+   {
+      itr = _cache.emplace( account, cached_feed() ).first;
+      _lru.push_front( account );
+      itr->second.lru = _lru.begin();
+   }
+   else
+   {
+      _lru.splice( _lru.begin(), _lru, itr->second.lru );
+   }
+
+   itr->second.head_block_id = head_block_id;
+   itr->second.complete = result.size() < limit;
+   itr->second.entries = result;
+
+   while( _cache.size() > _cache_size )
+   {
+      _cache.erase( _lru.back() );
+      _lru.pop_back();
+   }
+
+   return result;
+}
+
+} } // wls::follow
@@ -148,30 +148,38 @@ void private_message_plugin::plugin_initialize(const boost::program_options::var
 
 vector< message_api_obj > private_message_api::get_inbox( string to, time_point newest, uint16_t limit )const {
    FC_ASSERT( limit <= 100 );
-   vector< message_api_obj > result;
-   const auto& idx = _app->chain_database()->get_index< message_index >().indices().get< by_to_date >();
-   auto itr = idx.lower_bound( std::make_tuple( to, newest ) );
-   while( itr != idx.end() && limit && itr->to == to ) {
-      result.push_back(*itr);
-      ++itr;
-      --limit;
-   }
+   auto& db = *_app->chain_database();
+   return db.with_read_lock( [&]()
+   {
+      vector< message_api_obj > result;
+      const auto& idx = db.get_index< message_index >().indices().get< by_to_date >();
+      auto itr = idx.lower_bound( std::make_tuple( to, newest ) );
+      while( itr != idx.end() && limit && itr->to == to ) {
+         result.push_back(*itr);
+         ++itr;
+         --limit;
+      }
 
-   return result;
+      return result;
+   });
 }
 
 vector< message_api_obj > private_message_api::get_outbox( string from, time_point newest, uint16_t limit )const {
    FC_ASSERT( limit <= 100 );
-   vector< message_api_obj > result;
-   const auto& idx = _app->chain_database()->get_index< message_index >().indices().get< by_from_date >();
-
-   auto itr = idx.lower_bound( std::make_tuple( from, newest ) );
-   while( itr != idx.end() && limit && itr->from == from ) {
-      result.push_back(*itr);
-      ++itr;
-      --limit;
-   }
-   return result;
+   auto& db = *_app->chain_database();
+   return db.with_read_lock( [&]()
+   {
+      vector< message_api_obj > result;
+      const auto& idx = db.get_index< message_index >().indices().get< by_from_date >();
+
+      auto itr = idx.lower_bound( std::make_tuple( from, newest ) );
+      while( itr != idx.end() && limit && itr->from == from ) {
+         result.push_back(*itr);
+         ++itr;
+         --limit;
+      }
+      return result;
+   });
 }
 
 void private_message_plugin::plugin_startup()
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <wls/tags/tags_plugin.hpp>
+
+#include <wls/chain/operation_notification.hpp>
+
+#include <boost/multi_index/hashed_index.hpp>
+
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
+namespace wls { namespace tags {
+
+/// Parses the tags of a comment from its json_metadata, adding the universal tag when its payout is not negative
+comment_metadata filter_tags( const comment_object& c );
+
+double calculate_hot( const share_type& score, const time_point_sec& created );
+double calculate_trending( const share_type& score, const time_point_sec& created );
+
+/**
+ * The ranked values of a comment in one tag, matching the fields of tag_object.
+ */
+struct ranking_entry
+{
+   comment_id_type   comment;
+   comment_id_type   parent;
+   account_id_type   author;
+   time_point_sec    created;
+   time_point_sec    active;
+   time_point_sec    cashout;
+   int64_t           net_rshares = 0;
+   int32_t           net_votes   = 0;
+   int32_t           children    = 0;
+   double            hot         = 0;
+   double            trending    = 0;
+
+   bool is_post()const { return parent == comment_id_type(); }
+};
+
+/**
+ * One sorted index for each get_discussions_by_* query. There is one container for each tag,
+ * so unlike tag_index the tag name is not part of any key.
+ */
+typedef multi_index_container<
+   ranking_entry,
+   indexed_by<
+      hashed_unique< tag< by_comment >, member< ranking_entry, comment_id_type, &ranking_entry::comment > >,
+      ordered_unique< tag< by_parent_created >,
+         composite_key< ranking_entry,
+            member< ranking_entry, comment_id_type, &ranking_entry::parent >,
+            member< ranking_entry, time_point_sec, &ranking_entry::created >,
+            member< ranking_entry, comment_id_type, &ranking_entry::comment >
+         >,
+         composite_key_compare< std::less< comment_id_type >, std::greater< time_point_sec >, std::less< comment_id_type > >
+      >,
+      ordered_unique< tag< by_parent_active >,
+         composite_key< ranking_entry,
+            member< ranking_entry, comment_id_type, &ranking_entry::parent >,
+            member< ranking_entry, time_point_sec, &ranking_entry::active >,
+            member< ranking_entry, comment_id_type, &ranking_entry::comment >
+         >,
+         composite_key_compare< std::less< comment_id_type >, std::greater< time_point_sec >, std::less< comment_id_type > >
+      >,
+      ordered_unique< tag< by_parent_net_votes >,
+         composite_key< ranking_entry,
+            member< ranking_entry, comment_id_type, &ranking_entry::parent >,
+            member< ranking_entry, int32_t, &ranking_entry::net_votes >,
+            member< ranking_entry, comment_id_type, &ranking_entry::comment >
+         >,
+         composite_key_compare< std::less< comment_id_type >, std::greater< int32_t >, std::less< comment_id_type > >
+      >,
+      ordered_unique< tag< by_parent_children >,
+         composite_key< ranking_entry,
+            member< ranking_entry, comment_id_type, &ranking_entry::parent >,
+            member< ranking_entry, int32_t, &ranking_entry::children >,
+            member< ranking_entry, comment_id_type, &ranking_entry::comment >
+         >,
+         composite_key_compare< std::less< comment_id_type >, std::greater< int32_t >, std::less< comment_id_type > >
+      >,
+      ordered_unique< tag< by_parent_hot >,
+         composite_key< ranking_entry,
+            member< ranking_entry, comment_id_type, &ranking_entry::parent >,
+            member< ranking_entry, double, &ranking_entry::hot >,
+            member< ranking_entry, comment_id_type, &ranking_entry::comment >
+         >,
+         composite_key_compare< std::less< comment_id_type >, std::greater< double >, std::less< comment_id_type > >
+      >,
+      ordered_unique< tag< by_parent_trending >,
+         composite_key< ranking_entry,
+            member< ranking_entry, comment_id_type, &ranking_entry::parent >,
+            member< ranking_entry, double, &ranking_entry::trending >,
+            member< ranking_entry, comment_id_type, &ranking_entry::comment >
+         >,
+         composite_key_compare< std::less< comment_id_type >, std::greater< double >, std::less< comment_id_type > >
+      >,
+      ordered_unique< tag< by_cashout >,
+         composite_key< ranking_entry,
+            member< ranking_entry, time_point_sec, &ranking_entry::cashout >,
+            member< ranking_entry, comment_id_type, &ranking_entry::comment >
+         >,
+         composite_key_compare< std::less< time_point_sec >, std::less< comment_id_type > >
+      >,
+      ordered_unique< tag< by_net_rshares >,
+         composite_key< ranking_entry,
+            member< ranking_entry, int64_t, &ranking_entry::net_rshares >,
+            member< ranking_entry, comment_id_type, &ranking_entry::comment >
+         >,
+         composite_key_compare< std::greater< int64_t >, std::less< comment_id_type > >
+      >,
+      ordered_unique< tag< by_reward_fund_net_rshares >,
+         composite_key< ranking_entry,
+            const_mem_fun< ranking_entry, bool, &ranking_entry::is_post >,
+            member< ranking_entry, int64_t, &ranking_entry::net_rshares >,
+            member< ranking_entry, comment_id_type, &ranking_entry::comment >
+         >,
+         composite_key_compare< std::less< bool >, std::greater< int64_t >, std::less< comment_id_type > >
+      >
+   >
+> ranking_entry_index;
+
+enum ranking_sort
+{
+   rank_by_created,
+   rank_by_active,
+   rank_by_votes,
+   rank_by_children,
+   rank_by_hot,
+   rank_by_trending,
+   rank_by_cashout,
+   rank_by_payout,            ///< all comments by net_rshares
+   rank_by_post_payout,       ///< top level posts first by net_rshares
+   rank_by_comment_payout     ///< replies first by net_rshares
+};
+
+struct ranking_query
+{
+   ranking_sort                  sort = rank_by_trending;
+   string                        tag;
+   comment_id_type               parent;
+   bool                          ignore_parent = false;  ///< otherwise the walk stops at the first entry with another parent
+   optional< comment_id_type >   start;                  ///< start at this comment when it is ranked in tag
+   time_point_sec                min_cashout;            ///< rank_by_cashout starts at the first cashout at or after this time
+};
+
+/// The same sums tag_stats_object keeps, over the comments currently ranked in a tag
+struct tag_ranking_stats
+{
+   string            tag;
+   int32_t           net_votes = 0;
+   uint32_t          top_posts = 0;
+   uint32_t          comments  = 0;
+   uint64_t          total_trending = 0;
+};
+
+struct tag_ranking_index_stats
+{
+   uint64_t                tags = 0;
+   uint64_t                comments = 0;
+   uint64_t                entries = 0;
+   uint32_t                head_block_num = 0;
+   uint64_t                blocks = 0;               ///< batches applied since startup
+   uint64_t                comments_updated = 0;     ///< comments updated by those batches
+   uint64_t                fork_comments_updated = 0;///< comments updated again because their block was popped
+   fc::microseconds        update_time;              ///< spent applying batches
+   fc::microseconds        rebuild_time;
+};
+
+/**
+ * An alternative to tag_index for serving the get_discussions_by_* queries, kept in process
+ * memory instead of the shared memory file.
+ *
+ * Operations only mark the comments they touch. Once per block, each marked comment is read
+ * back from comment_index and its entries are replaced in the containers of its tags, so a
+ * post receiving many votes in a block is reranked once and nothing is written to the undo
+ * state. When a block is popped, the comments it touched are marked again and reread with
+ * the next block, which is applied on top of the fork point.
+ *
+ * The index is rebuilt from comment_index by start(). Like the rest of the chain state, it is
+ * guarded by the database lock: it is updated under the write lock while applying blocks and
+ * may be read under a read lock.
+ */
+class tag_ranking_index
+{
+   public:
+      explicit tag_ranking_index( database& db );
+      ~tag_ranking_index();
+
+      /// Rebuilds the index from comment_index and starts following applied operations and blocks
+      void start();
+      void stop();
+
+      /// Reranks the comment with the next block, parse_tags rereads its json_metadata
+      void mark_dirty( comment_id_type comment, bool parse_tags = false );
+
+      /// Calls f with the comments ranked by q.sort in q.tag until it returns false
+      void visit( const ranking_query& q, const std::function< bool( const ranking_entry& ) >& f )const;
+
+      bool has_tag( comment_id_type comment, const string& tag )const;
+
+      /// Tags by total_trending, starting from the position of the first tag at or after after_tag
+      vector< tag_ranking_stats > get_trending_tags( const string& after_tag, uint32_t limit )const;
+
+      /// The tags of the ranked posts of an author, by number of posts
+      vector< pair< string, uint32_t > > get_tags_used_by_author( account_id_type author )const;
+
+      tag_ranking_index_stats get_stats()const;
+
+   private:
+      struct ranked_comment
+      {
+         vector< string >     tags;
+         comment_id_type      parent;
+         account_id_type      author;
+      };
+
+      struct tag_ranking
+      {
+         ranking_entry_index  entries;
+         tag_ranking_stats    stats;
+      };
+
+      typedef std::unordered_map< comment_id_type, bool, boost::hash< comment_id_type > > dirty_set;
+
+      /// Orders tags as tag_stats_index by_trending does
+      struct trending_order
+      {
+         bool operator()( const pair< uint64_t, string >& a, const pair< uint64_t, string >& b )const
+         {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+         }
+      };
+
+      void on_pre_operation( const operation_notification& note );
+      void on_operation( const operation_notification& note );
+      void on_block( const signed_block& b );
+
+      void mark_dirty_with_parents( const comment_object& c, bool parse_tags );
+      void apply_block( uint32_t block_num );
+      void update_comment( comment_id_type id, bool parse_tags );
+      void remove_comment( comment_id_type id );
+      void remove_entry( tag_ranking& t, const string& tag, ranking_entry_index::iterator itr );
+      void add_stats( tag_ranking& t, const ranking_entry& e, int sign );
+
+      database&                                             _db;
+      std::map< string, tag_ranking >                       _tags;
+      std::unordered_map< comment_id_type, ranked_comment, boost::hash< comment_id_type > > _comments;
+      std::map< pair< account_id_type, string >, uint32_t > _author_posts;
+      std::set< pair< uint64_t, string >, trending_order > _trending_tags;
+
+      dirty_set                                             _dirty;
+      std::deque< pair< uint32_t, vector< comment_id_type > > > _reversible_blocks;   ///< comments touched by each reversible block
+      uint32_t                                              _head_block_num = 0;
+      bool                                                  _started = false;
+      tag_ranking_index_stats                               _stats;
+
+      boost::signals2::connection                           _pre_operation_connection;
+      boost::signals2::connection                           _operation_connection;
+      boost::signals2::connection                           _block_connection;
+};
+
+} } // wls::tags
+
+FC_REFLECT( wls::tags::tag_ranking_stats, (tag)(net_votes)(top_posts)(comments)(total_trending) )
+FC_REFLECT( wls::tags::tag_ranking_index_stats,
+   (tags)(comments)(entries)(head_block_num)(blocks)(comments_updated)(fork_comments_updated)(update_time)(rebuild_time) )
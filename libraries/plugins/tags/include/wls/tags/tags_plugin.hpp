@@ -51,6 +51,8 @@ enum
 
 namespace detail { class tags_plugin_impl; }
 
+class tag_ranking_index;
+
 
 /**
  *  The purpose of the tag object is to allow the generation and listing of
@@ -465,6 +467,9 @@ class tags_plugin : public wls::app::plugin
       virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
 
+      /// The in-memory rankings serving get_discussions_by_*, null when they are kept in tag_index
+      std::shared_ptr< tag_ranking_index > get_ranking_index()const;
+
       friend class detail::tags_plugin_impl;
       std::unique_ptr<detail::tags_plugin_impl> my;
 };
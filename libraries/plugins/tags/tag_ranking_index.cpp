@@ -0,0 +1,498 @@
+#include <wls/tags/tag_ranking_index.hpp>
+
+#include <wls/chain/account_object.hpp>
+#include <wls/chain/comment_object.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/string.hpp>
+
+namespace wls { namespace tags {
+
+using namespace wls::protocol;
+
+namespace detail {
+
+   /**
+    * https://medium.com/hacking-and-gonzo/how-reddit-ranking-algorithms-work-ef111e33d0d9#.lcbj6auuw
+    */
+   template< int64_t S, int32_t T >
+   double calculate_score( const share_type& score, const time_point_sec& created )
+   {
+      /// new algorithm
+      auto mod_score = score.value / S;
+
+      /// reddit algorithm
+      double order = log10( std::max<int64_t>( std::abs( mod_score ), 1) );
+      int sign = 0;
+      if( mod_score > 0 ) sign = 1;
+      else if( mod_score < 0 ) sign = -1;
+
+      return sign * order + double( created.sec_since_epoch() ) / double( T );
+   }
+
+   /// Walks one sorted index of a tag from start, or from the start of the query when it is not ranked there
+   template< typename Tag, typename Itr >
+   void visit_sorted( const ranking_entry_index& entries, Itr itr, const ranking_query& q,
+                      const std::function< bool( const ranking_entry& ) >& f )
+   {
+      const auto& idx = entries.get< Tag >();
+      if( q.start )
+      {
+         auto start = entries.find( *q.start );
+         if( start != entries.end() )
+            itr = entries.project< Tag >( start );
+      }
+
+      for( ; itr != idx.end(); ++itr )
+      {
+         if( !q.ignore_parent && itr->parent != q.parent )
+            break;
+         if( !f( *itr ) )
+            break;
+      }
+   }
+
+} // detail
+
+comment_metadata filter_tags( const comment_object& c )
+{
+   comment_metadata meta;
+
+   if( c.json_metadata.size() )
+   {
+      try
+      {
+         meta = fc::json::from_string( to_string( c.json_metadata ) ).as< comment_metadata >();
+      }
+      catch( const fc::exception& e )
+      {
+         // Do nothing on malformed json_metadata
+      }
+   }
+
+   // We need to write the transformed tags into a temporary
+   // local container because we can't modify meta.tags concurrently
+   // as we iterate over it.
+   set< string > lower_tags;
+
+   uint8_t tag_limit = 5;
+   uint8_t count = 0;
+   for( const string& tag : meta.tags )
+   {
+      ++count;
+      if( count > tag_limit || lower_tags.size() > tag_limit )
+         break;
+      if( tag == "" )
+         continue;
+      lower_tags.insert( fc::to_lower( tag ) );
+   }
+
+   /// the universal tag applies to everything safe for work or nsfw with a non-negative payout
+   if( c.net_rshares >= 0 )
+   {
+      lower_tags.insert( string() ); /// add it to the universal tag
+   }
+
+   meta.tags = lower_tags; /// TODO: std::move???
+
+   return meta;
+}
+
+double calculate_hot( const share_type& score, const time_point_sec& created )
+{
+   return detail::calculate_score< 10000000, 10000 >( score, created );
+}
+
+double calculate_trending( const share_type& score, const time_point_sec& created )
+{
+   return detail::calculate_score< 10000000, 480000 >( score, created );
+}
+
+tag_ranking_index::tag_ranking_index( database& db ) : _db( db ) {}
+
+tag_ranking_index::~tag_ranking_index()
+{
+   stop();
+}
+
+void tag_ranking_index::start()
+{
+   FC_ASSERT( !_started, "The tag ranking index is already started" );
+
+   auto start = fc::time_point::now();
+   const auto& idx = _db.get_index< comment_index >().indices();
+   for( const auto& c : idx )
+      update_comment( c.id, true );
+
+   _head_block_num = _db.head_block_num();
+   _stats.rebuild_time = fc::time_point::now() - start;
+   _started = true;
+
+   _pre_operation_connection = _db.pre_apply_operation.connect( [this]( const operation_notification& note ){ on_pre_operation( note ); } );
+   _operation_connection = _db.post_apply_operation.connect( [this]( const operation_notification& note ){ on_operation( note ); } );
+   _block_connection = _db.applied_block.connect( [this]( const signed_block& b ){ on_block( b ); } );
+
+   ilog( "Ranked ${e} tag entries of ${c} comments in ${t} tags in ${ms}ms",
+      ("e", get_stats().entries)("c", _comments.size())("t", _tags.size())("ms", _stats.rebuild_time.count() / 1000) );
+}
+
+void tag_ranking_index::stop()
+{
+   _pre_operation_connection.disconnect();
+   _operation_connection.disconnect();
+   _block_connection.disconnect();
+   _started = false;
+}
+
+void tag_ranking_index::mark_dirty( comment_id_type comment, bool parse_tags )
+{
+   auto& parse = _dirty[ comment ];
+   parse = parse || parse_tags;
+}
+
+void tag_ranking_index::mark_dirty_with_parents( const comment_object& c, bool parse_tags )
+{
+   mark_dirty( c.id, parse_tags );
+
+   /// replies change the children and active time of every comment above them
+   const comment_object* parent = &c;
+   while( parent->parent_author.size() )
+   {
+      parent = &_db.get_comment( parent->parent_author, parent->parent_permlink );
+      mark_dirty( parent->id );
+   }
+}
+
+void tag_ranking_index::on_pre_operation( const operation_notification& note )
+{
+   /// the comment is gone once the operation is applied
+   if( note.op.which() != operation::tag< delete_comment_operation >::value )
+      return;
+
+   try
+   {
+      const auto& op = note.op.get< delete_comment_operation >();
+      const auto* c = _db.find_comment( op.author, op.permlink );
+      if( c != nullptr )
+         mark_dirty_with_parents( *c, false );
+   }
+   catch( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+   }
+}
+
+void tag_ranking_index::on_operation( const operation_notification& note )
+{
+   try
+   {
+      switch( note.op.which() )
+      {
+         case operation::tag< comment_operation >::value:
+         {
+            const auto& op = note.op.get< comment_operation >();
+            mark_dirty_with_parents( _db.get_comment( op.author, op.permlink ), true );
+            break;
+         }
+         case operation::tag< vote_operation >::value:
+         {
+            const auto& op = note.op.get< vote_operation >();
+            mark_dirty( _db.get_comment( op.author, op.permlink ).id );
+            break;
+         }
+         case operation::tag< comment_reward_operation >::value:
+         {
+            const auto& op = note.op.get< comment_reward_operation >();
+            mark_dirty( _db.get_comment( op.author, op.permlink ).id );
+            break;
+         }
+         case operation::tag< comment_payout_update_operation >::value:
+         {
+            const auto& op = note.op.get< comment_payout_update_operation >();
+            mark_dirty( _db.get_comment( op.author, op.permlink ).id );
+            break;
+         }
+         default:
+            break;
+      }
+   }
+   catch( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+   }
+}
+
+void tag_ranking_index::on_block( const signed_block& b )
+{
+   /// plugins shouldn't ever throw
+   try
+   {
+      apply_block( b.block_num() );
+   }
+   catch( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+   }
+}
+
+void tag_ranking_index::apply_block( uint32_t block_num )
+{
+   auto start = fc::time_point::now();
+
+   /// Blocks at or above this one were popped, so what they touched is reread from the state on top of the fork point
+   while( _reversible_blocks.size() && _reversible_blocks.back().first >= block_num )
+   {
+      for( const auto& id : _reversible_blocks.back().second )
+      {
+         mark_dirty( id, true );
+         ++_stats.fork_comments_updated;
+      }
+      _reversible_blocks.pop_back();
+   }
+
+   vector< comment_id_type > touched;
+   touched.reserve( _dirty.size() );
+
+   dirty_set dirty;
+   std::swap( dirty, _dirty );
+   for( const auto& item : dirty )
+   {
+      update_comment( item.first, item.second );
+      touched.push_back( item.first );
+   }
+
+   _reversible_blocks.emplace_back( block_num, std::move( touched ) );
+
+   auto last_irreversible = _db.get_dynamic_global_properties().last_irreversible_block_num;
+   while( _reversible_blocks.size() && _reversible_blocks.front().first <= last_irreversible )
+      _reversible_blocks.pop_front();
+
+   _head_block_num = block_num;
+   _stats.comments_updated += dirty.size();
+   ++_stats.blocks;
+   _stats.update_time += fc::time_point::now() - start;
+}
+
+void tag_ranking_index::update_comment( comment_id_type id, bool parse_tags )
+{
+   const auto* c = _db.find< comment_object >( id );
+   if( c == nullptr || c->cashout_time == fc::time_point_sec::maximum() )
+   {
+      remove_comment( id );
+      return;
+   }
+
+   auto citr = _comments.find( id );
+   if( citr == _comments.end() || parse_tags )
+   {
+      ranked_comment rc;
+      for( const auto& tag : filter_tags( *c ).tags )
+         rc.tags.push_back( tag );
+
+      if( c->parent_author.size() )
+         rc.parent = _db.get_comment( c->parent_author, c->parent_permlink ).id;
+      rc.author = _db.get_account( c->author ).id;
+
+      /// the id may have been taken by another comment after a fork, so nothing of the old entries is kept
+      if( citr != _comments.end() )
+      {
+         const auto& old = citr->second;
+         for( const auto& tag : old.tags )
+         {
+            if( old.parent == rc.parent && old.author == rc.author && std::find( rc.tags.begin(), rc.tags.end(), tag ) != rc.tags.end() )
+               continue;
+            auto titr = _tags.find( tag );
+            if( titr == _tags.end() )
+               continue;
+            auto eitr = titr->second.entries.find( id );
+            if( eitr != titr->second.entries.end() )
+               remove_entry( titr->second, tag, eitr );
+         }
+         citr->second = std::move( rc );
+      }
+      else
+      {
+         citr = _comments.emplace( id, std::move( rc ) ).first;
+      }
+   }
+
+   const auto& rc = citr->second;
+
+   ranking_entry e;
+   e.comment     = id;
+   e.parent      = rc.parent;
+   e.author      = rc.author;
+   e.created     = c->created;
+   e.active      = c->active;
+   e.cashout     = _db.calculate_discussion_payout_time( *c );
+   e.net_rshares = c->net_rshares.value;
+   e.net_votes   = c->net_votes;
+   e.children    = c->children;
+   e.hot         = calculate_hot( c->net_rshares, c->created );
+   e.trending    = calculate_trending( c->net_rshares, c->created );
+
+   for( const auto& tag : rc.tags )
+   {
+      auto& t = _tags[ tag ];
+      t.stats.tag = tag;
+      _trending_tags.erase( std::make_pair( t.stats.total_trending, tag ) );
+
+      auto eitr = t.entries.find( id );
+      if( eitr != t.entries.end() )
+      {
+         add_stats( t, *eitr, -1 );
+         t.entries.replace( eitr, e );
+      }
+      else
+      {
+         t.entries.insert( e );
+         ++_author_posts[ std::make_pair( e.author, tag ) ];
+      }
+
+      add_stats( t, e, 1 );
+      _trending_tags.emplace( t.stats.total_trending, tag );
+   }
+}
+
+void tag_ranking_index::remove_comment( comment_id_type id )
+{
+   auto citr = _comments.find( id );
+   if( citr == _comments.end() )
+      return;
+
+   for( const auto& tag : citr->second.tags )
+   {
+      auto titr = _tags.find( tag );
+      if( titr == _tags.end() )
+         continue;
+      auto eitr = titr->second.entries.find( id );
+      if( eitr != titr->second.entries.end() )
+         remove_entry( titr->second, tag, eitr );
+   }
+
+   _comments.erase( citr );
+}
+
+void tag_ranking_index::remove_entry( tag_ranking& t, const string& tag, ranking_entry_index::iterator itr )
+{
+   _trending_tags.erase( std::make_pair( t.stats.total_trending, tag ) );
+   add_stats( t, *itr, -1 );
+
+   auto aitr = _author_posts.find( std::make_pair( itr->author, tag ) );
+   if( aitr != _author_posts.end() && --aitr->second == 0 )
+      _author_posts.erase( aitr );
+
+   t.entries.erase( itr );
+
+   if( t.entries.empty() )
+      _tags.erase( tag );
+   else
+      _trending_tags.emplace( t.stats.total_trending, tag );
+}
+
+void tag_ranking_index::add_stats( tag_ranking& t, const ranking_entry& e, int sign )
+{
+   if( e.is_post() )
+      t.stats.top_posts += sign;
+   else
+      t.stats.comments += sign;
+   t.stats.total_trending += sign * int64_t( static_cast< uint32_t >( e.trending ) );
+   t.stats.net_votes += sign * e.net_votes;
+}
+
+void tag_ranking_index::visit( const ranking_query& q, const std::function< bool( const ranking_entry& ) >& f )const
+{
+   auto titr = _tags.find( q.tag );
+   if( titr == _tags.end() )
+      return;
+
+   const auto& entries = titr->second.entries;
+   switch( q.sort )
+   {
+      case rank_by_created:
+         detail::visit_sorted< by_parent_created >( entries, entries.get< by_parent_created >().lower_bound( q.parent ), q, f );
+         break;
+      case rank_by_active:
+         detail::visit_sorted< by_parent_active >( entries, entries.get< by_parent_active >().lower_bound( q.parent ), q, f );
+         break;
+      case rank_by_votes:
+         detail::visit_sorted< by_parent_net_votes >( entries, entries.get< by_parent_net_votes >().lower_bound( q.parent ), q, f );
+         break;
+      case rank_by_children:
+         detail::visit_sorted< by_parent_children >( entries, entries.get< by_parent_children >().lower_bound( q.parent ), q, f );
+         break;
+      case rank_by_hot:
+         detail::visit_sorted< by_parent_hot >( entries, entries.get< by_parent_hot >().lower_bound( q.parent ), q, f );
+         break;
+      case rank_by_trending:
+         detail::visit_sorted< by_parent_trending >( entries, entries.get< by_parent_trending >().lower_bound( q.parent ), q, f );
+         break;
+      case rank_by_cashout:
+         detail::visit_sorted< by_cashout >( entries, entries.get< by_cashout >().lower_bound( q.min_cashout ), q, f );
+         break;
+      case rank_by_payout:
+         detail::visit_sorted< by_net_rshares >( entries, entries.get< by_net_rshares >().begin(), q, f );
+         break;
+      case rank_by_post_payout:
+         detail::visit_sorted< by_reward_fund_net_rshares >( entries, entries.get< by_reward_fund_net_rshares >().lower_bound( true ), q, f );
+         break;
+      case rank_by_comment_payout:
+         detail::visit_sorted< by_reward_fund_net_rshares >( entries, entries.get< by_reward_fund_net_rshares >().lower_bound( false ), q, f );
+         break;
+   }
+}
+
+bool tag_ranking_index::has_tag( comment_id_type comment, const string& tag )const
+{
+   auto citr = _comments.find( comment );
+   return citr != _comments.end() && std::find( citr->second.tags.begin(), citr->second.tags.end(), tag ) != citr->second.tags.end();
+}
+
+vector< tag_ranking_stats > tag_ranking_index::get_trending_tags( const string& after_tag, uint32_t limit )const
+{
+   vector< tag_ranking_stats > result;
+
+   auto itr = _trending_tags.begin();
+   if( after_tag != "" && _tags.size() )
+   {
+      auto titr = _tags.lower_bound( after_tag );
+      if( titr == _tags.end() )
+         itr = _trending_tags.end();
+      else
+         itr = _trending_tags.find( std::make_pair( titr->second.stats.total_trending, titr->first ) );
+   }
+
+   for( ; itr != _trending_tags.end() && result.size() < limit; ++itr )
+      result.push_back( _tags.at( itr->second ).stats );
+
+   return result;
+}
+
+vector< pair< string, uint32_t > > tag_ranking_index::get_tags_used_by_author( account_id_type author )const
+{
+   vector< pair< string, uint32_t > > result;
+   for( auto itr = _author_posts.lower_bound( std::make_pair( author, string() ) );
+        itr != _author_posts.end() && itr->first.first == author; ++itr )
+   {
+      result.emplace_back( itr->first.second, itr->second );
+   }
+
+   std::stable_sort( result.begin(), result.end(), []( const pair< string, uint32_t >& a, const pair< string, uint32_t >& b )
+   {
+      return a.second > b.second;
+   });
+   return result;
+}
+
+tag_ranking_index_stats tag_ranking_index::get_stats()const
+{
+   auto stats = _stats;
+   stats.tags = _tags.size();
+   stats.comments = _comments.size();
+   stats.head_block_num = _head_block_num;
+   for( const auto& t : _tags )
+      stats.entries += t.second.entries.size();
+   return stats;
+}
+
+} } // wls::tags
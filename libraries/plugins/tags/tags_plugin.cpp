@@ -1,4 +1,5 @@
 #include <wls/tags/tags_plugin.hpp>
+#include <wls/tags/tag_ranking_index.hpp>
 
 #include <wls/app/impacted.hpp>
 
@@ -41,6 +42,7 @@ class tags_plugin_impl
       void on_operation( const operation_notification& note );
 
       tags_plugin& _self;
+      std::shared_ptr< tag_ranking_index > _ranking;   ///< set when the rankings are kept in process memory
 };
 
 tags_plugin_impl::~tags_plugin_impl()
@@ -118,50 +120,6 @@ struct operation_visitor
       });
    }
 
-   comment_metadata filter_tags( const comment_object& c ) const
-   {
-      comment_metadata meta;
-
-      if( c.json_metadata.size() )
-      {
-         try
-         {
-            meta = fc::json::from_string( to_string( c.json_metadata ) ).as< comment_metadata >();
-         }
-         catch( const fc::exception& e )
-         {
-            // Do nothing on malformed json_metadata
-         }
-      }
-
-      // We need to write the transformed tags into a temporary
-      // local container because we can't modify meta.tags concurrently
-      // as we iterate over it.
-      set< string > lower_tags;
-
-      uint8_t tag_limit = 5;
-      uint8_t count = 0;
-      for( const string& tag : meta.tags )
-      {
-         ++count;
-         if( count > tag_limit || lower_tags.size() > tag_limit )
-            break;
-         if( tag == "" )
-            continue;
-         lower_tags.insert( fc::to_lower( tag ) );
-      }
-
-      /// the universal tag applies to everything safe for work or nsfw with a non-negative payout
-      if( c.net_rshares >= 0 )
-      {
-         lower_tags.insert( string() ); /// add it to the universal tag
-      }
-
-      meta.tags = lower_tags; /// TODO: std::move???
-
-      return meta;
-   }
-
    void update_tag( const tag_object& current, const comment_object& comment, double hot, double trending )const
    {
        const auto& stats = get_stats( current.tag );
@@ -230,34 +188,6 @@ struct operation_visitor
    }
 
 
-   /**
-    * https://medium.com/hacking-and-gonzo/how-reddit-ranking-algorithms-work-ef111e33d0d9#.lcbj6auuw
-    */
-   template< int64_t S, int32_t T >
-   double calculate_score( const share_type& score, const time_point_sec& created ) const
-   {
-      /// new algorithm
-      auto mod_score = score.value / S;
-
-      /// reddit algorithm
-      double order = log10( std::max<int64_t>( std::abs( mod_score ), 1) );
-      int sign = 0;
-      if( mod_score > 0 ) sign = 1;
-      else if( mod_score < 0 ) sign = -1;
-
-      return sign * order + double( created.sec_since_epoch() ) / double( T );
-   }
-
-   inline double calculate_hot( const share_type& score, const time_point_sec& created )const
-   {
-      return calculate_score< 10000000, 10000 >( score, created );
-   }
-
-   inline double calculate_trending( const share_type& score, const time_point_sec& created )const
-   {
-      return calculate_score< 10000000, 480000 >( score, created );
-   }
-
    /** finds tags that have been added or removed or updated */
    void update_tags( const comment_object& c, bool parse_tags = false )const
    {
@@ -424,22 +354,26 @@ struct operation_visitor
       }
    }
 
-   void operator()( const comment_reward_operation& op )const
+   void add_payout( const comment_object& c, const asset& payout )const
    {
-      const auto& c = _db.get_comment( op.author, op.permlink );
-      update_tags( c );
-
       comment_metadata meta = filter_tags( c );
 
       for( const string& tag : meta.tags )
       {
          _db.modify( get_stats( tag ), [&]( tag_stats_object& ts )
          {
-            ts.total_payout += op.payout;
+            ts.total_payout += payout;
          });
       }
    }
 
+   void operator()( const comment_reward_operation& op )const
+   {
+      const auto& c = _db.get_comment( op.author, op.permlink );
+      update_tags( c );
+      add_payout( c, op.payout );
+   }
+
    void operator()( const comment_payout_update_operation& op )const
    {
       const auto& c = _db.get_comment( op.author, op.permlink );
@@ -456,7 +390,16 @@ void tags_plugin_impl::on_operation( const operation_notification& note ) {
    try
    {
       /// plugins shouldn't ever throw
-      note.op.visit( operation_visitor( database() ) );
+      if( !_ranking )
+      {
+         note.op.visit( operation_visitor( database() ) );
+      }
+      else if( note.op.which() == operation::tag< comment_reward_operation >::value )
+      {
+         /// tag_ranking_index follows the other operations itself, only the payout totals stay in tag_stats_object
+         const auto& op = note.op.get< comment_reward_operation >();
+         operation_visitor( database() ).add_payout( database().get_comment( op.author, op.permlink ), op.payout );
+      }
    }
    catch ( const fc::exception& e )
    {
@@ -489,11 +432,24 @@ void tags_plugin::plugin_set_program_options(
    boost::program_options::options_description& cfg
    )
 {
+   cfg.add_options()
+      ("tags-ranking-engine", boost::program_options::value< string >()->default_value( "chainbase" ),
+         "Where discussion rankings are kept: chainbase (tag objects in shared memory, updated by every operation) "
+         "or memory (rebuilt from the comments at startup, updated once per block). Going back to chainbase requires a replay")
+      ;
 }
 
 void tags_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 {
    ilog("Intializing tags plugin" );
+
+   if( options.count( "tags-ranking-engine" ) )
+   {
+      auto engine = options.at( "tags-ranking-engine" ).as< string >();
+      FC_ASSERT( engine == "chainbase" || engine == "memory", "Unknown tags-ranking-engine ${e}", ("e", engine) );
+      if( engine == "memory" )
+         my->_ranking = std::make_shared< tag_ranking_index >( database() );
+   }
    database().post_apply_operation.connect( [&]( const operation_notification& note){ my->on_operation(note); } );
 
    app().register_api_factory<tag_api>("tag_api");
@@ -502,6 +458,19 @@ void tags_plugin::plugin_initialize(const boost::program_options::variables_map&
 
 void tags_plugin::plugin_startup()
 {
+   if( my->_ranking )
+   {
+      chain::database& db = database();
+      db.with_read_lock( [&]()
+      {
+         my->_ranking->start();
+      });
+   }
+}
+
+std::shared_ptr< tag_ranking_index > tags_plugin::get_ranking_index()const
+{
+   return my->_ranking;
 }
 
 } } /// wls::tags
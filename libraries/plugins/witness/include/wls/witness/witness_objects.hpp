@@ -3,6 +3,7 @@
 #include <wls/chain/wls_object_types.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 
 namespace wls { namespace witness {
 
@@ -122,7 +123,7 @@ typedef multi_index_container <
    indexed_by <
       ordered_unique< tag< by_id >,
          member< account_bandwidth_object, account_bandwidth_id_type, &account_bandwidth_object::id > >,
-      ordered_unique< tag< by_account_bandwidth_type >,
+      hashed_unique< tag< by_account_bandwidth_type >,
          composite_key< account_bandwidth_object,
             member< account_bandwidth_object, account_name_type, &account_bandwidth_object::account >,
             member< account_bandwidth_object, bandwidth_type, &account_bandwidth_object::type >
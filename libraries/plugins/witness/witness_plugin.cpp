@@ -207,7 +207,7 @@ namespace detail
                "Comment is nested ${x} posts deep, maximum depth is ${y}.", ("x",parent->depth)("y",WLS_SOFT_MAX_COMMENT_DEPTH) );
          }
 
-         auto itr = _db.find< comment_object, by_permlink >( boost::make_tuple( o.author, o.permlink ) );
+         auto itr = _db.find< comment_object, by_permlink_hash >( boost::make_tuple( o.author, o.permlink ) );
 
          if( itr != nullptr && itr->cashout_time == fc::time_point_sec::maximum() )
          {
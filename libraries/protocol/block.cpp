@@ -16,8 +16,12 @@ namespace wls { namespace protocol {
 
    block_id_type signed_block_header::id()const
    {
-      auto tmp = fc::sha224::hash( *this );
-      tmp._hash[0] = fc::endian_reverse_u32(block_num()); // store the block num in the ID, 160 bits is plenty for the hash
+      return id_from_hash( fc::sha224::hash( *this ), block_num() );
+   }
+
+   block_id_type signed_block_header::id_from_hash( fc::sha224 tmp, uint32_t block_num )
+   {
+      tmp._hash[0] = fc::endian_reverse_u32(block_num); // store the block num in the ID, 160 bits is plenty for the hash
       static_assert( sizeof(tmp._hash[0]) == 4, "should be 4 bytes" );
       block_id_type result;
       memcpy(result._hash, tmp._hash, std::min(sizeof(result), sizeof(tmp)));
@@ -49,6 +53,14 @@ namespace wls { namespace protocol {
       for( uint32_t i = 0; i < transactions.size(); ++i )
          ids[i] = transactions[i].merkle_digest();
 
+      return calculate_merkle_root( std::move( ids ) );
+   }
+
+   checksum_type signed_block::calculate_merkle_root( vector< digest_type > ids )
+   {
+      if( ids.size() == 0 )
+         return checksum_type();
+
       vector<digest_type>::size_type current_number_of_hashes = ids.size();
       while( current_number_of_hashes > 1 )
       {
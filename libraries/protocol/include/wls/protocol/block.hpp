@@ -7,6 +7,8 @@ namespace wls { namespace protocol {
    struct signed_block : public signed_block_header
    {
       checksum_type calculate_merkle_root()const;
+      /// The merkle root over already computed signed_transaction::merkle_digest() leaves
+      static checksum_type calculate_merkle_root( vector< digest_type > leaves );
       vector<signed_transaction> transactions;
    };
 
@@ -19,6 +19,8 @@ namespace wls { namespace protocol {
    struct signed_block_header : public block_header
    {
       block_id_type              id()const;
+      /// The id of a block whose packed signed header hashes to header_hash
+      static block_id_type       id_from_hash( fc::sha224 header_hash, uint32_t block_num );
       fc::ecc::public_key        signee()const;
       void                       sign( const fc::ecc::private_key& signer );
       bool                       validate_signee( const fc::ecc::public_key& expected_signee )const;
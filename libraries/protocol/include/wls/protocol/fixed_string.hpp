@@ -4,6 +4,7 @@
 #include <fc/io/raw_fwd.hpp>
 
 #include <boost/endian/conversion.hpp>
+#include <boost/functional/hash.hpp>
 
 // These overloads need to be defined before the implementation in fixed_string
 namespace fc
@@ -131,6 +132,22 @@ class fixed_string
       friend bool operator == ( const fixed_string& a, const fixed_string& b ) { return a.data == b.data; }
       friend bool operator != ( const fixed_string& a, const fixed_string& b ) { return a.data != b.data; }
 
+      /// Found by boost::hash, so fixed strings can key hashed_unique indices
+      friend std::size_t hash_value( const fixed_string& s )
+      {
+         static_assert( sizeof( Storage ) % sizeof( uint64_t ) == 0, "Storage must be a whole number of 64 bit words" );
+
+         std::size_t seed = 0;
+         const char* words = (const char*)&s.data;
+         for( size_t i = 0; i < sizeof( Storage ); i += sizeof( uint64_t ) )
+         {
+            uint64_t w;
+            memcpy( &w, words + i, sizeof( w ) );
+            boost::hash_combine( seed, w );
+         }
+         return seed;
+      }
+
       Storage data;
 };
 
@@ -19,6 +19,8 @@ namespace wls { namespace protocol {
 
       digest_type         digest()const;
       transaction_id_type id()const;
+      /// The id of a transaction whose digest() is d
+      static transaction_id_type id_from_digest( const digest_type& d );
       void                validate() const;
       digest_type         sig_digest( const chain_id_type& chain_id )const;
 
@@ -83,6 +85,8 @@ namespace wls { namespace protocol {
          ) const;
 
       flat_set<public_key_type> get_signature_keys( const chain_id_type& chain_id )const;
+      /// Same as get_signature_keys with sig_digest( chain_id ) already computed
+      flat_set<public_key_type> get_signature_keys_for_digest( const digest_type& sig_digest )const;
 
       vector<signature_type> signatures;
 
@@ -41,7 +41,11 @@ void transaction::validate() const
 
 wls::protocol::transaction_id_type wls::protocol::transaction::id() const
 {
-   auto h = digest();
+   return id_from_digest( digest() );
+}
+
+wls::protocol::transaction_id_type wls::protocol::transaction::id_from_digest( const digest_type& h )
+{
    transaction_id_type result;
    memcpy(result._hash, h._hash, std::min(sizeof(result), sizeof(h)));
    return result;
@@ -173,8 +177,12 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
 
 
 flat_set<public_key_type> signed_transaction::get_signature_keys( const chain_id_type& chain_id )const
+{
+   return get_signature_keys_for_digest( sig_digest( chain_id ) );
+}
+
+flat_set<public_key_type> signed_transaction::get_signature_keys_for_digest( const digest_type& d )const
 { try {
-   auto d = sig_digest( chain_id );
    flat_set<public_key_type> result;
    for( const auto&  sig : signatures )
    {
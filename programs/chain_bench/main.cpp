@@ -0,0 +1,497 @@
+/**
+ * Builds a synthetic chain and measures block production, block application and reindex.
+ *
+ * Accounts are created and funded, a share of them follow the first account, every account
+ * posts once, and votes and transfers are spread over the following blocks. A final block is
+ * produced at the cashout time of the posts so that their payout is part of the run.
+ *
+ * The chain is then pushed block by block into a second database and reindexed into a third
+ * one. The account_history and follow plugins are loaded on each of them, so plugin signal
+ * handlers are part of every measurement.
+ *
+ * Point lookups of accounts and comments are timed on the ordered and the hashed indices, and
+ * where the kernel allows perf events, cache misses are counted per lookup and per operation
+ * of the pushed blocks.
+ *
+ * Results are printed to stdout as JSON, with the time of each phase of block application.
+ * Requires a testnet build, as blocks are signed with the init key.
+ */
+#include <wls/app/application.hpp>
+#include <wls/account_history/account_history_plugin.hpp>
+#include <wls/chain/database.hpp>
+#include <wls/chain/wls_objects.hpp>
+#include <wls/follow/follow_operations.hpp>
+#include <wls/follow/follow_plugin.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/smart_ref_impl.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace wls::chain;
+using namespace wls::protocol;
+
+namespace bpo = boost::program_options;
+
+namespace {
+
+   struct bench_timing
+   {
+      uint64_t          count = 0;
+      fc::microseconds  busy;
+
+      double per_second()const
+      {
+         return busy.count() > 0 ? double( count ) * 1000000.0 / double( busy.count() ) : 0.0;
+      }
+
+      template< typename Lambda >
+      void time( Lambda&& l )
+      {
+         auto start = fc::time_point::now();
+         l();
+         busy += fc::time_point::now() - start;
+         ++count;
+      }
+   };
+
+   fc::variant timing_to_variant( const bench_timing& t )
+   {
+      return fc::mutable_variant_object()
+         ( "count", t.count )
+         ( "busy_sec", double( t.busy.count() ) / 1000000.0 )
+         ( "per_sec", t.per_second() );
+   }
+
+   /// Counts the cache misses of the calling thread, if perf events are available
+   class cache_miss_counter
+   {
+      public:
+         cache_miss_counter()
+         {
+#ifdef __linux__
+            perf_event_attr attr;
+            memset( &attr, 0, sizeof( attr ) );
+            attr.size = sizeof( attr );
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            _fd = syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 );
+#endif
+         }
+
+         ~cache_miss_counter()
+         {
+#ifdef __linux__
+            if( _fd >= 0 )
+               close( _fd );
+#endif
+         }
+
+         bool valid()const { return _fd >= 0; }
+
+         void start()
+         {
+#ifdef __linux__
+            if( _fd >= 0 )
+            {
+               ioctl( _fd, PERF_EVENT_IOC_RESET, 0 );
+               ioctl( _fd, PERF_EVENT_IOC_ENABLE, 0 );
+            }
+#endif
+         }
+
+         uint64_t stop()
+         {
+            uint64_t count = 0;
+#ifdef __linux__
+            if( _fd >= 0 )
+            {
+               ioctl( _fd, PERF_EVENT_IOC_DISABLE, 0 );
+               if( read( _fd, &count, sizeof( count ) ) != sizeof( count ) )
+                  count = 0;
+            }
+#endif
+            return count;
+         }
+
+      private:
+         int _fd = -1;
+   };
+
+   fc::variant per_unit( const cache_miss_counter& counter, uint64_t misses, uint64_t units )
+   {
+      if( !counter.valid() || units == 0 )
+         return fc::variant();
+      return double( misses ) / double( units );
+   }
+
+   /// Times lookup( i ) for i in [0, n), which returns an object id so the lookups are not optimized out
+   template< typename Lookup >
+   fc::variant time_lookups( uint32_t n, cache_miss_counter& counter, Lookup&& lookup )
+   {
+      int64_t sum = 0;
+      counter.start();
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < n; ++i )
+         sum += lookup( i );
+      auto busy = fc::time_point::now() - start;
+      uint64_t misses = counter.stop();
+
+      return fc::mutable_variant_object()
+         ( "lookups", n )
+         ( "ns_per_lookup", n > 0 ? double( busy.count() ) * 1000.0 / double( n ) : 0.0 )
+         ( "cache_misses_per_lookup", per_unit( counter, misses, n ) )
+         ( "checksum", sum );
+   }
+
+   const uint64_t initial_supply = 10000000000ll;
+
+   /// A database with the plugins whose signal handlers are part of the measurements
+   struct bench_node
+   {
+      bench_node()
+      {
+         bpo::variables_map options;
+         app.register_plugin< wls::account_history::account_history_plugin >()->plugin_initialize( options );
+         app.register_plugin< wls::follow::follow_plugin >()->plugin_initialize( options );
+         db()._log_hardforks = false;
+      }
+
+      database& db() { return *app.chain_database(); }
+
+      wls::app::application   app;
+   };
+
+   class chain_builder
+   {
+      public:
+         chain_builder( database& db, uint32_t txs_per_block ) : _db( db ), _txs_per_block( txs_per_block ) {}
+
+         /// Signs and pushes a transaction, producing a block once enough are pending
+         void push( const vector< operation >& ops )
+         {
+            signed_transaction trx;
+            trx.operations = ops;
+            trx.set_expiration( _db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+            trx.set_reference_block( _db.head_block_id() );
+            trx.sign( _key, _db.get_chain_id() );
+
+            push_transaction.time( [&]() { _db.push_transaction( trx ); } );
+
+            if( ++_pending >= _txs_per_block )
+               produce();
+         }
+
+         void produce( uint32_t slot = 1 )
+         {
+            generate_block.time( [&]()
+            {
+               _db.generate_block( _db.get_slot_time( slot ), _db.get_scheduled_witness( slot ), _key, database::skip_nothing );
+            });
+            _pending = 0;
+         }
+
+         bench_timing   push_transaction;
+         bench_timing   generate_block;
+
+      private:
+         database&               _db;
+         uint32_t                _txs_per_block;
+         uint32_t                _pending = 0;
+         fc::ecc::private_key    _key = WLS_INIT_PRIVATE_KEY;
+   };
+
+   string bench_account( uint32_t i )
+   {
+      return "bench" + fc::to_string( i );
+   }
+
+   string bench_permlink( uint32_t i )
+   {
+      return "bench-post-" + fc::to_string( i );
+   }
+
+   void build_chain( database& db, chain_builder& builder, const bpo::variables_map& options )
+   {
+      uint32_t accounts = std::max( options.at( "accounts" ).as< uint32_t >(), 2u );
+      uint32_t followers = std::min( options.at( "followers" ).as< uint32_t >(), accounts - 1 );
+      uint32_t posts = std::min( options.at( "comments" ).as< uint32_t >(), accounts );
+      uint32_t votes = options.at( "votes" ).as< uint32_t >();
+      uint32_t transfers = options.at( "transfers" ).as< uint32_t >();
+
+      builder.produce();
+
+      public_key_type key = WLS_INIT_PRIVATE_KEY.get_public_key();
+      asset fee = std::max( db.get_witness_schedule_object().median_props.account_creation_fee, asset( WLS_MIN_ACCOUNT_CREATION_FEE, WLS_SYMBOL ) );
+
+      for( uint32_t i = 0; i < accounts; ++i )
+      {
+         account_create_operation create;
+         create.creator = WLS_INIT_MINER_NAME;
+         create.new_account_name = bench_account( i );
+         create.owner = authority( 1, key, 1 );
+         create.active = authority( 1, key, 1 );
+         create.posting = authority( 1, key, 1 );
+         create.memo_key = key;
+         create.fee = fee;
+
+         transfer_to_vesting_operation vest;
+         vest.from = WLS_INIT_MINER_NAME;
+         vest.to = create.new_account_name;
+         vest.amount = asset( 100000, WLS_SYMBOL );
+
+         transfer_operation fund;
+         fund.from = WLS_INIT_MINER_NAME;
+         fund.to = create.new_account_name;
+         fund.amount = asset( 10000, WLS_SYMBOL );
+
+         builder.push( { create, vest, fund } );
+      }
+
+      for( uint32_t i = 1; i <= followers; ++i )
+      {
+         wls::follow::follow_operation follow;
+         follow.follower = bench_account( i );
+         follow.following = bench_account( 0 );
+         follow.what.insert( "blog" );
+
+         custom_json_operation op;
+         op.id = FOLLOW_PLUGIN_NAME;
+         op.required_posting_auths.insert( follow.follower );
+         op.json = fc::json::to_string( wls::follow::follow_plugin_operation( follow ) );
+         builder.push( { op } );
+      }
+
+      builder.produce();
+
+      // Accounts can only post once every few minutes, so each account posts once
+      for( uint32_t i = 0; i < posts; ++i )
+      {
+         comment_operation post;
+         post.parent_permlink = "bench";
+         post.author = bench_account( i );
+         post.permlink = bench_permlink( i );
+         post.title = "Benchmark post " + fc::to_string( i );
+         post.body = string( 1000, 'x' );
+         builder.push( { post } );
+      }
+
+      builder.produce();
+
+      // Every round each account votes on a different post, then a block is produced so that
+      // the minimum interval between votes has passed before the next round
+      votes = posts > 1 ? std::min( votes, accounts * ( posts - 1 ) ) : 0;
+      for( uint32_t v = 0; v < votes; ++v )
+      {
+         uint32_t round = v / accounts;
+         uint32_t voter = v % accounts;
+
+         if( voter == 0 && round > 0 )
+            builder.produce();
+
+         vote_operation vote;
+         vote.voter = bench_account( voter );
+         vote.author = bench_account( ( voter + round + 1 ) % posts );
+         vote.permlink = bench_permlink( ( voter + round + 1 ) % posts );
+         vote.weight = WLS_100_PERCENT;
+         builder.push( { vote } );
+      }
+
+      for( uint32_t t = 0; t < transfers; ++t )
+      {
+         transfer_operation transfer;
+         transfer.from = bench_account( t % accounts );
+         transfer.to = bench_account( ( t * 7 + 1 ) % accounts );
+         transfer.amount = asset( 1, WLS_SYMBOL );
+         transfer.memo = "bench";
+         if( transfer.from != transfer.to )
+            builder.push( { transfer } );
+      }
+
+      builder.produce();
+
+      // One block at the cashout time pays out every post
+      if( posts > 0 )
+      {
+         auto cashout = db.get_comment( bench_account( 0 ), bench_permlink( 0 ) ).cashout_time;
+         builder.produce( std::max( db.get_slot_at_time( cashout ), 1u ) );
+      }
+
+      // Let the cashout block become irreversible so it is in the block log for the reindex
+      uint32_t cashout_block = db.head_block_num();
+      while( db.get_dynamic_global_properties().last_irreversible_block_num < cashout_block )
+         builder.produce();
+   }
+
+   /// Looks up random accounts and posts through the ordered indices and the hashed indices that replaced them
+   fc::variant bench_lookups( const database& db, const bpo::variables_map& options, cache_miss_counter& counter )
+   {
+      uint32_t accounts = std::max( options.at( "accounts" ).as< uint32_t >(), 2u );
+      uint32_t posts = std::max( std::min( options.at( "comments" ).as< uint32_t >(), accounts ), 1u );
+      uint32_t n = options.at( "lookups" ).as< uint32_t >();
+
+      std::mt19937 rng( 42 );
+      vector< account_name_type > names( n );
+      vector< string > permlinks( n );
+      for( uint32_t i = 0; i < n; ++i )
+      {
+         uint32_t a = rng() % posts;
+         names[i] = bench_account( a );
+         permlinks[i] = bench_permlink( a );
+      }
+
+      return fc::mutable_variant_object()
+         ( "account_by_name", time_lookups( n, counter, [&]( uint32_t i )
+            { return db.get< account_object, by_name >( names[i] ).id._id; } ) )
+         ( "account_by_name_hash", time_lookups( n, counter, [&]( uint32_t i )
+            { return db.get< account_object, by_name_hash >( names[i] ).id._id; } ) )
+         ( "comment_by_permlink", time_lookups( n, counter, [&]( uint32_t i )
+            { return db.get< comment_object, by_permlink >( boost::make_tuple( names[i], permlinks[i] ) ).id._id; } ) )
+         ( "comment_by_permlink_hash", time_lookups( n, counter, [&]( uint32_t i )
+            { return db.get< comment_object, by_permlink_hash >( boost::make_tuple( names[i], permlinks[i] ) ).id._id; } ) );
+   }
+}
+
+int main( int argc, char** argv )
+{
+   try
+   {
+#ifndef IS_TEST_NET
+      std::cerr << "chain_bench signs blocks with the init key and requires a testnet build\n";
+      return 1;
+#else
+      bpo::options_description desc( "chain_bench options" );
+      desc.add_options()
+         ( "help,h", "Print this help message and exit" )
+         ( "accounts", bpo::value< uint32_t >()->default_value( 1000 ), "Number of accounts to create" )
+         ( "followers", bpo::value< uint32_t >()->default_value( 900 ), "Number of accounts following the first account" )
+         ( "comments", bpo::value< uint32_t >()->default_value( 1000 ), "Number of posts, at most one per account" )
+         ( "votes", bpo::value< uint32_t >()->default_value( 10000 ), "Number of votes" )
+         ( "transfers", bpo::value< uint32_t >()->default_value( 10000 ), "Number of transfers" )
+         ( "txs-per-block", bpo::value< uint32_t >()->default_value( 100 ), "Transactions in each generated block" )
+         ( "shared-file-size", bpo::value< uint64_t >()->default_value( 1024 ), "Size of each shared memory file in MB" )
+         ( "replay-threads", bpo::value< uint32_t >()->default_value( 2 ), "Worker threads used by the reindex" )
+         ( "lookups", bpo::value< uint32_t >()->default_value( 1000000 ), "Number of timed account and comment lookups" )
+         ( "output", bpo::value< string >(), "Also write the results to this file" )
+         ;
+
+      bpo::variables_map options;
+      bpo::store( bpo::parse_command_line( argc, argv, desc ), options );
+      bpo::notify( options );
+
+      if( options.count( "help" ) )
+      {
+         std::cout << desc << "\n";
+         return 0;
+      }
+
+      uint64_t shared_file_size = options.at( "shared-file-size" ).as< uint64_t >() * 1024 * 1024;
+      fc::temp_directory source_dir( graphene::utilities::temp_directory_path() );
+      fc::mutable_variant_object result;
+      cache_miss_counter cache_misses;
+
+      uint32_t head_block_num = 0;
+      {
+         bench_node source;
+         database& db = source.db();
+         db.open( source_dir.path(), source_dir.path(), initial_supply, shared_file_size, chainbase::database::read_write );
+         db.set_block_phase_timing( true );
+
+         chain_builder builder( db, std::max( options.at( "txs-per-block" ).as< uint32_t >(), 1u ) );
+         build_chain( db, builder, options );
+         head_block_num = db.get_dynamic_global_properties().last_irreversible_block_num;
+
+         result( "generate_block", timing_to_variant( builder.generate_block ) )
+               ( "push_transaction", timing_to_variant( builder.push_transaction ) )
+               ( "generate_block_phases", *db.get_block_phase_stats() )
+               ( "lookups", bench_lookups( db, options, cache_misses ) );
+
+         bench_node target;
+         fc::temp_directory target_dir( graphene::utilities::temp_directory_path() );
+         target.db().open( target_dir.path(), target_dir.path(), initial_supply, shared_file_size, chainbase::database::read_write );
+         target.db().set_block_phase_timing( true );
+
+         bench_timing push_block;
+         uint64_t operations = 0;
+         uint64_t push_block_misses = 0;
+         for( uint32_t i = 1; i <= head_block_num; ++i )
+         {
+            auto block = db.fetch_block_by_number( i );
+            FC_ASSERT( block.valid(), "Block ${i} is missing", ("i",i) );
+            for( const auto& trx : block->transactions )
+               operations += trx.operations.size();
+
+            cache_misses.start();
+            push_block.time( [&]() { target.db().push_block( *block, database::skip_nothing ); } );
+            push_block_misses += cache_misses.stop();
+         }
+
+         result( "push_block", timing_to_variant( push_block ) )
+               ( "push_block_operations", operations )
+               ( "push_block_cache_misses_per_operation", per_unit( cache_misses, push_block_misses, operations ) )
+               ( "push_block_phases", *target.db().get_block_phase_stats() );
+
+         target.db().close();
+         db.close();
+      }
+
+      {
+         bench_node replay;
+         fc::temp_directory shared_dir( graphene::utilities::temp_directory_path() );
+         replay.db().set_replay_threads( options.at( "replay-threads" ).as< uint32_t >() );
+         replay.db().set_block_phase_timing( true );
+
+         bench_timing reindex;
+         reindex.time( [&]() { replay.db().reindex( source_dir.path(), shared_dir.path(), shared_file_size ); } );
+         reindex.count = replay.db().head_block_num();
+
+         result( "reindex", timing_to_variant( reindex ) )
+               ( "reindex_stages", replay.db().get_last_replay_stats() )
+               ( "reindex_phases", *replay.db().get_block_phase_stats() );
+         replay.db().close();
+      }
+
+      result( "blocks", head_block_num )
+            ( "accounts", options.at( "accounts" ).as< uint32_t >() )
+            ( "followers", options.at( "followers" ).as< uint32_t >() )
+            ( "comments", options.at( "comments" ).as< uint32_t >() )
+            ( "votes", options.at( "votes" ).as< uint32_t >() )
+            ( "transfers", options.at( "transfers" ).as< uint32_t >() )
+            ( "txs_per_block", options.at( "txs-per-block" ).as< uint32_t >() );
+
+      string json = fc::json::to_pretty_string( result );
+      std::cout << json << "\n";
+
+      if( options.count( "output" ) )
+      {
+         std::ofstream out( options.at( "output" ).as< string >() );
+         out << json << "\n";
+      }
+#endif
+   }
+   catch( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      return 1;
+   }
+
+   return 0;
+}
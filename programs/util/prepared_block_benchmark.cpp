@@ -0,0 +1,130 @@
+/**
+ * Counts the hashes and serializations prepared blocks save while applying a block log.
+ *
+ * Usage: prepared_block_benchmark <blockchain_dir> [max_blocks]
+ *
+ * For each block, the legacy side makes the signed_block and signed_transaction calls that
+ * pushing, applying, announcing and logging a block used to make: the block id in the fork
+ * database, _apply_block and block_log::append, the merkle root and packed size in
+ * _apply_block, the id of each transaction in _apply_transaction and network_broadcast_api,
+ * its signature digest in recover_signature_keys and _apply_transaction, its merkle digest
+ * for the verified signature cache, and the packed block in block_log::append. The prepared
+ * side builds a prepared_block from the same bytes. Counts and timings are printed as JSON.
+ */
+#include <wls/chain/block_log.hpp>
+#include <wls/chain/prepared_block.hpp>
+
+#include <wls/protocol/config.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/variant_object.hpp>
+
+#include <iostream>
+#include <limits>
+#include <string>
+
+struct work_counts
+{
+   uint64_t          unpacks = 0;
+   uint64_t          packs = 0;     ///< whole or partial serializations, size passes included
+   uint64_t          hashes = 0;
+   fc::microseconds  time;
+};
+
+FC_REFLECT( work_counts, (unpacks)(packs)(hashes)(time) )
+
+int main( int argc, char** argv, char** envp )
+{
+   try
+   {
+      if( argc < 2 )
+      {
+         std::cerr << "Usage: " << argv[0] << " <blockchain_dir> [max_blocks]\n";
+         return 1;
+      }
+
+      fc::path data_dir( argv[1] );
+      uint32_t max_blocks = argc > 2 ? std::stoul( argv[2] ) : std::numeric_limits< uint32_t >::max();
+
+      wls::chain::block_log log;
+      log.open( data_dir / "block_log" );
+
+      const wls::protocol::chain_id_type chain_id = WLS_CHAIN_ID;
+      work_counts legacy, prepared;
+      uint64_t blocks = 0, transactions = 0;
+
+      for( uint32_t num = 1; num <= max_blocks; ++num )
+      {
+         auto packed = log.read_packed_block_by_num( num );
+         if( !packed.valid() )
+            break;
+
+         auto start = fc::time_point::now();
+         {
+            auto b = packed.unpack();
+            ++legacy.unpacks;
+            uint64_t n = b.transactions.size();
+
+            for( int i = 0; i < 3; ++i )
+               b.id();
+            b.calculate_merkle_root();
+            fc::raw::pack_size( b );
+            fc::raw::pack( b );
+
+            for( const auto& trx : b.transactions )
+            {
+               trx.id();
+               trx.id();
+               trx.sig_digest( chain_id );
+               trx.sig_digest( chain_id );
+               trx.merkle_digest();
+            }
+
+            // ids pack the header, the merkle root packs every transaction, the block is
+            // sized and packed, and each transaction is packed for each of its five hashes
+            legacy.packs += 3 + n + 2 + 5 * n;
+            // ids, then n leaves, n - 1 pairs and the root of the merkle tree, then transactions
+            legacy.hashes += 3 + 2 * n + 5 * n;
+            transactions += n;
+         }
+         legacy.time += fc::time_point::now() - start;
+
+         start = fc::time_point::now();
+         {
+            auto p = wls::chain::prepared_block::create( packed );
+            uint64_t n = p->transactions().size();
+
+            // the id, three hashes per transaction, then n - 1 pairs and the root of the merkle tree
+            ++prepared.unpacks;
+            prepared.hashes += 1 + 3 * n + n;
+         }
+         prepared.time += fc::time_point::now() - start;
+
+         ++blocks;
+      }
+
+      log.close();
+
+      auto per_block = [&]( uint64_t v ) { return blocks ? double( v ) / double( blocks ) : 0.0; };
+
+      fc::mutable_variant_object result;
+      result( "blocks", blocks )
+            ( "transactions", transactions )
+            ( "legacy", legacy )
+            ( "prepared", prepared )
+            ( "packs_saved_per_block", per_block( legacy.packs - prepared.packs ) )
+            ( "hashes_saved_per_block", per_block( legacy.hashes - prepared.hashes ) )
+            ( "legacy_us_per_block", per_block( legacy.time.count() ) )
+            ( "prepared_us_per_block", per_block( prepared.time.count() ) );
+      std::cout << fc::json::to_pretty_string( result ) << "\n";
+   }
+   catch( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      return 1;
+   }
+
+   return 0;
+}
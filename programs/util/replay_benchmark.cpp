@@ -0,0 +1,68 @@
+/**
+ * Measures replay throughput of a block log.
+ *
+ * Usage: replay_benchmark <blockchain_dir> [worker_threads] [apply]
+ *
+ * By default only the read and hash stages of the replay pipeline are run. Passing "apply"
+ * reindexes the chain into a temporary shared memory directory so the apply stage is measured
+ * as well. Per-stage stats are printed to stdout as JSON.
+ */
+#include <wls/chain/database.hpp>
+#include <wls/chain/replay_pipeline.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <iostream>
+#include <string>
+
+int main( int argc, char** argv, char** envp )
+{
+   try
+   {
+      if( argc < 2 )
+      {
+         std::cerr << "Usage: " << argv[0] << " <blockchain_dir> [worker_threads] [apply]\n";
+         return 1;
+      }
+
+      fc::path data_dir( argv[1] );
+      uint32_t threads = argc > 2 ? std::stoul( argv[2] ) : 2;
+      bool apply = argc > 3 && std::string( argv[3] ) == "apply";
+
+      wls::chain::replay_stats stats;
+
+      if( apply )
+      {
+         fc::temp_directory shared_dir( fc::temp_directory_path() );
+         wls::chain::database db;
+         db.set_replay_threads( threads );
+         db.reindex( data_dir, shared_dir.path() );
+         stats = db.get_last_replay_stats();
+         db.close();
+      }
+      else
+      {
+         wls::chain::replay_pipeline pipeline( data_dir / "block_log", threads );
+         while( !pipeline.next_batch()->empty() );
+         stats = pipeline.stats();
+      }
+
+      fc::mutable_variant_object result;
+      result( "worker_threads", stats.worker_threads )
+            ( "elapsed_sec", double( stats.elapsed.count() ) / 1000000.0 )
+            ( "read_blocks_per_sec", stats.read.blocks_per_second() )
+            ( "hash_blocks_per_sec", stats.hash.blocks_per_second() )
+            ( "apply_blocks_per_sec", stats.apply.blocks_per_second() )
+            ( "stats", stats );
+      std::cout << fc::json::to_pretty_string( result ) << "\n";
+   }
+   catch( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      return 1;
+   }
+
+   return 0;
+}
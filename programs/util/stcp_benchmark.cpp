@@ -0,0 +1,124 @@
+/**
+ * Measures the throughput of an encrypted p2p connection over the loopback interface.
+ *
+ * Usage: stcp_benchmark [transactions] [batch] [blocks]
+ *
+ * Sends blocks as served during sync, one write each, then small transaction sized messages
+ * one write each and batch at a time through send_messages. For each run, the time, throughput,
+ * socket reads and decryption time of the receiving side are printed as JSON.
+ */
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message_oriented_connection.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/variant_object.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+struct run_result
+{
+   std::string       name;
+   uint32_t          messages = 0;
+   uint32_t          size = 0;
+   uint32_t          batch = 0;
+   fc::microseconds  time;
+   uint64_t          mb_per_second = 0;
+   uint64_t          socket_reads = 0;
+   fc::microseconds  decrypt_time;
+};
+
+FC_REFLECT( run_result, (name)(messages)(size)(batch)(time)(mb_per_second)(socket_reads)(decrypt_time) )
+
+struct counting_connection_delegate : public graphene::net::message_oriented_connection_delegate
+{
+   uint64_t messages = 0;
+
+   void on_message( graphene::net::message_oriented_connection*, const graphene::net::message& ) override { ++messages; }
+   void on_connection_closed( graphene::net::message_oriented_connection* ) override {}
+};
+
+int main( int argc, char** argv, char** envp )
+{
+   try
+   {
+      uint32_t transactions = argc > 1 ? std::stoul( argv[1] ) : 20000;
+      uint32_t batch = argc > 2 ? std::stoul( argv[2] ) : 1000;
+      uint32_t blocks = argc > 3 ? std::stoul( argv[3] ) : 200;
+
+      fc::tcp_server server;
+      server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+
+      counting_connection_delegate receiver_delegate;
+      graphene::net::message_oriented_connection receiver( &receiver_delegate );
+      graphene::net::message_oriented_connection sender;
+
+      auto accepted = fc::async( [&]()
+      {
+         server.accept( receiver.get_socket() );
+         receiver.accept();
+      }, "accept benchmark connection" );
+      sender.connect_to( server.get_local_endpoint() );
+      accepted.wait();
+
+      auto run = [&]( const std::string& name, uint32_t count, uint32_t size, uint32_t per_write ) -> run_result
+      {
+         uint64_t expected = receiver_delegate.messages + count;
+         auto before = receiver.get_socket_stats();
+         auto start = fc::time_point::now();
+
+         graphene::net::message m;
+         m.msg_type = graphene::net::block_message_type;
+         m.data.resize( size, 'x' );
+         m.size = size;
+
+         std::vector< graphene::net::message > messages;
+         for( uint32_t i = 0; i < count; ++i )
+         {
+            messages.push_back( m );
+            if( messages.size() == per_write || i + 1 == count )
+            {
+               sender.send_messages( messages );
+               messages.clear();
+            }
+         }
+
+         while( receiver_delegate.messages < expected )
+            fc::usleep( fc::milliseconds( 1 ) );
+
+         auto after = receiver.get_socket_stats();
+
+         run_result r;
+         r.name = name;
+         r.messages = count;
+         r.size = size;
+         r.batch = per_write;
+         r.time = fc::time_point::now() - start;
+         r.mb_per_second = uint64_t( count ) * size * 1000000 / std::max< int64_t >( r.time.count(), 1 ) / ( 1024 * 1024 );
+         r.socket_reads = after.socket_reads - before.socket_reads;
+         r.decrypt_time = after.decrypt_time - before.decrypt_time;
+         return r;
+      };
+
+      std::vector< run_result > results;
+      results.push_back( run( "sync blocks", blocks, 2 * 1024 * 1024 - 64, 1 ) );
+      results.push_back( run( "unbatched transactions", transactions, 256, 1 ) );
+      results.push_back( run( "batched transactions", transactions, 256, batch ) );
+
+      sender.close_connection();
+      receiver.destroy_connection();
+      sender.destroy_connection();
+
+      std::cout << fc::json::to_pretty_string( results ) << "\n";
+   }
+   catch( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      return 1;
+   }
+
+   return 0;
+}
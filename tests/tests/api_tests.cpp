@@ -0,0 +1,302 @@
+#ifdef IS_TEST_NET
+#include <boost/test/unit_test.hpp>
+
+#include <wls/chain/comment_object.hpp>
+#include <wls/chain/history_object.hpp>
+#include <wls/app/block_notifier.hpp>
+#include <wls/app/discussion_cache.hpp>
+#include <wls/app/operation_stream.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <mutex>
+
+using namespace wls;
+using namespace wls::chain;
+using namespace wls::protocol;
+
+BOOST_FIXTURE_TEST_SUITE( api_tests, clean_database_fixture )
+
+BOOST_AUTO_TEST_CASE( discussion_cache )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: discussion_cache drops the discussions changed by a block" );
+      ACTORS( (alice)(bob) )
+      generate_block();
+
+      vest( "alice", ASSET( "1000.000 TESTS" ) );
+      vest( "bob", ASSET( "1000.000 TESTS" ) );
+      generate_block();
+
+      auto push = [&]( const operation& op, const fc::ecc::private_key& key )
+      {
+         signed_transaction tx;
+         tx.operations.push_back( op );
+         tx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+         tx.sign( key, db.get_chain_id() );
+         db.push_transaction( tx, 0 );
+      };
+
+      comment_operation comment;
+      comment.author = "alice";
+      comment.permlink = "p1";
+      comment.parent_permlink = "test";
+      comment.title = "test";
+      comment.body = "foo bar";
+      push( comment, alice_private_key );
+
+      comment.author = "bob";
+      comment.permlink = "p2";
+      push( comment, bob_private_key );
+      generate_block();
+
+      app::discussion_cache cache( db, 1, 5 );
+      auto p1 = db.get_comment( "alice", string( "p1" ) ).id;
+      auto p2 = db.get_comment( "bob", string( "p2" ) ).id;
+
+      BOOST_CHECK( !cache.find( p1 ) );
+      cache.add( app::discussion( db.get( p1 ) ) );
+      BOOST_REQUIRE( cache.find( p1 ) );
+      BOOST_CHECK_EQUAL( cache.find( p1 )->permlink, "p1" );
+
+      BOOST_TEST_MESSAGE( "--- Test the least recently used discussion is evicted" );
+      cache.add( app::discussion( db.get( p2 ) ) );
+      BOOST_CHECK( !cache.find( p1 ) );
+      BOOST_CHECK( cache.find( p2 ) );
+      BOOST_CHECK_EQUAL( cache.get_stats().evictions, 1u );
+
+      BOOST_TEST_MESSAGE( "--- Test votes drop the discussion with their block" );
+      vote_operation vote;
+      vote.voter = "alice";
+      vote.author = "bob";
+      vote.permlink = "p2";
+      vote.weight = WLS_100_PERCENT;
+      push( vote, alice_private_key );
+
+      // The pending vote may never be included, so what was read with it is not kept
+      BOOST_CHECK( !cache.find( p2 ) );
+      cache.add( app::discussion( db.get( p2 ) ) );
+      BOOST_CHECK( !cache.find( p2 ) );
+
+      generate_block();
+      BOOST_CHECK( !cache.find( p2 ) );
+      BOOST_CHECK_EQUAL( cache.get_stats().invalidations, 1u );
+
+      BOOST_TEST_MESSAGE( "--- Test discussions are hydrated again after max_age blocks" );
+      cache.add( app::discussion( db.get( p2 ) ) );
+      generate_blocks( 5 );
+      BOOST_CHECK( cache.find( p2 ) );
+      generate_block();
+      BOOST_CHECK( !cache.find( p2 ) );
+      BOOST_CHECK_EQUAL( cache.get_stats().expired, 1u );
+
+      BOOST_TEST_MESSAGE( "--- Test popped blocks drop every discussion" );
+      cache.add( app::discussion( db.get( p2 ) ) );
+      db.pop_block();
+      generate_block();
+      BOOST_CHECK( !cache.find( p2 ) );
+
+      auto stats = cache.get_stats();
+      BOOST_CHECK_EQUAL( stats.entries, 0u );
+      BOOST_CHECK_EQUAL( stats.invalidations, 2u );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( block_notifier_fan_out )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: block_notifier shares one notification per block between its subscribers" );
+      std::mutex mutex;
+      vector< app::block_notification_ptr > fast_notes, slow_notes;
+      fc::promise< void >::ptr release( new fc::promise< void >() );
+
+      app::block_notifier notifier( db, 2 );
+
+      auto wait_for = [&]( std::function< bool() > done )
+      {
+         for( int i = 0; i < 500 && !done(); ++i )
+            fc::usleep( fc::milliseconds( 10 ) );
+         BOOST_REQUIRE( done() );
+      };
+
+      generate_block();
+      BOOST_CHECK_EQUAL( notifier.get_stats().notifications, 0u );
+
+      auto fast = notifier.subscribe( [&]( const app::block_notification_ptr& n )
+      {
+         std::lock_guard< std::mutex > guard( mutex );
+         fast_notes.push_back( n );
+      }, 10 );
+      notifier.subscribe( [&]( const app::block_notification_ptr& n )
+      {
+         fc::future< void >( release ).wait();
+         std::lock_guard< std::mutex > guard( mutex );
+         slow_notes.push_back( n );
+      });
+
+      generate_blocks( 5 );
+      wait_for( [&]() { std::lock_guard< std::mutex > guard( mutex ); return fast_notes.size() == 5; } );
+
+      BOOST_TEST_MESSAGE( "--- Test the blocked subscriber holds at most max_queued blocks without holding up the other" );
+      auto stats = notifier.get_stats();
+      BOOST_CHECK_EQUAL( stats.notifications, 5u );
+      BOOST_REQUIRE_EQUAL( stats.subscribers.size(), 2u );
+      BOOST_CHECK_EQUAL( stats.subscribers[0].delivered, 5u );
+      BOOST_CHECK_LE( stats.subscribers[1].queued, 2u );
+      BOOST_CHECK( fast_notes.back()->block->id() == db.head_block_id() );
+      BOOST_CHECK( fast_notes.back()->header[ "previous" ].as< block_id_type >() == fast_notes[3]->block->id() );
+
+      release->set_value();
+      wait_for( [&]()
+      {
+         std::lock_guard< std::mutex > guard( mutex );
+         return slow_notes.size() && slow_notes.back() == fast_notes.back();
+      });
+
+      BOOST_TEST_MESSAGE( "--- Test the blocked subscriber lost its oldest blocks and both received the same notification" );
+      {
+         std::lock_guard< std::mutex > guard( mutex );
+         BOOST_CHECK_LT( slow_notes.size(), 5u );
+         BOOST_CHECK( slow_notes.back() == fast_notes.back() );
+      }
+
+      BOOST_TEST_MESSAGE( "--- Test a subscriber that throws is removed" );
+      notifier.subscribe( []( const app::block_notification_ptr& ) { FC_ASSERT( false, "client went away" ); } );
+      generate_block();
+      wait_for( [&]() { std::lock_guard< std::mutex > guard( mutex ); return notifier.get_stats().failed == 1 && fast_notes.size() == 6; } );
+      BOOST_CHECK_EQUAL( notifier.get_stats().subscribers.size(), 2u );
+
+      BOOST_TEST_MESSAGE( "--- Test unsubscribed callbacks are not called" );
+      notifier.unsubscribe( fast );
+      generate_block();
+      wait_for( [&]() { std::lock_guard< std::mutex > guard( mutex ); return slow_notes.back()->block->id() == db.head_block_id(); } );
+      BOOST_CHECK_EQUAL( fast_notes.size(), 6u );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( operation_stream_replay_and_live )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: operation_stream replays history, then streams the blocks applied" );
+      ACTORS( (alice)(bob) )
+      generate_block();
+
+      transfer( WLS_INIT_MINER_NAME, "alice", 1000 );
+      generate_block();
+      uint32_t transfer_block = db.head_block_num();
+      transfer( WLS_INIT_MINER_NAME, "bob", 2000 );
+      generate_block();
+
+      std::mutex mutex;
+      vector< app::operation_stream_frame > frames, virtual_frames;
+
+      app::operation_stream stream( db, nullptr, true, 2, 2 );
+
+      auto wait_for = [&]( std::function< bool() > done )
+      {
+         for( int i = 0; i < 500 && !done(); ++i )
+            fc::usleep( fc::milliseconds( 10 ) );
+         BOOST_REQUIRE( done() );
+      };
+      auto received_through = [&]( const vector< app::operation_stream_frame >& f, uint32_t block_num )
+      {
+         std::lock_guard< std::mutex > guard( mutex );
+         return f.size() && f.back().last_block == block_num;
+      };
+
+      app::operation_stream_filter filter;
+      filter.operations.insert( "transfer" );
+      filter.accounts.insert( "alice" );
+      stream.subscribe( [&]( const app::operation_stream_frame& f )
+      {
+         std::lock_guard< std::mutex > guard( mutex );
+         frames.push_back( f );
+      }, filter, 1 );
+
+      uint32_t head = db.head_block_num();
+      wait_for( [&]() { return received_through( frames, head ); } );
+
+      BOOST_TEST_MESSAGE( "--- Test history is replayed in consecutive frames of matching operations" );
+      {
+         std::lock_guard< std::mutex > guard( mutex );
+         BOOST_CHECK_EQUAL( frames.size(), ( head + 1 ) / 2 );
+         vector< app::applied_operation > ops;
+         for( size_t i = 0; i < frames.size(); ++i )
+         {
+            BOOST_CHECK( !frames[i].live );
+            BOOST_CHECK_EQUAL( frames[i].first_block, i ? frames[i - 1].last_block + 1 : 1u );
+            ops.insert( ops.end(), frames[i].operations.begin(), frames[i].operations.end() );
+         }
+
+         BOOST_REQUIRE_EQUAL( ops.size(), 1u );
+         BOOST_CHECK_EQUAL( ops[0].block, transfer_block );
+         BOOST_CHECK( ops[0].op.get< transfer_operation >().to == "alice" );
+      }
+      BOOST_CHECK_EQUAL( stream.get_stats().replayed_blocks, head );
+      BOOST_CHECK( !stream.get_stats().subscribers[0].catching_up );
+
+      BOOST_TEST_MESSAGE( "--- Test applied blocks are streamed live" );
+      transfer( WLS_INIT_MINER_NAME, "alice", 3000 );
+      transfer( WLS_INIT_MINER_NAME, "bob", 4000 );
+      generate_block();
+      wait_for( [&]() { return received_through( frames, db.head_block_num() ); } );
+      {
+         std::lock_guard< std::mutex > guard( mutex );
+         BOOST_CHECK( frames.back().live );
+         BOOST_CHECK_EQUAL( frames.back().first_block, head + 1 );
+         BOOST_REQUIRE_EQUAL( frames.back().operations.size(), 1u );
+         BOOST_CHECK_EQUAL( frames.back().operations[0].op.get< transfer_operation >().amount.amount.value, 3000 );
+      }
+
+      BOOST_TEST_MESSAGE( "--- Test virtual operations are streamed from the next block" );
+      app::operation_stream_filter virtual_filter;
+      virtual_filter.operations.insert( "producer_reward" );
+      virtual_filter.real_operations = false;
+      stream.subscribe( [&]( const app::operation_stream_frame& f )
+      {
+         std::lock_guard< std::mutex > guard( mutex );
+         virtual_frames.push_back( f );
+      }, virtual_filter, 0 );
+
+      generate_block();
+      wait_for( [&]() { return received_through( virtual_frames, db.head_block_num() ); } );
+      {
+         std::lock_guard< std::mutex > guard( mutex );
+         BOOST_REQUIRE_EQUAL( virtual_frames.size(), 1u );
+         BOOST_CHECK_EQUAL( virtual_frames[0].first_block, db.head_block_num() );
+         BOOST_REQUIRE_EQUAL( virtual_frames[0].operations.size(), 1u );
+         BOOST_CHECK( virtual_frames[0].operations[0].op.which() == operation::tag< producer_reward_operation >::value );
+      }
+
+      BOOST_TEST_MESSAGE( "--- Test invalid subscriptions are refused" );
+      app::operation_stream_filter unknown;
+      unknown.operations.insert( "not_an_operation" );
+      BOOST_REQUIRE_THROW( stream.subscribe( []( const app::operation_stream_frame& ) {}, unknown, 0 ), fc::exception );
+      BOOST_REQUIRE_THROW( stream.subscribe( []( const app::operation_stream_frame& ) {}, filter, db.head_block_num() + 2 ), fc::exception );
+      BOOST_CHECK_EQUAL( stream.get_stats().subscribers.size(), 2u );
+
+      BOOST_TEST_MESSAGE( "--- Test replay does not start before the history kept" );
+      app::operation_stream partial( db, nullptr, false, 2, 2 );
+      BOOST_REQUIRE_THROW( partial.subscribe( []( const app::operation_stream_frame& ) {}, filter, db.head_block_num() ), fc::exception );
+      partial.subscribe( []( const app::operation_stream_frame& ) {}, filter, db.head_block_num() + 1 );
+
+      // The removal is part of the pending state, which is enough for the subscription below
+      db.with_write_lock( [&]()
+      {
+         const auto& idx = db.get_index< operation_index >().indices().get< by_location >();
+         while( idx.begin()->block == 1 )
+            db.remove( *idx.begin() );
+      });
+      BOOST_REQUIRE_THROW( stream.subscribe( []( const app::operation_stream_frame& ) {}, filter, 1 ), fc::exception );
+      stream.subscribe( []( const app::operation_stream_frame& ) {}, filter, 2 );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif
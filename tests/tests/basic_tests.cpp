@@ -24,6 +24,7 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <wls/app/api_executor.hpp>
 #include <wls/chain/database.hpp>
 #include <wls/protocol/protocol.hpp>
 
@@ -31,10 +32,13 @@
 
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/hex.hpp>
+#include <fc/thread/thread.hpp>
 #include "../common/database_fixture.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <random>
+#include <thread>
 
 using namespace wls;
 using namespace wls::chain;
@@ -324,4 +328,207 @@ BOOST_AUTO_TEST_CASE( merkle_root )
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
 }
 
+BOOST_AUTO_TEST_CASE( signature_cache_test )
+{
+   try
+   {
+      auto alice_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "alice" ) ) );
+      auto bob_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "bob" ) ) );
+
+      signed_transaction tx;
+      transfer_operation op;
+      op.from = "alice";
+      op.to = "bob";
+      op.amount = asset( 1000, WLS_SYMBOL );
+      tx.operations.push_back( op );
+      tx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+      tx.sign( alice_key, db.get_chain_id() );
+      tx.sign( bob_key, db.get_chain_id() );
+
+      signature_cache cache( 4 );
+
+      BOOST_TEST_MESSAGE( "--- Recovered keys match and are served from the cache the second time" );
+      auto expected = tx.get_signature_keys( db.get_chain_id() );
+      BOOST_CHECK( cache.get_signature_keys( tx, db.get_chain_id() ) == expected );
+      BOOST_CHECK_EQUAL( cache.get_stats().key_misses, 2 );
+      BOOST_CHECK( cache.get_signature_keys( tx, db.get_chain_id() ) == expected );
+      BOOST_CHECK_EQUAL( cache.get_stats().key_hits, 2 );
+
+      BOOST_TEST_MESSAGE( "--- Duplicate signatures are still rejected" );
+      signed_transaction dup = tx;
+      dup.signatures.push_back( dup.signatures[0] );
+      WLS_REQUIRE_THROW( cache.get_signature_keys( dup, db.get_chain_id() ), tx_duplicate_sig );
+
+      BOOST_TEST_MESSAGE( "--- Verified results are dropped on invalidation" );
+      auto digest = tx.merkle_digest();
+      BOOST_CHECK( !cache.is_verified( digest ) );
+      cache.set_verified( digest );
+      BOOST_CHECK( cache.is_verified( digest ) );
+      cache.invalidate_verified();
+      BOOST_CHECK( !cache.is_verified( digest ) );
+      BOOST_CHECK_EQUAL( cache.get_stats().invalidations, 1 );
+
+      BOOST_TEST_MESSAGE( "--- Least recently used entries are evicted" );
+      cache.set_max_size( 1 );
+      cache.set_verified( digest );
+      cache.set_verified( fc::sha256::hash( string( "other" ) ) );
+      BOOST_CHECK( !cache.is_verified( digest ) );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( preemptible_read_lock_test )
+{
+   try
+   {
+      std::atomic< bool > reading( false );
+      std::atomic< uint32_t > attempts( 0 );
+      uint32_t writes = 0;
+      uint32_t seen = 0;
+
+      // Walks an index it fetched once until a writer shows up, like a long running API call
+      std::thread reader( [&]()
+      {
+         seen = db.with_preemptible_read_lock( [&]()
+         {
+            reading = true;
+            if( ++attempts == 1 )
+            {
+               const auto& accounts = db.get_index< account_index >().indices();
+               while( true )
+               {
+                  for( auto itr = accounts.begin(); itr != accounts.end(); ++itr )
+                     db.check_preempt();
+               }
+            }
+
+            return db.with_read_lock( [&]() { return writes; } );
+         });
+      });
+
+      while( !reading )
+         std::this_thread::yield();
+
+      BOOST_TEST_MESSAGE( "--- The writer preempts the reader instead of waiting for it" );
+      auto start = fc::time_point::now();
+      db.with_write_lock( [&]() { ++writes; } );
+      BOOST_CHECK( fc::time_point::now() - start < fc::milliseconds( 500 ) );
+      reader.join();
+
+      BOOST_CHECK_EQUAL( attempts.load(), 2 );
+      BOOST_CHECK_EQUAL( seen, 1 );
+      BOOST_CHECK_EQUAL( db.get_read_preemptions(), 1 );
+
+      BOOST_TEST_MESSAGE( "--- Reads without a waiting writer run once" );
+      attempts = 0;
+      db.with_preemptible_read_lock( [&]() { ++attempts; return db.head_block_num(); } );
+      BOOST_CHECK_EQUAL( attempts.load(), 1 );
+      BOOST_CHECK_EQUAL( db.get_read_preemptions(), 1 );
+
+      BOOST_TEST_MESSAGE( "--- A task run while the reader yields is not preempted in its place" );
+      attempts = 0;
+      bool other_task_preempted = false;
+      std::thread writer;
+      db.with_preemptible_read_lock( [&]()
+      {
+         if( ++attempts == 1 )
+         {
+            writer = std::thread( [&]() { db.with_write_lock( [&]() { ++writes; } ); } );
+            try
+            {
+               while( true )
+                  db.get_dynamic_global_properties();
+            }
+            catch( const chainbase::read_preempted& ) {}
+
+            // The writer waits on this read, so the other task may look without a lock of its own
+            fc::async( [&]()
+            {
+               try
+               {
+                  db.get_dynamic_global_properties();
+               }
+               catch( const chainbase::read_preempted& )
+               {
+                  other_task_preempted = true;
+               }
+            }, "preemptible_read_lock_test" ).wait();
+         }
+         return writes;
+      });
+      writer.join();
+
+      BOOST_CHECK( !other_task_preempted );
+      BOOST_CHECK_EQUAL( attempts.load(), 2 );
+      BOOST_CHECK_EQUAL( db.get_read_preemptions(), 2 );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( api_executor_test )
+{
+   try
+   {
+      wls::app::api_executor exec( 2 );
+
+      wls::app::api_limits limits;
+      limits.max_concurrent = 1;
+      limits.max_queued = 1;
+      exec.add_api( "test_api", limits );
+
+      BOOST_REQUIRE( exec.is_pooled( "test_api" ) );
+      BOOST_REQUIRE( !exec.is_pooled( "other_api" ) );
+
+      std::atomic< bool > release( false );
+      auto slow = [&]() -> uint32_t
+      {
+         while( !release )
+            fc::usleep( fc::milliseconds( 1 ) );
+         return 1;
+      };
+
+      BOOST_TEST_MESSAGE( "--- First call takes the only slot, second call waits for it" );
+      auto first = fc::async( [&]() { return exec.execute( "test_api", slow ); } );
+      fc::usleep( fc::milliseconds( 50 ) );
+      auto second = fc::async( [&]() { return exec.execute( "test_api", slow ); } );
+      fc::usleep( fc::milliseconds( 50 ) );
+
+      auto stats = exec.get_stats()[ "test_api" ];
+      BOOST_REQUIRE_EQUAL( stats.running, 1 );
+      BOOST_REQUIRE_EQUAL( stats.queued, 1 );
+
+      BOOST_TEST_MESSAGE( "--- Third call is rejected once the queue is full" );
+      BOOST_REQUIRE_THROW( exec.execute( "test_api", slow ), fc::exception );
+      BOOST_REQUIRE_EQUAL( exec.get_stats()[ "test_api" ].rejected, 1 );
+
+      BOOST_TEST_MESSAGE( "--- Other APIs run inline" );
+      BOOST_REQUIRE_EQUAL( exec.execute( "other_api", []() { return 2u; } ), 2u );
+
+      release = true;
+      BOOST_REQUIRE_EQUAL( first.wait(), 1 );
+      BOOST_REQUIRE_EQUAL( second.wait(), 1 );
+
+      stats = exec.get_stats()[ "test_api" ];
+      BOOST_REQUIRE_EQUAL( stats.running, 0 );
+      BOOST_REQUIRE_EQUAL( stats.queued, 0 );
+      BOOST_REQUIRE_EQUAL( stats.completed, 2 );
+
+      BOOST_TEST_MESSAGE( "--- A canceled waiter leaves the slot to its call until the call finishes" );
+      release = false;
+      auto canceled = fc::async( [&]() { return exec.execute( "test_api", slow ); } );
+      fc::usleep( fc::milliseconds( 50 ) );
+      canceled.cancel_and_wait();
+      BOOST_REQUIRE_EQUAL( exec.get_stats()[ "test_api" ].running, 1 );
+
+      release = true;
+      for( uint32_t i = 0; i < 1000 && exec.get_stats()[ "test_api" ].running; ++i )
+         fc::usleep( fc::milliseconds( 1 ) );
+
+      stats = exec.get_stats()[ "test_api" ];
+      BOOST_REQUIRE_EQUAL( stats.running, 0 );
+      BOOST_REQUIRE_EQUAL( stats.completed, 3 );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -26,15 +26,18 @@
 
 #include <wls/protocol/exceptions.hpp>
 
+#include <wls/chain/account_history_store.hpp>
 #include <wls/chain/database.hpp>
 #include <wls/chain/wls_objects.hpp>
 #include <wls/chain/history_object.hpp>
+#include <wls/chain/state_snapshot.hpp>
 
 #include <wls/account_history/account_history_plugin.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/fstream.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -105,6 +108,176 @@ BOOST_AUTO_TEST_CASE( generate_empty_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( reindex_pipeline )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+      block_id_type log_head_id;
+      uint32_t log_head_num = 0;
+
+      {
+         database db;
+         db._log_hardforks = false;
+         db.open(data_dir.path(), data_dir.path(), INITIAL_TEST_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+         while( db.get_dynamic_global_properties().last_irreversible_block_num < 150 )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+
+         log_head_num = db.get_dynamic_global_properties().last_irreversible_block_num;
+         log_head_id = db.fetch_block_by_number( log_head_num )->id();
+         db.close();
+      }
+      {
+         database db;
+         db._log_hardforks = false;
+         db.set_replay_threads( 3 );
+         db.reindex( data_dir.path(), data_dir.path(), TEST_SHARED_MEM_SIZE );
+
+         BOOST_CHECK_EQUAL( db.head_block_num(), log_head_num );
+         BOOST_CHECK( db.head_block_id() == log_head_id );
+
+         const auto& stats = db.get_last_replay_stats();
+         BOOST_CHECK_EQUAL( stats.worker_threads, 3 );
+         BOOST_CHECK_EQUAL( stats.read.blocks, log_head_num );
+         BOOST_CHECK_EQUAL( stats.hash.blocks, log_head_num );
+         BOOST_CHECK_EQUAL( stats.apply.blocks, log_head_num );
+         db.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( import_block_log )
+{
+   try {
+      fc::temp_directory source_dir( graphene::utilities::temp_directory_path() ),
+                         import_dir( graphene::utilities::temp_directory_path() ),
+                         tampered_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+      public_key_type init_account_pub_key = init_account_priv_key.get_public_key();
+      auto bad_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "bad_key" ) ) );
+      uint32_t log_head_num = 0;
+      block_id_type log_head_id;
+
+      // A chain with signed transactions in its first blocks, as another node would have it
+      {
+         database db;
+         db._log_hardforks = false;
+         db.open( source_dir.path(), source_dir.path(), WLS_INIT_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+         for( int i = 0; i < 20; ++i )
+         {
+            signed_transaction trx;
+            account_create_operation cop;
+            cop.new_account_name = "alice" + fc::to_string( i );
+            cop.creator = WLS_INIT_MINER_NAME;
+            cop.owner = authority( 1, init_account_pub_key, 1 );
+            cop.active = cop.owner;
+            trx.operations.push_back( cop );
+            trx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+            trx.sign( init_account_priv_key, db.get_chain_id() );
+            PUSH_TX( db, trx );
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         }
+         while( db.get_dynamic_global_properties().last_irreversible_block_num < 50 )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+
+         log_head_num = db.get_dynamic_global_properties().last_irreversible_block_num;
+         log_head_id = db.fetch_block_by_number( log_head_num )->id();
+         db.close();
+      }
+
+      // Every block is verified and written to the importing node's own block log
+      {
+         database db;
+         db._log_hardforks = false;
+         db.set_replay_threads( 3 );
+         db.import_block_log( import_dir.path(), import_dir.path(), TEST_SHARED_MEM_SIZE, source_dir.path() / "block_log" );
+
+         BOOST_CHECK_EQUAL( db.head_block_num(), log_head_num );
+         BOOST_CHECK( db.head_block_id() == log_head_id );
+         BOOST_CHECK( db.find_account( "alice19" ) != nullptr );
+         BOOST_CHECK_EQUAL( db.get_last_replay_stats().apply.blocks, log_head_num );
+
+         auto imported = db.fetch_block_by_number( log_head_num );
+         BOOST_REQUIRE( imported.valid() );
+         BOOST_CHECK( imported->id() == log_head_id );
+         db.close();
+      }
+
+      // A transaction signature swapped for another key is caught, even with the block re-signed by its witness
+      {
+         fc::create_directories( tampered_dir.path() / "source" );
+         fc::create_directories( tampered_dir.path() / "data" );
+         block_log source;
+         source.open( source_dir.path() / "block_log" );
+         block_log tampered;
+         tampered.open( tampered_dir.path() / "source" / "block_log" );
+         for( uint32_t n = 1; n <= log_head_num; ++n )
+         {
+            auto b = *source.read_block_by_num( n );
+            if( n == 10 )
+            {
+               BOOST_REQUIRE( b.transactions.size() );
+               b.transactions[0].signatures.clear();
+               b.transactions[0].sign( bad_priv_key, WLS_CHAIN_ID );
+               b.transaction_merkle_root = b.calculate_merkle_root();
+               b.sign( init_account_priv_key );
+            }
+            tampered.append( b );
+         }
+         tampered.close();
+         source.close();
+
+         database db;
+         db._log_hardforks = false;
+         WLS_REQUIRE_THROW( db.import_block_log( tampered_dir.path() / "data", tampered_dir.path() / "data", TEST_SHARED_MEM_SIZE,
+            tampered_dir.path() / "source" / "block_log" ), fc::exception );
+         BOOST_CHECK( db.fetch_block_by_number( 9 ).valid() );
+         BOOST_CHECK( !db.fetch_block_by_number( 10 ).valid() );
+         db.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( packed_block_reads )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+
+      database db;
+      db._log_hardforks = false;
+      db.open(data_dir.path(), data_dir.path(), INITIAL_TEST_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+      while( db.get_dynamic_global_properties().last_irreversible_block_num < 50 )
+         db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+
+      // Irreversible blocks come from the block log mapping, the rest from the fork database
+      for( uint32_t num = 1; num <= db.head_block_num(); ++num )
+      {
+         auto block = db.fetch_block_by_number( num );
+         BOOST_REQUIRE( block.valid() );
+
+         auto packed = db.fetch_packed_block_by_number( num );
+         BOOST_REQUIRE( packed.valid() );
+         BOOST_CHECK( std::vector< char >( packed.data(), packed.data() + packed.size() ) == fc::raw::pack( *block ) );
+         BOOST_CHECK( packed.unpack_header().id() == block->id() );
+         BOOST_CHECK( db.fetch_packed_block_by_id( block->id() ).valid() );
+      }
+
+      BOOST_CHECK( !db.fetch_packed_block_by_number( db.head_block_num() + 1 ).valid() );
+      BOOST_CHECK( !db.fetch_packed_block_by_id( block_id_type() ).valid() );
+      db.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( undo_block )
 {
    try {
@@ -221,6 +394,155 @@ BOOST_AUTO_TEST_CASE( fork_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( parallel_signature_recovery )
+{
+   try {
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() );
+      database db1,
+               db2;
+      db1._log_hardforks = false;
+      db1.open( dir1.path(), dir1.path(), INITIAL_TEST_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+      db2._log_hardforks = false;
+      db2.open( dir2.path(), dir2.path(), INITIAL_TEST_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+      db2.set_signature_threads( 3 );
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("init_key")) );
+      public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+      auto bad_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("bad_key")) );
+
+      // Several correctly signed transactions are recovered across the workers
+      for( int i = 0; i < 5; ++i )
+      {
+         signed_transaction trx;
+         account_create_operation cop;
+         cop.new_account_name = "alice" + fc::to_string( i );
+         cop.creator = WLS_INIT_MINER_NAME;
+         cop.owner = authority(1, init_account_pub_key, 1);
+         cop.active = cop.owner;
+         trx.operations.push_back(cop);
+         trx.set_expiration( db1.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+         trx.sign( init_account_priv_key, db1.get_chain_id() );
+         PUSH_TX( db1, trx );
+      }
+
+      auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      BOOST_REQUIRE_EQUAL( b.transactions.size(), 5 );
+      PUSH_BLOCK( db2, b );
+      BOOST_CHECK( db2.head_block_id() == b.id() );
+      BOOST_CHECK( db2.find_account( "alice4" ) != nullptr );
+
+      // A block carrying a transaction signed with the wrong key is still rejected
+      signed_transaction trx;
+      account_create_operation cop;
+      cop.new_account_name = "bob";
+      cop.creator = WLS_INIT_MINER_NAME;
+      cop.owner = authority(1, init_account_pub_key, 1);
+      cop.active = cop.owner;
+      trx.operations.push_back(cop);
+      trx.set_expiration( db1.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+      trx.sign( bad_priv_key, db1.get_chain_id() );
+      PUSH_TX( db1, trx, database::skip_transaction_signatures | database::skip_authority_check );
+
+      b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_transaction_signatures | database::skip_authority_check);
+      BOOST_REQUIRE_EQUAL( b.transactions.size(), 1 );
+      WLS_REQUIRE_THROW( PUSH_BLOCK( db2, b ), fc::exception );
+      BOOST_CHECK( db2.find_account( "bob" ) == nullptr );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( account_history_store_test )
+{
+   try {
+      fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+
+      // One transfer from alice to bob per block, in its own transaction
+      auto make_block = []( uint32_t block_num, int64_t amount ) -> history_block
+      {
+         transfer_operation op;
+         op.from = "alice";
+         op.to = "bob";
+         op.amount = asset( amount, WLS_SYMBOL );
+
+         history_block b;
+         b.block_num = block_num;
+         b.operations.resize( 1 );
+         b.operations[0].trx_id = fc::ripemd160::hash( fc::to_string( block_num ) + "/" + fc::to_string( amount ) );
+         b.operations[0].block = block_num;
+         b.operations[0].serialized_op = fc::raw::pack( operation( op ) );
+         b.account_ops.emplace_back( "alice", 0 );
+         b.account_ops.emplace_back( "bob", 0 );
+         return b;
+      };
+
+      auto amount_of = []( const history_operation& op ) -> int64_t
+      {
+         return fc::raw::unpack< operation >( op.serialized_op ).get< transfer_operation >().amount.amount.value;
+      };
+
+      {
+         account_history_store store;
+         store.open( dir.path() );
+
+         for( uint32_t i = 1; i <= 200; ++i )
+            store.push_block( make_block( i, i ) );
+         store.commit( 150 );
+         BOOST_CHECK_EQUAL( store.committed_block_num(), 150 );
+         BOOST_CHECK_EQUAL( store.head_block_num(), 200 );
+
+         BOOST_TEST_MESSAGE( "--- Reversible blocks can be replaced" );
+         store.push_block( make_block( 199, 1000 ) );
+         BOOST_CHECK_EQUAL( store.head_block_num(), 199 );
+         BOOST_CHECK_EQUAL( amount_of( store.get_ops_in_block( 199 )[0] ), 1000 );
+         BOOST_CHECK( store.get_ops_in_block( 200 ).empty() );
+
+         BOOST_TEST_MESSAGE( "--- History spans committed and reversible blocks" );
+         auto history = store.get_account_history( "bob", uint64_t(-1), 100 );
+         BOOST_REQUIRE_EQUAL( history.size(), 101 );
+         BOOST_CHECK_EQUAL( history.begin()->first, 99 );
+         BOOST_CHECK_EQUAL( history.rbegin()->first, 199 );
+         BOOST_CHECK_EQUAL( amount_of( history.rbegin()->second ), 1000 );
+         for( const auto& entry : history )
+            BOOST_CHECK_EQUAL( entry.second.block, entry.first );
+
+         auto trx = store.find_transaction( make_block( 42, 42 ).operations[0].trx_id );
+         BOOST_REQUIRE( trx.valid() );
+         BOOST_CHECK_EQUAL( trx->block, 42 );
+         BOOST_CHECK( !store.find_transaction( make_block( 200, 200 ).operations[0].trx_id ).valid() );
+         store.close();
+      }
+
+      BOOST_TEST_MESSAGE( "--- Only committed blocks survive a reopen" );
+      {
+         account_history_store store;
+         store.open( dir.path() );
+         BOOST_CHECK_EQUAL( store.head_block_num(), 150 );
+
+         auto history = store.get_account_history( "alice", 77, 10 );
+         BOOST_REQUIRE_EQUAL( history.size(), 11 );
+         BOOST_CHECK_EQUAL( history.begin()->first, 67 );
+         BOOST_CHECK_EQUAL( amount_of( history.rbegin()->second ), 77 );
+         BOOST_CHECK_EQUAL( amount_of( store.get_ops_in_block( 150 )[0] ), 150 );
+
+         BOOST_TEST_MESSAGE( "--- Pushing from an earlier block truncates the store" );
+         store.push_block( make_block( 101, 5000 ) );
+         store.commit( 101 );
+         BOOST_CHECK_EQUAL( store.committed_block_num(), 101 );
+         history = store.get_account_history( "bob", uint64_t(-1), 0 );
+         BOOST_REQUIRE_EQUAL( history.size(), 1 );
+         BOOST_CHECK_EQUAL( history.begin()->first, 101 );
+         BOOST_CHECK_EQUAL( amount_of( history.begin()->second ), 5000 );
+         BOOST_CHECK( !store.find_transaction( make_block( 120, 120 ).operations[0].trx_id ).valid() );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( switch_forks_undo_create )
 {
    try {
@@ -280,6 +602,148 @@ BOOST_AUTO_TEST_CASE( switch_forks_undo_create )
    }
 }
 
+BOOST_AUTO_TEST_CASE( switch_forks_undo_journal )
+{
+   try {
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() );
+      database db1,
+               db2;
+      db1._log_hardforks = false;
+      db1.set_undo_journal( true );
+      db1.open( dir1.path(), dir1.path(), INITIAL_TEST_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+      db2._log_hardforks = false;
+      db2.open( dir2.path(), dir2.path(), INITIAL_TEST_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+
+      BOOST_REQUIRE( db1.get_index< account_index >().undo_journal_enabled() );
+      BOOST_REQUIRE( db1.get_index< comment_index >().undo_journal_enabled() );
+      BOOST_REQUIRE( !db1.get_index< witness_index >().undo_journal_enabled() );
+      BOOST_REQUIRE( !db2.get_index< account_index >().undo_journal_enabled() );
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("init_key")) );
+      public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+
+      signed_transaction trx;
+      account_create_operation cop;
+      cop.new_account_name = "alice";
+      cop.creator = WLS_INIT_MINER_NAME;
+      cop.owner = authority(1, init_account_pub_key, 1);
+      cop.active = cop.owner;
+      cop.json_metadata = "{\"a\":1}";
+      trx.operations.push_back(cop);
+
+      account_update_operation uop;
+      uop.account = "alice";
+      uop.memo_key = init_account_pub_key;
+      uop.json_metadata = "{\"a\":2}";
+      trx.operations.push_back(uop);
+
+      trx.set_expiration( db1.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+      trx.sign( init_account_priv_key, db1.get_chain_id() );
+      PUSH_TX( db1, trx );
+
+      // db1 : A
+      // db2 : B C D
+      auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto alice_id = db1.get_account( "alice" ).id;
+      BOOST_CHECK( to_string( db1.get(alice_id).json_metadata ) == "{\"a\":2}" );
+
+      b = db2.generate_block(db2.get_slot_time(1), db2.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      db1.push_block(b);
+      b = db2.generate_block(db2.get_slot_time(1), db2.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      db1.push_block(b);
+      db1.clear_pending();
+      WLS_REQUIRE_THROW(db1.get(alice_id), std::exception);
+      BOOST_CHECK( db1.get_account( WLS_INIT_MINER_NAME ).balance == db2.get_account( WLS_INIT_MINER_NAME ).balance );
+      BOOST_CHECK( db1.get_account( WLS_INIT_MINER_NAME ).vesting_shares == db2.get_account( WLS_INIT_MINER_NAME ).vesting_shares );
+
+      PUSH_TX( db2, trx );
+      b = db2.generate_block(db2.get_slot_time(1), db2.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      db1.push_block(b);
+
+      BOOST_CHECK( fc::json::to_string( db1.get(alice_id) ) == fc::json::to_string( db2.get(alice_id) ) );
+      BOOST_CHECK( fc::json::to_string( db1.get_account( WLS_INIT_MINER_NAME ) ) == fc::json::to_string( db2.get_account( WLS_INIT_MINER_NAME ) ) );
+
+      db1.pop_block();
+      WLS_REQUIRE_THROW(db1.get(alice_id), std::exception);
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( state_snapshot )
+{
+   try {
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() );
+      database db1,
+               db2;
+      db1._log_hardforks = false;
+      db1.open( dir1.path(), dir1.path(), INITIAL_TEST_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+      db2._log_hardforks = false;
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("init_key")) );
+      public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+
+      signed_transaction trx;
+      account_create_operation cop;
+      cop.new_account_name = "alice";
+      cop.creator = WLS_INIT_MINER_NAME;
+      cop.owner = authority(1, init_account_pub_key, 1);
+      cop.active = cop.owner;
+      cop.json_metadata = "{\"a\":1}";
+      trx.operations.push_back(cop);
+      trx.set_expiration( db1.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+      trx.sign( init_account_priv_key, db1.get_chain_id() );
+      PUSH_TX( db1, trx );
+
+      for( uint32_t i = 0; i < 10; ++i )
+         db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+
+      // Reopening rewinds to the last irreversible block, which is in the block log
+      db1.close();
+      db1.open( dir1.path(), dir1.path(), INITIAL_TEST_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+      BOOST_REQUIRE( db1.head_block_num() > 0 );
+
+      auto snapshot1 = dir1.path() / "state.snapshot";
+      db1.export_snapshot( snapshot1 );
+      BOOST_CHECK( read_state_snapshot_header( snapshot1 ).head_block_id == db1.head_block_id() );
+
+      WLS_REQUIRE_THROW( db2.import_snapshot( dir2.path(), dir2.path(), TEST_SHARED_MEM_SIZE, snapshot1 ), fc::exception );
+
+      fc::remove_all( dir2.path() / "block_log" );
+      fc::remove_all( dir2.path() / "block_log.index" );
+      fc::copy( dir1.path() / "block_log", dir2.path() / "block_log" );
+      fc::copy( dir1.path() / "block_log.index", dir2.path() / "block_log.index" );
+
+      // A snapshot whose state digest is not the one expected is refused before anything is wiped
+      WLS_REQUIRE_THROW( db2.import_snapshot( dir2.path(), dir2.path(), TEST_SHARED_MEM_SIZE, snapshot1, fc::sha256::hash( string( "other" ) ) ), fc::exception );
+      db2.import_snapshot( dir2.path(), dir2.path(), TEST_SHARED_MEM_SIZE, snapshot1, read_state_snapshot_footer( snapshot1 ).state_digest );
+
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+      BOOST_CHECK( fc::json::to_string( db2.get_account( "alice" ) ) == fc::json::to_string( db1.get_account( "alice" ) ) );
+      BOOST_CHECK( fc::json::to_string( db2.get_dynamic_global_properties() ) == fc::json::to_string( db1.get_dynamic_global_properties() ) );
+
+      // Exporting the imported state gives back the same file
+      auto snapshot2 = dir2.path() / "state.snapshot";
+      db2.export_snapshot( snapshot2 );
+      std::string data1, data2;
+      fc::read_file_contents( snapshot1, data1 );
+      fc::read_file_contents( snapshot2, data2 );
+      BOOST_CHECK( data1 == data2 );
+
+      // Both nodes produce and accept the same blocks from here
+      auto b = db2.generate_block(db2.get_slot_time(1), db2.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      db1.push_block( b );
+      BOOST_CHECK( db1.head_block_id() == db2.head_block_id() );
+      BOOST_CHECK( db2.get_account( "alice" ).id == db1.get_account( "alice" ).id );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( duplicate_transactions )
 {
    try {
@@ -334,6 +798,62 @@ BOOST_AUTO_TEST_CASE( duplicate_transactions )
    }
 }
 
+BOOST_AUTO_TEST_CASE( recent_transactions )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+      auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+
+      signed_transaction trx;
+      {
+         database db;
+         db._log_hardforks = false;
+         db.open( data_dir.path(), data_dir.path(), INITIAL_TEST_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+
+         transfer_operation t;
+         t.from = WLS_INIT_MINER_NAME;
+         t.to = WLS_NULL_ACCOUNT;
+         t.amount = asset( 500, WLS_SYMBOL );
+         trx.operations.push_back( t );
+         trx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+         trx.sign( init_account_priv_key, db.get_chain_id() );
+         PUSH_TX( db, trx, skip_sigs );
+
+         // Only transactions applied in a block are kept
+         BOOST_REQUIRE( db.is_known_transaction( trx.id() ) );
+         BOOST_REQUIRE_EQUAL( db.get_recent_transaction_cache().get_stats().entries, 0u );
+
+         auto b = db.generate_block( db.get_slot_time( 1 ), db.get_scheduled_witness( 1 ), init_account_priv_key, skip_sigs );
+         while( db.get_dynamic_global_properties().last_irreversible_block_num < b.block_num() )
+            db.generate_block( db.get_slot_time( 1 ), db.get_scheduled_witness( 1 ), init_account_priv_key, skip_sigs );
+
+         BOOST_REQUIRE( db.get_recent_transaction( trx.id() ).id() == trx.id() );
+         db.close();
+      }
+
+      BOOST_TEST_MESSAGE( "--- Test the cache is rebuilt from the block log" );
+      database db;
+      db._log_hardforks = false;
+      db.open( data_dir.path(), data_dir.path(), INITIAL_TEST_SUPPLY, TEST_SHARED_MEM_SIZE, chainbase::database::read_write );
+
+      BOOST_REQUIRE_EQUAL( db.get_recent_transaction_cache().get_stats().entries, 1u );
+      BOOST_REQUIRE( db.is_known_transaction( trx.id() ) );
+      BOOST_REQUIRE( db.get_recent_transaction( trx.id() ).id() == trx.id() );
+
+      BOOST_TEST_MESSAGE( "--- Test expired transactions are dropped" );
+      uint32_t slot = db.get_slot_at_time( trx.expiration ) + 1;
+      db.generate_block( db.get_slot_time( slot ), db.get_scheduled_witness( slot ), init_account_priv_key, skip_sigs );
+
+      BOOST_REQUIRE( !db.is_known_transaction( trx.id() ) );
+      BOOST_REQUIRE_EQUAL( db.get_recent_transaction_cache().get_stats().entries, 0u );
+      WLS_REQUIRE_THROW( db.get_recent_transaction( trx.id() ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( tapos )
 {
    try {
@@ -675,6 +1195,46 @@ BOOST_FIXTURE_TEST_CASE( rsf_missed_blocks, clean_database_fixture )
    FC_LOG_AND_RETHROW()
 }
 
+BOOST_FIXTURE_TEST_CASE( object_change_notifications, clean_database_fixture )
+{
+   try
+   {
+      std::vector< std::pair< account_id_type, object_change_kind > > changes;
+      uint32_t witness_changes = 0;
+
+      boost::signals2::scoped_connection account_conn = db.on_object_change< account_object >(
+         [&]( const object_change_notification< account_object >& note )
+         {
+            BOOST_CHECK_EQUAL( note.type, account_object::type_id );
+            BOOST_CHECK( note.id == note.object.id );
+            changes.emplace_back( note.id, note.kind );
+         });
+      boost::signals2::scoped_connection witness_conn = db.on_object_change< witness_object >(
+         [&]( const object_change_notification< witness_object >& ) { ++witness_changes; });
+
+      ACTORS( (alice) );
+
+      BOOST_REQUIRE( !changes.empty() );
+      BOOST_CHECK( std::find( changes.begin(), changes.end(), std::make_pair( alice_id, object_created ) ) != changes.end() );
+
+      changes.clear();
+      db.modify( db.get_account( "alice" ), [&]( account_object& a ) { a.post_count++; } );
+      BOOST_REQUIRE_EQUAL( changes.size(), 1 );
+      BOOST_CHECK( changes[0].first == alice_id );
+      BOOST_CHECK_EQUAL( changes[0].second, object_modified );
+
+      witness_changes = 0;
+      generate_block();
+      BOOST_CHECK( witness_changes > 0 );
+
+      account_conn.disconnect();
+      changes.clear();
+      db.modify( db.get_account( "alice" ), [&]( account_object& a ) { a.post_count++; } );
+      BOOST_CHECK( changes.empty() );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_FIXTURE_TEST_CASE( skip_block, clean_database_fixture )
 {
    try
@@ -700,6 +1260,283 @@ BOOST_FIXTURE_TEST_CASE( skip_block, clean_database_fixture )
    FC_LOG_AND_RETHROW();
 }
 
+BOOST_FIXTURE_TEST_CASE( prepared_block_hashes, clean_database_fixture )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing prepared blocks hash the same as the signed_block methods" );
+      prepared_block_ptr applied;
+      boost::signals2::scoped_connection conn = db.applied_prepared_block.connect(
+         [&]( const prepared_block_ptr& b ) { applied = b; } );
+
+      ACTORS( (alice)(bob)(carol) )
+      generate_block();
+
+      BOOST_REQUIRE( applied );
+      BOOST_CHECK( applied->id() == db.head_block_id() );
+
+      auto block = *db.fetch_block_by_number( db.head_block_num() );
+      BOOST_REQUIRE( block.transactions.size() >= 3 );
+
+      auto check = [&]( const prepared_block& p )
+      {
+         BOOST_CHECK( p.id() == block.id() );
+         BOOST_CHECK( p.merkle_root() == block.calculate_merkle_root() );
+         BOOST_CHECK( p.merkle_root() == block.transaction_merkle_root );
+         BOOST_CHECK_EQUAL( p.packed_size(), fc::raw::pack_size( block ) );
+
+         auto packed = fc::raw::pack( block );
+         BOOST_CHECK( std::equal( packed.begin(), packed.end(), p.packed().data() ) );
+
+         BOOST_REQUIRE_EQUAL( p.transactions().size(), block.transactions.size() );
+         for( size_t i = 0; i < block.transactions.size(); ++i )
+         {
+            const auto& trx = block.transactions[i];
+            BOOST_CHECK( p.transactions()[i].id == trx.id() );
+            BOOST_CHECK( p.transactions()[i].sig_digest == trx.sig_digest( db.get_chain_id() ) );
+            BOOST_CHECK( p.transactions()[i].merkle_digest == trx.merkle_digest() );
+            BOOST_CHECK_EQUAL( p.transactions()[i].packed_size, fc::raw::pack_size( trx ) );
+         }
+      };
+
+      check( *applied );
+      check( *prepared_block::create( block ) );
+      check( *prepared_block::create( packed_block( block ) ) );
+
+      BOOST_TEST_MESSAGE( "--- Test trailing bytes are rejected" );
+      auto padded = fc::raw::pack( block );
+      padded.push_back( 0 );
+      auto owner = std::make_shared< vector< char > >( padded );
+      BOOST_REQUIRE_THROW( prepared_block::create( packed_block( owner, owner->data(), owner->size() ) ), fc::exception );
+
+      BOOST_TEST_MESSAGE( "--- Test blocks are served from the bytes they were prepared from" );
+      auto served = db.fetch_packed_block_by_id( db.head_block_id() );
+      BOOST_CHECK( served.data() == applied->packed().data() );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( single_apply_production, clean_database_fixture )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing blocks are produced with one apply of each pending transaction" );
+      ACTORS( (alice)(bob) )
+      fund( "alice", ASSET( "100.000 TESTS" ) );
+      generate_block();
+
+      uint32_t applied = 0;
+      boost::signals2::scoped_connection conn = db.on_pre_apply_transaction.connect(
+         [&]( const signed_transaction& ) { ++applied; } );
+
+      auto push_transfers = [&]( uint32_t count )
+      {
+         for( uint32_t i = 0; i < count; ++i )
+         {
+            transfer_operation op;
+            op.from = "alice";
+            op.to = "bob";
+            op.amount = ASSET( "1.000 TESTS" );
+            op.memo = fc::to_string( db.head_block_num() ) + "-" + fc::to_string( i );
+
+            signed_transaction tx;
+            tx.operations.push_back( op );
+            tx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+            tx.sign( alice_private_key, db.get_chain_id() );
+            db.push_transaction( tx, 0 );
+         }
+      };
+
+      BOOST_TEST_MESSAGE( "--- Test the legacy path applies each transaction twice more" );
+      push_transfers( 3 );
+      applied = 0;
+      generate_block();
+      BOOST_CHECK_EQUAL( db.fetch_block_by_number( db.head_block_num() )->transactions.size(), 3u );
+      BOOST_CHECK_EQUAL( applied, 6u );
+
+      BOOST_TEST_MESSAGE( "--- Test the block is built and applied in place" );
+      db.set_single_apply_production( true );
+      auto bob_balance = db.get_account( "bob" ).balance;
+      push_transfers( 3 );
+      applied = 0;
+      generate_block();
+
+      auto block = *db.fetch_block_by_number( db.head_block_num() );
+      BOOST_CHECK_EQUAL( block.transactions.size(), 3u );
+      BOOST_CHECK_EQUAL( applied, 3u );
+      BOOST_CHECK( block.transaction_merkle_root == block.calculate_merkle_root() );
+      BOOST_CHECK( db.head_block_id() == block.id() );
+      BOOST_CHECK( db._pending_tx.empty() );
+      BOOST_CHECK( db.get_account( "bob" ).balance == bob_balance + ASSET( "3.000 TESTS" ) );
+      validate_database();
+
+      BOOST_TEST_MESSAGE( "--- Test a transaction failing in the block is left out of it" );
+      push_transfers( 2 );
+      transfer_operation overdraft;
+      overdraft.from = "bob";
+      overdraft.to = "alice";
+      overdraft.amount = ASSET( "1000.000 TESTS" );
+      signed_transaction bad;
+      bad.operations.push_back( overdraft );
+      bad.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+      bad.sign( bob_private_key, db.get_chain_id() );
+      db._pending_tx.add( bad, bad.id() );
+
+      uint32_t blocks_started = 0;
+      boost::signals2::scoped_connection block_conn = db.pre_apply_block.connect(
+         [&]( const signed_block& ) { ++blocks_started; } );
+      applied = 0;
+      generate_block();
+      block_conn.disconnect();
+
+      block = *db.fetch_block_by_number( db.head_block_num() );
+      BOOST_CHECK_EQUAL( block.transactions.size(), 2u );
+      BOOST_CHECK_EQUAL( blocks_started, 1u );
+      BOOST_CHECK_EQUAL( applied, 3u );
+      BOOST_CHECK( db.get_account( "bob" ).balance == bob_balance + ASSET( "5.000 TESTS" ) );
+      BOOST_CHECK( db._pending_tx.empty() );
+      validate_database();
+
+      BOOST_TEST_MESSAGE( "--- Test blocks produced in place are accepted by a peer" );
+      BOOST_CHECK( db.fetch_block_by_id( db.head_block_id() ).valid() );
+      db.pop_block();
+      db.push_block( block, 0 );
+      BOOST_CHECK( db.head_block_id() == block.id() );
+
+      BOOST_TEST_MESSAGE( "--- Test a failing transaction is dropped when the block does not change its accounts" );
+      auto push_overdraft = [&]( const string& memo )
+      {
+         overdraft.memo = memo;
+         signed_transaction trx;
+         trx.operations.push_back( overdraft );
+         trx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+         trx.sign( bob_private_key, db.get_chain_id() );
+         db._pending_tx.add( trx, trx.id() );
+      };
+
+      auto invalidated = db._pending_tx.get_stats().invalidated;
+      push_overdraft( "in place" );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.fetch_block_by_number( db.head_block_num() )->transactions.size(), 0u );
+      BOOST_CHECK( db._pending_tx.empty() );
+      BOOST_CHECK_EQUAL( db._pending_tx.get_stats().invalidated, invalidated + 1 );
+
+      db.set_single_apply_production( false );
+      push_overdraft( "rebuild" );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.fetch_block_by_number( db.head_block_num() )->transactions.size(), 0u );
+      BOOST_CHECK( db._pending_tx.empty() );
+      BOOST_CHECK_EQUAL( db._pending_tx.get_stats().invalidated, invalidated + 2 );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( pending_transaction_pool )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing the limits, eviction and revalidation of the transaction pool" );
+      time_point_sec now( 1000000 );
+
+      auto make_trx = [&]( const string& from, int64_t amount, uint32_t expires_in ) -> signed_transaction
+      {
+         transfer_operation op;
+         op.from = from;
+         op.to = "bob";
+         op.amount = asset( amount, WLS_SYMBOL );
+
+         signed_transaction trx;
+         trx.operations.push_back( op );
+         trx.expiration = now + expires_in;
+         return trx;
+      };
+
+      wls::chain::transaction_pool pool( 4, 1024 * 1024, 3 );
+      auto add = [&]( const signed_transaction& trx ) { pool.add( trx, trx.id() ); };
+
+      BOOST_TEST_MESSAGE( "--- Test the per sender limit" );
+      for( int64_t i = 1; i <= 3; ++i )
+         add( make_trx( "alice", i, 60 ) );
+      BOOST_REQUIRE_THROW( pool.check_sender( make_trx( "alice", 4, 60 ) ), fc::exception );
+      pool.check_sender( make_trx( "carol", 1, 120 ) );
+
+      BOOST_TEST_MESSAGE( "--- Test the newest transaction of the largest sender is evicted" );
+      add( make_trx( "carol", 1, 120 ) );
+      add( make_trx( "dave", 1, 120 ) );
+      BOOST_CHECK_EQUAL( pool.size(), 4u );
+      BOOST_CHECK( pool.contains( make_trx( "alice", 1, 60 ).id() ) );
+      BOOST_CHECK( !pool.contains( make_trx( "alice", 3, 60 ).id() ) );
+      BOOST_CHECK_EQUAL( pool.get_stats().evicted, 1u );
+
+      BOOST_TEST_MESSAGE( "--- Test a transaction that would evict itself is refused" );
+      BOOST_REQUIRE_THROW( add( make_trx( "alice", 5, 60 ) ), fc::exception );
+      BOOST_CHECK_EQUAL( pool.size(), 4u );
+      BOOST_CHECK_EQUAL( pool.get_stats().rejected, 2u );
+
+      BOOST_TEST_MESSAGE( "--- Test only transactions of changed accounts are applied again" );
+      vector< account_name_type > applied;
+      account_name_type fail;
+      auto apply = [&]( const signed_transaction& trx )
+      {
+         auto from = trx.operations.front().get< transfer_operation >().from;
+         FC_ASSERT( from != fail );
+         applied.push_back( from );
+      };
+
+      pool.state_popped();
+      BOOST_CHECK_EQUAL( pool.unapplied(), 4u );
+      pool.account_changed( "carol" );
+      pool.revalidate( apply );
+      BOOST_REQUIRE_EQUAL( applied.size(), 1u );
+      BOOST_CHECK( applied[0] == "carol" );
+      BOOST_CHECK_EQUAL( pool.unapplied(), 3u );
+      BOOST_CHECK_EQUAL( pool.get_stats().kept, 3u );
+
+      BOOST_TEST_MESSAGE( "--- Test a failing transaction is tried again after the unapplied ones" );
+      applied.clear();
+      pool.state_popped();
+      pool.account_changed( "dave" );
+      bool failed_once = false;
+      pool.revalidate( [&]( const signed_transaction& trx )
+      {
+         if( !failed_once && trx.operations.front().get< transfer_operation >().from == "dave" )
+         {
+            failed_once = true;
+            FC_ASSERT( false );
+         }
+         apply( trx );
+      });
+      BOOST_REQUIRE_EQUAL( applied.size(), 4u );
+      BOOST_CHECK( applied[0] == "alice" );
+      BOOST_CHECK( applied[3] == "dave" );
+      BOOST_CHECK_EQUAL( pool.size(), 4u );
+      BOOST_CHECK_EQUAL( pool.unapplied(), 0u );
+
+      BOOST_TEST_MESSAGE( "--- Test a transaction failing again is dropped" );
+      applied.clear();
+      pool.state_popped();
+      pool.account_changed( "dave" );
+      fail = "dave";
+      pool.revalidate( apply );
+      BOOST_CHECK_EQUAL( applied.size(), 3u );
+      BOOST_CHECK_EQUAL( pool.size(), 3u );
+      BOOST_CHECK( !pool.contains( make_trx( "dave", 1, 120 ).id() ) );
+      BOOST_CHECK_EQUAL( pool.get_stats().invalidated, 1u );
+
+      BOOST_TEST_MESSAGE( "--- Test expired and included transactions are removed" );
+      auto carol_id = make_trx( "carol", 1, 120 ).id();
+      pool.remove_stale( now + 60, [&]( const transaction_id_type& id ) { return id == carol_id; } );
+      BOOST_CHECK( pool.empty() );
+
+      auto stats = pool.get_stats();
+      BOOST_CHECK_EQUAL( stats.expired, 2u );
+      BOOST_CHECK_EQUAL( stats.included, 1u );
+      BOOST_CHECK_EQUAL( stats.bytes, 0u );
+      BOOST_CHECK_EQUAL( stats.senders, 0u );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 //BOOST_FIXTURE_TEST_CASE( hardfork_test, database_fixture )
 //{
 //   try
@@ -0,0 +1,350 @@
+#ifdef IS_TEST_NET
+#include <boost/test/unit_test.hpp>
+#include <boost/program_options.hpp>
+
+#include <wls/account_history/account_history_plugin.hpp>
+#include <wls/app/api_context.hpp>
+#include <wls/app/database_api.hpp>
+#include <wls/follow/follow_objects.hpp>
+#include <wls/follow/follow_operations.hpp>
+#include <wls/follow/follow_plugin.hpp>
+#include <wls/follow/merged_feed.hpp>
+#include <wls/witness/witness_plugin.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <algorithm>
+
+#include "../common/database_fixture.hpp"
+
+using namespace wls;
+using namespace wls::chain;
+using namespace wls::protocol;
+
+namespace {
+
+   /// clean_database_fixture with the follow plugin, whose indexes must exist before the database opens
+   struct follow_database_fixture : public database_fixture
+   {
+      follow_database_fixture( const string& feed_mode = "fan-out" )
+      {
+         try
+         {
+            auto ahplugin = app.register_plugin< wls::account_history::account_history_plugin >();
+            db_plugin = app.register_plugin< wls::plugin::debug_node::debug_node_plugin >();
+            auto wit_plugin = app.register_plugin< wls::witness::witness_plugin >();
+            follow_plugin = app.register_plugin< wls::follow::follow_plugin >();
+
+            boost::program_options::variables_map options;
+            options.insert( std::make_pair( "follow-feed-mode", boost::program_options::variable_value( feed_mode, false ) ) );
+
+            db_plugin->logging = false;
+            ahplugin->plugin_initialize( options );
+            db_plugin->plugin_initialize( options );
+            wit_plugin->plugin_initialize( options );
+            follow_plugin->plugin_initialize( options );
+
+            open_database();
+
+            generate_block();
+            db.set_hardfork( WLS_NUM_HARDFORKS );
+            generate_block();
+
+            db_plugin->plugin_startup();
+            vest( "initminer", 10000 );
+            validate_database();
+         }
+         catch( const fc::exception& e )
+         {
+            edump( (e.to_detail_string()) );
+            throw;
+         }
+      }
+
+      ~follow_database_fixture()
+      {
+         if( data_dir )
+            db.close();
+      }
+
+      std::shared_ptr< wls::follow::follow_plugin > follow_plugin;
+   };
+
+   struct merge_feeds_database_fixture : public follow_database_fixture
+   {
+      merge_feeds_database_fixture() : follow_database_fixture( "merge" ) {}
+   };
+
+   /// An entry of a feed, with the accounts that reblogged it sorted
+   struct listed_entry
+   {
+      comment_id_type               comment;
+      vector< account_name_type >   reblog_by;
+
+      bool operator == ( const listed_entry& other )const { return comment == other.comment && reblog_by == other.reblog_by; }
+   };
+
+   /// The feed written to feed_index as blocks were applied, as get_feed returns it in fan-out mode
+   vector< listed_entry > fan_out_feed( const database& db, const account_name_type& account )
+   {
+      vector< listed_entry > result;
+      const auto& feed_idx = db.get_index< follow::feed_index >().indices().get< follow::by_feed >();
+      for( auto itr = feed_idx.lower_bound( account ); itr != feed_idx.end() && itr->account == account; ++itr )
+      {
+         listed_entry e;
+         e.comment = itr->comment;
+         if( itr->first_reblogged_by != account_name_type() )
+            e.reblog_by.assign( itr->reblogged_by.begin(), itr->reblogged_by.end() );
+         std::sort( e.reblog_by.begin(), e.reblog_by.end() );
+         result.push_back( e );
+      }
+      return result;
+   }
+
+   vector< listed_entry > listed( const vector< follow::merged_feed_entry >& feed )
+   {
+      vector< listed_entry > result;
+      for( const auto& f : feed )
+      {
+         listed_entry e;
+         e.comment = f.comment;
+         e.reblog_by = f.reblog_by;
+         std::sort( e.reblog_by.begin(), e.reblog_by.end() );
+         result.push_back( e );
+      }
+      return result;
+   }
+
+}
+
+BOOST_FIXTURE_TEST_SUITE( follow_tests, follow_database_fixture )
+
+BOOST_AUTO_TEST_CASE( merged_feed_matches_fan_out )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing feeds merged from blogs list what fan-out feeds do" );
+      ACTORS( (alice)(bob)(carol)(dave)(eve)(frank)(gina) )
+      generate_block();
+
+      auto push = [&]( const operation& op )
+      {
+         signed_transaction tx;
+         tx.operations.push_back( op );
+         tx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+         db.push_transaction( tx, database::skip_transaction_signatures );
+      };
+
+      auto push_follow_op = [&]( const account_name_type& account, const follow::follow_plugin_operation& op )
+      {
+         custom_json_operation cop;
+         cop.required_posting_auths.insert( account );
+         cop.id = FOLLOW_PLUGIN_NAME;
+         cop.json = fc::json::to_string( op );
+         push( cop );
+      };
+
+      auto post = [&]( const string& author )
+      {
+         comment_operation com;
+         com.author = author;
+         com.permlink = "mypost";
+         com.parent_author = WLS_ROOT_POST_PARENT;
+         com.parent_permlink = "test";
+         com.title = "Hello from " + author;
+         com.body = "Hello, my name is " + author;
+         push( com );
+      };
+
+      auto reblog = [&]( const string& account, const string& author )
+      {
+         follow::reblog_operation op;
+         op.account = account;
+         op.author = author;
+         op.permlink = "mypost";
+         push_follow_op( account, op );
+      };
+
+      for( const string& following : { "bob", "carol", "dave", "eve" } )
+      {
+         follow::follow_operation op;
+         op.follower = "alice";
+         op.following = following;
+         op.what.insert( "blog" );
+         push_follow_op( "alice", op );
+      }
+      generate_block();
+
+      post( "frank" );
+      post( "gina" );
+      generate_block();
+
+      // Three entries in the same second, listed by comment id
+      post( "bob" );
+      post( "carol" );
+      post( "dave" );
+      generate_block();
+
+      // frank's post is listed once, reblogged by both
+      reblog( "eve", "frank" );
+      generate_block();
+      reblog( "bob", "frank" );
+      generate_block();
+
+      reblog( "carol", "gina" );
+      generate_block();
+
+      post( "eve" );
+      generate_block();
+
+      follow::merged_feed merger( 0 );
+      auto merged = merger.get_feed( db, "alice", 0, 500 );
+      auto expected = fan_out_feed( db, "alice" );
+
+      BOOST_TEST_MESSAGE( "--- Test the merged feed lists the fan-out entries in the same order" );
+      BOOST_REQUIRE_EQUAL( expected.size(), 6u );
+      BOOST_REQUIRE_EQUAL( merged.size(), expected.size() );
+      BOOST_CHECK( listed( merged ) == expected );
+
+      const auto& frank_post = db.get_comment( "frank", string( "mypost" ) );
+      BOOST_CHECK( merged[2].comment == frank_post.id );
+      BOOST_REQUIRE_EQUAL( merged[2].reblog_by.size(), 2u );
+      BOOST_CHECK( merged[2].reblog_on == merged[2].time );
+      BOOST_CHECK( merged[0].reblog_by.empty() );
+      BOOST_CHECK( merged[0].reblog_on == time_point_sec() );
+
+      BOOST_TEST_MESSAGE( "--- Test paging by entry_id across entries of the same second" );
+      BOOST_REQUIRE( merged[3].time == merged[5].time );
+
+      vector< follow::merged_feed_entry > paged;
+      uint32_t entry_id = 0;
+      while( true )
+      {
+         auto page = merger.get_feed( db, "alice", entry_id, 3 );
+         BOOST_REQUIRE( page.size() );
+         bool full = page.size() == 3;
+
+         // A page starts with the entry entry_id refers to, which ended the previous one
+         if( entry_id != 0 )
+         {
+            BOOST_CHECK( page.front().comment == paged.back().comment );
+            page.erase( page.begin() );
+         }
+         paged.insert( paged.end(), page.begin(), page.end() );
+
+         if( !full )
+            break;
+         entry_id = paged.back().entry_id;
+      }
+
+      BOOST_CHECK( listed( paged ) == expected );
+
+      BOOST_TEST_MESSAGE( "--- Test the cached first page follows the head block" );
+      follow::merged_feed cached( 10 );
+      BOOST_CHECK( listed( cached.get_feed( db, "alice", 0, 2 ) ) == vector< listed_entry >( expected.begin(), expected.begin() + 2 ) );
+
+      reblog( "dave", "frank" );
+      generate_block();
+      auto first = cached.get_feed( db, "alice", 0, 2 );
+      BOOST_REQUIRE_EQUAL( first.size(), 2u );
+      BOOST_CHECK( first[0].comment == frank_post.id );
+      BOOST_CHECK_EQUAL( first[0].reblog_by.size(), 3u );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( discussions_by_feed_in_merge_mode, merge_feeds_database_fixture )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing get_discussions_by_feed lists merged feeds" );
+      ACTORS( (alice)(bob)(carol)(dave) )
+      generate_block();
+
+      BOOST_REQUIRE( follow_plugin->merge_feeds );
+
+      auto push = [&]( const operation& op )
+      {
+         signed_transaction tx;
+         tx.operations.push_back( op );
+         tx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+         db.push_transaction( tx, database::skip_transaction_signatures );
+      };
+
+      auto push_follow_op = [&]( const account_name_type& account, const follow::follow_plugin_operation& op )
+      {
+         custom_json_operation cop;
+         cop.required_posting_auths.insert( account );
+         cop.id = FOLLOW_PLUGIN_NAME;
+         cop.json = fc::json::to_string( op );
+         push( cop );
+      };
+
+      for( const string& following : { "bob", "carol" } )
+      {
+         follow::follow_operation op;
+         op.follower = "alice";
+         op.following = following;
+         op.what.insert( "blog" );
+         push_follow_op( "alice", op );
+      }
+      generate_block();
+
+      for( const string& author : { "alice", "dave", "bob", "carol" } )
+      {
+         comment_operation com;
+         com.author = author;
+         com.permlink = "mypost";
+         com.parent_author = WLS_ROOT_POST_PARENT;
+         com.parent_permlink = "test";
+         com.title = "Hello from " + author;
+         com.body = "Hello, my name is " + author;
+         push( com );
+         generate_block();
+      }
+
+      follow::reblog_operation reblog;
+      reblog.account = "bob";
+      reblog.author = "dave";
+      reblog.permlink = "mypost";
+      push_follow_op( "bob", reblog );
+      generate_block();
+
+      BOOST_REQUIRE( db.get_index< follow::feed_index >().indices().empty() );
+
+      wls::app::database_api api( wls::app::api_context( app, "database_api", std::weak_ptr< wls::app::api_session_data >() ) );
+      auto merged = follow_plugin->feed_merger->get_feed( db, "alice", 0, 100 );
+
+      BOOST_TEST_MESSAGE( "--- Test the discussions are the entries of the merged feed" );
+      wls::app::discussion_query query;
+      query.tag = "alice";
+      query.limit = 10;
+      auto discussions = api.get_discussions_by_feed( query );
+
+      BOOST_REQUIRE_EQUAL( merged.size(), 3u );
+      BOOST_REQUIRE_EQUAL( discussions.size(), merged.size() );
+      for( size_t i = 0; i < merged.size(); ++i )
+         BOOST_CHECK( discussions[i].id == merged[i].comment );
+
+      BOOST_CHECK_EQUAL( discussions[0].author, "dave" );
+      BOOST_REQUIRE_EQUAL( discussions[0].reblogged_by.size(), 1u );
+      BOOST_CHECK_EQUAL( discussions[0].first_reblogged_by, "bob" );
+      BOOST_CHECK( discussions[1].reblogged_by.empty() );
+
+      BOOST_TEST_MESSAGE( "--- Test paging starts with the start comment" );
+      query.start_author = "carol";
+      query.start_permlink = "mypost";
+      discussions = api.get_discussions_by_feed( query );
+      BOOST_REQUIRE_EQUAL( discussions.size(), 2u );
+      BOOST_CHECK_EQUAL( discussions[0].author, "carol" );
+      BOOST_CHECK_EQUAL( discussions[1].author, "bob" );
+
+      BOOST_TEST_MESSAGE( "--- Test a comment outside the feed is refused as a start" );
+      query.start_author = "alice";
+      BOOST_CHECK_THROW( api.get_discussions_by_feed( query ), fc::exception );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif
@@ -2610,5 +2610,54 @@ BOOST_AUTO_TEST_CASE( comment_beneficiaries_apply )
    FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( hashed_lookup_indices )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: hashed lookup indices agree with the ordered indices" );
+      ACTORS( (alice)(bob) )
+      generate_block();
+
+      vest( "alice", ASSET( "1000.000 TESTS" ) );
+      generate_block();
+
+      comment_operation comment;
+      comment.author = "alice";
+      comment.permlink = "test";
+      comment.parent_permlink = "test";
+      comment.title = "test";
+      comment.body = "foo bar";
+
+      signed_transaction tx;
+      tx.operations.push_back( comment );
+      tx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+      tx.sign( alice_private_key, db.get_chain_id() );
+      db.push_transaction( tx, 0 );
+      generate_block();
+
+      for( const string name : { "alice", "bob", WLS_INIT_MINER_NAME } )
+      {
+         BOOST_REQUIRE( &db.get_account( name ) == &db.get< account_object, by_name >( name ) );
+         BOOST_REQUIRE( db.get< account_authority_object, by_account >( name ).account == name );
+      }
+
+      BOOST_REQUIRE( &db.get_witness( WLS_INIT_MINER_NAME ) == &db.get< witness_object, by_name >( WLS_INIT_MINER_NAME ) );
+      BOOST_REQUIRE( db.find_account( "carol" ) == nullptr );
+      BOOST_REQUIRE( db.find_witness( "alice" ) == nullptr );
+
+      const auto& post = db.get< comment_object, by_permlink >( boost::make_tuple( "alice", string( "test" ) ) );
+      BOOST_REQUIRE( &db.get_comment( "alice", string( "test" ) ) == &post );
+      BOOST_REQUIRE( &db.get_comment( "alice", post.permlink ) == &post );
+      BOOST_REQUIRE( db.find_comment( "alice", string( "tes" ) ) == nullptr );
+      BOOST_REQUIRE( db.find_comment( "bob", string( "test" ) ) == nullptr );
+
+      BOOST_TEST_MESSAGE( "--- Test undo removes objects from the hashed indices" );
+      db.pop_block();
+      BOOST_REQUIRE( db.find_comment( "alice", string( "test" ) ) == nullptr );
+      BOOST_REQUIRE( db.find< comment_object, by_permlink >( boost::make_tuple( "alice", string( "test" ) ) ) == nullptr );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 #endif
@@ -1839,5 +1839,113 @@ BOOST_AUTO_TEST_CASE( clear_null_account )
    FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( cashout_plan_matches_serial )
+{
+   try
+   {
+      ACTORS( (alice)(bob)(dave)(ulysses)(vivian)(wendy) )
+
+      vector< string > authors = { "alice", "bob", "dave" };
+      vector< string > voters = { "ulysses", "vivian", "wendy" };
+
+      for( const auto& voter : voters )
+      {
+         fund( voter, 10000 );
+         vest( voter, 10000 );
+      }
+
+      for( const auto& author : authors )
+      {
+         comment_operation com;
+         com.author = author;
+         com.permlink = "mypost";
+         com.parent_author = WLS_ROOT_POST_PARENT;
+         com.parent_permlink = "test";
+         com.title = "Hello from " + author;
+         com.body = "Hello, my name is " + author;
+
+         signed_transaction tx;
+         tx.operations.push_back( com );
+         tx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+         tx.sign( generate_private_key( author ), db.get_chain_id() );
+         db.push_transaction( tx, 0 );
+      }
+
+      generate_blocks( 1 );
+
+      // Every voter votes on every post, so each payout has several curators. Accounts can only
+      // vote once per block.
+      for( const auto& author : authors )
+      {
+         for( const auto& voter : voters )
+         {
+            vote_operation vote;
+            vote.voter = voter;
+            vote.author = author;
+            vote.permlink = "mypost";
+            vote.weight = WLS_100_PERCENT;
+
+            signed_transaction tx;
+            tx.operations.push_back( vote );
+            tx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+            tx.sign( generate_private_key( voter ), db.get_chain_id() );
+            db.push_transaction( tx, 0 );
+         }
+
+         generate_blocks( 1 );
+      }
+
+      generate_blocks( 10 );
+      generate_blocks( db.get_comment( "alice", string( "mypost" ) ).cashout_time - WLS_BLOCK_INTERVAL, true );
+      BOOST_REQUIRE( db.get_comment( "alice", string( "mypost" ) ).cashout_time > db.head_block_time() );
+
+      auto snapshot = [&]() -> string
+      {
+         fc::mutable_variant_object result;
+         for( const auto& name : authors )
+         {
+            const auto& a = db.get_account( name );
+            const auto& c = db.get_comment( name, string( "mypost" ) );
+            result( name, fc::mutable_variant_object()( "vesting_shares", a.vesting_shares )( "posting_rewards", a.posting_rewards )
+               ( "total_payout_value", c.total_payout_value )( "curator_payout_value", c.curator_payout_value )
+               ( "author_rewards", c.author_rewards )( "net_rshares", c.net_rshares )( "cashout_time", c.cashout_time ) );
+         }
+
+         for( const auto& name : voters )
+         {
+            const auto& a = db.get_account( name );
+            result( name, fc::mutable_variant_object()( "vesting_shares", a.vesting_shares )( "curation_rewards", a.curation_rewards ) );
+         }
+
+         const auto& gpo = db.get_dynamic_global_properties();
+         const auto& rf = db.get< reward_fund_object, by_name >( WLS_POST_REWARD_FUND_NAME );
+         result( "total_vesting_shares", gpo.total_vesting_shares )( "total_vesting_fund_steem", gpo.total_vesting_fund_steem )
+               ( "reward_balance", rf.reward_balance )( "recent_claims", rf.recent_claims );
+         return fc::json::to_string( result );
+      };
+
+      BOOST_TEST_MESSAGE( "--- Paying out from plans computed on the worker threads" );
+      // Three comments are due, so the threshold is lowered for them to be split between the threads
+      db.set_cashout_threads( 2, 1 );
+      generate_block();
+      BOOST_REQUIRE( db.get_comment( "alice", string( "mypost" ) ).cashout_time == fc::time_point_sec::maximum() );
+      BOOST_REQUIRE( db.get_account( "alice" ).posting_rewards > 0 );
+      BOOST_REQUIRE( db.get_account( "ulysses" ).curation_rewards > 0 );
+
+      string planned = snapshot();
+      auto block = db.fetch_block_by_number( db.head_block_num() );
+      BOOST_REQUIRE( block.valid() );
+
+      BOOST_TEST_MESSAGE( "--- Paying the same block out one comment at a time" );
+      db.pop_block();
+      db.clear_pending();
+      db.set_cashout_threads( 0 );
+      db.push_block( *block, database::skip_witness_signature );
+
+      BOOST_REQUIRE_EQUAL( snapshot(), planned );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 #endif
@@ -0,0 +1,232 @@
+#ifdef IS_TEST_NET
+#include <boost/test/unit_test.hpp>
+#include <boost/program_options.hpp>
+
+#include <wls/app/application.hpp>
+#include <wls/chain/database.hpp>
+#include <wls/protocol/wls_operations.hpp>
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message_oriented_connection.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+
+using namespace wls;
+using namespace wls::chain;
+using namespace wls::protocol;
+
+namespace bpo = boost::program_options;
+
+namespace {
+
+   /// An application listening on a local port with its own data directory
+   struct p2p_test_node
+   {
+      fc::temp_directory      data_dir;
+      bpo::variables_map      options;
+      wls::app::application   app;
+
+      p2p_test_node() : data_dir( graphene::utilities::temp_directory_path() )
+      {
+         bpo::options_description cli, cfg;
+         app.set_program_options( cli, cfg );
+         cli.add( cfg );
+
+         const char* argv[] = { "p2p_test", "--shared-file-size", "64M", "--p2p-endpoint", "127.0.0.1:0" };
+         bpo::store( bpo::parse_command_line( 5, argv, cli ), options );
+         bpo::notify( options );
+
+         app.initialize( data_dir.path(), options );
+         app.startup();
+      }
+
+      ~p2p_test_node() { app.shutdown(); }
+
+      database& db() { return *app.chain_database(); }
+   };
+
+   /// Waits for condition while letting the p2p and delegate tasks run, returns false on timeout
+   template< typename Condition >
+   bool wait_for( Condition condition, fc::microseconds timeout = fc::seconds( 10 ) )
+   {
+      auto deadline = fc::time_point::now() + timeout;
+      while( !condition() )
+      {
+         if( fc::time_point::now() > deadline )
+            return false;
+         fc::usleep( fc::milliseconds( 5 ) );
+      }
+      return true;
+   }
+
+   bool has_cached_transaction( p2p_test_node& node, const transaction_id_type& id )
+   {
+      try
+      {
+         node.app.p2p_node()->get_transaction_propagation_data( id );
+         return true;
+      }
+      catch( const fc::key_not_found_exception& )
+      {
+         return false;
+      }
+   }
+
+   uint64_t compact_blocks_info( p2p_test_node& node, const char* counter )
+   {
+      return node.app.p2p_node()->network_get_info()[ "compact_blocks" ].get_object()[ counter ].as_uint64();
+   }
+
+   struct recording_connection_delegate : public graphene::net::message_oriented_connection_delegate
+   {
+      std::vector< graphene::net::message > messages;
+
+      void on_message( graphene::net::message_oriented_connection*, const graphene::net::message& received_message ) override
+      {
+         messages.push_back( received_message );
+      }
+      void on_connection_closed( graphene::net::message_oriented_connection* ) override {}
+   };
+
+   /// A message whose bytes depend on seed, so one delivered out of place or corrupted is told apart
+   graphene::net::message make_test_message( uint32_t seed, uint32_t size )
+   {
+      graphene::net::message m;
+      m.msg_type = graphene::net::block_message_type;
+      m.data.resize( size );
+      for( uint32_t i = 0; i < size; ++i )
+         m.data[i] = char( ( seed * 31 + i ) & 0xff );
+      m.size = size;
+      return m;
+   }
+
+}
+
+BOOST_AUTO_TEST_SUITE(p2p_tests)
+
+BOOST_AUTO_TEST_CASE( stcp_batched_round_trip )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing messages sent singly and in batches arrive intact and in order" );
+      fc::tcp_server server;
+      server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+
+      recording_connection_delegate receiver_delegate;
+      graphene::net::message_oriented_connection receiver( &receiver_delegate );
+      graphene::net::message_oriented_connection sender;
+
+      auto accepted = fc::async( [&]()
+      {
+         server.accept( receiver.get_socket() );
+         receiver.accept();
+      }, "accept test connection" );
+      sender.connect_to( server.get_local_endpoint() );
+      accepted.wait();
+
+      // Sizes around the 16 byte encryption blocks, the first of which holds the 8 byte header,
+      // with a few large enough to span several reads
+      std::vector< graphene::net::message > sent;
+      const uint32_t sizes[] = { 8, 9, 15, 16, 24, 25, 4096, 70000 };
+      for( uint32_t i = 0; i < 40; ++i )
+         sent.push_back( make_test_message( i, sizes[ i % 8 ] ) );
+
+      for( uint32_t i = 0; i < 8; ++i )
+         sender.send_message( sent[i] );
+      sender.send_messages( std::vector< graphene::net::message >( sent.begin() + 8, sent.begin() + 24 ) );
+      sender.send_messages( std::vector< graphene::net::message >( sent.begin() + 24, sent.begin() + 25 ) );
+      sender.send_messages( std::vector< graphene::net::message >( sent.begin() + 25, sent.end() ) );
+
+      BOOST_REQUIRE( wait_for( [&]() { return receiver_delegate.messages.size() == sent.size(); } ) );
+      for( size_t i = 0; i < sent.size(); ++i )
+      {
+         const auto& received = receiver_delegate.messages[i];
+         BOOST_CHECK_EQUAL( received.msg_type, sent[i].msg_type );
+         BOOST_CHECK_EQUAL( received.size, sent[i].size );
+         BOOST_CHECK( received.data == sent[i].data );
+      }
+
+      sender.close_connection();
+      receiver.destroy_connection();
+      sender.destroy_connection();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( compact_block_relay )
+{
+   try
+   {
+      auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+      public_key_type init_account_pub_key = init_account_priv_key.get_public_key();
+
+      // a - b - c, so blocks reach c through b's cache of relayed transactions
+      p2p_test_node a, b, c;
+      b.app.p2p_node()->connect_to_endpoint( a.app.p2p_node()->get_actual_listening_endpoint() );
+      c.app.p2p_node()->connect_to_endpoint( b.app.p2p_node()->get_actual_listening_endpoint() );
+      BOOST_REQUIRE( wait_for( [&]() { return a.app.p2p_node()->get_connection_count() == 1 && c.app.p2p_node()->get_connection_count() == 1; } ) );
+
+      uint32_t account_number = 0;
+      auto create_accounts = [&]( uint32_t count, bool relay )
+      {
+         vector< signed_transaction > trxs;
+         for( uint32_t i = 0; i < count; ++i )
+         {
+            signed_transaction trx;
+            account_create_operation cop;
+            cop.new_account_name = "p2p" + fc::to_string( account_number++ );
+            cop.creator = WLS_INIT_MINER_NAME;
+            cop.owner = authority( 1, init_account_pub_key, 1 );
+            cop.active = cop.owner;
+            trx.operations.push_back( cop );
+            trx.set_expiration( a.db().head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+            trx.sign( init_account_priv_key, a.db().get_chain_id() );
+            a.db().push_transaction( trx );
+            if( relay )
+               a.app.p2p_node()->broadcast( graphene::net::trx_message( trx ) );
+            trxs.push_back( trx );
+         }
+
+         if( relay )
+         {
+            auto last_id = trxs.back().id();
+            BOOST_REQUIRE( wait_for( [&]() { return has_cached_transaction( c, last_id ); } ) );
+         }
+      };
+
+      auto produce_and_time_block = [&]() -> fc::microseconds
+      {
+         auto block = a.db().generate_block( a.db().get_slot_time( 1 ), a.db().get_scheduled_witness( 1 ), init_account_priv_key, database::skip_nothing );
+         auto start = fc::time_point::now();
+         a.app.p2p_node()->broadcast( graphene::net::block_message( block ) );
+         BOOST_REQUIRE( wait_for( [&]() { return c.db().head_block_id() == block.id(); } ) );
+         return fc::time_point::now() - start;
+      };
+
+      // Transactions relayed ahead of the block are rebuilt from the message cache
+      create_accounts( 50, true );
+      auto relayed_time = produce_and_time_block();
+      BOOST_CHECK( c.db().find_account( "p2p49" ) != nullptr );
+      BOOST_CHECK_EQUAL( compact_blocks_info( c, "received" ), 1u );
+      BOOST_CHECK_EQUAL( compact_blocks_info( c, "completed_from_cache" ), 1u );
+      BOOST_CHECK_EQUAL( compact_blocks_info( c, "transactions_requested" ), 0u );
+
+      // Transactions the peers never saw are fetched by index along each hop
+      create_accounts( 50, false );
+      auto unrelayed_time = produce_and_time_block();
+      BOOST_CHECK( c.db().find_account( "p2p99" ) != nullptr );
+      BOOST_CHECK_EQUAL( compact_blocks_info( c, "received" ), 2u );
+      BOOST_CHECK_EQUAL( compact_blocks_info( c, "transactions_requested" ), 50u );
+      BOOST_CHECK_EQUAL( compact_blocks_info( b, "transactions_sent" ), 50u );
+      BOOST_CHECK_EQUAL( compact_blocks_info( a, "sent" ), 2u );
+
+      BOOST_TEST_MESSAGE( "Block propagation over two hops: " << relayed_time.count() << "us with relayed transactions, "
+                          << unrelayed_time.count() << "us without" );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif
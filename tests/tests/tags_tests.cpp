@@ -0,0 +1,159 @@
+#ifdef IS_TEST_NET
+#include <boost/test/unit_test.hpp>
+
+#include <wls/chain/comment_object.hpp>
+#include <wls/tags/tag_ranking_index.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace wls;
+using namespace wls::chain;
+using namespace wls::protocol;
+
+namespace {
+
+   /// The permlinks of the comments ranked by sort in tag, below parent
+   vector< string > ranked( const database& db, const tags::tag_ranking_index& ranking, tags::ranking_sort sort,
+                            const string& tag, comment_id_type parent = comment_id_type() )
+   {
+      tags::ranking_query q;
+      q.sort = sort;
+      q.tag = tag;
+      q.parent = parent;
+
+      vector< string > result;
+      ranking.visit( q, [&]( const tags::ranking_entry& e ) -> bool
+      {
+         result.push_back( to_string( db.get( e.comment ).permlink ) );
+         return true;
+      });
+      return result;
+   }
+
+   /// Checks the rankings kept up to date block by block match rankings rebuilt from the current state
+   void check_rebuilt( database& db, const tags::tag_ranking_index& ranking, comment_id_type parent )
+   {
+      tags::tag_ranking_index rebuilt( db );
+      rebuilt.start();
+
+      for( auto sort : { tags::rank_by_created, tags::rank_by_active, tags::rank_by_votes, tags::rank_by_children,
+                         tags::rank_by_hot, tags::rank_by_trending, tags::rank_by_payout } )
+      {
+         for( const string tag : { "", "wls", "photo" } )
+         {
+            BOOST_CHECK( ranked( db, ranking, sort, tag ) == ranked( db, rebuilt, sort, tag ) );
+            BOOST_CHECK( ranked( db, ranking, sort, tag, parent ) == ranked( db, rebuilt, sort, tag, parent ) );
+         }
+      }
+
+      auto tags = ranking.get_trending_tags( "", 10 );
+      auto rebuilt_tags = rebuilt.get_trending_tags( "", 10 );
+      BOOST_REQUIRE_EQUAL( tags.size(), rebuilt_tags.size() );
+      for( size_t i = 0; i < tags.size(); ++i )
+      {
+         BOOST_CHECK_EQUAL( tags[i].tag, rebuilt_tags[i].tag );
+         BOOST_CHECK_EQUAL( tags[i].top_posts, rebuilt_tags[i].top_posts );
+         BOOST_CHECK_EQUAL( tags[i].comments, rebuilt_tags[i].comments );
+         BOOST_CHECK_EQUAL( tags[i].net_votes, rebuilt_tags[i].net_votes );
+      }
+   }
+
+}
+
+BOOST_FIXTURE_TEST_SUITE( tags_tests, clean_database_fixture )
+
+BOOST_AUTO_TEST_CASE( tag_ranking_index )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: tag_ranking_index follows posts, votes and replies once per block" );
+      ACTORS( (alice)(bob)(carol)(dave) )
+      generate_block();
+
+      vest( "alice", ASSET( "1000.000 TESTS" ) );
+      vest( "bob", ASSET( "1000.000 TESTS" ) );
+      vest( "carol", ASSET( "1000.000 TESTS" ) );
+      vest( "dave", ASSET( "1000.000 TESTS" ) );
+      generate_block();
+
+      tags::tag_ranking_index ranking( db );
+      ranking.start();
+
+      auto push = [&]( const operation& op, const fc::ecc::private_key& key )
+      {
+         signed_transaction tx;
+         tx.operations.push_back( op );
+         tx.set_expiration( db.head_block_time() + WLS_MAX_TIME_UNTIL_EXPIRATION );
+         tx.sign( key, db.get_chain_id() );
+         db.push_transaction( tx, 0 );
+      };
+
+      auto post = [&]( const string& author, const fc::ecc::private_key& key, const string& permlink, const string& tags,
+                       const string& parent_author, const string& parent_permlink )
+      {
+         comment_operation op;
+         op.author = author;
+         op.permlink = permlink;
+         op.parent_author = parent_author;
+         op.parent_permlink = parent_permlink;
+         op.title = "test";
+         op.body = "foo bar";
+         op.json_metadata = "{\"tags\":[" + tags + "]}";
+         push( op, key );
+         generate_block();
+      };
+
+      post( "alice", alice_private_key, "p1", "\"wls\",\"Photo\"", "", "test" );
+      post( "bob", bob_private_key, "p2", "\"wls\"", "", "test" );
+      post( "carol", carol_private_key, "p3", "\"photo\"", "", "test" );
+
+      BOOST_CHECK( ranked( db, ranking, tags::rank_by_created, "wls" ) == vector< string >( { "p2", "p1" } ) );
+      BOOST_CHECK( ranked( db, ranking, tags::rank_by_created, "photo" ) == vector< string >( { "p3", "p1" } ) );
+      BOOST_CHECK( ranked( db, ranking, tags::rank_by_created, "" ) == vector< string >( { "p3", "p2", "p1" } ) );
+      BOOST_CHECK_EQUAL( ranking.get_tags_used_by_author( db.get_account( "alice" ).id ).size(), 3u );
+
+      BOOST_TEST_MESSAGE( "--- Test votes are ranked with the next block" );
+      vote_operation vote;
+      vote.voter = "alice";
+      vote.author = "bob";
+      vote.permlink = "p2";
+      vote.weight = WLS_100_PERCENT;
+      push( vote, alice_private_key );
+      BOOST_CHECK( ranked( db, ranking, tags::rank_by_votes, "wls" ) == vector< string >( { "p1", "p2" } ) );
+
+      generate_block();
+      BOOST_CHECK( ranked( db, ranking, tags::rank_by_votes, "wls" ) == vector< string >( { "p2", "p1" } ) );
+
+      BOOST_TEST_MESSAGE( "--- Test replies update the ranking of their parents" );
+      post( "dave", dave_private_key, "r1", "\"wls\"", "alice", "p1" );
+      auto p1 = db.get_comment( "alice", string( "p1" ) ).id;
+      BOOST_CHECK( ranked( db, ranking, tags::rank_by_children, "wls" ) == vector< string >( { "p1", "p2" } ) );
+      BOOST_CHECK( ranked( db, ranking, tags::rank_by_created, "wls", p1 ) == vector< string >( { "r1" } ) );
+      check_rebuilt( db, ranking, p1 );
+
+      BOOST_TEST_MESSAGE( "--- Test deleted comments are dropped" );
+      auto r1 = db.get_comment( "dave", string( "r1" ) ).id;
+      BOOST_CHECK( ranking.has_tag( r1, "wls" ) );
+
+      delete_comment_operation del;
+      del.author = "dave";
+      del.permlink = "r1";
+      push( del, dave_private_key );
+      generate_block();
+
+      BOOST_CHECK( !ranking.has_tag( r1, "wls" ) );
+      BOOST_CHECK( ranked( db, ranking, tags::rank_by_created, "wls", p1 ) == vector< string >() );
+      BOOST_CHECK_EQUAL( db.get( p1 ).children, 0u );
+      check_rebuilt( db, ranking, p1 );
+
+      BOOST_TEST_MESSAGE( "--- Test the comments of a popped block are reranked with the block replacing it" );
+      db.pop_block();
+      generate_block();
+      BOOST_CHECK( ranking.get_stats().fork_comments_updated > 0 );
+      check_rebuilt( db, ranking, p1 );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif